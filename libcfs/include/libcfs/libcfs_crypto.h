@@ -204,7 +204,19 @@ int cfs_crypto_hash_update(struct cfs_crypto_hash_desc *desc, const void *buf,
 			   unsigned int buf_len);
 int cfs_crypto_hash_final(struct cfs_crypto_hash_desc *desc,
 			  unsigned char *hash, unsigned int *hash_len);
+
+/**
+ * Return the page, offset in the page and length of the \a idx-th fragment
+ * of the \a data vector passed to cfs_crypto_hash_pages().
+ */
+typedef void (*cfs_crypto_get_frag_t)(void *data, int idx, struct page **page,
+				      unsigned int *offset, unsigned int *len);
+
+int cfs_crypto_hash_pages(enum cfs_crypto_hash_alg hash_alg, void *data,
+			  int count, cfs_crypto_get_frag_t get_frag,
+			  unsigned char *hash, unsigned int *hash_len);
 int cfs_crypto_register(void);
 void cfs_crypto_unregister(void);
 int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg);
+int cfs_crypto_mb_stats_print(char *buf, int len);
 #endif
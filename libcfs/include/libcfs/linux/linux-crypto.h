@@ -53,3 +53,13 @@ void cfs_crypto_crc32_pclmul_unregister(void);
  */
 int cfs_crypto_crc32c_pclmul_register(void);
 void cfs_crypto_crc32c_pclmul_unregister(void);
+
+/**
+ * Functions of the multi-lane bulk checksum engine
+ */
+int cfs_crypto_mb_hash_pages(enum cfs_crypto_hash_alg hash_alg, void *data,
+			     int count, cfs_crypto_get_frag_t get_frag,
+			     unsigned char *hash, unsigned int *hash_len);
+int cfs_crypto_mb_speed(enum cfs_crypto_hash_alg hash_alg);
+void cfs_crypto_mb_performance_test(enum cfs_crypto_hash_alg hash_alg,
+				    int api_speed);
@@ -0,0 +1,597 @@
+/* GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see http://www.gnu.org/licenses
+ *
+ * GPL HEADER END
+ */
+
+/*
+ * Multi-lane bulk checksum engine.
+ *
+ * The checksum of a bulk RPC is one running hash over all of its pages, so
+ * hashing the pages one after the other is bound by the latency of the hash
+ * dependency chain rather than by the throughput of the CPU.  Here the pages
+ * are split into CFS_CRYPTO_MB_LANES contiguous runs that are hashed in
+ * lockstep, and the partial checksums are then combined into exactly the
+ * value the serial hash would have returned, so the wire format does not
+ * change.
+ */
+
+#include <linux/highmem.h>
+#include <linux/random.h>
+#include <linux/zutil.h>
+#include <asm/unaligned.h>
+#ifdef CONFIG_X86_64
+#include <asm/cpufeature.h>
+#endif
+#include <libcfs/libcfs.h>
+#include <libcfs/libcfs_crypto.h>
+#include <libcfs/linux/linux-crypto.h>
+
+#define CFS_CRYPTO_MB_LANES	4
+
+/* reflected CRC32C (Castagnoli) polynomial */
+#define CRC32C_POLY_LE		0x82F63B78
+/* largest prime smaller than 65536 and the adler32 block size, see zlib */
+#define ADLER_BASE		65521U
+#define ADLER_NMAX		5552
+
+struct cfs_crypto_mb_lane {
+	int		 cml_idx;	/* next fragment to map */
+	int		 cml_end;	/* first fragment of the next lane */
+	struct page	*cml_page;	/* currently mapped page */
+	const u8	*cml_addr;	/* current position in cml_page */
+	unsigned int	 cml_left;	/* bytes left in the current fragment */
+	size_t		 cml_nob;	/* bytes hashed by this lane */
+	u32		 cml_cksum;	/* partial checksum of this lane */
+};
+
+struct cfs_crypto_mb_ops {
+	/* initial value of the first lane and of the other lanes */
+	u32	cmo_seed;
+	u32	cmo_lane_seed;
+	/* hash the same number of bytes in every lane */
+	void	(*cmo_update_lanes)(struct cfs_crypto_mb_lane *lanes,
+				    unsigned int len);
+	/* hash the rest of the current fragment of one lane */
+	u32	(*cmo_update)(u32 cksum, const u8 *p, unsigned int len);
+	/* checksum of A+B from those of A and B and the length of B */
+	u32	(*cmo_combine)(u32 cksum1, u32 cksum2, size_t len2);
+	/* write the checksum in the format of the crypto API digest */
+	void	(*cmo_final)(u32 cksum, unsigned char *hash);
+	/* alignment of the length hashed by cmo_update_lanes() */
+	unsigned int cmo_align;
+};
+
+/**
+ * Speed of the multi-lane engine in MByte per second, or 0 if the engine
+ * does not support the algorithm or is slower than the crypto API for it.
+ */
+static int cfs_crypto_mb_speeds[CFS_HASH_ALG_MAX];
+
+/**
+ * Number of page vectors hashed by the multi-lane engine, per algorithm.
+ */
+static atomic_t cfs_crypto_mb_hashes[CFS_HASH_ALG_MAX];
+
+static u32 gf2_matrix_times(const u32 *mat, u32 vec)
+{
+	u32 sum = 0;
+
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void gf2_matrix_square(u32 *square, const u32 *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/**
+ * Combine the CRC32C registers of two adjacent buffers.
+ *
+ * \a crc1 is the register after hashing the first buffer, \a crc2 the one
+ * after hashing the \a len2 bytes of the second buffer from a zero register.
+ * The register after hashing both buffers is \a crc1 advanced over \a len2
+ * zero bytes, xor-ed with \a crc2; the advance is done in O(log(len2)) by
+ * squaring the zero-byte operator, as zlib's crc32_combine() does.
+ */
+static u32 crc32c_combine(u32 crc1, u32 crc2, size_t len2)
+{
+	u32 even[32];
+	u32 odd[32];
+	u32 row = 1;
+	int n;
+
+	if (len2 == 0)
+		return crc1;
+
+	/* operator for one zero bit */
+	odd[0] = CRC32C_POLY_LE;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	/* operators for two and four zero bits */
+	gf2_matrix_square(even, odd);
+	gf2_matrix_square(odd, even);
+
+	/* apply len2 zero bytes, the first square gives the one byte one */
+	do {
+		gf2_matrix_square(even, odd);
+		if (len2 & 1)
+			crc1 = gf2_matrix_times(even, crc1);
+		len2 >>= 1;
+		if (len2 == 0)
+			break;
+
+		gf2_matrix_square(odd, even);
+		if (len2 & 1)
+			crc1 = gf2_matrix_times(odd, crc1);
+		len2 >>= 1;
+	} while (len2 != 0);
+
+	return crc1 ^ crc2;
+}
+
+static void crc32c_final(u32 crc, unsigned char *hash)
+{
+	/* same as the digest of the crc32c shash algorithms */
+	put_unaligned_le32(~crc, hash);
+}
+
+#ifdef CONFIG_X86_64
+static inline u64 crc32c_sse42_u64(u64 crc, u64 val)
+{
+	asm("crc32q %1, %0" : "+r" (crc) : "rm" (val));
+	return crc;
+}
+
+static inline u32 crc32c_sse42_u8(u32 crc, u8 val)
+{
+	asm("crc32b %1, %0" : "+r" (crc) : "rm" (val));
+	return crc;
+}
+
+static u32 crc32c_sse42_update(u32 crc, const u8 *p, unsigned int len)
+{
+	u64 crc64 = crc;
+
+	for (; len >= sizeof(u64); len -= sizeof(u64), p += sizeof(u64))
+		crc64 = crc32c_sse42_u64(crc64, get_unaligned((u64 *)p));
+
+	crc = crc64;
+	while (len-- > 0)
+		crc = crc32c_sse42_u8(crc, *p++);
+
+	return crc;
+}
+
+/*
+ * The crc32 instruction has a latency of 3 cycles but a throughput of one
+ * per cycle, so interleaving independent lanes keeps the unit busy.
+ */
+static void crc32c_sse42_update_lanes(struct cfs_crypto_mb_lane *lanes,
+				      unsigned int len)
+{
+	const u8 *p0 = lanes[0].cml_addr;
+	const u8 *p1 = lanes[1].cml_addr;
+	const u8 *p2 = lanes[2].cml_addr;
+	const u8 *p3 = lanes[3].cml_addr;
+	u64 c0 = lanes[0].cml_cksum;
+	u64 c1 = lanes[1].cml_cksum;
+	u64 c2 = lanes[2].cml_cksum;
+	u64 c3 = lanes[3].cml_cksum;
+	unsigned int i;
+
+	for (i = 0; i < len; i += sizeof(u64)) {
+		c0 = crc32c_sse42_u64(c0, get_unaligned((u64 *)(p0 + i)));
+		c1 = crc32c_sse42_u64(c1, get_unaligned((u64 *)(p1 + i)));
+		c2 = crc32c_sse42_u64(c2, get_unaligned((u64 *)(p2 + i)));
+		c3 = crc32c_sse42_u64(c3, get_unaligned((u64 *)(p3 + i)));
+	}
+
+	lanes[0].cml_cksum = c0;
+	lanes[1].cml_cksum = c1;
+	lanes[2].cml_cksum = c2;
+	lanes[3].cml_cksum = c3;
+}
+
+static const struct cfs_crypto_mb_ops crc32c_sse42_ops = {
+	.cmo_seed		= ~0U,
+	.cmo_lane_seed		= 0,
+	.cmo_update_lanes	= crc32c_sse42_update_lanes,
+	.cmo_update		= crc32c_sse42_update,
+	.cmo_combine		= crc32c_combine,
+	.cmo_final		= crc32c_final,
+	.cmo_align		= sizeof(u64),
+};
+#endif /* CONFIG_X86_64 */
+
+static u32 adler32_update(u32 adler, const u8 *p, unsigned int len)
+{
+	return zlib_adler32(adler, p, len);
+}
+
+/*
+ * Both adler32 sums are serial additions, hashing four lanes at once lets
+ * the CPU issue the additions of the lanes in parallel.
+ */
+static void adler32_update_lanes(struct cfs_crypto_mb_lane *lanes,
+				 unsigned int len)
+{
+	u32 s1[CFS_CRYPTO_MB_LANES];
+	u32 s2[CFS_CRYPTO_MB_LANES];
+	const u8 *p[CFS_CRYPTO_MB_LANES];
+	unsigned int i;
+	int k;
+
+	for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+		s1[k] = lanes[k].cml_cksum & 0xffff;
+		s2[k] = lanes[k].cml_cksum >> 16;
+		p[k] = lanes[k].cml_addr;
+	}
+
+	while (len > 0) {
+		unsigned int n = min_t(unsigned int, len, ADLER_NMAX);
+
+		for (i = 0; i < n; i++) {
+			s1[0] += p[0][i];
+			s2[0] += s1[0];
+			s1[1] += p[1][i];
+			s2[1] += s1[1];
+			s1[2] += p[2][i];
+			s2[2] += s1[2];
+			s1[3] += p[3][i];
+			s2[3] += s1[3];
+		}
+
+		for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+			s1[k] %= ADLER_BASE;
+			s2[k] %= ADLER_BASE;
+			p[k] += n;
+		}
+		len -= n;
+	}
+
+	for (k = 0; k < CFS_CRYPTO_MB_LANES; k++)
+		lanes[k].cml_cksum = (s2[k] << 16) | s1[k];
+}
+
+/**
+ * Combine the adler32 checksums of two adjacent buffers, the second one
+ * \a len2 bytes long and hashed from the initial value 1.  This is zlib's
+ * adler32_combine().
+ */
+static u32 adler32_combine(u32 adler1, u32 adler2, size_t len2)
+{
+	u32 rem = len2 % ADLER_BASE;
+	u32 sum1 = adler1 & 0xffff;
+	u32 sum2 = (rem * sum1) % ADLER_BASE;
+
+	sum1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum2 >= (ADLER_BASE << 1))
+		sum2 -= (ADLER_BASE << 1);
+	if (sum2 >= ADLER_BASE)
+		sum2 -= ADLER_BASE;
+
+	return sum1 | (sum2 << 16);
+}
+
+static void adler32_final(u32 adler, unsigned char *hash)
+{
+	/* same as the digest of the adler32 shash algorithm */
+	memcpy(hash, &adler, sizeof(adler));
+}
+
+static const struct cfs_crypto_mb_ops adler32_ops = {
+	.cmo_seed		= 1,
+	.cmo_lane_seed		= 1,
+	.cmo_update_lanes	= adler32_update_lanes,
+	.cmo_update		= adler32_update,
+	.cmo_combine		= adler32_combine,
+	.cmo_final		= adler32_final,
+	.cmo_align		= 1,
+};
+
+static const struct cfs_crypto_mb_ops *
+cfs_crypto_mb_ops(enum cfs_crypto_hash_alg hash_alg)
+{
+	switch (hash_alg) {
+	case CFS_HASH_ALG_ADLER32:
+		return &adler32_ops;
+#ifdef CONFIG_X86_64
+	case CFS_HASH_ALG_CRC32C:
+		if (boot_cpu_has(X86_FEATURE_XMM4_2))
+			return &crc32c_sse42_ops;
+		return NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/* map the next non-empty fragment of \a lane, return false at its end */
+static bool cfs_crypto_mb_lane_next(struct cfs_crypto_mb_lane *lane,
+				    void *data, cfs_crypto_get_frag_t get_frag)
+{
+	while (lane->cml_left == 0) {
+		struct page *page;
+		unsigned int offset;
+
+		if (lane->cml_page != NULL) {
+			kunmap(lane->cml_page);
+			lane->cml_page = NULL;
+		}
+		if (lane->cml_idx >= lane->cml_end)
+			return false;
+
+		get_frag(data, lane->cml_idx++, &page, &offset,
+			 &lane->cml_left);
+		lane->cml_page = page;
+		lane->cml_addr = (u8 *)kmap(page) + offset;
+		lane->cml_nob += lane->cml_left;
+	}
+
+	return true;
+}
+
+static void cfs_crypto_mb_hash_lanes(const struct cfs_crypto_mb_ops *ops,
+				     void *data, int count,
+				     cfs_crypto_get_frag_t get_frag,
+				     unsigned char *hash)
+{
+	struct cfs_crypto_mb_lane lanes[CFS_CRYPTO_MB_LANES];
+	u32 cksum;
+	int k;
+
+	for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+		lanes[k].cml_idx = k * count / CFS_CRYPTO_MB_LANES;
+		lanes[k].cml_end = (k + 1) * count / CFS_CRYPTO_MB_LANES;
+		lanes[k].cml_page = NULL;
+		lanes[k].cml_left = 0;
+		lanes[k].cml_nob = 0;
+		lanes[k].cml_cksum = k == 0 ? ops->cmo_seed :
+					      ops->cmo_lane_seed;
+	}
+
+	for (;;) {
+		unsigned int len = UINT_MAX;
+		int active = 0;
+
+		for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+			if (!cfs_crypto_mb_lane_next(&lanes[k], data,
+						     get_frag))
+				continue;
+			len = min(len, lanes[k].cml_left);
+			active++;
+		}
+		if (active == 0)
+			break;
+
+		len &= ~(ops->cmo_align - 1);
+		if (active == CFS_CRYPTO_MB_LANES && len > 0) {
+			ops->cmo_update_lanes(lanes, len);
+			for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+				lanes[k].cml_addr += len;
+				lanes[k].cml_left -= len;
+			}
+			continue;
+		}
+
+		/* the lanes are out of step, finish their fragments alone */
+		for (k = 0; k < CFS_CRYPTO_MB_LANES; k++) {
+			if (lanes[k].cml_left == 0)
+				continue;
+			lanes[k].cml_cksum = ops->cmo_update(lanes[k].cml_cksum,
+							     lanes[k].cml_addr,
+							     lanes[k].cml_left);
+			lanes[k].cml_left = 0;
+		}
+	}
+
+	cksum = lanes[0].cml_cksum;
+	for (k = 1; k < CFS_CRYPTO_MB_LANES; k++)
+		cksum = ops->cmo_combine(cksum, lanes[k].cml_cksum,
+					 lanes[k].cml_nob);
+
+	ops->cmo_final(cksum, hash);
+}
+
+/**
+ * Hash a vector of page fragments with the multi-lane engine.
+ *
+ * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
+ * \param[in] data	opaque vector passed to \a get_frag
+ * \param[in] count	number of fragments in \a data
+ * \param[in] get_frag	returns the page, offset and length of a fragment
+ * \param[out] hash	hash digest, in the same format as the crypto API one
+ * \param[in,out] hash_len size of \a hash, set to the size of the digest
+ *
+ * \retval		0 for success
+ * \retval		-EOPNOTSUPP if the engine should not be used for
+ *			\a hash_alg or \a count fragments
+ * \retval		-EOVERFLOW if \a hash_len is too small
+ */
+int cfs_crypto_mb_hash_pages(enum cfs_crypto_hash_alg hash_alg, void *data,
+			     int count, cfs_crypto_get_frag_t get_frag,
+			     unsigned char *hash, unsigned int *hash_len)
+{
+	const struct cfs_crypto_mb_ops *ops;
+
+	if (hash_alg >= CFS_HASH_ALG_MAX || cfs_crypto_mb_speeds[hash_alg] <= 0)
+		return -EOPNOTSUPP;
+	if (count < CFS_CRYPTO_MB_LANES)
+		return -EOPNOTSUPP;
+
+	ops = cfs_crypto_mb_ops(hash_alg);
+	if (ops == NULL)
+		return -EOPNOTSUPP;
+
+	if (*hash_len < sizeof(u32))
+		return -EOVERFLOW;
+
+	cfs_crypto_mb_hash_lanes(ops, data, count, get_frag, hash);
+	*hash_len = sizeof(u32);
+	atomic_inc(&cfs_crypto_mb_hashes[hash_alg]);
+
+	return 0;
+}
+
+/**
+ * Speed of the multi-lane engine for \a hash_alg in MB/s, 0 if unused.
+ */
+int cfs_crypto_mb_speed(enum cfs_crypto_hash_alg hash_alg)
+{
+	if (hash_alg < CFS_HASH_ALG_MAX)
+		return cfs_crypto_mb_speeds[hash_alg];
+
+	return 0;
+}
+
+/**
+ * Print the speed and use count of the multi-lane engine per algorithm.
+ *
+ * \retval		number of bytes written to \a buf
+ * \retval		-EFBIG if \a len is too small
+ */
+int cfs_crypto_mb_stats_print(char *buf, int len)
+{
+	enum cfs_crypto_hash_alg hash_alg;
+	char *tmp = buf;
+	int rc;
+
+	rc = snprintf(tmp, len, "%-10s %10s %10s\n", "algorithm",
+		      "speed_MBps", "hashes");
+	if (rc >= len)
+		return -EFBIG;
+	tmp += rc;
+	len -= rc;
+
+	for (hash_alg = 0; hash_alg < CFS_HASH_ALG_MAX; hash_alg++) {
+		if (cfs_crypto_mb_ops(hash_alg) == NULL)
+			continue;
+
+		rc = snprintf(tmp, len, "%-10s %10d %10d\n",
+			      cfs_crypto_hash_name(hash_alg),
+			      cfs_crypto_mb_speeds[hash_alg],
+			      atomic_read(&cfs_crypto_mb_hashes[hash_alg]));
+		if (rc >= len)
+			return -EFBIG;
+		tmp += rc;
+		len -= rc;
+	}
+
+	return tmp - buf;
+}
+
+static void cfs_crypto_mb_test_frag(void *data, int idx, struct page **page,
+				    unsigned int *offset, unsigned int *len)
+{
+	*page = data;
+	*offset = 0;
+	*len = PAGE_SIZE;
+}
+
+/**
+ * Benchmark the multi-lane engine against the crypto API.
+ *
+ * Hash a 1MB page vector for 1 second, the same load as
+ * cfs_crypto_performance_test(), after checking that the engine returns the
+ * same digest as the crypto API.  The engine is only used for \a hash_alg
+ * if it is faster than the \a api_speed of the crypto API.
+ *
+ * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
+ * \param[in] api_speed	speed of the crypto API for \a hash_alg in MB/s
+ */
+void cfs_crypto_mb_performance_test(enum cfs_crypto_hash_alg hash_alg,
+				    int api_speed)
+{
+	const struct cfs_crypto_mb_ops *ops = cfs_crypto_mb_ops(hash_alg);
+	int count = max(PAGE_SIZE, 1048576UL) / PAGE_SIZE;
+	unsigned char hash[CFS_CRYPTO_HASH_DIGESTSIZE_MAX];
+	unsigned char check[CFS_CRYPTO_HASH_DIGESTSIZE_MAX];
+	unsigned int check_len = sizeof(check);
+	struct cfs_crypto_hash_desc *hdesc;
+	unsigned long start, end;
+	struct page *page;
+	unsigned long tmp;
+	int bcount;
+	int err = 0;
+	int i;
+
+	cfs_crypto_mb_speeds[hash_alg] = 0;
+	if (ops == NULL || api_speed <= 0 || count < CFS_CRYPTO_MB_LANES)
+		return;
+
+	page = alloc_page(GFP_KERNEL);
+	if (page == NULL)
+		return;
+
+	get_random_bytes(kmap(page), PAGE_SIZE);
+	kunmap(page);
+
+	hdesc = cfs_crypto_hash_init(hash_alg, NULL, 0);
+	if (IS_ERR(hdesc))
+		goto out;
+	for (i = 0; i < count && err == 0; i++)
+		err = cfs_crypto_hash_update_page(hdesc, page, 0, PAGE_SIZE);
+	if (err == 0)
+		err = cfs_crypto_hash_final(hdesc, check, &check_len);
+	else
+		cfs_crypto_hash_final(hdesc, NULL, NULL);
+	if (err != 0)
+		goto out;
+
+	cfs_crypto_mb_hash_lanes(ops, page, count, cfs_crypto_mb_test_frag,
+				 hash);
+	if (check_len != sizeof(u32) || memcmp(hash, check, check_len) != 0) {
+		CWARN("Crypto hash algorithm %s multi-lane digest mismatch, disabled\n",
+		      cfs_crypto_hash_name(hash_alg));
+		goto out;
+	}
+
+	for (start = jiffies, end = start + msecs_to_jiffies(MSEC_PER_SEC),
+	     bcount = 0; time_before(jiffies, end); bcount++)
+		cfs_crypto_mb_hash_lanes(ops, page, count,
+					 cfs_crypto_mb_test_frag, hash);
+	end = jiffies;
+
+	tmp = ((bcount * count * PAGE_SIZE / jiffies_to_msecs(end - start)) *
+	       1000) / (1024 * 1024);
+	if (tmp > api_speed)
+		cfs_crypto_mb_speeds[hash_alg] = (int)tmp;
+	CDEBUG(D_CONFIG, "Crypto hash algorithm %s multi-lane speed = %lu MB/s%s\n",
+	       cfs_crypto_hash_name(hash_alg), tmp,
+	       tmp > api_speed ? "" : ", not used");
+out:
+	__free_page(page);
+}
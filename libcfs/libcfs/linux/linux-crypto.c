@@ -303,6 +303,60 @@ free:
 }
 EXPORT_SYMBOL(cfs_crypto_hash_final);
 
+/**
+ * Hash a vector of page fragments
+ *
+ * Compute the hash of the concatenation of \a count page fragments, as
+ * returned by \a get_frag, with the default key of \a hash_alg.  This is
+ * the same as calling cfs_crypto_hash_update_page() for each fragment, but
+ * uses the multi-lane engine when cfs_crypto_mb_performance_test() found it
+ * faster than the crypto API for \a hash_alg.
+ *
+ * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
+ * \param[in] data	opaque fragment vector passed to \a get_frag
+ * \param[in] count	number of fragments in \a data
+ * \param[in] get_frag	returns the page, offset and length of a fragment
+ * \param[out] hash	pointer to hash buffer to store hash digest
+ * \param[in,out] hash_len	size of \a hash, set to the digest size
+ *
+ * \retval		0 for success
+ * \retval		-EOVERFLOW if hash_len is too small for the hash digest
+ * \retval		negative errno for other errors from lower layers
+ */
+int cfs_crypto_hash_pages(enum cfs_crypto_hash_alg hash_alg, void *data,
+			  int count, cfs_crypto_get_frag_t get_frag,
+			  unsigned char *hash, unsigned int *hash_len)
+{
+	struct cfs_crypto_hash_desc *hdesc;
+	int i;
+	int err;
+
+	err = cfs_crypto_mb_hash_pages(hash_alg, data, count, get_frag,
+				       hash, hash_len);
+	if (err != -EOPNOTSUPP)
+		return err;
+
+	hdesc = cfs_crypto_hash_init(hash_alg, NULL, 0);
+	if (IS_ERR(hdesc))
+		return PTR_ERR(hdesc);
+
+	for (i = 0; i < count; i++) {
+		struct page *page;
+		unsigned int offset;
+		unsigned int len;
+
+		get_frag(data, i, &page, &offset, &len);
+		err = cfs_crypto_hash_update_page(hdesc, page, offset, len);
+		if (err != 0) {
+			cfs_crypto_hash_final(hdesc, NULL, NULL);
+			return err;
+		}
+	}
+
+	return cfs_crypto_hash_final(hdesc, hash, hash_len);
+}
+EXPORT_SYMBOL(cfs_crypto_hash_pages);
+
 /**
  * Compute the speed of specified hash function
  *
@@ -380,7 +434,8 @@ out_err:
  * hash speed in Mbytes per second for valid hash algorithm
  *
  * Return the performance of the specified \a hash_alg that was previously
- * computed using cfs_crypto_performance_test().
+ * computed using cfs_crypto_performance_test(), or that of the multi-lane
+ * engine if it is faster, since cfs_crypto_hash_pages() then uses it.
  *
  * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
  *
@@ -391,7 +446,8 @@ out_err:
 int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg)
 {
 	if (hash_alg < CFS_HASH_ALG_MAX)
-		return cfs_crypto_hash_speeds[hash_alg];
+		return max(cfs_crypto_hash_speeds[hash_alg],
+			   cfs_crypto_mb_speed(hash_alg));
 
 	return -ENOENT;
 }
@@ -409,6 +465,9 @@ EXPORT_SYMBOL(cfs_crypto_hash_speed);
  * engines), this speed only represents an estimate of the actual speed under
  * actual usage, but is reasonable for comparing available algorithms.
  *
+ * The multi-lane engine is benchmarked on the same load right after, and
+ * only enabled for the algorithms it hashes faster than the crypto API.
+ *
  * The actual speeds are available via cfs_crypto_hash_speed() for later
  * comparison.
  *
@@ -419,8 +478,11 @@ static int cfs_crypto_test_hashes(void)
 {
 	enum cfs_crypto_hash_alg hash_alg;
 
-	for (hash_alg = 0; hash_alg < CFS_HASH_ALG_MAX; hash_alg++)
+	for (hash_alg = 0; hash_alg < CFS_HASH_ALG_MAX; hash_alg++) {
 		cfs_crypto_performance_test(hash_alg);
+		cfs_crypto_mb_performance_test(hash_alg,
+					cfs_crypto_hash_speeds[hash_alg]);
+	}
 
 	return 0;
 }
@@ -463,6 +463,43 @@ proc_cpt_table(struct ctl_table *table, int write, void __user *buffer,
 				    __proc_cpt_table);
 }
 
+static int __proc_crypto_mb_stats(void *data, int write,
+				  loff_t pos, void __user *buffer, int nob)
+{
+	char *buf;
+	int len = PAGE_SIZE;
+	int rc;
+
+	if (write)
+		return -EPERM;
+
+	LIBCFS_ALLOC(buf, len);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	rc = cfs_crypto_mb_stats_print(buf, len);
+	if (rc < 0)
+		goto out;
+
+	if (pos >= rc) {
+		rc = 0;
+		goto out;
+	}
+
+	rc = cfs_trace_copyout_string(buffer, nob, buf + pos, NULL);
+out:
+	LIBCFS_FREE(buf, len);
+	return rc;
+}
+
+static int
+proc_crypto_mb_stats(struct ctl_table *table, int write, void __user *buffer,
+		     size_t *lenp, loff_t *ppos)
+{
+	return lprocfs_call_handler(table->data, write, ppos, buffer, lenp,
+				    __proc_crypto_mb_stats);
+}
+
 static struct ctl_table lnet_table[] = {
 	/*
 	 * NB No .strategy entries have been provided since sysctl(8) prefers
@@ -536,6 +573,13 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0444,
 		.proc_handler	= &proc_cpt_table,
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "crypto_mb_stats",
+		.maxlen		= 128,
+		.mode		= 0444,
+		.proc_handler	= &proc_crypto_mb_stats,
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "debug_log_upcall",
@@ -2019,6 +2019,23 @@ iov_iter_rw, [
 ])
 ]) # LC_IOV_ITER_RW
 
+#
+# LC_KIOCB_IOCB_DIRECT
+#
+# 4.1 O_DIRECT is mirrored into kiocb->ki_flags as IOCB_DIRECT
+#
+AC_DEFUN([LC_KIOCB_IOCB_DIRECT], [
+LB_CHECK_COMPILE([if 'struct kiocb' has IOCB_DIRECT in 'ki_flags'],
+kiocb_iocb_direct, [
+	#include <linux/fs.h>
+],[
+	((struct kiocb *)0)->ki_flags |= IOCB_DIRECT;
+],[
+	AC_DEFINE(HAVE_KIOCB_IOCB_DIRECT, 1,
+		[kiocb->ki_flags has IOCB_DIRECT])
+])
+]) # LC_KIOCB_IOCB_DIRECT
+
 #
 # LC_HAVE_SYNC_READ_WRITE
 #
@@ -2183,6 +2200,26 @@ key_payload_data_array, [
 ])
 ]) #LC_HAVE_KEY_PAYLOAD_DATA_ARRAY
 
+#
+# LC_HAVE_BLK_INTEGRITY_PROFILE
+#
+# 4.4 kernel moved the integrity profile name and tuple size out of
+# struct blk_integrity into struct blk_integrity_profile
+#
+AC_DEFUN([LC_HAVE_BLK_INTEGRITY_PROFILE], [
+LB_CHECK_COMPILE([if 'struct blk_integrity' has 'profile'],
+blk_integrity_profile, [
+	#include <linux/blkdev.h>
+],[
+	struct blk_integrity bi;
+
+	bi.profile = NULL;
+],[
+	AC_DEFINE(HAVE_BLK_INTEGRITY_PROFILE, 1,
+		[struct blk_integrity has profile])
+])
+]) # LC_HAVE_BLK_INTEGRITY_PROFILE
+
 #
 # LC_HAVE_FILE_DENTRY
 #
@@ -2415,6 +2452,7 @@ AC_DEFUN([LC_PROG_LINUX], [
 
 	# 4.1.0
 	LC_IOV_ITER_RW
+	LC_KIOCB_IOCB_DIRECT
 	LC_HAVE_SYNC_READ_WRITE
 
 	# 4.2
@@ -2429,6 +2467,7 @@ AC_DEFUN([LC_PROG_LINUX], [
 	LC_HAVE_LOCKS_LOCK_FILE_WAIT
 	LC_HAVE_QC_MAKE_REQUEST_FN
 	LC_HAVE_KEY_PAYLOAD_DATA_ARRAY
+	LC_HAVE_BLK_INTEGRITY_PROFILE
 
 	# 4.5
 	LC_HAVE_FILE_DENTRY
@@ -1452,6 +1452,11 @@ struct cl_read_ahead {
 	pgoff_t cra_end;
 	/* optimal RPC size for this read, by pages */
 	unsigned long cra_rpc_size;
+	/* stripe size by pages and stripe count of a striped object, both
+	 * 0 for unstriped objects. Lets read-ahead build per-stripe batches
+	 * in stride mode. */
+	unsigned long cra_stripe_pages;
+	unsigned int cra_stripe_count;
 	/* Release callback. If readahead holds resources underneath, this
 	 * function should be called to release it. */
 	void    (*cra_release)(const struct lu_env *env, void *cbdata);
@@ -1641,10 +1646,21 @@ enum cl_enq_flags {
 	 * is known to exist.
 	 */
 	CEF_LOCK_MATCH  = 0x00000080,
+	/**
+	 * tell the server not to expand the lock extent, used by lock ahead
+	 * which asks for exactly the extent it is going to write.
+	 */
+	CEF_LOCK_NO_EXPAND = 0x00000100,
+	/**
+	 * enqueue the lock speculatively, i.e. without an io waiting for it.
+	 * The server grants it only if it does not conflict with any other
+	 * lock. Used by lock ahead.
+	 */
+	CEF_SPECULATIVE  = 0x00000200,
 	/**
 	 * mask of enq_flags.
 	 */
-	CEF_MASK         = 0x000000ff,
+	CEF_MASK         = 0x000003ff,
 };
 
 /**
@@ -1798,6 +1814,11 @@ struct cl_io {
 			enum cl_fsync_mode fi_mode;
 			/* how many pages were written/discarded */
 			unsigned int       fi_nr_written;
+			/** collects the OST_SYNC RPCs of all stripes for
+			 * CL_FSYNC_ALL, the caller waits for it once the
+			 * io is done. If NULL each stripe is synced on its
+			 * own. */
+			struct cl_sync_io *fi_anchor;
 		} ci_fsync;
 		struct cl_ladvise_io {
 			__u64			 li_start;
@@ -1842,11 +1863,29 @@ struct cl_io {
 	/**
 	 * O_NOATIME
 	 */
-			     ci_noatime:1;
+			     ci_noatime:1,
+	/**
+	 * Read-ahead issued on behalf of a reader by a read-ahead thread,
+	 * the io only sets up the stack for cl_io_read_ahead() and does not
+	 * read anything by itself.
+	 */
+			     ci_async_readahead:1,
+	/**
+	 * Direct I/O issued to all the stripes it covers in one iteration,
+	 * so that the RPCs of every stripe are in flight at once while the
+	 * locks of the whole range are held.
+	 */
+			     ci_parallel_dio:1;
 	/**
 	 * Number of pages owned by this IO. For invariant checking.
 	 */
 	unsigned	     ci_owned_nr;
+	/**
+	 * Jobid the RPCs of this io are accounted to, instead of the one
+	 * stored in the inode by the last read or write. Only set for
+	 * read-ahead issued by a read-ahead thread, NULL otherwise.
+	 */
+	const char	    *ci_jobid;
 };
 
 /** @} cl_io */
@@ -1860,7 +1899,7 @@ struct cl_req_attr {
 	struct cl_page  *cra_page;
 	/** Generic attributes for the server consumption. */
 	struct obdo	*cra_oa;
-	/** Jobid */
+	/** Jobid, filled by the top layer unless set by the caller */
 	char		 cra_jobid[LUSTRE_JOBID_SIZE];
 };
 
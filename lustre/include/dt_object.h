@@ -85,6 +85,9 @@ struct dt_device_param {
 	/* per-extent insertion overhead to be used by client for grant
 	 * calculation */
 	unsigned	   ddp_extent_tax;
+	/* OBD_CKSUM_T10* type whose guard tags are stored with the data,
+	 * 0 if the device has no matching integrity profile */
+	unsigned	   ddp_t10_cksum_type;
 };
 
 /**
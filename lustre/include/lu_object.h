@@ -910,6 +910,22 @@ struct lu_rdpg {
         __u32                   rp_attrs;
         /** pointers to pages */
         struct page           **rp_pages;
+	/**
+	 * readdir-plus: lock the target of an entry for the caller before
+	 * its attributes are packed with LUDA_ATTRS. No attributes are
+	 * returned for the entries it fails on, or if it is NULL.
+	 */
+	int		      (*rp_lock)(const struct lu_env *env, void *data,
+					 const struct lu_fid *fid,
+					 struct luda_attrs *lda);
+	/**
+	 * cancel the lock rp_lock just granted for an entry, if its
+	 * attributes cannot be packed after all
+	 */
+	void		      (*rp_unlock)(const struct lu_env *env, void *data,
+					   struct luda_attrs *lda);
+	/** argument of rp_lock and rp_unlock */
+	void		       *rp_lock_data;
 };
 
 enum lu_xattr_flags {
@@ -136,6 +136,8 @@ struct lu_target {
 				 lut_sync_lock_cancel:2,
 				 /* e.g. OST node */
 				 lut_no_reconstruct:1;
+	/* T10 checksum type whose guard tags lut_bottom stores on disk */
+	cksum_type_t		 lut_dt_t10_type;
 	/** last_rcvd file */
 	struct dt_object	*lut_last_rcvd;
 	/* transaction callbacks */
@@ -336,6 +336,8 @@ enum lu_dirent_attrs {
 	LUDA_FID		= 0x0001,
 	LUDA_TYPE		= 0x0002,
 	LUDA_64BITHASH		= 0x0004,
+	/* struct luda_attrs follows the type, see OBD_CONNECT2_READDIR_PLUS */
+	LUDA_ATTRS		= 0x0008,
 
 	/* The following attrs are used for MDT internal only,
 	 * not visible to client */
@@ -407,6 +409,35 @@ struct luda_type {
         __u16 lt_type;
 };
 
+/**
+ * Inode attributes of the entry's target, returned to clients that
+ * requested them with LUDA_ATTRS (readdir-plus). \a lda_valid holds the
+ * OBD_MD_FL* bits of the fields which are filled. Size and blocks are
+ * only valid for objects whose size is kept on the MDT.
+ *
+ * The attributes are only returned with a PR LOOKUP|UPDATE lock on the
+ * target, granted to the client lock handle \a lda_lock_idx of the
+ * request's struct ldlm_request. \a lda_lock is the cookie of the server
+ * handle of that lock.
+ *
+ * Aligned to 8 bytes.
+ */
+struct luda_attrs {
+	__u64	lda_valid;
+	__u64	lda_size;
+	__u64	lda_blocks;
+	__s64	lda_mtime;
+	__s64	lda_atime;
+	__s64	lda_ctime;
+	__u32	lda_mode;
+	__u32	lda_uid;
+	__u32	lda_gid;
+	__u32	lda_nlink;
+	__u32	lda_flags;
+	__u32	lda_lock_idx;
+	__u64	lda_lock;
+};
+
 struct lu_dirpage {
         __u64            ldp_hash_start;
         __u64            ldp_hash_end;
@@ -457,6 +488,9 @@ static inline size_t lu_dirent_calc_size(size_t namelen, __u16 attr)
         } else
                 size = sizeof(struct lu_dirent) + namelen;
 
+	if (attr & LUDA_ATTRS)
+		size = ((size + 7) & ~7) + sizeof(struct luda_attrs);
+
         return (size + 7) & ~7;
 }
 
@@ -726,6 +760,11 @@ struct ptlrpc_body_v2 {
 #define OBD_CONNECT_FLAGS2	 0x8000000000000000ULL /* second flags word */
 /* ocd_connect_flags2 flags */
 #define OBD_CONNECT2_FILE_SECCTX	0x1ULL /* set file security context at create */
+#define OBD_CONNECT2_READDIR_PLUS	0x2ULL /* dirent attrs in readpage */
+#define OBD_CONNECT2_MULTIOBJ_BRW	0x4ULL /* several objects per write */
+#define OBD_CONNECT2_LOCKAHEAD		0x8ULL /* speculative extent locks */
+#define OBD_CONNECT2_BL_AST_BATCH	0x10ULL /* many locks per BL AST */
+#define OBD_CONNECT2_LOCK_CONVERT	0x20ULL /* drop ibits, not cancel */
 
 /* XXX README XXX:
  * Please DO NOT add flag values here before first ensuring that this same
@@ -774,7 +813,10 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT_SUBTREE | \
 				OBD_CONNECT_FLAGS2)
 
-#define MDT_CONNECT_SUPPORTED2 OBD_CONNECT2_FILE_SECCTX
+#define MDT_CONNECT_SUPPORTED2 (OBD_CONNECT2_FILE_SECCTX | \
+				OBD_CONNECT2_READDIR_PLUS | \
+				OBD_CONNECT2_BL_AST_BATCH | \
+				OBD_CONNECT2_LOCK_CONVERT)
 
 #define OST_CONNECT_SUPPORTED  (OBD_CONNECT_SRVLOCK | OBD_CONNECT_GRANT | \
 				OBD_CONNECT_REQPORTAL | OBD_CONNECT_VERSION | \
@@ -792,8 +834,11 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT_LAYOUTLOCK | OBD_CONNECT_FID | \
 				OBD_CONNECT_PINGLESS | OBD_CONNECT_LFSCK | \
 				OBD_CONNECT_BULK_MBITS | \
-				OBD_CONNECT_GRANT_PARAM)
-#define OST_CONNECT_SUPPORTED2 0
+				OBD_CONNECT_GRANT_PARAM | OBD_CONNECT_SHORTIO |\
+				OBD_CONNECT_FLAGS2)
+#define OST_CONNECT_SUPPORTED2 (OBD_CONNECT2_MULTIOBJ_BRW | \
+				OBD_CONNECT2_LOCKAHEAD | \
+				OBD_CONNECT2_BL_AST_BATCH)
 
 #define ECHO_CONNECT_SUPPORTED 0
 #define ECHO_CONNECT_SUPPORTED2 0
@@ -870,6 +915,8 @@ typedef enum {
         OBD_CKSUM_CRC32 = 0x00000001,
         OBD_CKSUM_ADLER = 0x00000002,
         OBD_CKSUM_CRC32C= 0x00000004,
+	OBD_CKSUM_T10IP512  = 0x00000008, /* T10 IP guard tags, 512B sector */
+	OBD_CKSUM_T10CRC512 = 0x00000010, /* T10 CRC guard tags, 512B sector */
 } cksum_type_t;
 
 /*
@@ -917,6 +964,8 @@ enum obdo_flags {
         OBD_FL_CKSUM_CRC32  = 0x00001000, /* CRC32 checksum type */
         OBD_FL_CKSUM_ADLER  = 0x00002000, /* ADLER checksum type */
         OBD_FL_CKSUM_CRC32C = 0x00004000, /* CRC32C checksum type */
+	OBD_FL_CKSUM_T10IP512  = 0x00005000, /* T10PI IP cksum, 512B sector */
+	OBD_FL_CKSUM_T10CRC512 = 0x00006000, /* T10PI CRC cksum, 512B sector */
         OBD_FL_CKSUM_RSVD2  = 0x00008000, /* for future cksum types */
         OBD_FL_CKSUM_RSVD3  = 0x00010000, /* for future cksum types */
         OBD_FL_SHRINK_GRANT = 0x00020000, /* object shrink the grant */
@@ -2192,7 +2241,10 @@ struct ldlm_extent {
 };
 
 struct ldlm_inodebits {
-        __u64 bits;
+	__u64 bits;
+	/* In a blocking AST: bits the client may drop instead of cancelling
+	 * the whole lock (OBD_CONNECT2_LOCK_CONVERT), 0 to cancel it all. */
+	__u64 cancel_bits;
 };
 
 struct ldlm_flock_wire {
@@ -2257,6 +2309,9 @@ struct ldlm_lock_desc {
 #define LDLM_LOCKREQ_HANDLES 2
 #define LDLM_ENQUEUE_CANCEL_OFF 1
 
+/* A blocking AST with lock_count > 1 (OBD_CONNECT2_BL_AST_BATCH) carries
+ * the client handles of lock_count locks in lock_handle[0 .. lock_count - 1]
+ * followed by their server handles, all blocked by the lock in lock_desc. */
 struct ldlm_request {
         __u32 lock_flags;
         __u32 lock_count;
@@ -1378,11 +1378,13 @@ enum lu_ladvise_type {
 	LU_LADVISE_INVALID	= 0,
 	LU_LADVISE_WILLREAD	= 1,
 	LU_LADVISE_DONTNEED	= 2,
+	LU_LADVISE_LOCKAHEAD	= 3,
 };
 
 #define LU_LADVISE_NAMES {						\
 	[LU_LADVISE_WILLREAD]	= "willread",				\
 	[LU_LADVISE_DONTNEED]	= "dontneed",				\
+	[LU_LADVISE_LOCKAHEAD]	= "lockahead",				\
 }
 
 /* This is the userspace argument for ladvise.  It is currently the same as
@@ -1398,6 +1400,30 @@ struct llapi_lu_ladvise {
 	__u32 lla_value4;
 };
 
+/* lock mode and result of LU_LADVISE_LOCKAHEAD */
+#define lla_lockahead_mode	lla_value1
+#define lla_lockahead_result	lla_value2
+
+enum lock_mode_user {
+	MODE_READ_USER	= 1,
+	MODE_WRITE_USER	= 2,
+	MODE_MAX_USER,
+};
+
+#define LOCK_MODE_NAMES {						\
+	[MODE_READ_USER]	= "READ",				\
+	[MODE_WRITE_USER]	= "WRITE",				\
+}
+
+/* Lock ahead only sends the enqueue, the lock is granted or refused by the
+ * server asynchronously. Each advice gets its own result: LLA_RESULT_SAME
+ * means existing locks already cover the extent on every stripe and nothing
+ * was sent, a negative errno that no stripe could be enqueued. */
+enum lla_lockahead_result {
+	LLA_RESULT_SENT	= 0,
+	LLA_RESULT_SAME	= 1,
+};
+
 enum ladvise_flag {
 	LF_ASYNC	= 0x00000001,
 };
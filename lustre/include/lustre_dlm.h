@@ -177,7 +177,7 @@ static inline int lockmode_compat(enum ldlm_mode exist_mode,
  * lr_lock
  *
  * lr_lock
- *     waiting_locks_spinlock
+ *     ww_lock (of the lock waiting wheel)
  *
  * lr_lock
  *     led_lock
@@ -612,6 +612,8 @@ enum ldlm_cancel_flags {
 	LCF_ASYNC	= 0x1, /* Cancel locks asynchronously. */
 	LCF_LOCAL	= 0x2, /* Cancel locks locally, not notifing server */
 	LCF_BL_AST	= 0x4, /* Cancel LDLM_FL_BL_AST locks in the same RPC */
+	LCF_CONVERT	= 0x8, /* Drop the inodebits asked by a blocking AST
+				* and keep the lock if the server allows */
 };
 
 struct ldlm_flock {
@@ -702,6 +704,12 @@ struct ldlm_lock {
 	 * Tree node for ldlm_extent.
 	 */
 	struct ldlm_interval	*l_tree_node;
+	/**
+	 * Position of an extent lock in the waiting interval trees of its
+	 * resource, taken from lr_wait_seq. 0 if the lock is not waiting.
+	 * Protected by lr_lock in struct ldlm_resource.
+	 */
+	__u64			l_wait_seq;
 	/**
 	 * Per export hash of locks.
 	 * Protected by per-bucket exp->exp_lock_hash locks.
@@ -830,10 +838,10 @@ struct ldlm_lock {
 	/**
 	 * List item for locks waiting for cancellation from clients.
 	 * The lists this could be linked into are:
-	 * waiting_locks_list (protected by waiting_locks_spinlock),
-	 * then if the lock timed out, it is moved to
-	 * expired_lock_thread.elt_expired_locks for further processing.
-	 * Protected by elt_lock.
+	 * a slot of the waiting-locks wheel the lock hashes to, then if the
+	 * lock timed out, it is moved to ww_expired of the same wheel for
+	 * further processing.
+	 * Protected by ww_lock of that wheel.
 	 */
 	struct list_head	l_pending_chain;
 
@@ -949,6 +957,13 @@ struct ldlm_resource {
 	 * Interval trees (only for extent locks) for all modes of this resource
 	 */
 	struct ldlm_interval_tree *lr_itree;
+	/**
+	 * Interval trees of the waiting extent locks, allocated together
+	 * with lr_itree.
+	 */
+	struct ldlm_interval_tree *lr_witree;
+	/** Source of l_wait_seq, orders the locks of the waiting trees */
+	__u64			lr_wait_seq;
 
 	union {
 		/**
@@ -1240,6 +1255,9 @@ int ldlm_glimpse_locks(struct ldlm_resource *res,
  */
 int ldlm_handle_enqueue(struct ptlrpc_request *req, ldlm_completion_callback,
                         ldlm_blocking_callback, ldlm_glimpse_callback);
+int ldlm_lock_handover(const struct lustre_handle *lockh, enum ldlm_mode mode,
+		       struct obd_export *exp,
+		       const struct lustre_handle *remote);
 int ldlm_handle_enqueue0(struct ldlm_namespace *ns, struct ptlrpc_request *req,
                          const struct ldlm_request *dlm_req,
                          const struct ldlm_callback_suite *cbs);
@@ -1473,6 +1491,13 @@ int ldlm_cli_enqueue(struct obd_export *exp, struct ptlrpc_request **reqp,
 		     union ldlm_policy_data const *policy, __u64 *flags,
 		     void *lvb, __u32 lvb_len, enum lvb_type lvb_type,
 		     struct lustre_handle *lockh, int async);
+int ldlm_cli_lock_prep(struct obd_export *exp, struct ldlm_enqueue_info *einfo,
+		       const struct ldlm_res_id *res_id,
+		       struct lustre_handle *lockh, int count);
+int ldlm_cli_lock_fini(struct obd_export *exp, const struct lustre_handle *lockh,
+		       enum ldlm_mode mode, const struct lustre_handle *remote,
+		       const struct ldlm_res_id *res_id,
+		       const union ldlm_policy_data *policy);
 int ldlm_prep_enqueue_req(struct obd_export *exp,
 			  struct ptlrpc_request *req,
 			  struct list_head *cancels,
@@ -26,7 +26,7 @@
 #ifndef LDLM_ALL_FLAGS_MASK
 
 /** l_flags bits marked as "all_flags" bits */
-#define LDLM_FL_ALL_FLAGS_MASK          0x00FFFFFFC08F932FULL
+#define LDLM_FL_ALL_FLAGS_MASK          0x00FFFFFFE08F933FULL
 
 /** extent, mode, or resource changed */
 #define LDLM_FL_LOCK_CHANGED            0x0000000000000001ULL // bit   0
@@ -58,6 +58,14 @@
 #define ldlm_set_block_wait(_l)         LDLM_SET_FLAG((  _l), 1ULL <<  3)
 #define ldlm_clear_block_wait(_l)       LDLM_CLEAR_FLAG((_l), 1ULL <<  3)
 
+/**
+ * Lock request is speculative, e.g. lock ahead: grant it only if it does not
+ * conflict with any other lock, and never send blocking ASTs for it. */
+#define LDLM_FL_SPECULATIVE             0x0000000000000010ULL // bit   4
+#define ldlm_is_speculative(_l)         LDLM_TEST_FLAG(( _l), 1ULL <<  4)
+#define ldlm_set_speculative(_l)        LDLM_SET_FLAG((  _l), 1ULL <<  4)
+#define ldlm_clear_speculative(_l)      LDLM_CLEAR_FLAG((_l), 1ULL <<  4)
+
 /** blocking or cancel packet was queued for sending. */
 #define LDLM_FL_AST_SENT                0x0000000000000020ULL // bit   5
 #define ldlm_is_ast_sent(_l)            LDLM_TEST_FLAG(( _l), 1ULL <<  5)
@@ -138,6 +146,12 @@
 #define ldlm_set_cos_incompat(_l)	LDLM_SET_FLAG((_l), 1ULL << 24)
 #define ldlm_clear_cos_incompat(_l)	LDLM_CLEAR_FLAG((_l), 1ULL << 24)
 
+/** do not expand the extent of this lock on the server */
+#define LDLM_FL_NO_EXPANSION            0x0000000020000000ULL // bit  29
+#define ldlm_is_no_expansion(_l)        LDLM_TEST_FLAG(( _l), 1ULL << 29)
+#define ldlm_set_no_expansion(_l)       LDLM_SET_FLAG((  _l), 1ULL << 29)
+#define ldlm_clear_no_expansion(_l)     LDLM_CLEAR_FLAG((_l), 1ULL << 29)
+
 /**
  * measure lock contention and return -EUSERS if locking contention is high */
 #define LDLM_FL_DENY_ON_CONTENTION        0x0000000040000000ULL // bit  30
@@ -362,6 +376,13 @@
 #define ldlm_is_cos_enabled(_l)          LDLM_TEST_FLAG((_l), 1ULL << 57)
 #define ldlm_set_cos_enabled(_l)         LDLM_SET_FLAG((_l), 1ULL << 57)
 
+/** Client is dropping some inodebits of the lock instead of cancelling it,
+ *  LDLM_CONVERT RPC is in flight. */
+#define LDLM_FL_CONVERTING               0x0400000000000000ULL /* bit  58 */
+#define ldlm_is_converting(_l)           LDLM_TEST_FLAG((_l), 1ULL << 58)
+#define ldlm_set_converting(_l)          LDLM_SET_FLAG((_l), 1ULL << 58)
+#define ldlm_clear_converting(_l)        LDLM_CLEAR_FLAG((_l), 1ULL << 58)
+
 /** l_flags bits marked as "ast" bits */
 #define LDLM_FL_AST_MASK                (LDLM_FL_FLOCK_DEADLOCK		|\
 					 LDLM_FL_AST_DISCARD_DATA)
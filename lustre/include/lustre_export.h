@@ -317,6 +317,13 @@ static inline __u64 exp_connect_flags(struct obd_export *exp)
 	return *exp_connect_flags_ptr(exp);
 }
 
+static inline __u64 exp_connect_flags2(struct obd_export *exp)
+{
+	if (exp_connect_flags(exp) & OBD_CONNECT_FLAGS2)
+		return exp->exp_connect_data.ocd_connect_flags2;
+	return 0;
+}
+
 static inline int exp_max_brw_size(struct obd_export *exp)
 {
 	LASSERT(exp != NULL);
@@ -406,6 +413,25 @@ static inline bool imp_connect_disp_stripe(struct obd_import *imp)
 	return ocd->ocd_connect_flags & OBD_CONNECT_DISP_STRIPE;
 }
 
+static inline bool imp_connect_shortio(struct obd_import *imp)
+{
+	struct obd_connect_data *ocd;
+
+	LASSERT(imp != NULL);
+	ocd = &imp->imp_connect_data;
+	return ocd->ocd_connect_flags & OBD_CONNECT_SHORTIO;
+}
+
+static inline bool imp_connect_multiobj_brw(struct obd_import *imp)
+{
+	struct obd_connect_data *ocd;
+
+	LASSERT(imp != NULL);
+	ocd = &imp->imp_connect_data;
+	return ocd->ocd_connect_flags & OBD_CONNECT_FLAGS2 &&
+	       ocd->ocd_connect_flags2 & OBD_CONNECT2_MULTIOBJ_BRW;
+}
+
 static inline __u64 exp_connect_ibits(struct obd_export *exp)
 {
 	struct obd_connect_data *ocd;
@@ -463,9 +463,16 @@
 #define OSS_CR_NTHRS_BASE	8
 #define OSS_CR_NTHRS_MAX	64
 
+/**
+ * Maximum number of objects a client packs into one OST_WRITE when the OST
+ * supports OBD_CONNECT2_MULTIOBJ_BRW, each one costs an obd_ioobj and an
+ * obdo in the request.
+ */
+#define OBD_MAX_BRW_OBJS	16
+
 /**
  * OST_IO_MAXREQSIZE ~=
- * 	lustre_msg + ptlrpc_body + obdo + obd_ioobj +
+ * 	lustre_msg + ptlrpc_body + (obdo + obd_ioobj) * OBD_MAX_BRW_OBJS +
  * 	DT_MAX_BRW_PAGES * niobuf_remote
  *
  * - single object with 16 pages is 512 bytes
@@ -475,8 +482,8 @@
  */
 #define _OST_MAXREQSIZE_SUM (sizeof(struct lustre_msg) + \
 			     sizeof(struct ptlrpc_body) + \
-			     sizeof(struct obdo) + \
-			     sizeof(struct obd_ioobj) + \
+			     (sizeof(struct obdo) + \
+			      sizeof(struct obd_ioobj)) * OBD_MAX_BRW_OBJS + \
 			     sizeof(struct niobuf_remote) * DT_MAX_BRW_PAGES)
 /**
  * FIEMAP request can be 4K+ for now
@@ -488,6 +495,14 @@
 #define OST_MAXREPSIZE		(9 * 1024)
 #define OST_IO_MAXREPSIZE	OST_MAXREPSIZE
 
+/**
+ * Largest OST_READ/OST_WRITE payload that is carried inline in the request
+ * or reply buffer instead of a bulk transfer (OBD_CONNECT_SHORTIO).  It has
+ * to fit into OST_IO_MAXREPSIZE together with the ost_body of the reply.
+ */
+#define OBD_MAX_SHORT_IO_BYTES	(8 * 1024)
+#define OBD_DEF_SHORT_IO_BYTES	min_t(int, PAGE_SIZE, OBD_MAX_SHORT_IO_BYTES)
+
 #define OST_NBUFS		64
 /** OST_BUFSIZE = max_reqsize + max sptlrpc payload size */
 #define OST_BUFSIZE		max_t(int, OST_MAXREQSIZE + 1024, 16 * 1024)
@@ -604,9 +619,30 @@ struct ptlrpc_request_set {
 	set_producer_func	set_producer;
 	/** opaq argument passed to the producer callback */
 	void			*set_producer_arg;
-	unsigned int		 set_allow_intr:1;
+	unsigned int		 set_allow_intr:1,
+	/** ptlrpc_check_set() only looks at the requests on set_changed,
+	 * see ptlrpc_set_req_changed().  Used by the ptlrpcd sets. */
+				 set_changed_only:1,
+	/** the next ptlrpc_check_set() must scan the whole set */
+				 set_rescan:1;
+	/**
+	 * Lock-free stack of the requests whose state changed since the last
+	 * ptlrpc_check_set(), linked by ptlrpc_cli_req::cr_changed_next.
+	 */
+	struct ptlrpc_request	*set_changed;
+	/** when ptlrpc_check_set() scans the whole set next */
+	cfs_time_t		 set_next_scan;
+	/** ptlrpc_check_set() calls that scanned the whole set */
+	unsigned long		 set_full_scans;
+	/** ptlrpc_check_set() calls that only checked set_changed */
+	unsigned long		 set_changed_scans;
+	/** requests checked by ptlrpc_check_set() */
+	unsigned long		 set_checked_reqs;
 };
 
+/** seconds between two full scans of a set with set_changed_only */
+#define PTLRPC_SET_SCAN_INTERVAL	1
+
 /**
  * Description of a single ptrlrpc_set callback
  */
@@ -807,6 +843,10 @@ struct ptlrpc_cli_req {
 	wait_queue_head_t		 cr_set_waitq;
 	/** Link item for request set lists */
 	struct list_head		 cr_set_chain;
+	/** link of ptlrpc_request_set::set_changed */
+	struct ptlrpc_request		*cr_changed_next;
+	/** bit 0 is set while the request is on set_changed */
+	unsigned long			 cr_changed;
 	/** link to waited ctx */
 	struct list_head		 cr_ctx_chain;
 
@@ -1913,6 +1953,14 @@ struct ptlrpcd_ctl {
 	 * Error code if the thread failed to fully start.
 	 */
 	int				pc_error;
+	/**
+	 * Number of new requests stolen from the partners.
+	 */
+	unsigned long			pc_partner_stolen;
+	/**
+	 * Number of new requests stolen from the other threads of the CPT.
+	 */
+	unsigned long			pc_cpt_stolen;
 };
 
 /* Bits for pc_flags */
@@ -1935,6 +1983,10 @@ enum ptlrpcd_ctl_flags {
          * This is a recovery ptlrpc thread.
          */
         LIOD_RECOVERY    = 1 << 3,
+	/**
+	 * The thread found nothing to do and may sleep, it can steal.
+	 */
+	LIOD_IDLE	 = 1 << 4,
 };
 
 /**
@@ -2096,6 +2148,7 @@ struct ptlrpc_request_set *ptlrpc_prep_fcset(int max, set_producer_func func,
 int ptlrpc_set_add_cb(struct ptlrpc_request_set *set,
                       set_interpreter_func fn, void *data);
 int ptlrpc_check_set(const struct lu_env *env, struct ptlrpc_request_set *set);
+void ptlrpc_set_req_changed(struct ptlrpc_request *req);
 int ptlrpc_set_wait(struct ptlrpc_request_set *);
 void ptlrpc_mark_interrupted(struct ptlrpc_request *req);
 void ptlrpc_set_destroy(struct ptlrpc_request_set *);
@@ -2504,10 +2557,12 @@ ptlrpc_client_recv_or_unlink(struct ptlrpc_request *req)
 static inline void
 ptlrpc_client_wake_req(struct ptlrpc_request *req)
 {
-	if (req->rq_set == NULL)
+	if (req->rq_set == NULL) {
 		wake_up(&req->rq_reply_waitq);
-	else
+	} else {
+		ptlrpc_set_req_changed(req);
 		wake_up(&req->rq_set->set_waitq);
+	}
 }
 
 static inline void
@@ -34,6 +34,8 @@
 #define __OBD_H
 
 #include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
 
 #include <lustre/lustre_idl.h>
 #include <lustre_lib.h>
@@ -159,6 +161,58 @@ enum obd_cl_sem_lock_class {
 
 struct mdc_rpc_lock;
 struct obd_import;
+
+/**
+ * Round trip times of the reads or of the writes of an OSC, as seen by the
+ * adaptive RPC controller.
+ */
+struct client_rpc_adapt_win {
+	/** the in-flight limit held back RPCs in the current window */
+	unsigned int		craw_limited:1;
+	/** # of BRW RPCs completed in the current window */
+	__u32			craw_count;
+	/** windows to go before the limits may grow again */
+	__u32			craw_hold;
+	/** windows since the baseline was refreshed */
+	__u32			craw_age;
+	/** sum of the round trip times per page in the window, nsec */
+	__u64			craw_rtt_sum;
+	/** baseline round trip time per page without queueing, nsec */
+	__u64			craw_rtt_base;
+	/** lowest window average since the baseline was refreshed */
+	__u64			craw_rtt_min;
+};
+
+/**
+ * State of the adaptive RPC controller of an OSC, see osc_rpc_adapt().
+ * Protected by client_obd::cl_loi_list_lock.
+ */
+struct client_rpc_adapt {
+	/** controller enabled */
+	unsigned int		cra_enabled:1;
+	/** max_rpcs_in_flight and max_pages_per_rpc set by the admin */
+	__u32			cra_rif_base;
+	__u32			cra_pages_base;
+	/** lowest max_rpcs_in_flight and max_pages_per_rpc seen queueing
+	 * since the baseline was refreshed, 0 if none */
+	__u32			cra_rif_ceil;
+	__u32			cra_pages_ceil;
+	/** [0] for reads, [1] for writes, their costs differ */
+	struct client_rpc_adapt_win cra_win[2];
+};
+
+/** Per-CPT partition of the LRU pages of a client_obd */
+struct cl_lru_cpt {
+	/** List of LRU pages of this partition */
+	struct list_head	clc_list;
+	/** Lock for clc_list */
+	spinlock_t		clc_lock;
+	/** # of pages in clc_list */
+	long			clc_in_list;
+	/** # of threads shrinking this partition */
+	atomic_t		clc_shrinkers;
+};
+
 struct client_obd {
 	struct rw_semaphore	 cl_sem;
 	struct obd_uuid		 cl_target_uuid;
@@ -246,6 +300,14 @@ struct client_obd {
 	atomic_t		cl_pending_r_pages;
 	__u32			cl_max_pages_per_rpc;
 	__u32			cl_max_rpcs_in_flight;
+	struct client_rpc_adapt	cl_rpc_adapt;
+	/** write coalescing window in usec, 0 if disabled, see
+	 * osc_extent_coalescing() */
+	__u32			cl_write_coalesce_us;
+	/** fires at the earliest end of the windows of the objects */
+	struct timer_list	cl_write_coalesce_timer;
+	/** kicks writeback from process context when the timer fires */
+	struct work_struct	cl_write_coalesce_work;
 	struct obd_histogram	cl_read_rpc_hist;
 	struct obd_histogram	cl_write_rpc_hist;
 	struct obd_histogram	cl_read_page_hist;
@@ -277,10 +339,11 @@ struct client_obd {
 	 * reclaim is sync, initiated by IO thread when the LRU slots are
 	 * in shortage. */
 	__u64                    cl_lru_reclaim;
-	/** List of LRU pages for this client_obd */
-	struct list_head         cl_lru_list;
-	/** Lock for LRU page list */
-	spinlock_t		 cl_lru_list_lock;
+	/** LRU pages of this client_obd, split per CPT so that I/O threads
+	 * on different partitions don't contend on one list lock */
+	struct cl_lru_cpt	**cl_lru_cpts;
+	/** CPT the next asynchronous LRU shrink starts from */
+	unsigned int		 cl_lru_shrink_cpt;
 	/** # of unstable pages in this client_obd.
 	 * An unstable page is a page state that WRITE RPC has finished but
 	 * the transaction has NOT yet committed. */
@@ -317,6 +380,8 @@ struct client_obd {
         __u32                    cl_supp_cksum_types;
         /* checksum algorithm to be used */
         cksum_type_t             cl_cksum_type;
+	/* largest BRW sent inline instead of as a bulk, 0 = disabled */
+	__u32			 cl_short_io_bytes;
 
         /* also protected by the poorly named _loi_list_lock lock above */
         struct osc_async_rc      cl_ar;
@@ -421,6 +486,9 @@ struct lmv_obd {
 	struct obd_connect_data	conn_data;
 };
 
+/* number of 512-byte sectors, and T10 guard tags, of a page */
+#define OBD_GUARDS_PER_PAGE	(PAGE_SIZE >> 9)
+
 struct niobuf_local {
 	__u64		lnb_file_offset;
 	__u32		lnb_page_offset;
@@ -429,6 +497,13 @@ struct niobuf_local {
 	int		lnb_rc;
 	struct page	*lnb_page;
 	void		*lnb_data;
+	/* lnb_guards are the T10 guard tags the client sent for the
+	 * sectors covered by the write, to be stored on the disk */
+	unsigned int	lnb_guard_rpc:1,
+	/* set before the read to ask for the guard tags stored on the disk,
+	 * cleared by the OSD if it could not return them in lnb_guards */
+			lnb_guard_disk:1;
+	__u16		lnb_guards[OBD_GUARDS_PER_PAGE];
 };
 
 struct tgt_thread_big_cache {
@@ -788,6 +863,7 @@ enum md_cli_flags {
 	CLI_HASH64      = 1 << 2,
 	CLI_API32       = 1 << 3,
 	CLI_MIGRATE     = 1 << 4,
+	CLI_READDIR_PLUS = 1 << 5,
 };
 
 /**
@@ -36,12 +36,24 @@
 #include <libcfs/libcfs_crypto.h>
 #include <lustre/lustre_idl.h>
 
+/* checksum types that carry per-sector T10 guard tags, see obd_t10_cksum_bulk */
+#define OBD_CKSUM_T10_ALL	(OBD_CKSUM_T10IP512 | OBD_CKSUM_T10CRC512)
+
+#if defined(CONFIG_CRC_T10DIF) || defined(CONFIG_CRC_T10DIF_MODULE)
+#define OBD_CKSUM_T10_SUPPORTED	OBD_CKSUM_T10_ALL
+#else
+#define OBD_CKSUM_T10_SUPPORTED	OBD_CKSUM_T10IP512
+#endif
+
 static inline unsigned char cksum_obd2cfs(cksum_type_t cksum_type)
 {
 	switch (cksum_type) {
 	case OBD_CKSUM_CRC32:
 		return CFS_HASH_ALG_CRC32;
 	case OBD_CKSUM_ADLER:
+	/* the guard tags of the T10 types are hashed with adler32 */
+	case OBD_CKSUM_T10IP512:
+	case OBD_CKSUM_T10CRC512:
 		return CFS_HASH_ALG_ADLER32;
 	case OBD_CKSUM_CRC32C:
 		return CFS_HASH_ALG_CRC32C;
@@ -68,6 +80,12 @@ static inline u32 cksum_type_pack(cksum_type_t cksum_type)
 	unsigned int    performance = 0, tmp;
 	u32		flag = OBD_FL_CKSUM_ADLER;
 
+	/* the T10 types are never picked by speed, only when asked for */
+	if (cksum_type == OBD_CKSUM_T10IP512)
+		return OBD_FL_CKSUM_T10IP512;
+	if (cksum_type == OBD_CKSUM_T10CRC512)
+		return OBD_FL_CKSUM_T10CRC512;
+
 	if (cksum_type & OBD_CKSUM_CRC32) {
 		tmp = cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32));
 		if (tmp > performance) {
@@ -91,7 +109,8 @@ static inline u32 cksum_type_pack(cksum_type_t cksum_type)
 	}
 	if (unlikely(cksum_type && !(cksum_type & (OBD_CKSUM_CRC32C |
 						   OBD_CKSUM_CRC32 |
-						   OBD_CKSUM_ADLER))))
+						   OBD_CKSUM_ADLER |
+						   OBD_CKSUM_T10_ALL))))
 		CWARN("unknown cksum type %x\n", cksum_type);
 
 	return flag;
@@ -104,6 +123,10 @@ static inline cksum_type_t cksum_type_unpack(u32 o_flags)
 		return OBD_CKSUM_CRC32C;
 	case OBD_FL_CKSUM_CRC32:
 		return OBD_CKSUM_CRC32;
+	case OBD_FL_CKSUM_T10IP512:
+		return OBD_CKSUM_T10IP512;
+	case OBD_FL_CKSUM_T10CRC512:
+		return OBD_CKSUM_T10CRC512;
 	default:
 		break;
 	}
@@ -128,6 +151,7 @@ static inline cksum_type_t cksum_types_supported_client(void)
 		ret |= OBD_CKSUM_CRC32C;
 	if (cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32)) > 0)
 		ret |= OBD_CKSUM_CRC32;
+	ret |= OBD_CKSUM_T10_SUPPORTED;
 
 	return ret;
 }
@@ -151,6 +175,8 @@ static inline cksum_type_t cksum_types_supported_server(void)
 	if (cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32)) >=
 	    base_speed)
 		ret |= OBD_CKSUM_CRC32;
+	/* opt-in only, and they save hashing when the disk stores the tags */
+	ret |= OBD_CKSUM_T10_SUPPORTED;
 
 	return ret;
 }
@@ -162,14 +188,59 @@ static inline cksum_type_t cksum_types_supported_server(void)
  * Currently, calling cksum_type_pack() with a mask will return the fastest
  * checksum type due to its benchmarking at libcfs module load.
  * Caution is advised, however, since what is fastest on a single client may
- * not be the fastest or most efficient algorithm on the server.  */
+ * not be the fastest or most efficient algorithm on the server.
+ * The T10 types are left out, they have to be set with checksum_type. */
 static inline cksum_type_t cksum_type_select(cksum_type_t cksum_types)
 {
-	return cksum_type_unpack(cksum_type_pack(cksum_types));
+	return cksum_type_unpack(cksum_type_pack(cksum_types &
+						 ~OBD_CKSUM_T10_ALL));
 }
 
 /* Checksum algorithm names. Must be defined in the same order as the
  * OBD_CKSUM_* flags. */
-#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler", "crc32c"}
+#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler", "crc32c", \
+						 "t10ip512", "t10crc512"}
+
+/*
+ * T10 protection information guard tags, computed over every 512-byte
+ * sector.  The RPC checksum of the T10 types is the adler32 of the guard
+ * tags of the bulk, so the tags can be computed once on the client and
+ * stored with the data by a disk with a matching integrity profile.
+ */
+#define OBD_DIF_SECTOR_SIZE	512
+
+typedef __u16 (obd_dif_csum_fn)(void *data, unsigned int length);
+
+__u16 obd_dif_ip_fn(void *data, unsigned int length);
+__u16 obd_dif_crc_fn(void *data, unsigned int length);
+
+static inline obd_dif_csum_fn *obd_t10_cksum2dif(cksum_type_t cksum_type)
+{
+	switch (cksum_type) {
+	case OBD_CKSUM_T10IP512:
+		return obd_dif_ip_fn;
+#if defined(CONFIG_CRC_T10DIF) || defined(CONFIG_CRC_T10DIF_MODULE)
+	case OBD_CKSUM_T10CRC512:
+		return obd_dif_crc_fn;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+int obd_page_dif_generate_buffer(const char *obd_name, struct page *page,
+				 __u32 offset, __u32 length,
+				 __u16 *guard_start, int guard_number,
+				 int *used_number, obd_dif_csum_fn *fn);
+
+/**
+ * Store the guard tags of the \a idx-th fragment of \a data in \a guards,
+ * see obd_t10_cksum_bulk().
+ */
+typedef int (*obd_t10_frag_guards_t)(void *data, int idx, __u16 *guards,
+				     int guard_number, int *used_number);
+
+int obd_t10_cksum_bulk(cksum_type_t cksum_type, void *data, int count,
+		       obd_t10_frag_guards_t frag_guards, u32 *cksum);
 
 #endif /* __OBD_H */
@@ -56,6 +56,18 @@
 
 #include "ldlm_internal.h"
 
+static inline int ldlm_mode_to_index(enum ldlm_mode mode)
+{
+	int index;
+
+	LASSERT(mode != 0);
+	LASSERT(IS_PO2(mode));
+	for (index = -1; mode != 0; index++, mode >>= 1)
+		/* do nothing */;
+	LASSERT(index < LCK_MODE_NUM);
+	return index;
+}
+
 #ifdef HAVE_SERVER_SUPPORT
 # define LDLM_MAX_GROWN_EXTENT (32 * 1024 * 1024 - 1)
 
@@ -176,91 +188,135 @@ static void ldlm_extent_internal_policy_granted(struct ldlm_lock *req,
         EXIT;
 }
 
+struct ldlm_extent_policy_args {
+	struct ldlm_lock	*lpa_req;
+	struct ldlm_extent	*lpa_new_ex;
+	bool			 lpa_compat;
+	int			 lpa_conflicting;
+};
+
+/* Callback for interval_search over the waiting trees, used by
+ * ldlm_extent_internal_policy_waiting */
+static enum interval_iter ldlm_extent_policy_waiting_cb(struct interval_node *n,
+							void *data)
+{
+	struct ldlm_extent_policy_args *arg = data;
+	struct ldlm_interval *node = to_ldlm_interval(n);
+	struct ldlm_lock *req = arg->lpa_req;
+	struct ldlm_extent *new_ex = arg->lpa_new_ex;
+	__u64 req_start = req->l_req_extent.start;
+	__u64 req_end = req->l_req_extent.end;
+	struct ldlm_lock *lock;
+
+	list_for_each_entry(lock, &node->li_group, l_sl_policy) {
+		struct ldlm_extent *l_extent = &lock->l_policy_data.l_extent;
+
+		/* We already hit the minimum requested size, search no more */
+		if (new_ex->start == req_start && new_ex->end == req_end)
+			return INTERVAL_ITER_STOP;
+
+		/* Don't conflict with ourselves */
+		if (req == lock)
+			continue;
+
+		/* Until bug 20 is fixed, try to avoid granting overlapping
+		 * locks on one client (they take a long time to cancel) */
+		if (arg->lpa_compat) {
+			if (lock->l_export != req->l_export)
+				continue;
+			++arg->lpa_conflicting;
+		}
+
+		/* If lock doesn't overlap new_ex, skip it. */
+		if (!ldlm_extent_overlap(l_extent, new_ex))
+			continue;
+
+		/* Locks conflicting in requested extents and we can't satisfy
+		 * both locks, so ignore it. */
+		if (ldlm_extent_overlap(&lock->l_req_extent,
+					&req->l_req_extent))
+			continue;
+
+		/* Grow downwards only as far as we don't overlap with the
+		 * waiting lock, see ldlm_extent_internal_policy_granted(). */
+		if (l_extent->start < req_start && new_ex->start != req_start) {
+			if (l_extent->end >= req_start)
+				new_ex->start = req_start;
+			else
+				new_ex->start = min(l_extent->end + 1,
+						    req_start);
+		}
+
+		/* If we need to cancel this lock anyways because our request
+		 * overlaps it, grow up to its requested extent start instead
+		 * of limiting this extent. */
+		if (l_extent->end > req_end) {
+			if (l_extent->start <= req_end)
+				new_ex->end = max(lock->l_req_extent.start - 1,
+						  req_end);
+			else
+				new_ex->end = max(l_extent->start - 1, req_end);
+		}
+	}
+
+	return INTERVAL_ITER_CONT;
+}
+
 /* The purpose of this function is to return:
  * - the maximum extent
  * - containing the requested extent
  * - and not overlapping existing conflicting extents outside the requested one
+ *
+ * Only the waiting locks overlapping the extent grown so far are looked at,
+ * they are found through the waiting interval trees of the resource rather
+ * than by walking lr_waiting.
  */
 static void
 ldlm_extent_internal_policy_waiting(struct ldlm_lock *req,
-                                    struct ldlm_extent *new_ex)
+				    struct ldlm_extent *new_ex)
 {
 	struct ldlm_resource *res = req->l_resource;
 	enum ldlm_mode req_mode = req->l_req_mode;
-	__u64 req_start = req->l_req_extent.start;
-	__u64 req_end = req->l_req_extent.end;
-	struct ldlm_lock *lock;
-	int conflicting = 0;
+	struct ldlm_extent_policy_args arg = { .lpa_req = req,
+					       .lpa_new_ex = new_ex };
+	struct ldlm_interval_tree *tree;
+	struct interval_node_extent ex;
+	int idx;
 	ENTRY;
 
 	lockmode_verify(req_mode);
 
-	/* for waiting locks */
-	list_for_each_entry(lock, &res->lr_waiting, l_res_link) {
-		struct ldlm_extent *l_extent = &lock->l_policy_data.l_extent;
-
-		/* We already hit the minimum requested size, search no more */
-		if (new_ex->start == req_start && new_ex->end == req_end) {
-			EXIT;
-			return;
-		}
-
-                /* Don't conflict with ourselves */
-                if (req == lock)
-                        continue;
-
-                /* Locks are compatible, overlap doesn't matter */
-                /* Until bug 20 is fixed, try to avoid granting overlapping
-                 * locks on one client (they take a long time to cancel) */
-                if (lockmode_compat(lock->l_req_mode, req_mode) &&
-                    lock->l_export != req->l_export)
-                        continue;
-
-                /* If this is a high-traffic lock, don't grow downwards at all
-                 * or grow upwards too much */
-                ++conflicting;
-                if (conflicting > 4)
-                        new_ex->start = req_start;
-
-                /* If lock doesn't overlap new_ex, skip it. */
-                if (!ldlm_extent_overlap(l_extent, new_ex))
-                        continue;
+	/* every incompatible waiting lock counts towards the contention
+	 * of the resource, whether it overlaps us or not */
+	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
+		tree = &res->lr_witree[idx];
+		if (!lockmode_compat(tree->lit_mode, req_mode))
+			arg.lpa_conflicting += tree->lit_size;
+	}
+	if (req->l_wait_seq != 0 && !lockmode_compat(req_mode, req_mode))
+		arg.lpa_conflicting--;
 
-                /* Locks conflicting in requested extents and we can't satisfy
-                 * both locks, so ignore it.  Either we will ping-pong this
-                 * extent (we would regardless of what extent we granted) or
-                 * lock is unused and it shouldn't limit our extent growth. */
-                if (ldlm_extent_overlap(&lock->l_req_extent,&req->l_req_extent))
-                        continue;
+	/* If this is a high-traffic resource, don't grow downwards at all
+	 * or grow upwards too much */
+	if (arg.lpa_conflicting > 4)
+		new_ex->start = req->l_req_extent.start;
 
-                /* We grow extents downwards only as far as they don't overlap
-                 * with already-granted locks, on the assumption that clients
-                 * will be writing beyond the initial requested end and would
-                 * then need to enqueue a new lock beyond previous request.
-                 * l_req_extent->end strictly < req_start, checked above. */
-                if (l_extent->start < req_start && new_ex->start != req_start) {
-                        if (l_extent->end >= req_start)
-                                new_ex->start = req_start;
-                        else
-                                new_ex->start = min(l_extent->end+1, req_start);
-                }
+	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
+		tree = &res->lr_witree[idx];
+		if (tree->lit_root == NULL)
+			continue;
 
-                /* If we need to cancel this lock anyways because our request
-                 * overlaps the granted lock, we grow up to its requested
-                 * extent start instead of limiting this extent, assuming that
-                 * clients are writing forwards and the lock had over grown
-                 * its extent downwards before we enqueued our request. */
-                if (l_extent->end > req_end) {
-                        if (l_extent->start <= req_end)
-                                new_ex->end = max(lock->l_req_extent.start - 1,
-                                                  req_end);
-                        else
-                                new_ex->end = max(l_extent->start - 1, req_end);
-                }
-        }
+		ex.start = new_ex->start;
+		ex.end = new_ex->end;
+		arg.lpa_compat = lockmode_compat(tree->lit_mode, req_mode);
+		if (interval_search(tree->lit_root, &ex,
+				    ldlm_extent_policy_waiting_cb, &arg) ==
+		    INTERVAL_ITER_STOP)
+			break;
+	}
 
-        ldlm_extent_internal_policy_fixup(req, new_ex, conflicting);
-        EXIT;
+	ldlm_extent_internal_policy_fixup(req, new_ex, arg.lpa_conflicting);
+	EXIT;
 }
 
 
@@ -286,6 +342,10 @@ static void ldlm_extent_policy(struct ldlm_resource *res,
                 /* fast-path whole file locks */
                 return;
 
+	/* lock ahead asks for exactly the extent it wants */
+	if (*flags & LDLM_FL_NO_EXPANSION)
+		return;
+
         ldlm_extent_internal_policy_granted(lock, &new_ex);
         ldlm_extent_internal_policy_waiting(lock, &new_ex);
 
@@ -358,6 +418,135 @@ static enum interval_iter ldlm_extent_compat_cb(struct interval_node *n,
         RETURN(INTERVAL_ITER_CONT);
 }
 
+struct ldlm_extent_wait_args {
+	struct list_head	*lwa_work_list;
+	struct ldlm_lock	*lwa_req;
+	/* only the locks queued before this sequence are looked at */
+	__u64			 lwa_seq;
+	int			*lwa_locks;
+	int			 lwa_compat;
+};
+
+/* Find the first waiting lock which is compatible with \a req and covers
+ * it, nothing queued after such a lock can block \a req. */
+static enum interval_iter ldlm_extent_cover_cb(struct interval_node *n,
+					       void *data)
+{
+	struct ldlm_extent_wait_args *arg = data;
+	struct ldlm_interval *node = to_ldlm_interval(n);
+	struct ldlm_extent *req_ex = &arg->lwa_req->l_policy_data.l_extent;
+	struct ldlm_extent *extent = ldlm_interval_extent(node);
+	struct ldlm_lock *lock;
+
+	if (extent->start > req_ex->start || extent->end < req_ex->end)
+		return INTERVAL_ITER_CONT;
+
+	/* There IS a case where AST_SENT is not set for a lock, yet it
+	 * blocks something. This is only during destroy, so the lock is
+	 * exclusive and we are safe here. */
+	list_for_each_entry(lock, &node->li_group, l_sl_policy) {
+		if (lock->l_wait_seq < arg->lwa_seq &&
+		    !ldlm_is_ast_sent(lock))
+			arg->lwa_seq = lock->l_wait_seq;
+	}
+
+	return INTERVAL_ITER_CONT;
+}
+
+static enum interval_iter ldlm_extent_wait_compat_cb(struct interval_node *n,
+						     void *data)
+{
+	struct ldlm_extent_wait_args *arg = data;
+	struct ldlm_interval *node = to_ldlm_interval(n);
+	struct ldlm_lock *req = arg->lwa_req;
+	struct ldlm_lock *lock;
+	int check_contention;
+
+	list_for_each_entry(lock, &node->li_group, l_sl_policy) {
+		if (lock->l_wait_seq >= arg->lwa_seq)
+			continue;
+
+		arg->lwa_compat = 0;
+		if (arg->lwa_work_list == NULL)
+			return INTERVAL_ITER_STOP;
+
+		/* false contention, the requests doesn't really overlap */
+		check_contention =
+			ldlm_extent_overlap(&lock->l_req_extent,
+					    &req->l_req_extent);
+		/* don't count conflicting glimpse locks */
+		if (lock->l_req_mode == LCK_PR &&
+		    lock->l_policy_data.l_extent.start == 0 &&
+		    lock->l_policy_data.l_extent.end == OBD_OBJECT_EOF)
+			check_contention = 0;
+
+		*arg->lwa_locks += check_contention;
+
+		if (lock->l_blocking_ast)
+			ldlm_add_ast_work_item(lock, req, arg->lwa_work_list);
+	}
+
+	return INTERVAL_ITER_CONT;
+}
+
+/**
+ * Check \a req against the waiting interval trees of its resource.
+ *
+ * This gives the same answer as walking lr_waiting up to \a req, as long
+ * as no GROUP lock is involved: those are reordered in the waiting list and
+ * must be handled by the list walk in ldlm_extent_compat_queue().
+ *
+ * \retval 0 if the lock is not compatible
+ * \retval 1 if the lock is compatible
+ */
+static int ldlm_extent_compat_waiting(struct ldlm_lock *req,
+				      struct list_head *work_list,
+				      int *contended_locks, bool *covered)
+{
+	struct ldlm_resource *res = req->l_resource;
+	enum ldlm_mode req_mode = req->l_req_mode;
+	struct ldlm_extent_wait_args data = { .lwa_work_list = work_list,
+					      .lwa_req = req,
+					      .lwa_locks = contended_locks,
+					      .lwa_compat = 1 };
+	struct interval_node_extent ex;
+	struct ldlm_interval_tree *tree;
+	int idx;
+
+	/* a lock not queued yet is checked against all waiting locks */
+	data.lwa_seq = req->l_wait_seq != 0 ? req->l_wait_seq : ~0ULL;
+
+	if (req_mode == LCK_PR) {
+		ex.start = req->l_policy_data.l_extent.start;
+		ex.end = req->l_policy_data.l_extent.end;
+		for (idx = 0; idx < LCK_MODE_NUM; idx++) {
+			tree = &res->lr_witree[idx];
+			if (tree->lit_root == NULL ||
+			    !lockmode_compat(tree->lit_mode, req_mode))
+				continue;
+			interval_search(tree->lit_root, &ex,
+					ldlm_extent_cover_cb, &data);
+		}
+		*covered = data.lwa_seq != (req->l_wait_seq != 0 ?
+					    req->l_wait_seq : ~0ULL);
+	}
+
+	ex.start = req->l_req_extent.start;
+	ex.end = req->l_req_extent.end;
+	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
+		tree = &res->lr_witree[idx];
+		if (tree->lit_root == NULL ||
+		    lockmode_compat(tree->lit_mode, req_mode))
+			continue;
+		if (interval_search(tree->lit_root, &ex,
+				    ldlm_extent_wait_compat_cb, &data) ==
+		    INTERVAL_ITER_STOP)
+			break;
+	}
+
+	return data.lwa_compat;
+}
+
 /**
  * Determine if the lock is compatible with all locks on the queue.
  *
@@ -449,7 +638,18 @@ ldlm_extent_compat_queue(struct list_head *queue, struct ldlm_lock *req,
                                         compat = 0;
                         }
                 }
-        } else { /* for waiting queue */
+	} else if (req_mode != LCK_GROUP &&
+		   res->lr_witree[ldlm_mode_to_index(LCK_GROUP)].lit_root ==
+		   NULL) {
+		bool covered = false;
+
+		compat = ldlm_extent_compat_waiting(req, work_list,
+						    contended_locks, &covered);
+		/* we met a PR lock just like us or wider which nobody
+		 * conflicted with, see below */
+		if (covered)
+			RETURN(compat);
+	} else { /* for waiting queue with group locks */
 		list_for_each_entry(lock, queue, l_res_link) {
                         check_contention = 1;
 
@@ -627,7 +827,7 @@ ldlm_extent_compat_queue(struct list_head *queue, struct ldlm_lock *req,
 
         RETURN(compat);
 destroylock:
-	list_del_init(&req->l_res_link);
+	ldlm_resource_unlink_lock(req);
         ldlm_lock_destroy_nolock(req);
         *err = compat;
         RETURN(compat);
@@ -823,6 +1023,28 @@ int ldlm_process_extent_lock(struct ldlm_lock *lock, __u64 *flags,
                 RETURN(LDLM_ITER_CONTINUE);
         }
 
+	/* A speculative lock is granted right away or not at all, it must
+	 * never cause blocking ASTs to be sent to the holders of the locks
+	 * it conflicts with. */
+	if (*flags & LDLM_FL_SPECULATIVE) {
+		rc = ldlm_extent_compat_queue(&res->lr_granted, lock, flags,
+					      err, NULL, &contended_locks);
+		if (rc == 1)
+			rc = ldlm_extent_compat_queue(&res->lr_waiting, lock,
+						      flags, err, NULL,
+						      &contended_locks);
+		if (rc < 0)
+			RETURN(rc); /* lock was destroyed */
+		if (rc > 0)
+			goto grant;
+
+		LDLM_DEBUG(lock, "speculative lock conflicts, refusing it");
+		list_del_init(&lock->l_res_link);
+		ldlm_lock_destroy_nolock(lock);
+		*err = -EWOULDBLOCK;
+		RETURN(-EWOULDBLOCK);
+	}
+
  restart:
         contended_locks = 0;
         rc = ldlm_extent_compat_queue(&res->lr_granted, lock, flags, err,
@@ -1060,18 +1282,6 @@ struct ldlm_interval *ldlm_interval_detach(struct ldlm_lock *l)
 	return list_empty(&n->li_group) ? n : NULL;
 }
 
-static inline int ldlm_mode_to_index(enum ldlm_mode mode)
-{
-	int index;
-
-	LASSERT(mode != 0);
-	LASSERT(IS_PO2(mode));
-	for (index = -1; mode != 0; index++, mode >>= 1)
-		/* do nothing */;
-	LASSERT(index < LCK_MODE_NUM);
-	return index;
-}
-
 /** Add newly granted lock into interval tree for the resource. */
 void ldlm_extent_add_lock(struct ldlm_resource *res,
                           struct ldlm_lock *lock)
@@ -1132,14 +1342,96 @@ void ldlm_extent_add_lock(struct ldlm_resource *res,
 	}
 }
 
+/**
+ * Add a lock queued on lr_waiting into the waiting interval tree of its
+ * requested mode.
+ *
+ * Locks with the same extent share one tree node, as in the granted trees,
+ * but each of them keeps its own ldlm_interval so that it can be moved to
+ * the granted tree later on without allocating.
+ */
+void ldlm_extent_add_waiting(struct ldlm_resource *res, struct ldlm_lock *lock)
+{
+	struct ldlm_interval *node = lock->l_tree_node;
+	struct ldlm_extent *extent = &lock->l_policy_data.l_extent;
+	struct ldlm_interval_tree *tree;
+	struct interval_node *found;
+	int rc;
+
+	if (lock->l_wait_seq != 0) /* already there, moved in the list only */
+		return;
+
+	LASSERT(node != NULL);
+	LASSERT(!interval_is_intree(&node->li_node));
+
+	tree = &res->lr_witree[ldlm_mode_to_index(lock->l_req_mode)];
+	rc = interval_set(&node->li_node, extent->start, extent->end);
+	LASSERT(!rc);
+
+	found = interval_insert(&node->li_node, &tree->lit_root);
+	if (found)
+		list_move_tail(&lock->l_sl_policy,
+			       &to_ldlm_interval(found)->li_group);
+	tree->lit_size++;
+	lock->l_wait_seq = ++res->lr_wait_seq;
+}
+
+/* Remove a lock from the waiting interval tree. */
+static void ldlm_extent_unlink_waiting(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct ldlm_interval *own = lock->l_tree_node;
+	struct ldlm_interval *node = own;
+	struct ldlm_interval_tree *tree;
+
+	tree = &res->lr_witree[ldlm_mode_to_index(lock->l_req_mode)];
+	LASSERT(tree->lit_root != NULL);
+
+	/* the extent the lock was indexed with is kept in its own node */
+	if (!interval_is_intree(&own->li_node)) {
+		struct interval_node *found;
+
+		found = interval_find(tree->lit_root, &own->li_node.in_extent);
+		LASSERT(found != NULL);
+		node = to_ldlm_interval(found);
+	}
+
+	list_del_init(&lock->l_sl_policy);
+	if (node == own) {
+		if (list_empty(&own->li_group)) {
+			interval_erase(&own->li_node, &tree->lit_root);
+		} else {
+			/* hand the tree node over to another lock with the
+			 * same extent and take its spare node instead */
+			struct ldlm_lock *next;
+
+			next = list_entry(own->li_group.next, struct ldlm_lock,
+					  l_sl_policy);
+			LASSERT(list_empty(&next->l_tree_node->li_group));
+			own = next->l_tree_node;
+			next->l_tree_node = node;
+			lock->l_tree_node = own;
+		}
+	}
+	list_add_tail(&lock->l_sl_policy, &own->li_group);
+
+	tree->lit_size--;
+	lock->l_wait_seq = 0;
+}
+
 /** Remove cancelled lock from resource interval tree. */
 void ldlm_extent_unlink_lock(struct ldlm_lock *lock)
 {
 	struct ldlm_resource *res = lock->l_resource;
-	struct ldlm_interval *node = lock->l_tree_node;
+	struct ldlm_interval *node;
 	struct ldlm_interval_tree *tree;
 	int idx;
 
+	/* this may change the tree node of the lock */
+	if (lock->l_wait_seq != 0)
+		ldlm_extent_unlink_waiting(lock);
+
+	node = lock->l_tree_node;
 	if (!node || !interval_is_intree(&node->li_node)) /* duplicate unlink */
 		return;
 
@@ -258,8 +258,101 @@ out:
 
 	RETURN(rc);
 }
+
+/**
+ * Work out which bits of \a lock a blocking AST sent on behalf of
+ * \a blocker may ask the client to drop, the rest of the lock staying
+ * granted (OBD_CONNECT2_LOCK_CONVERT).
+ *
+ * \retval the conflicting bits, if they are a strict subset of the bits
+ *	   held by \a lock
+ * \retval 0 if the whole lock has to be cancelled
+ */
+__u64 ldlm_inodebits_cancel_bits(struct ldlm_lock *lock,
+				 struct ldlm_lock *blocker)
+{
+	__u64 bits = lock->l_policy_data.l_inodebits.bits;
+	__u64 drop;
+
+	if (lock->l_resource->lr_type != LDLM_IBITS ||
+	    lock->l_export == NULL || blocker == NULL || blocker == lock ||
+	    ldlm_is_cancel_on_block(lock) ||
+	    !(exp_connect_flags2(lock->l_export) & OBD_CONNECT2_LOCK_CONVERT))
+		return 0;
+
+	drop = bits & blocker->l_policy_data.l_inodebits.bits;
+	if (drop == 0 || drop == bits)
+		return 0;
+
+	return drop;
+}
+
+/**
+ * Convert a granted lock to \a new_bits, a subset of its bits, after the
+ * client dropped the others in reply to a blocking AST.
+ *
+ * The conversion is refused if the remaining bits still conflict with a
+ * waiting lock: blocking ASTs for it were sent already and would not be
+ * sent again, so the client has to cancel the whole lock instead.
+ *
+ * \retval 0 if the lock holds \a new_bits only now
+ * \retval -EINVAL if \a new_bits is not a subset of the granted bits
+ * \retval -EBUSY if the remaining bits still block a waiting lock
+ */
+int ldlm_inodebits_convert(struct ldlm_lock *lock, __u64 new_bits)
+{
+	struct ldlm_resource *res;
+	struct ldlm_lock *waiter;
+	__u64 bits;
+	int rc = 0;
+	ENTRY;
+
+	res = lock_res_and_lock(lock);
+	bits = lock->l_policy_data.l_inodebits.bits;
+	if (lock->l_granted_mode != lock->l_req_mode ||
+	    ldlm_is_destroyed(lock) || new_bits == 0 ||
+	    (new_bits & ~bits) != 0)
+		GOTO(out, rc = -EINVAL);
+
+	list_for_each_entry(waiter, &res->lr_waiting, l_res_link) {
+		if (!lockmode_compat(waiter->l_req_mode, lock->l_granted_mode) &&
+		    (waiter->l_policy_data.l_inodebits.bits & new_bits))
+			GOTO(out, rc = -EBUSY);
+	}
+
+	if (new_bits != bits)
+		ldlm_inodebits_drop(lock, bits & ~new_bits);
+
+	/* the lock does not block anybody anymore, a new conflict has to
+	 * send a new blocking AST */
+	ldlm_clear_ast_sent(lock);
+	ldlm_clear_cbpending(lock);
+	lock->l_bl_ast_run = 0;
+	LDLM_DEBUG(lock, "converted to bits %#llx", new_bits);
+	EXIT;
+out:
+	unlock_res_and_lock(lock);
+	return rc;
+}
 #endif /* HAVE_SERVER_SUPPORT */
 
+/**
+ * Remove \a to_drop from the bits of granted \a lock, moving the lock to
+ * the skiplist group of the bits it keeps.
+ *
+ * Must be called with the resource lock held.
+ */
+void ldlm_inodebits_drop(struct ldlm_lock *lock, __u64 to_drop)
+{
+	check_res_locked(lock->l_resource);
+	LASSERT(lock->l_resource->lr_type == LDLM_IBITS);
+	LASSERT(lock->l_granted_mode == lock->l_req_mode);
+
+	ldlm_resource_unlink_lock(lock);
+	lock->l_policy_data.l_inodebits.bits &= ~to_drop;
+	ldlm_grant_lock_with_skiplist(lock);
+}
+
 void ldlm_ibits_policy_wire_to_local(const union ldlm_wire_policy_data *wpolicy,
 				     union ldlm_policy_data *lpolicy)
 {
@@ -113,12 +113,19 @@ int ldlm_cancel_lru_local(struct ldlm_namespace *ns,
 			  struct list_head *cancels, int count, int max,
 			  enum ldlm_cancel_flags cancel_flags,
 			  enum ldlm_lru_flags lru_flags);
+int ldlm_request_bufsize(int count, int type);
+int ldlm_cli_cancel_handles(struct obd_import *imp,
+			    struct lustre_handle *handles, int count);
 extern unsigned int ldlm_enqueue_min;
 /* ldlm_resource.c */
 extern struct kmem_cache *ldlm_resource_slab;
 extern struct kmem_cache *ldlm_lock_slab;
 extern struct kmem_cache *ldlm_interval_tree_slab;
 
+/* granted and waiting interval trees of a resource share one allocation */
+#define LDLM_ITREE_ALLOC_SIZE	\
+	(sizeof(struct ldlm_interval_tree) * LCK_MODE_NUM * 2)
+
 void ldlm_resource_insert_lock_after(struct ldlm_lock *original,
                                      struct ldlm_lock *new);
 
@@ -140,6 +147,7 @@ typedef enum {
 } ldlm_desc_ast_t;
 
 void ldlm_grant_lock(struct ldlm_lock *lock, struct list_head *work_list);
+void ldlm_grant_lock_with_skiplist(struct ldlm_lock *lock);
 int ldlm_fill_lvb(struct ldlm_lock *lock, struct req_capsule *pill,
 		  enum req_location loc, void *data, int size);
 struct ldlm_lock *
@@ -185,6 +193,13 @@ int ldlm_bl_thread_wakeup(void);
 
 void ldlm_handle_bl_callback(struct ldlm_namespace *ns,
                              struct ldlm_lock_desc *ld, struct ldlm_lock *lock);
+#ifdef HAVE_SERVER_SUPPORT
+int ldlm_bl_ast_batch_size(struct ldlm_lock *lock);
+int ldlm_waiting_locks_seq_show(struct seq_file *m, void *v);
+int ldlm_server_blocking_ast_batch(struct ldlm_lock **locks, int count,
+				   struct ldlm_lock_desc *desc,
+				   struct ldlm_cb_set_arg *arg);
+#endif
 
 #ifdef HAVE_SERVER_SUPPORT
 /* ldlm_plain.c */
@@ -196,7 +211,11 @@ int ldlm_process_plain_lock(struct ldlm_lock *lock, __u64 *flags,
 int ldlm_process_inodebits_lock(struct ldlm_lock *lock, __u64 *flags,
 				int first_enq, enum ldlm_error *err,
 				struct list_head *work_list);
+__u64 ldlm_inodebits_cancel_bits(struct ldlm_lock *lock,
+				 struct ldlm_lock *blocker);
+int ldlm_inodebits_convert(struct ldlm_lock *lock, __u64 new_bits);
 #endif
+void ldlm_inodebits_drop(struct ldlm_lock *lock, __u64 to_drop);
 
 /* ldlm_extent.c */
 #ifdef HAVE_SERVER_SUPPORT
@@ -206,6 +225,7 @@ int ldlm_process_extent_lock(struct ldlm_lock *lock, __u64 *flags,
 #endif
 void ldlm_extent_add_lock(struct ldlm_resource *res, struct ldlm_lock *lock);
 void ldlm_extent_unlink_lock(struct ldlm_lock *lock);
+void ldlm_extent_add_waiting(struct ldlm_resource *res, struct ldlm_lock *lock);
 
 /* ldlm_flock.c */
 int ldlm_process_flock_lock(struct ldlm_lock *req, __u64 *flags,
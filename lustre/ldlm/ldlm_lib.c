@@ -384,8 +384,6 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	atomic_set(&cli->cl_lru_shrinkers, 0);
 	atomic_long_set(&cli->cl_lru_busy, 0);
 	atomic_long_set(&cli->cl_lru_in_list, 0);
-	INIT_LIST_HEAD(&cli->cl_lru_list);
-	spin_lock_init(&cli->cl_lru_list_lock);
 	atomic_long_set(&cli->cl_unstable_count, 0);
 	INIT_LIST_HEAD(&cli->cl_shrink_list);
 
@@ -402,6 +400,7 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	cli->cl_cksum_type = cli->cl_supp_cksum_types = OBD_CKSUM_CRC32;
 #endif
 	atomic_set(&cli->cl_resends, OSC_DEFAULT_RESENDS);
+	cli->cl_short_io_bytes = OBD_DEF_SHORT_IO_BYTES;
 
 	/* Set it to possible maximum size. It may be reduced by ocd_brw_size
 	 * from OFD after connecting. */
@@ -1068,7 +1068,7 @@ static void ldlm_granted_list_add_lock(struct ldlm_lock *lock,
  * Add a lock to granted list on a resource maintaining skiplist
  * correctness.
  */
-static void ldlm_grant_lock_with_skiplist(struct ldlm_lock *lock)
+void ldlm_grant_lock_with_skiplist(struct ldlm_lock *lock)
 {
         struct sl_insert_point prev;
         ENTRY;
@@ -1891,6 +1891,78 @@ int ldlm_reprocess_queue(struct ldlm_resource *res, struct list_head *queue,
 }
 #endif
 
+#ifdef HAVE_SERVER_SUPPORT
+/**
+ * Send the blocking AST of \a lock together with those of the other locks
+ * on the ast_work list which belong to the same export and are blocked by
+ * the same lock, at most \a max of them.  If the batch can't be sent, the
+ * ASTs are sent one by one with ->l_blocking_ast() instead.
+ *
+ * \retval 1 if nothing was done and the AST of \a lock is still to be sent
+ */
+static int ldlm_work_bl_ast_batch(struct ldlm_cb_set_arg *arg,
+				  struct ldlm_lock *lock,
+				  struct ldlm_lock_desc *d, int max)
+{
+	__u64 ast_flags = lock->l_flags & LDLM_FL_AST_MASK;
+	struct ldlm_lock *tmp, *next;
+	struct ldlm_lock **locks;
+	int count = 1;
+	int rc, rc0 = 0, rc2, i;
+
+	OBD_ALLOC(locks, max * sizeof(*locks));
+	if (locks == NULL)
+		return 1;
+
+	locks[0] = lock;
+	list_for_each_entry_safe(tmp, next, arg->list, l_bl_ast) {
+		if (count == max)
+			break;
+
+		if (tmp->l_export != lock->l_export ||
+		    tmp->l_blocking_lock != lock->l_blocking_lock ||
+		    tmp->l_blocking_ast != lock->l_blocking_ast)
+			continue;
+
+		/* nobody should touch l_bl_ast */
+		lock_res_and_lock(tmp);
+		if (ldlm_is_cancel_on_block(tmp) ||
+		    (tmp->l_flags & LDLM_FL_AST_MASK) != ast_flags) {
+			unlock_res_and_lock(tmp);
+			continue;
+		}
+		list_del_init(&tmp->l_bl_ast);
+
+		LASSERT(ldlm_is_ast_sent(tmp));
+		LASSERT(tmp->l_bl_ast_run == 0);
+		tmp->l_bl_ast_run++;
+		unlock_res_and_lock(tmp);
+
+		locks[count++] = tmp;
+	}
+
+	rc = ldlm_server_blocking_ast_batch(locks, count, d, arg);
+	if (rc != 0)
+		LDLM_DEBUG(lock, "batched blocking AST of %d locks failed: "
+			   "rc = %d, sending them one by one", count, rc);
+
+	for (i = 0; i < count; i++) {
+		if (rc != 0) {
+			rc2 = locks[i]->l_blocking_ast(locks[i], d, (void *)arg,
+						       LDLM_CB_BLOCKING);
+			if (i == 0)
+				rc0 = rc2;
+		}
+		LDLM_LOCK_RELEASE(locks[i]->l_blocking_lock);
+		locks[i]->l_blocking_lock = NULL;
+		LDLM_LOCK_RELEASE(locks[i]);
+	}
+	OBD_FREE(locks, max * sizeof(*locks));
+
+	return rc != 0 ? rc0 : 0;
+}
+#endif
+
 /**
  * Process a call to blocking AST callback for a lock in ast_work list
  */
@@ -1901,6 +1973,10 @@ ldlm_work_bl_ast_lock(struct ptlrpc_request_set *rqset, void *opaq)
 	struct ldlm_lock_desc   d;
 	int                     rc;
 	struct ldlm_lock       *lock;
+#ifdef HAVE_SERVER_SUPPORT
+	__u64			cancel_bits;
+	int			max;
+#endif
 	ENTRY;
 
 	if (list_empty(arg->list))
@@ -1920,6 +1996,20 @@ ldlm_work_bl_ast_lock(struct ptlrpc_request_set *rqset, void *opaq)
 
 	ldlm_lock2desc(lock->l_blocking_lock, &d);
 
+#ifdef HAVE_SERVER_SUPPORT
+	/* let the client keep the bits that do not conflict; such a lock
+	 * needs its own desc, so it is never part of a batch */
+	cancel_bits = ldlm_inodebits_cancel_bits(lock, lock->l_blocking_lock);
+	if (cancel_bits != 0)
+		d.l_policy_data.l_inodebits.cancel_bits = cancel_bits;
+	max = cancel_bits != 0 ? 1 : ldlm_bl_ast_batch_size(lock);
+	if (max > 1) {
+		rc = ldlm_work_bl_ast_batch(arg, lock, &d, max);
+		if (rc != 1)
+			RETURN(rc);
+	}
+#endif
+
 	rc = lock->l_blocking_ast(lock, &d, (void *)arg, LDLM_CB_BLOCKING);
 	LDLM_LOCK_RELEASE(lock->l_blocking_lock);
 	lock->l_blocking_lock = NULL;
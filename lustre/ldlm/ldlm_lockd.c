@@ -53,12 +53,24 @@ static char *ldlm_cpts;
 module_param(ldlm_cpts, charp, 0444);
 MODULE_PARM_DESC(ldlm_cpts, "CPU partitions ldlm threads should run on");
 
+static unsigned int ldlm_bl_ast_batch = 64;
+module_param(ldlm_bl_ast_batch, uint, 0644);
+MODULE_PARM_DESC(ldlm_bl_ast_batch,
+		 "max locks of one client per blocking AST RPC, 1 disables batching");
+
+/* client and server handles of every lock must fit into LDLM_MAXREQSIZE */
+#define LDLM_BL_AST_BATCH_MAX	128
+
 static struct mutex	ldlm_ref_mutex;
 static int ldlm_refcount;
 
 struct ldlm_cb_async_args {
         struct ldlm_cb_set_arg *ca_set_arg;
         struct ldlm_lock       *ca_lock;
+	/* locks of a batched blocking AST, NULL terminated if shorter than
+	 * ca_count, ca_lock is not used then */
+	struct ldlm_lock      **ca_locks;
+	int			ca_count;
 };
 
 /* LDLM state */
@@ -122,72 +134,150 @@ struct ldlm_bl_work_item {
 #ifdef HAVE_SERVER_SUPPORT
 
 /**
- * Protects both waiting_locks_list and expired_lock_thread.
+ * Locks waiting for a client to cancel them after a blocking AST.
+ *
+ * As soon as a lock is contended, it gets placed into a waiting-locks wheel
+ * and expected time to get a response is filled in the lock. The locks are
+ * spread over one wheel per CPU partition, so that lock storms do not
+ * serialize on a single spinlock.
+ *
+ * Each wheel is a two level timing wheel: level 0 has one slot per second
+ * for the next LDLM_WHEEL_SIZE seconds, level 1 has one slot per
+ * LDLM_WHEEL_SIZE seconds after that. A level 1 slot is moved down to
+ * level 0 when the wheel clock gets to it, so adding, refreshing and
+ * expiring a lock are all O(1). Locks which were not released in time are
+ * moved to ww_expired, and the expired-lock thread of the partition
+ * schedules the client evictions.
  */
-static spinlock_t waiting_locks_spinlock;   /* BH lock (timer) */
+#define LDLM_WHEEL_BITS		6
+#define LDLM_WHEEL_SIZE		(1 << LDLM_WHEEL_BITS)
+#define LDLM_WHEEL_MASK		(LDLM_WHEEL_SIZE - 1)
+
+struct ldlm_waiting_wheel {
+	/** Protects all the fields below, BH lock (timer) */
+	spinlock_t		ww_lock;
+	/** Next second to expire, seconds before are done */
+	unsigned long		ww_clock;
+	/** Locks linked into ww_slots or ww_expired, the timer is armed
+	 * as long as there are any */
+	unsigned int		ww_count;
+	struct list_head	ww_slots[2][LDLM_WHEEL_SIZE];
+	struct timer_list	ww_timer;
+	/** Timed out locks, waiting for the expired-lock thread */
+	struct list_head	ww_expired;
+	wait_queue_head_t	ww_waitq;
+	int			ww_state;
+	int			ww_dump;
+	int			ww_cpt;
+	/** Locks which timed out in this wheel */
+	unsigned long		ww_timeouts;
+	/** Most seconds a lock timed out after its callback deadline */
+	unsigned long		ww_late_max;
+};
+
+static struct ldlm_waiting_wheel **ldlm_waiting_wheels;
+
+static inline struct ldlm_waiting_wheel *ldlm_lock2wheel(struct ldlm_lock *lock)
+{
+	return ldlm_waiting_wheels[hash_long((unsigned long)lock, 16) %
+				   cfs_percpt_number(ldlm_waiting_wheels)];
+}
 
 /**
- * List for contended locks.
+ * Link \a lock into the slot of \a ww for second \a expire.
  *
- * As soon as a lock is contended, it gets placed on this list and
- * expected time to get a response is filled in the lock. A special
- * thread walks the list looking for locks that should be released and
- * schedules client evictions for those that have not been released in
- * time.
+ * Called with ww_lock held.
+ */
+static void ldlm_wheel_link(struct ldlm_waiting_wheel *ww,
+			    struct ldlm_lock *lock, unsigned long expire)
+{
+	struct list_head *slot;
+
+	if (time_before(expire, ww->ww_clock))
+		expire = ww->ww_clock;
+
+	if (expire - ww->ww_clock < LDLM_WHEEL_SIZE)
+		slot = &ww->ww_slots[0][expire & LDLM_WHEEL_MASK];
+	else if (expire - ww->ww_clock < LDLM_WHEEL_SIZE * LDLM_WHEEL_SIZE)
+		slot = &ww->ww_slots[1][(expire >> LDLM_WHEEL_BITS) &
+					LDLM_WHEEL_MASK];
+	else	/* beyond the wheel, looked at again by the next cascade of
+		 * the current level 1 slot */
+		slot = &ww->ww_slots[1][(ww->ww_clock >> LDLM_WHEEL_BITS) &
+					LDLM_WHEEL_MASK];
+
+	list_add_tail(&lock->l_pending_chain, slot);
+}
+
+static inline unsigned long ldlm_wheel_expire(struct ldlm_lock *lock)
+{
+	return cfs_duration_sec(round_timeout(lock->l_callback_timeout));
+}
+
+/**
+ * Account a lock linked into \a ww, the timer ticks every second as long as
+ * there are any.
  *
- * All access to it should be under waiting_locks_spinlock.
+ * Called with ww_lock held.
  */
-static struct list_head waiting_locks_list;
-static struct timer_list waiting_locks_timer;
+static void ldlm_wheel_get(struct ldlm_waiting_wheel *ww)
+{
+	if (ww->ww_count++ == 0) {
+		/* an idle wheel restarts from the current time */
+		ww->ww_clock = cfs_duration_sec(cfs_time_current()) + 1;
+		cfs_timer_arm(&ww->ww_timer, cfs_time_seconds(ww->ww_clock));
+	}
+}
 
-static struct expired_lock_thread {
-	wait_queue_head_t	elt_waitq;
-	int			elt_state;
-	int			elt_dump;
-	struct list_head		elt_expired_locks;
-} expired_lock_thread;
+static void ldlm_wheel_put(struct ldlm_waiting_wheel *ww)
+{
+	if (--ww->ww_count == 0)
+		cfs_timer_disarm(&ww->ww_timer);
+}
 
-static inline int have_expired_locks(void)
+static inline int have_expired_locks(struct ldlm_waiting_wheel *ww)
 {
 	int need_to_run;
 
 	ENTRY;
-	spin_lock_bh(&waiting_locks_spinlock);
-	need_to_run = !list_empty(&expired_lock_thread.elt_expired_locks);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_lock_bh(&ww->ww_lock);
+	need_to_run = !list_empty(&ww->ww_expired);
+	spin_unlock_bh(&ww->ww_lock);
 
 	RETURN(need_to_run);
 }
 
 /**
- * Check expired lock list for expired locks and time them out.
+ * Check expired lock list of a partition for expired locks and time them out.
  */
 static int expired_lock_main(void *arg)
 {
-	struct list_head *expired = &expired_lock_thread.elt_expired_locks;
+	struct ldlm_waiting_wheel *ww = arg;
+	struct list_head *expired = &ww->ww_expired;
 	struct l_wait_info lwi = { 0 };
 	int do_dump;
 
 	ENTRY;
 
-	expired_lock_thread.elt_state = ELT_READY;
-	wake_up(&expired_lock_thread.elt_waitq);
+	cfs_cpt_bind(cfs_cpt_tab, ww->ww_cpt);
+	ww->ww_state = ELT_READY;
+	wake_up(&ww->ww_waitq);
 
 	while (1) {
-		l_wait_event(expired_lock_thread.elt_waitq,
-			     have_expired_locks() ||
-			     expired_lock_thread.elt_state == ELT_TERMINATE,
+		l_wait_event(ww->ww_waitq,
+			     have_expired_locks(ww) ||
+			     ww->ww_state == ELT_TERMINATE,
 			     &lwi);
 
-		spin_lock_bh(&waiting_locks_spinlock);
-		if (expired_lock_thread.elt_dump) {
-			spin_unlock_bh(&waiting_locks_spinlock);
+		spin_lock_bh(&ww->ww_lock);
+		if (ww->ww_dump) {
+			spin_unlock_bh(&ww->ww_lock);
 
 			/* from waiting_locks_callback, but not in timer */
 			libcfs_debug_dumplog();
 
-			spin_lock_bh(&waiting_locks_spinlock);
-			expired_lock_thread.elt_dump = 0;
+			spin_lock_bh(&ww->ww_lock);
+			ww->ww_dump = 0;
 		}
 
 		do_dump = 0;
@@ -200,11 +290,12 @@ static int expired_lock_main(void *arg)
 					  l_pending_chain);
 			if ((void *)lock < LP_POISON + PAGE_SIZE &&
 			    (void *)lock >= LP_POISON) {
-				spin_unlock_bh(&waiting_locks_spinlock);
+				spin_unlock_bh(&ww->ww_lock);
 				CERROR("free lock on elt list %p\n", lock);
 				LBUG();
 			}
 			list_del_init(&lock->l_pending_chain);
+			ldlm_wheel_put(ww);
 			if ((void *)lock->l_export <
 			     LP_POISON + PAGE_SIZE &&
 			    (void *)lock->l_export >= LP_POISON) {
@@ -226,7 +317,7 @@ static int expired_lock_main(void *arg)
 				continue;
 			}
 			export = class_export_lock_get(lock->l_export, lock);
-			spin_unlock_bh(&waiting_locks_spinlock);
+			spin_unlock_bh(&ww->ww_lock);
 
 			spin_lock_bh(&export->exp_bl_list_lock);
 			list_del_init(&lock->l_exp_list);
@@ -240,21 +331,21 @@ static int expired_lock_main(void *arg)
 			 * or ldlm_failed_ast() */
 			LDLM_LOCK_RELEASE(lock);
 
-			spin_lock_bh(&waiting_locks_spinlock);
+			spin_lock_bh(&ww->ww_lock);
 		}
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&ww->ww_lock);
 
 		if (do_dump && obd_dump_on_eviction) {
 			CERROR("dump the log upon eviction\n");
 			libcfs_debug_dumplog();
 		}
 
-		if (expired_lock_thread.elt_state == ELT_TERMINATE)
+		if (ww->ww_state == ELT_TERMINATE)
 			break;
 	}
 
-	expired_lock_thread.elt_state = ELT_STOPPED;
-	wake_up(&expired_lock_thread.elt_waitq);
+	ww->ww_state = ELT_STOPPED;
+	wake_up(&ww->ww_waitq);
 	RETURN(0);
 }
 
@@ -287,122 +378,161 @@ static int ldlm_lock_busy(struct ldlm_lock *lock)
 	RETURN(match);
 }
 
+/**
+ * Link \a lock into \a ww to time out in \a seconds, unless it is already
+ * due later.
+ *
+ * Called with ww_lock held.
+ */
+static void ldlm_waiting_lock_link(struct ldlm_waiting_wheel *ww,
+				   struct ldlm_lock *lock, int seconds)
+{
+	cfs_time_t timeout;
+
+	if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_NOTIMEOUT) ||
+	    OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT))
+		seconds = 1;
+
+	timeout = cfs_time_shift(seconds);
+	if (likely(cfs_time_after(timeout, lock->l_callback_timeout)))
+		lock->l_callback_timeout = timeout;
+
+	ldlm_wheel_link(ww, lock, ldlm_wheel_expire(lock));
+}
+
 /* This is called from within a timer interrupt and cannot schedule */
-static void waiting_locks_callback(unsigned long unused)
+static void waiting_locks_callback(uintptr_t data)
 {
+	struct ldlm_waiting_wheel *ww = (struct ldlm_waiting_wheel *)data;
 	struct ldlm_lock	*lock;
-	int			need_dump = 0;
-
-	spin_lock_bh(&waiting_locks_spinlock);
-	while (!list_empty(&waiting_locks_list)) {
-		lock = list_entry(waiting_locks_list.next, struct ldlm_lock,
-                                      l_pending_chain);
-                if (cfs_time_after(lock->l_callback_timeout,
-                                   cfs_time_current()) ||
-                    (lock->l_req_mode == LCK_GROUP))
-                        break;
-
-                /* Check if we need to prolong timeout */
-                if (!OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT) &&
-                    ldlm_lock_busy(lock)) {
-                        int cont = 1;
+	struct list_head	 list = LIST_HEAD_INIT(list);
+	unsigned long		 now = cfs_duration_sec(cfs_time_current());
+	int			 need_dump = 0;
+
+	spin_lock_bh(&ww->ww_lock);
+	while (ww->ww_count > 0 && !time_after(ww->ww_clock, now)) {
+		unsigned long clock = ww->ww_clock;
+
+		/* the level 1 slot starting now moves down to level 0 */
+		if ((clock & LDLM_WHEEL_MASK) == 0) {
+			list_splice_init(&ww->ww_slots[1][(clock >>
+					 LDLM_WHEEL_BITS) & LDLM_WHEEL_MASK],
+					 &list);
+			while (!list_empty(&list)) {
+				lock = list_entry(list.next, struct ldlm_lock,
+						  l_pending_chain);
+				list_del_init(&lock->l_pending_chain);
+				ldlm_wheel_link(ww, lock,
+						ldlm_wheel_expire(lock));
+			}
+		}
 
-                        if (lock->l_pending_chain.next == &waiting_locks_list)
-                                cont = 0;
+		list_splice_init(&ww->ww_slots[0][clock & LDLM_WHEEL_MASK],
+				 &list);
+		ww->ww_clock = clock + 1;
+		while (!list_empty(&list)) {
+			lock = list_entry(list.next, struct ldlm_lock,
+					  l_pending_chain);
+			list_del_init(&lock->l_pending_chain);
 
-                        LDLM_LOCK_GET(lock);
+			/* group locks never time out */
+			if (lock->l_req_mode == LCK_GROUP) {
+				ldlm_wheel_link(ww, lock, clock +
+					LDLM_WHEEL_SIZE * LDLM_WHEEL_SIZE);
+				continue;
+			}
 
-			spin_unlock_bh(&waiting_locks_spinlock);
-			LDLM_DEBUG(lock, "prolong the busy lock");
-			ldlm_refresh_waiting_lock(lock,
-						  ldlm_bl_timeout(lock) >> 1);
-			spin_lock_bh(&waiting_locks_spinlock);
+			/* Check if we need to prolong timeout */
+			if (!OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT) &&
+			    ldlm_lock_busy(lock)) {
+				LDLM_DEBUG(lock, "prolong the busy lock");
+				ldlm_waiting_lock_link(ww, lock,
+					ldlm_bl_timeout(lock) >> 1);
+				continue;
+			}
 
-                        if (!cont) {
-                                LDLM_LOCK_RELEASE(lock);
-                                break;
-                        }
+			ldlm_lock_to_ns(lock)->ns_timeouts++;
+			ww->ww_timeouts++;
+			if (now > ldlm_wheel_expire(lock) &&
+			    now - ldlm_wheel_expire(lock) > ww->ww_late_max)
+				ww->ww_late_max = now - ldlm_wheel_expire(lock);
+			LDLM_ERROR(lock, "lock callback timer expired after "
+				   "%llds: evicting client at %s ",
+				   ktime_get_real_seconds() -
+				   lock->l_last_activity,
+				   libcfs_nid2str(
+				   lock->l_export->exp_connection->c_peer.nid));
+
+			/* no needs to take an extra ref on the lock since it
+			 * was in the wheel and ldlm_add_waiting_lock()
+			 * already grabbed a ref */
+			list_add(&lock->l_pending_chain, &ww->ww_expired);
+			need_dump = 1;
+		}
+	}
 
-                        LDLM_LOCK_RELEASE(lock);
-                        continue;
-                }
-                ldlm_lock_to_ns(lock)->ns_timeouts++;
-		LDLM_ERROR(lock, "lock callback timer expired after %llds: "
-                           "evicting client at %s ",
-			   ktime_get_real_seconds() - lock->l_last_activity,
-                           libcfs_nid2str(
-                                   lock->l_export->exp_connection->c_peer.nid));
-
-                /* no needs to take an extra ref on the lock since it was in
-                 * the waiting_locks_list and ldlm_add_waiting_lock()
-                 * already grabbed a ref */
-		list_del(&lock->l_pending_chain);
-		list_add(&lock->l_pending_chain,
-                             &expired_lock_thread.elt_expired_locks);
-		need_dump = 1;
-	}
-
-	if (!list_empty(&expired_lock_thread.elt_expired_locks)) {
+	if (!list_empty(&ww->ww_expired)) {
 		if (obd_dump_on_timeout && need_dump)
-			expired_lock_thread.elt_dump = __LINE__;
+			ww->ww_dump = __LINE__;
 
-		wake_up(&expired_lock_thread.elt_waitq);
+		wake_up(&ww->ww_waitq);
 	}
 
-        /*
-         * Make sure the timer will fire again if we have any locks
-         * left.
-         */
-	if (!list_empty(&waiting_locks_list)) {
-                cfs_time_t timeout_rounded;
-		lock = list_entry(waiting_locks_list.next, struct ldlm_lock,
-                                      l_pending_chain);
-                timeout_rounded = (cfs_time_t)round_timeout(lock->l_callback_timeout);
-                cfs_timer_arm(&waiting_locks_timer, timeout_rounded);
-        }
-	spin_unlock_bh(&waiting_locks_spinlock);
+	/*
+	 * Make sure the timer will fire again if we have any locks
+	 * left.
+	 */
+	if (ww->ww_count > 0)
+		cfs_timer_arm(&ww->ww_timer, cfs_time_seconds(ww->ww_clock));
+	spin_unlock_bh(&ww->ww_lock);
 }
 
 /**
- * Add lock to the list of contended locks.
+ * Show the locks waiting in the wheel of each CPU partition, how many timed
+ * out there, and how late at most.
+ */
+int ldlm_waiting_locks_seq_show(struct seq_file *m, void *v)
+{
+	struct ldlm_waiting_wheel *ww;
+	int i;
+
+	seq_printf(m, "%-4s %10s %10s %10s\n", "cpt", "waiting", "timeouts",
+		   "max_late_s");
+	if (ldlm_waiting_wheels == NULL)
+		return 0;
+
+	cfs_percpt_for_each(ww, i, ldlm_waiting_wheels) {
+		spin_lock_bh(&ww->ww_lock);
+		seq_printf(m, "%-4d %10u %10lu %10lu\n", i, ww->ww_count,
+			   ww->ww_timeouts, ww->ww_late_max);
+		spin_unlock_bh(&ww->ww_lock);
+	}
+
+	return 0;
+}
+
+/**
+ * Add lock to the wheel of contended locks.
  *
  * Indicate that we're waiting for a client to call us back cancelling a given
- * lock.  We add it to the pending-callback chain, and schedule the lock-timeout
+ * lock.  We add it to the pending-callback wheel, and schedule the lock-timeout
  * timer to fire appropriately.  (We round up to the next second, to avoid
  * floods of timer firings during periods of high lock contention and traffic).
  * As done by ldlm_add_waiting_lock(), the caller must grab a lock reference
  * if it has been added to the waiting list (1 is returned).
  *
- * Called with the namespace lock held.
+ * Called with ww_lock of the lock wheel held.
  */
 static int __ldlm_add_waiting_lock(struct ldlm_lock *lock, int seconds)
 {
-        cfs_time_t timeout;
-        cfs_time_t timeout_rounded;
+	struct ldlm_waiting_wheel *ww = ldlm_lock2wheel(lock);
 
 	if (!list_empty(&lock->l_pending_chain))
-                return 0;
-
-        if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_NOTIMEOUT) ||
-            OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT))
-                seconds = 1;
-
-        timeout = cfs_time_shift(seconds);
-        if (likely(cfs_time_after(timeout, lock->l_callback_timeout)))
-                lock->l_callback_timeout = timeout;
-
-        timeout_rounded = round_timeout(lock->l_callback_timeout);
+		return 0;
 
-        if (cfs_time_before(timeout_rounded,
-                            cfs_timer_deadline(&waiting_locks_timer)) ||
-            !cfs_timer_is_armed(&waiting_locks_timer)) {
-                cfs_timer_arm(&waiting_locks_timer, timeout_rounded);
-        }
-        /* if the new lock has a shorter timeout than something earlier on
-           the list, we'll wait the longer amount of time; no big deal. */
-        /* FIFO */
-	list_add_tail(&lock->l_pending_chain, &waiting_locks_list);
-        return 1;
+	ldlm_wheel_get(ww);
+	ldlm_waiting_lock_link(ww, lock, seconds);
+	return 1;
 }
 
 static void ldlm_add_blocked_lock(struct ldlm_lock *lock)
@@ -429,6 +559,7 @@ static void ldlm_add_blocked_lock(struct ldlm_lock *lock)
 
 static int ldlm_add_waiting_lock(struct ldlm_lock *lock)
 {
+	struct ldlm_waiting_wheel *ww;
 	int ret;
 	int timeout = ldlm_bl_timeout(lock);
 
@@ -442,16 +573,17 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock)
 	    (exp_connect_flags(lock->l_export) & OBD_CONNECT_MDS_MDS))
 		return 0;
 
-	spin_lock_bh(&waiting_locks_spinlock);
+	ww = ldlm_lock2wheel(lock);
+	spin_lock_bh(&ww->ww_lock);
 	if (ldlm_is_cancel(lock)) {
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&ww->ww_lock);
 		return 0;
 	}
 
 	if (ldlm_is_destroyed(lock)) {
 		static cfs_time_t next;
 
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&ww->ww_lock);
 		LDLM_ERROR(lock, "not waiting on destroyed lock (bug 5653)");
 		if (cfs_time_after(cfs_time_current(), next)) {
 			next = cfs_time_shift(14400);
@@ -468,7 +600,7 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock)
 		 * waiting list */
 		LDLM_LOCK_GET(lock);
 	}
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&ww->ww_lock);
 
 	if (ret)
 		ldlm_add_blocked_lock(lock);
@@ -480,42 +612,31 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock)
 }
 
 /**
- * Remove a lock from the pending list, likely because it had its cancellation
- * callback arrive without incident.  This adjusts the lock-timeout timer if
- * needed.  Returns 0 if the lock wasn't pending after all, 1 if it was.
+ * Remove a lock from the pending wheel, likely because it had its cancellation
+ * callback arrive without incident.  The lock-timeout timer is stopped when
+ * the wheel becomes empty.  Returns 0 if the lock wasn't pending after all,
+ * 1 if it was.
  * As done by ldlm_del_waiting_lock(), the caller must release the lock
  * reference when the lock is removed from any list (1 is returned).
  *
- * Called with namespace lock held.
+ * Called with ww_lock of the lock wheel held.
  */
 static int __ldlm_del_waiting_lock(struct ldlm_lock *lock)
 {
-	struct list_head *list_next;
+	struct ldlm_waiting_wheel *ww = ldlm_lock2wheel(lock);
 
 	if (list_empty(&lock->l_pending_chain))
-                return 0;
+		return 0;
 
-        list_next = lock->l_pending_chain.next;
-        if (lock->l_pending_chain.prev == &waiting_locks_list) {
-                /* Removing the head of the list, adjust timer. */
-                if (list_next == &waiting_locks_list) {
-                        /* No more, just cancel. */
-                        cfs_timer_disarm(&waiting_locks_timer);
-                } else {
-                        struct ldlm_lock *next;
-			next = list_entry(list_next, struct ldlm_lock,
-                                              l_pending_chain);
-                        cfs_timer_arm(&waiting_locks_timer,
-                                      round_timeout(next->l_callback_timeout));
-                }
-        }
 	list_del_init(&lock->l_pending_chain);
+	ldlm_wheel_put(ww);
 
-        return 1;
+	return 1;
 }
 
 int ldlm_del_waiting_lock(struct ldlm_lock *lock)
 {
+	struct ldlm_waiting_wheel *ww;
         int ret;
 
         if (lock->l_export == NULL) {
@@ -524,10 +645,11 @@ int ldlm_del_waiting_lock(struct ldlm_lock *lock)
                 return 0;
         }
 
-	spin_lock_bh(&waiting_locks_spinlock);
+	ww = ldlm_lock2wheel(lock);
+	spin_lock_bh(&ww->ww_lock);
 	ret = __ldlm_del_waiting_lock(lock);
 	ldlm_clear_waited(lock);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&ww->ww_lock);
 
 	/* remove the lock out of export blocking list */
 	spin_lock_bh(&lock->l_export->exp_bl_list_lock);
@@ -551,6 +673,8 @@ int ldlm_del_waiting_lock(struct ldlm_lock *lock)
  */
 int ldlm_refresh_waiting_lock(struct ldlm_lock *lock, int timeout)
 {
+	struct ldlm_waiting_wheel *ww;
+
 	if (lock->l_export == NULL) {
 		/* We don't have a "waiting locks list" on clients. */
 		LDLM_DEBUG(lock, "client lock: no-op");
@@ -563,19 +687,20 @@ int ldlm_refresh_waiting_lock(struct ldlm_lock *lock, int timeout)
 		return 0;
 	}
 
-	spin_lock_bh(&waiting_locks_spinlock);
+	ww = ldlm_lock2wheel(lock);
+	spin_lock_bh(&ww->ww_lock);
 
 	if (list_empty(&lock->l_pending_chain)) {
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&ww->ww_lock);
 		LDLM_DEBUG(lock, "wasn't waiting");
 		return 0;
 	}
 
-	/* we remove/add the lock to the waiting list, so no needs to
+	/* we remove/add the lock to the waiting wheel, so no needs to
 	 * release/take a lock reference */
 	__ldlm_del_waiting_lock(lock);
 	__ldlm_add_waiting_lock(lock, timeout);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&ww->ww_lock);
 
 	LDLM_DEBUG(lock, "refreshed");
 	return 1;
@@ -629,6 +754,8 @@ EXPORT_SYMBOL(ldlm_bl_timeout);
 static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
                             const char *ast_type)
 {
+	struct ldlm_waiting_wheel *ww;
+
         LCONSOLE_ERROR_MSG(0x138, "%s: A client on nid %s was evicted due "
                            "to a lock %s callback time out: rc %d\n",
                            lock->l_export->exp_obd->obd_name,
@@ -636,15 +763,16 @@ static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
 
         if (obd_dump_on_timeout)
                 libcfs_debug_dumplog();
-	spin_lock_bh(&waiting_locks_spinlock);
+	ww = ldlm_lock2wheel(lock);
+	spin_lock_bh(&ww->ww_lock);
 	if (__ldlm_del_waiting_lock(lock) == 0)
 		/* the lock was not in any list, grab an extra ref before adding
 		 * the lock to the expired list */
 		LDLM_LOCK_GET(lock);
-	list_add(&lock->l_pending_chain,
-		     &expired_lock_thread.elt_expired_locks);
-	wake_up(&expired_lock_thread.elt_waitq);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	list_add(&lock->l_pending_chain, &ww->ww_expired);
+	ldlm_wheel_get(ww);
+	wake_up(&ww->ww_waitq);
+	spin_unlock_bh(&ww->ww_lock);
 }
 
 /**
@@ -709,6 +837,33 @@ static int ldlm_handle_ast_error(struct ldlm_lock *lock,
 	return rc;
 }
 
+static int ldlm_cb_batch_interpret(struct ptlrpc_request *req,
+				   struct ldlm_cb_async_args *ca, int rc)
+{
+	struct ldlm_cb_set_arg *arg = ca->ca_set_arg;
+	int i;
+	ENTRY;
+
+	LASSERT(arg->type == LDLM_BL_CALLBACK);
+
+	for (i = 0; i < ca->ca_count && ca->ca_locks[i] != NULL; i++) {
+		struct ldlm_lock *lock = ca->ca_locks[i];
+		int rc2 = rc;
+
+		if (rc2 != 0)
+			rc2 = ldlm_handle_ast_error(lock, req, rc2, "blocking");
+
+		/* release extra reference taken for the batch */
+		LDLM_LOCK_RELEASE(lock);
+
+		if (rc2 == -ERESTART)
+			atomic_inc(&arg->restart);
+	}
+	OBD_FREE(ca->ca_locks, ca->ca_count * sizeof(*ca->ca_locks));
+
+	RETURN(0);
+}
+
 static int ldlm_cb_interpret(const struct lu_env *env,
                              struct ptlrpc_request *req, void *data, int rc)
 {
@@ -717,6 +872,9 @@ static int ldlm_cb_interpret(const struct lu_env *env,
         struct ldlm_cb_set_arg    *arg  = ca->ca_set_arg;
         ENTRY;
 
+	if (ca->ca_locks != NULL)
+		RETURN(ldlm_cb_batch_interpret(req, ca, rc));
+
         LASSERT(lock != NULL);
 
 	switch (arg->type) {
@@ -766,8 +924,16 @@ static void ldlm_update_resend(struct ptlrpc_request *req, void *data)
 {
 	struct ldlm_cb_async_args *ca   = data;
 	struct ldlm_lock          *lock = ca->ca_lock;
+	int i;
+
+	if (ca->ca_locks == NULL) {
+		ldlm_refresh_waiting_lock(lock, ldlm_bl_timeout(lock));
+		return;
+	}
 
-	ldlm_refresh_waiting_lock(lock, ldlm_bl_timeout(lock));
+	for (i = 0; i < ca->ca_count && ca->ca_locks[i] != NULL; i++)
+		ldlm_refresh_waiting_lock(ca->ca_locks[i],
+					  ldlm_bl_timeout(ca->ca_locks[i]));
 }
 
 static inline int ldlm_ast_fini(struct ptlrpc_request *req,
@@ -868,6 +1034,7 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
         ca = ptlrpc_req_async_args(req);
         ca->ca_set_arg = arg;
         ca->ca_lock = lock;
+	ca->ca_locks = NULL;
 
         req->rq_interpret_reply = ldlm_cb_interpret;
 
@@ -935,6 +1102,142 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
         RETURN(rc);
 }
 
+/**
+ * Return how many locks may share the blocking AST RPC of \a lock, 1 if its
+ * blocking AST has to be sent on its own.
+ */
+int ldlm_bl_ast_batch_size(struct ldlm_lock *lock)
+{
+	if (lock->l_blocking_ast != ldlm_server_blocking_ast ||
+	    lock->l_export == NULL ||
+	    !(exp_connect_flags2(lock->l_export) & OBD_CONNECT2_BL_AST_BATCH) ||
+	    ldlm_is_cancel_on_block(lock) ||
+	    OBD_FAIL_PRECHECK(OBD_FAIL_LDLM_SRV_BL_AST))
+		return 1;
+
+	return clamp_t(unsigned int, ldlm_bl_ast_batch, 1,
+		       LDLM_BL_AST_BATCH_MAX);
+}
+
+/**
+ * Send one blocking AST for \a count locks of the same export, all of them
+ * blocked by the lock described by \a desc.
+ *
+ * This is ldlm_server_blocking_ast() for several locks at once, the client
+ * is expected to cancel all of them with a single LDLM_CANCEL RPC. Locks
+ * for which the AST is no longer needed are skipped. The caller keeps its
+ * references on \a locks.
+ */
+int ldlm_server_blocking_ast_batch(struct ldlm_lock **locks, int count,
+				   struct ldlm_lock_desc *desc,
+				   struct ldlm_cb_set_arg *arg)
+{
+	struct obd_export *exp = locks[0]->l_export;
+	struct ldlm_cb_async_args *ca;
+	struct ldlm_request *body;
+	struct ptlrpc_request *req;
+	struct ldlm_lock **sent;
+	struct ldlm_lock *lock;
+	int i, n = 0;
+	int rc;
+	ENTRY;
+
+	LASSERT(arg != NULL);
+	if (exp->exp_obd->obd_recovering != 0)
+		LDLM_ERROR(locks[0], "BUG 6063: lock collide during recovery");
+
+	OBD_ALLOC(sent, count * sizeof(*sent));
+	if (sent == NULL)
+		RETURN(-ENOMEM);
+
+	req = ptlrpc_request_alloc(exp->exp_imp_reverse, &RQF_LDLM_BL_CALLBACK);
+	if (req == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_CLIENT,
+			     ldlm_request_bufsize(2 * count, LDLM_BL_CALLBACK));
+	rc = ptlrpc_request_pack(req, LUSTRE_DLM_VERSION, LDLM_BL_CALLBACK);
+	if (rc) {
+		ptlrpc_request_free(req);
+		GOTO(out, rc);
+	}
+
+	body = req_capsule_client_get(&req->rq_pill, &RMF_DLM_REQ);
+	for (i = 0; i < count; i++) {
+		lock = locks[i];
+		ldlm_lock_reorder_req(lock);
+
+		lock_res_and_lock(lock);
+		if (ldlm_is_destroyed(lock)) {
+			unlock_res_and_lock(lock);
+			continue;
+		}
+
+		if (lock->l_granted_mode != lock->l_req_mode) {
+			/* this blocking AST will be communicated as part of
+			 * the completion AST instead */
+			ldlm_add_blocked_lock(lock);
+			ldlm_set_waited(lock);
+			unlock_res_and_lock(lock);
+			LDLM_DEBUG(lock, "lock not granted, not sending "
+				   "blocking AST");
+			continue;
+		}
+
+		body->lock_handle[n] = lock->l_remote_handle;
+		body->lock_flags |= ldlm_flags_to_wire(lock->l_flags &
+						       LDLM_FL_AST_MASK);
+		LDLM_DEBUG(lock, "server preparing batched blocking AST");
+
+		ldlm_set_cbpending(lock);
+		ldlm_add_waiting_lock(lock);
+		unlock_res_and_lock(lock);
+
+		lock->l_last_activity = ktime_get_real_seconds();
+		if (exp->exp_nid_stats && exp->exp_nid_stats->nid_ldlm_stats)
+			lprocfs_counter_incr(exp->exp_nid_stats->nid_ldlm_stats,
+					     LDLM_BL_CALLBACK - LDLM_FIRST_OPC);
+
+		LDLM_LOCK_GET(lock);
+		sent[n++] = lock;
+	}
+
+	if (n == 0) {
+		ptlrpc_req_finished(req);
+		GOTO(out, rc = 0);
+	}
+
+	/* the server handles follow the client ones */
+	for (i = 0; i < n; i++)
+		ldlm_lock2handle(sent[i], &body->lock_handle[n + i]);
+	body->lock_count = n;
+	body->lock_desc = *desc;
+
+	CLASSERT(sizeof(*ca) <= sizeof(req->rq_async_args));
+	ca = ptlrpc_req_async_args(req);
+	ca->ca_set_arg = arg;
+	ca->ca_lock = NULL;
+	ca->ca_locks = sent;
+	ca->ca_count = count;
+
+	req->rq_interpret_reply = ldlm_cb_interpret;
+	ptlrpc_request_set_replen(req);
+
+	/* Do not resend after lock callback timeout */
+	req->rq_delay_limit = ldlm_bl_timeout(sent[0]);
+	req->rq_resend_cb = ldlm_update_resend;
+	req->rq_send_state = LUSTRE_IMP_FULL;
+	/* ptlrpc_request_pack already set timeout */
+	if (AT_OFF)
+		req->rq_timeout = ldlm_get_rq_timeout();
+
+	ptlrpc_set_add_req(arg->set, req);
+	RETURN(0);
+out:
+	OBD_FREE(sent, count * sizeof(*sent));
+	RETURN(rc);
+}
+
 /**
  * ->l_completion_ast callback for a remote lock in server namespace.
  *
@@ -986,6 +1289,7 @@ int ldlm_server_completion_ast(struct ldlm_lock *lock, __u64 flags, void *data)
         ca = ptlrpc_req_async_args(req);
         ca->ca_set_arg = arg;
         ca->ca_lock = lock;
+	ca->ca_locks = NULL;
 
         req->rq_interpret_reply = ldlm_cb_interpret;
         body = req_capsule_client_get(&req->rq_pill, &RMF_DLM_REQ);
@@ -1112,6 +1416,7 @@ int ldlm_server_glimpse_ast(struct ldlm_lock *lock, void *data)
 	ca = ptlrpc_req_async_args(req);
 	ca->ca_set_arg = arg;
 	ca->ca_lock = lock;
+	ca->ca_locks = NULL;
 
         /* server namespace, doesn't need lock */
         req_capsule_set_size(&req->rq_pill, &RMF_DLM_LVB, RCL_SERVER,
@@ -1202,6 +1507,63 @@ static void ldlm_svc_get_eopc(const struct ldlm_request *dlm_req,
         return;
 }
 
+/**
+ * Hand a granted local lock over to the client of \a exp, as if the client
+ * had enqueued it for its lock \a remote. This lets a server grant locks in
+ * the reply of other requests than LDLM_ENQUEUE, e.g. the entry locks of
+ * readdir-plus. The reference of the caller in \a mode is given up in any
+ * case.
+ *
+ * A lock that got a conflict meanwhile is not handed over: the blocking AST
+ * went to the local lock and would never reach the client.
+ *
+ * \retval 0 if the lock belongs to the client now
+ * \retval -EAGAIN if a blocking AST was sent for it, the lock is released
+ * \retval -ENOTCONN if the export is gone, the lock is released
+ */
+int ldlm_lock_handover(const struct lustre_handle *lockh, enum ldlm_mode mode,
+		       struct obd_export *exp,
+		       const struct lustre_handle *remote)
+{
+	struct ldlm_lock *lock;
+	int rc = 0;
+	ENTRY;
+
+	lock = ldlm_handle2lock(lockh);
+	LASSERT(lock != NULL);
+
+	lock_res_and_lock(lock);
+	if (ldlm_is_ast_sent(lock) || ldlm_is_cbpending(lock))
+		GOTO(out_unlock, rc = -EAGAIN);
+	if (exp->exp_disconnected)
+		GOTO(out_unlock, rc = -ENOTCONN);
+
+	/* drop the local reference without triggering a blocking AST, as
+	 * mdt_intent_lock_replace() does */
+	ldlm_lock_decref_internal_nolock(lock, mode);
+	lock->l_export = class_export_lock_get(exp, lock);
+	lock->l_blocking_ast = ldlm_server_blocking_ast;
+	lock->l_completion_ast = ldlm_server_completion_ast;
+	lock->l_remote_handle = *remote;
+	lock->l_flags &= ~LDLM_FL_LOCAL;
+	unlock_res_and_lock(lock);
+
+	if (exp->exp_lock_hash != NULL)
+		cfs_hash_add(exp->exp_lock_hash, &lock->l_remote_handle,
+			     &lock->l_exp_hash);
+
+	LDLM_DEBUG(lock, "handed over to client %s", exp->exp_client_uuid.uuid);
+	LDLM_LOCK_PUT(lock);
+	RETURN(0);
+
+out_unlock:
+	unlock_res_and_lock(lock);
+	LDLM_LOCK_PUT(lock);
+	ldlm_lock_decref(lockh, mode);
+	RETURN(rc);
+}
+EXPORT_SYMBOL(ldlm_lock_handover);
+
 /**
  * Main server-side entry point into LDLM for enqueue. This is called by ptlrpc
  * service threads to carry out client lock enqueueing requests.
@@ -1579,6 +1941,24 @@ int ldlm_handle_convert0(struct ptlrpc_request *req,
 
                 LDLM_DEBUG(lock, "server-side convert handler START");
 
+		/* a client dropping inodebits it was asked for in a blocking
+		 * AST, see ldlm_cli_inodebits_convert() */
+		if (lock->l_resource->lr_type == LDLM_IBITS &&
+		    dlm_req->lock_desc.l_policy_data.l_inodebits.bits != 0) {
+			rc = ldlm_inodebits_convert(lock,
+				dlm_req->lock_desc.l_policy_data.l_inodebits.bits);
+			if (rc == 0) {
+				if (ldlm_del_waiting_lock(lock))
+					LDLM_DEBUG(lock, "converted waiting lock");
+				ldlm_lock2desc(lock, &dlm_rep->lock_desc);
+				req->rq_status = 0;
+			} else {
+				req->rq_status = rc == -EBUSY ? LUSTRE_EBUSY :
+								LUSTRE_EINVAL;
+			}
+			GOTO(out, rc = 0);
+		}
+
                 res = ldlm_lock_convert(lock, dlm_req->lock_desc.l_req_mode,
                                         &dlm_rep->lock_flags);
                 if (res) {
@@ -1590,6 +1970,7 @@ int ldlm_handle_convert0(struct ptlrpc_request *req,
                 }
         }
 
+out:
         if (lock) {
                 if (!req->rq_status)
                         ldlm_reprocess_all(lock->l_resource);
@@ -2131,6 +2512,196 @@ static inline void ldlm_callback_errmsg(struct ptlrpc_request *req,
                 CWARN("Send reply failed, maybe cause bug 21636.\n");
 }
 
+/* the client does not need the lock anymore, see ldlm_callback_lock() */
+static inline bool ldlm_bl_lock_is_stale(struct ldlm_lock *lock)
+{
+	return (ldlm_is_canceling(lock) && ldlm_is_bl_done(lock)) ||
+	       ldlm_is_failed(lock);
+}
+
+/**
+ * Find the lock of handle \a lockh of a callback and copy the AST flags to
+ * it.  For a blocking AST the lock is also taken out of the LRU and marked,
+ * unless the client has no use for it anymore.
+ *
+ * Used for each lock of a callback, batched or not.
+ *
+ * \retval 0 and the lock with a reference in \a lockp
+ * \retval -ENOENT if the lock does not exist
+ * \retval -ESTALE if the lock of a blocking AST is cancelled or failed
+ */
+static int ldlm_callback_lock(struct ptlrpc_request *req,
+			      struct ldlm_request *dlm_req,
+			      struct lustre_handle *lockh,
+			      struct ldlm_lock **lockp)
+{
+	bool blocking = lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK;
+	struct ldlm_lock *lock;
+	int rc;
+
+	/* Force a known safe race, send a cancel to the server for a lock
+	 * which the server has already started a blocking callback on. */
+	if (OBD_FAIL_CHECK(OBD_FAIL_LDLM_CANCEL_BL_CB_RACE) && blocking) {
+		rc = ldlm_cli_cancel(lockh, 0);
+		if (rc < 0)
+			CERROR("ldlm_cli_cancel: %d\n", rc);
+	}
+
+	lock = ldlm_handle2lock_long(lockh, 0);
+	if (!lock) {
+		CDEBUG(D_DLMTRACE, "callback on lock %#llx - lock "
+		       "disappeared\n", lockh->cookie);
+		return -ENOENT;
+	}
+
+	if (ldlm_is_fail_loc(lock) && blocking)
+		OBD_RACE(OBD_FAIL_LDLM_CP_BL_RACE);
+
+	/* Copy hints/flags (e.g. LDLM_FL_DISCARD_DATA) from AST. */
+	lock_res_and_lock(lock);
+	lock->l_flags |= ldlm_flags_from_wire(dlm_req->lock_flags &
+					      LDLM_FL_AST_MASK);
+	if (blocking) {
+		/* If somebody cancels lock and cache is already dropped,
+		 * or lock is failed before cp_ast received on client,
+		 * we can tell the server we have no lock. Otherwise, we
+		 * should send cancel after dropping the cache. */
+		if (ldlm_bl_lock_is_stale(lock)) {
+			LDLM_DEBUG(lock, "callback on lock %llx - lock disappeared",
+				   lockh->cookie);
+			unlock_res_and_lock(lock);
+			LDLM_LOCK_RELEASE(lock);
+			return -ESTALE;
+		}
+		/* BL_AST locks are not needed in LRU.
+		 * Let ldlm_cancel_lru() be fast. */
+		ldlm_lock_remove_from_lru(lock);
+		ldlm_set_bl_ast(lock);
+		/* the server may let us keep the bits that do not conflict,
+		 * see ldlm_cli_inodebits_convert() */
+		if (lock->l_resource->lr_type == LDLM_IBITS)
+			lock->l_policy_data.l_inodebits.cancel_bits =
+			dlm_req->lock_desc.l_policy_data.l_inodebits.cancel_bits;
+	}
+	unlock_res_and_lock(lock);
+
+	*lockp = lock;
+	return 0;
+}
+
+/**
+ * Callback handler for a blocking AST covering several locks.
+ *
+ * Every lock goes through ldlm_callback_lock() as the lock of a single
+ * blocking AST does.  The unused locks are then cancelled together by a
+ * blocking thread, which sends one LDLM_CANCEL RPC for all of them.  The
+ * locks still in use are handled one by one as usual and cancelled when
+ * their last user is gone.
+ *
+ * If the client has none of the locks anymore, the AST gets -EINVAL as a
+ * single one would, and the server cancels them.  One reply can't carry a
+ * per-lock -EINVAL, so the locks that are gone among locks still held are
+ * cancelled by server handle instead, otherwise the server would wait for
+ * them until it evicts us.
+ */
+static void ldlm_handle_bl_batch(struct ptlrpc_request *req,
+				 struct ldlm_namespace *ns,
+				 struct ldlm_request *dlm_req)
+{
+	struct obd_import *imp = req->rq_export->exp_obd->u.cli.cl_import;
+	struct lustre_handle *srv_handles;
+	struct lustre_handle *gone = NULL;
+	struct ldlm_lock *lock;
+	struct list_head cancels = LIST_HEAD_INIT(cancels);
+	int count = dlm_req->lock_count;
+	int nlive = 0, ngone = 0, ncancel = 0;
+	int i, rc;
+	ENTRY;
+
+	if (count > LDLM_MAXREQSIZE / sizeof(struct lustre_handle) ||
+	    req_capsule_get_size(&req->rq_pill, &RMF_DLM_REQ, RCL_CLIENT) <
+	    ldlm_request_bufsize(2 * count, LDLM_BL_CALLBACK)) {
+		rc = ldlm_callback_reply(req, -EPROTO);
+		ldlm_callback_errmsg(req, "Batch with short handle array", rc,
+				     NULL);
+		RETURN_EXIT;
+	}
+	srv_handles = &dlm_req->lock_handle[count];
+
+	/* the reply tells whether we still have any of the locks */
+	for (i = 0; i < count && nlive == 0; i++) {
+		lock = ldlm_handle2lock_long(&dlm_req->lock_handle[i], 0);
+		if (lock == NULL)
+			continue;
+		lock_res_and_lock(lock);
+		if (!ldlm_bl_lock_is_stale(lock))
+			nlive++;
+		unlock_res_and_lock(lock);
+		LDLM_LOCK_RELEASE(lock);
+	}
+
+	CDEBUG(D_INODE, "blocking ast for %d locks\n", count);
+	req_capsule_extend(&req->rq_pill, &RQF_LDLM_BL_CALLBACK);
+	if (nlive == 0) {
+		rc = ldlm_callback_reply(req, -EINVAL);
+		ldlm_callback_errmsg(req, "Operate on stale locks", rc,
+				     &dlm_req->lock_handle[0]);
+		RETURN_EXIT;
+	}
+	rc = ldlm_callback_reply(req, 0);
+	if (req->rq_no_reply || rc)
+		ldlm_callback_errmsg(req, "Batched process", rc,
+				     &dlm_req->lock_handle[0]);
+
+	for (i = 0; i < count; i++) {
+		rc = ldlm_callback_lock(req, dlm_req, &dlm_req->lock_handle[i],
+					&lock);
+		if (rc != 0) {
+			if (gone == NULL)
+				OBD_ALLOC(gone, count * sizeof(*gone));
+			if (gone != NULL)
+				gone[ngone++] = srv_handles[i];
+			else
+				ldlm_cli_cancel_handles(imp, &srv_handles[i],
+							1);
+			continue;
+		}
+
+		lock_res_and_lock(lock);
+		if (!lock->l_readers && !lock->l_writers &&
+		    !ldlm_is_canceling(lock) && list_empty(&lock->l_bl_ast)) {
+			/* Unused, cancel it along with the others. Once
+			 * CBPENDING is set the lock accumulates no more
+			 * readers and writers, see ldlm_prepare_lru_list() */
+			ldlm_clear_cancel_on_block(lock);
+			lock->l_flags |= LDLM_FL_CBPENDING | LDLM_FL_CANCELING;
+			list_add_tail(&lock->l_bl_ast, &cancels);
+			unlock_res_and_lock(lock);
+			ncancel++;
+			continue;
+		}
+		unlock_res_and_lock(lock);
+
+		if (ldlm_bl_to_thread_lock(ns, &dlm_req->lock_desc, lock))
+			ldlm_handle_bl_callback(ns, &dlm_req->lock_desc, lock);
+	}
+
+	if (ncancel > 0 &&
+	    ldlm_bl_to_thread_list(ns, &dlm_req->lock_desc, &cancels, ncancel,
+				   LCF_ASYNC) != 0) {
+		ncancel = ldlm_cli_cancel_list_local(&cancels, ncancel,
+						     LCF_BL_AST);
+		ldlm_cli_cancel_list(&cancels, ncancel, NULL, LCF_ASYNC);
+	}
+
+	if (gone != NULL) {
+		ldlm_cli_cancel_handles(imp, gone, ngone);
+		OBD_FREE(gone, count * sizeof(*gone));
+	}
+
+	EXIT;
+}
+
 /* TODO: handle requests in a similar way as MDT: see mdt_handle_common() */
 static int ldlm_callback_handler(struct ptlrpc_request *req)
 {
@@ -2230,55 +2801,21 @@ static int ldlm_callback_handler(struct ptlrpc_request *req)
                 RETURN(0);
         }
 
-        /* Force a known safe race, send a cancel to the server for a lock
-         * which the server has already started a blocking callback on. */
-        if (OBD_FAIL_CHECK(OBD_FAIL_LDLM_CANCEL_BL_CB_RACE) &&
-            lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK) {
-		rc = ldlm_cli_cancel(&dlm_req->lock_handle[0], 0);
-                if (rc < 0)
-                        CERROR("ldlm_cli_cancel: %d\n", rc);
-        }
-
-        lock = ldlm_handle2lock_long(&dlm_req->lock_handle[0], 0);
-        if (!lock) {
-		CDEBUG(D_DLMTRACE, "callback on lock %#llx - lock "
-                       "disappeared\n", dlm_req->lock_handle[0].cookie);
-                rc = ldlm_callback_reply(req, -EINVAL);
-                ldlm_callback_errmsg(req, "Operate with invalid parameter", rc,
-                                     &dlm_req->lock_handle[0]);
-                RETURN(0);
-        }
+	if (lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK &&
+	    dlm_req->lock_count > 1) {
+		ldlm_handle_bl_batch(req, ns, dlm_req);
+		RETURN(0);
+	}
 
-	if (ldlm_is_fail_loc(lock) &&
-            lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK)
-                OBD_RACE(OBD_FAIL_LDLM_CP_BL_RACE);
+	rc = ldlm_callback_lock(req, dlm_req, &dlm_req->lock_handle[0], &lock);
+	if (rc != 0) {
+		const char *msg = rc == -ESTALE ? "Operate on stale lock" :
+				  "Operate with invalid parameter";
 
-        /* Copy hints/flags (e.g. LDLM_FL_DISCARD_DATA) from AST. */
-        lock_res_and_lock(lock);
-	lock->l_flags |= ldlm_flags_from_wire(dlm_req->lock_flags &
-					      LDLM_FL_AST_MASK);
-	if (lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK) {
-		/* If somebody cancels lock and cache is already dropped,
-		 * or lock is failed before cp_ast received on client,
-		 * we can tell the server we have no lock. Otherwise, we
-		 * should send cancel after dropping the cache. */
-		if ((ldlm_is_canceling(lock) && ldlm_is_bl_done(lock)) ||
-		     ldlm_is_failed(lock)) {
-			LDLM_DEBUG(lock, "callback on lock %llx - lock disappeared",
-				   dlm_req->lock_handle[0].cookie);
-			unlock_res_and_lock(lock);
-			LDLM_LOCK_RELEASE(lock);
-			rc = ldlm_callback_reply(req, -EINVAL);
-			ldlm_callback_errmsg(req, "Operate on stale lock", rc,
-					     &dlm_req->lock_handle[0]);
-			RETURN(0);
-		}
-		/* BL_AST locks are not needed in LRU.
-		 * Let ldlm_cancel_lru() be fast. */
-		ldlm_lock_remove_from_lru(lock);
-		ldlm_set_bl_ast(lock);
+		rc = ldlm_callback_reply(req, -EINVAL);
+		ldlm_callback_errmsg(req, msg, rc, &dlm_req->lock_handle[0]);
+		RETURN(0);
 	}
-        unlock_res_and_lock(lock);
 
         /* We want the ost thread to get this reply so that it can respond
          * to ost requests (write cache writeback) that might be triggered
@@ -2907,6 +3444,7 @@ static int ldlm_setup(void)
 	static struct ptlrpc_service_conf	conf;
 	struct ldlm_bl_pool		       *blp = NULL;
 #ifdef HAVE_SERVER_SUPPORT
+	struct ldlm_waiting_wheel *ww;
 	struct task_struct *task;
 #endif /* HAVE_SERVER_SUPPORT */
 	int i;
@@ -3037,23 +3575,41 @@ static int ldlm_setup(void)
 	}
 
 #ifdef HAVE_SERVER_SUPPORT
-	INIT_LIST_HEAD(&expired_lock_thread.elt_expired_locks);
-	expired_lock_thread.elt_state = ELT_STOPPED;
-	init_waitqueue_head(&expired_lock_thread.elt_waitq);
+	ldlm_waiting_wheels = cfs_percpt_alloc(cfs_cpt_tab,
+					       sizeof(**ldlm_waiting_wheels));
+	if (ldlm_waiting_wheels == NULL)
+		GOTO(out, rc = -ENOMEM);
 
-	INIT_LIST_HEAD(&waiting_locks_list);
-	spin_lock_init(&waiting_locks_spinlock);
-	cfs_timer_init(&waiting_locks_timer, waiting_locks_callback, NULL);
+	cfs_percpt_for_each(ww, i, ldlm_waiting_wheels) {
+		int j;
 
-	task = kthread_run(expired_lock_main, NULL, "ldlm_elt");
-	if (IS_ERR(task)) {
-		rc = PTR_ERR(task);
-		CERROR("Cannot start ldlm expired-lock thread: %d\n", rc);
-		GOTO(out, rc);
+		spin_lock_init(&ww->ww_lock);
+		ww->ww_count = 0;
+		for (j = 0; j < LDLM_WHEEL_SIZE; j++) {
+			INIT_LIST_HEAD(&ww->ww_slots[0][j]);
+			INIT_LIST_HEAD(&ww->ww_slots[1][j]);
+		}
+		cfs_timer_init(&ww->ww_timer, waiting_locks_callback, ww);
+		INIT_LIST_HEAD(&ww->ww_expired);
+		init_waitqueue_head(&ww->ww_waitq);
+		ww->ww_state = ELT_STOPPED;
+		ww->ww_dump = 0;
+		ww->ww_cpt = i;
+		ww->ww_timeouts = 0;
+		ww->ww_late_max = 0;
 	}
 
-	wait_event(expired_lock_thread.elt_waitq,
-		       expired_lock_thread.elt_state == ELT_READY);
+	cfs_percpt_for_each(ww, i, ldlm_waiting_wheels) {
+		task = kthread_run(expired_lock_main, ww, "ldlm_elt_%02d", i);
+		if (IS_ERR(task)) {
+			rc = PTR_ERR(task);
+			CERROR("Cannot start ldlm expired-lock thread: %d\n",
+			       rc);
+			GOTO(out, rc);
+		}
+
+		wait_event(ww->ww_waitq, ww->ww_state == ELT_READY);
+	}
 #endif /* HAVE_SERVER_SUPPORT */
 
 	rc = ldlm_pools_init();
@@ -3118,11 +3674,20 @@ static int ldlm_cleanup(void)
 	ldlm_proc_cleanup();
 
 #ifdef HAVE_SERVER_SUPPORT
-	if (expired_lock_thread.elt_state != ELT_STOPPED) {
-		expired_lock_thread.elt_state = ELT_TERMINATE;
-		wake_up(&expired_lock_thread.elt_waitq);
-		wait_event(expired_lock_thread.elt_waitq,
-			       expired_lock_thread.elt_state == ELT_STOPPED);
+	if (ldlm_waiting_wheels != NULL) {
+		struct ldlm_waiting_wheel *ww;
+		int i;
+
+		cfs_percpt_for_each(ww, i, ldlm_waiting_wheels) {
+			cfs_timer_disarm(&ww->ww_timer);
+			if (ww->ww_state == ELT_STOPPED)
+				continue;
+			ww->ww_state = ELT_TERMINATE;
+			wake_up(&ww->ww_waitq);
+			wait_event(ww->ww_waitq, ww->ww_state == ELT_STOPPED);
+		}
+		cfs_percpt_free(ldlm_waiting_wheels);
+		ldlm_waiting_wheels = NULL;
 	}
 #endif
 
@@ -3161,7 +3726,7 @@ int ldlm_init(void)
 		goto out_lock;
 
 	ldlm_interval_tree_slab = kmem_cache_create("interval_tree",
-			sizeof(struct ldlm_interval_tree) * LCK_MODE_NUM,
+			LDLM_ITREE_ALLOC_SIZE,
 			0, SLAB_HWCACHE_ALIGN, NULL);
 	if (ldlm_interval_tree_slab == NULL)
 		goto out_interval;
@@ -1007,6 +1007,119 @@ int ldlm_cli_enqueue(struct obd_export *exp, struct ptlrpc_request **reqp,
 }
 EXPORT_SYMBOL(ldlm_cli_enqueue);
 
+/**
+ * Create client locks for a server to grant in the reply of another
+ * request than LDLM_ENQUEUE, e.g. the entry locks of readdir-plus.
+ *
+ * The handles in \a lockh are sent to the server, which tells in the reply
+ * which of them it granted and on what. Each lock is created on \a res_id
+ * without any inodebits and holds a reference in \a einfo->ei_mode, so that
+ * a blocking AST racing with the reply is handled when ldlm_cli_lock_fini()
+ * drops it.
+ */
+int ldlm_cli_lock_prep(struct obd_export *exp, struct ldlm_enqueue_info *einfo,
+		       const struct ldlm_res_id *res_id,
+		       struct lustre_handle *lockh, int count)
+{
+	struct ldlm_namespace *ns = exp->exp_obd->obd_namespace;
+	const struct ldlm_callback_suite cbs = {
+		.lcs_completion	= einfo->ei_cb_cp,
+		.lcs_blocking	= einfo->ei_cb_bl,
+		.lcs_glimpse	= einfo->ei_cb_gl
+	};
+	struct ldlm_lock *lock;
+	int i;
+	ENTRY;
+
+	for (i = 0; i < count; i++) {
+		lock = ldlm_lock_create(ns, res_id, einfo->ei_type,
+					einfo->ei_mode, &cbs, einfo->ei_cbdata,
+					0, LVB_T_NONE);
+		if (IS_ERR(lock)) {
+			while (--i >= 0)
+				ldlm_cli_lock_fini(exp, &lockh[i],
+						   einfo->ei_mode, NULL, NULL,
+						   NULL);
+			RETURN(PTR_ERR(lock));
+		}
+
+		ldlm_lock_addref_internal(lock, einfo->ei_mode);
+		ldlm_lock2handle(lock, &lockh[i]);
+		lock->l_conn_export = exp;
+		lock->l_export = NULL;
+		lock->l_blocking_ast = einfo->ei_cb_bl;
+		lock->l_last_activity = cfs_time_current_sec();
+		LDLM_DEBUG(lock, "client-side lock prepared for a reply");
+	}
+
+	RETURN(0);
+}
+EXPORT_SYMBOL(ldlm_cli_lock_prep);
+
+/**
+ * Finish a lock created by ldlm_cli_lock_prep().
+ *
+ * If the server granted it, \a remote is the server handle and \a res_id,
+ * \a policy tell what the lock covers: the lock is moved to that resource
+ * and granted locally, as ldlm_cli_enqueue_fini() does. If \a remote is
+ * NULL, the lock was not granted and is dropped without telling the server.
+ *
+ * The reference taken by ldlm_cli_lock_prep() is dropped in both cases, so
+ * a granted lock goes to the LRU, or is cancelled at once if a blocking AST
+ * came before the reply.
+ */
+int ldlm_cli_lock_fini(struct obd_export *exp, const struct lustre_handle *lockh,
+		       enum ldlm_mode mode, const struct lustre_handle *remote,
+		       const struct ldlm_res_id *res_id,
+		       const union ldlm_policy_data *policy)
+{
+	struct ldlm_namespace *ns = exp->exp_obd->obd_namespace;
+	struct ldlm_lock *lock;
+	__u64 flags = 0;
+	int rc = 0;
+	ENTRY;
+
+	lock = ldlm_handle2lock(lockh);
+	/* ldlm_cli_lock_prep() is holding a reference on this lock. */
+	LASSERT(lock != NULL);
+
+	if (remote == NULL) {
+		LDLM_DEBUG(lock, "client-side lock not granted by the reply");
+		GOTO(cleanup, rc = 0);
+	}
+
+	if (!ldlm_res_eq(res_id, &lock->l_resource->lr_name)) {
+		rc = ldlm_lock_change_resource(ns, lock, res_id);
+		if (rc || lock->l_resource == NULL)
+			GOTO(cleanup, rc = -ENOMEM);
+	}
+
+	/* the bits are only set on the new resource, a failed lock must not
+	 * flush anything cached under the one it was created on */
+	lock_res_and_lock(lock);
+	lock->l_remote_handle = *remote;
+	lock->l_policy_data = *policy;
+	unlock_res_and_lock(lock);
+
+	rc = ldlm_lock_enqueue(ns, &lock, NULL, &flags);
+	if (rc == ELDLM_OK && lock->l_completion_ast != NULL)
+		rc = lock->l_completion_ast(lock, flags, NULL);
+
+	LDLM_DEBUG(lock, "client-side lock granted by the reply, rc = %d", rc);
+	EXIT;
+cleanup:
+	if (remote == NULL || rc != 0)
+		failed_lock_cleanup(ns, lock, mode);
+	else
+		ldlm_lock_decref_internal(lock, mode);
+	/* Put lock 2 times, the second reference is held by
+	 * ldlm_cli_lock_prep() */
+	LDLM_LOCK_PUT(lock);
+	LDLM_LOCK_RELEASE(lock);
+	return rc;
+}
+EXPORT_SYMBOL(ldlm_cli_lock_fini);
+
 static int ldlm_cli_convert_local(struct ldlm_lock *lock, int new_mode,
                                   __u32 *flags)
 {
@@ -1291,6 +1404,60 @@ out:
         return sent ? sent : rc;
 }
 
+/**
+ * Send an asynchronous LDLM_CANCEL RPC for \a count server lock handles the
+ * client has no lock for anymore, e.g. found in a batched blocking AST.
+ */
+int ldlm_cli_cancel_handles(struct obd_import *imp,
+			    struct lustre_handle *handles, int count)
+{
+	struct ptlrpc_request *req;
+	struct ldlm_request *dlm;
+	int free;
+	int rc;
+	ENTRY;
+
+	LASSERT(count > 0);
+
+	if (imp == NULL || imp->imp_invalid) {
+		CDEBUG(D_DLMTRACE, "skipping cancel on invalid import %p\n",
+		       imp);
+		RETURN(0);
+	}
+
+	free = ldlm_format_handles_avail(imp, &RQF_LDLM_CANCEL, RCL_CLIENT, 0);
+	if (count > free)
+		count = free;
+
+	req = ptlrpc_request_alloc(imp, &RQF_LDLM_CANCEL);
+	if (req == NULL)
+		RETURN(-ENOMEM);
+
+	req_capsule_filled_sizes(&req->rq_pill, RCL_CLIENT);
+	req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_CLIENT,
+			     ldlm_request_bufsize(count, LDLM_CANCEL));
+
+	rc = ptlrpc_request_pack(req, LUSTRE_DLM_VERSION, LDLM_CANCEL);
+	if (rc) {
+		ptlrpc_request_free(req);
+		RETURN(rc);
+	}
+
+	req->rq_request_portal = LDLM_CANCEL_REQUEST_PORTAL;
+	req->rq_reply_portal = LDLM_CANCEL_REPLY_PORTAL;
+	ptlrpc_at_set_req_timeout(req);
+
+	dlm = req_capsule_client_get(&req->rq_pill, &RMF_DLM_REQ);
+	memcpy(dlm->lock_handle, handles, count * sizeof(*handles));
+	dlm->lock_count = count;
+	CDEBUG(D_DLMTRACE, "%d lock handles packed\n", count);
+
+	ptlrpc_request_set_replen(req);
+	ptlrpcd_add_req(req);
+
+	RETURN(0);
+}
+
 static inline struct ldlm_pool *ldlm_imp2pl(struct obd_import *imp)
 {
         LASSERT(imp != NULL);
@@ -1346,6 +1513,137 @@ int ldlm_cli_update_pool(struct ptlrpc_request *req)
         RETURN(0);
 }
 
+/**
+ * Finish the inodebits conversion of \a lock started by
+ * ldlm_cli_inodebits_convert().
+ *
+ * On success the lock is usable again with the bits it kept, otherwise it
+ * is cancelled completely as the blocking AST asked in the first place.
+ */
+static void ldlm_cli_inodebits_convert_fini(struct ldlm_lock *lock, int rc)
+{
+	struct lustre_handle lockh;
+
+	lock_res_and_lock(lock);
+	ldlm_clear_converting(lock);
+	lock->l_policy_data.l_inodebits.cancel_bits = 0;
+	if (rc == 0 && !ldlm_is_canceling(lock)) {
+		ldlm_clear_cbpending(lock);
+		ldlm_clear_bl_ast(lock);
+		if (!lock->l_readers && !lock->l_writers &&
+		    !ldlm_is_no_lru(lock) && list_empty(&lock->l_lru))
+			ldlm_lock_add_to_lru(lock);
+		unlock_res_and_lock(lock);
+		LDLM_DEBUG(lock, "client-side convert done");
+		return;
+	}
+	unlock_res_and_lock(lock);
+
+	LDLM_DEBUG(lock, "client-side convert failed %d, cancelling", rc);
+	/* may be called from ptlrpcd, leave the cache flush to a BL thread;
+	 * with cancel_bits cleared the blocking callback cancels it all */
+	LDLM_LOCK_GET(lock);
+	if (ldlm_bl_to_thread_lock(ldlm_lock_to_ns(lock), NULL, lock) != 0) {
+		LDLM_LOCK_RELEASE(lock);
+		ldlm_lock2handle(lock, &lockh);
+		ldlm_cli_cancel(&lockh, LCF_ASYNC);
+	}
+}
+
+static int ldlm_cli_inodebits_convert_interpret(const struct lu_env *env,
+						struct ptlrpc_request *req,
+						struct ldlm_async_args *aa,
+						int rc)
+{
+	struct ldlm_lock *lock;
+
+	lock = ldlm_handle2lock_long(&aa->lock_handle, 0);
+	if (lock == NULL)
+		return 0;
+
+	ldlm_cli_inodebits_convert_fini(lock, rc);
+	LDLM_LOCK_RELEASE(lock);
+
+	return 0;
+}
+
+/**
+ * Drop the inodebits a blocking AST asked for instead of cancelling the
+ * whole lock (OBD_CONNECT2_LOCK_CONVERT).
+ *
+ * The bits are dropped from the lock and the caches they protect are
+ * flushed by the LDLM_CB_CANCELING callback before the server is told
+ * with an LDLM_CONVERT RPC, the lock staying unmatchable (CBPENDING)
+ * until the server agreed.
+ *
+ * \retval 0 if the conversion is started or done
+ * \retval -EINVAL if the lock has to be cancelled as a whole instead
+ */
+static int ldlm_cli_inodebits_convert(struct ldlm_lock *lock,
+				      enum ldlm_cancel_flags cancel_flags)
+{
+	struct ldlm_request *body;
+	struct ptlrpc_request *req;
+	struct ldlm_async_args *aa;
+	__u64 drop;
+	__u64 bits;
+	int rc;
+	ENTRY;
+
+	lock_res_and_lock(lock);
+	drop = lock->l_policy_data.l_inodebits.cancel_bits;
+	bits = lock->l_policy_data.l_inodebits.bits & ~drop;
+	if (lock->l_conn_export == NULL || drop == 0 || bits == 0 ||
+	    ldlm_is_converting(lock) || ldlm_is_canceling(lock) ||
+	    lock->l_readers != 0 || lock->l_writers != 0 ||
+	    lock->l_granted_mode != lock->l_req_mode) {
+		lock->l_policy_data.l_inodebits.cancel_bits = 0;
+		unlock_res_and_lock(lock);
+		RETURN(-EINVAL);
+	}
+	ldlm_set_converting(lock);
+	ldlm_inodebits_drop(lock, drop);
+	unlock_res_and_lock(lock);
+
+	LDLM_DEBUG(lock, "client-side convert, dropping bits %#llx", drop);
+
+	/* flush what the dropped bits protect, cancel_bits tells the callback
+	 * which bits go away */
+	if (lock->l_blocking_ast != NULL)
+		lock->l_blocking_ast(lock, NULL, lock->l_ast_data,
+				     LDLM_CB_CANCELING);
+
+	req = ptlrpc_request_alloc_pack(class_exp2cliimp(lock->l_conn_export),
+					&RQF_LDLM_CONVERT, LUSTRE_DLM_VERSION,
+					LDLM_CONVERT);
+	if (req == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	body = req_capsule_client_get(&req->rq_pill, &RMF_DLM_REQ);
+	body->lock_handle[0] = lock->l_remote_handle;
+	body->lock_desc.l_req_mode = lock->l_granted_mode;
+	body->lock_desc.l_policy_data.l_inodebits.bits = bits;
+	ptlrpc_request_set_replen(req);
+
+	if (cancel_flags & LCF_ASYNC) {
+		CLASSERT(sizeof(*aa) <= sizeof(req->rq_async_args));
+		aa = ptlrpc_req_async_args(req);
+		ldlm_lock2handle(lock, &aa->lock_handle);
+		req->rq_interpret_reply =
+			(ptlrpc_interpterer_t)ldlm_cli_inodebits_convert_interpret;
+		ptlrpcd_add_req(req);
+		RETURN(0);
+	}
+
+	rc = ptlrpc_queue_wait(req);
+	ptlrpc_req_finished(req);
+	EXIT;
+out:
+	/* the bits are gone already, failure means a full cancel */
+	ldlm_cli_inodebits_convert_fini(lock, rc);
+	return 0;
+}
+
 /**
  * Client side lock cancel.
  *
@@ -1369,6 +1667,15 @@ int ldlm_cli_cancel(const struct lustre_handle *lockh,
 		RETURN(0);
 	}
 
+	/* The server may let us keep the bits that do not conflict */
+	if ((cancel_flags & LCF_CONVERT) && !(cancel_flags & LCF_LOCAL) &&
+	    lock->l_resource->lr_type == LDLM_IBITS &&
+	    lock->l_policy_data.l_inodebits.cancel_bits != 0 &&
+	    ldlm_cli_inodebits_convert(lock, cancel_flags) == 0) {
+		LDLM_LOCK_RELEASE(lock);
+		RETURN(0);
+	}
+
 	lock_res_and_lock(lock);
 	/* Lock is being canceled and the caller doesn't want to wait */
 	if (ldlm_is_canceling(lock) && (cancel_flags & LCF_ASYNC)) {
@@ -177,6 +177,8 @@ static const struct file_operations ldlm_granted_fops = {
 	.release = seq_release,
 };
 
+LPROC_SEQ_FOPS_RO(ldlm_waiting_locks);
+
 #endif /* HAVE_SERVER_SUPPORT */
 
 int ldlm_proc_setup(void)
@@ -202,6 +204,8 @@ int ldlm_proc_setup(void)
 		{ .name =	"lock_granted_count",
 		  .fops =	&ldlm_granted_fops,
 		  .data =	&ldlm_granted_total },
+		{ .name =	"waiting_locks",
+		  .fops =	&ldlm_waiting_locks_fops },
 #endif
 		{ NULL }};
 	ENTRY;
@@ -1144,16 +1148,20 @@ static struct ldlm_resource *ldlm_resource_new(enum ldlm_type ldlm_type)
 
 	if (ldlm_type == LDLM_EXTENT) {
 		OBD_SLAB_ALLOC(res->lr_itree, ldlm_interval_tree_slab,
-			       sizeof(*res->lr_itree) * LCK_MODE_NUM);
+			       LDLM_ITREE_ALLOC_SIZE);
 		if (res->lr_itree == NULL) {
 			OBD_SLAB_FREE_PTR(res, ldlm_resource_slab);
 			return NULL;
 		}
+		res->lr_witree = res->lr_itree + LCK_MODE_NUM;
 		/* Initialize interval trees for each lock mode. */
 		for (idx = 0; idx < LCK_MODE_NUM; idx++) {
 			res->lr_itree[idx].lit_size = 0;
 			res->lr_itree[idx].lit_mode = 1 << idx;
 			res->lr_itree[idx].lit_root = NULL;
+			res->lr_witree[idx].lit_size = 0;
+			res->lr_witree[idx].lit_mode = 1 << idx;
+			res->lr_witree[idx].lit_root = NULL;
 		}
 	}
 
@@ -1229,7 +1237,7 @@ ldlm_resource_get(struct ldlm_namespace *ns, struct ldlm_resource *parent,
 		lu_ref_fini(&res->lr_reference);
 		if (res->lr_itree != NULL)
 			OBD_SLAB_FREE(res->lr_itree, ldlm_interval_tree_slab,
-				      sizeof(*res->lr_itree) * LCK_MODE_NUM);
+				      LDLM_ITREE_ALLOC_SIZE);
 		OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
 found:
 		res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
@@ -1313,7 +1321,7 @@ int ldlm_resource_putref(struct ldlm_resource *res)
 			ns->ns_lvbo->lvbo_free(res);
 		if (res->lr_itree != NULL)
 			OBD_SLAB_FREE(res->lr_itree, ldlm_interval_tree_slab,
-				      sizeof(*res->lr_itree) * LCK_MODE_NUM);
+				      LDLM_ITREE_ALLOC_SIZE);
 		OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
 		return 1;
 	}
@@ -1339,6 +1347,9 @@ void ldlm_resource_add_lock(struct ldlm_resource *res, struct list_head *head,
 	LASSERT(list_empty(&lock->l_res_link));
 
 	list_add_tail(&lock->l_res_link, head);
+
+	if (res->lr_type == LDLM_EXTENT && head == &res->lr_waiting)
+		ldlm_extent_add_waiting(res, lock);
 }
 
 /**
@@ -1364,6 +1375,9 @@ void ldlm_resource_insert_lock_after(struct ldlm_lock *original,
 	LASSERT(list_empty(&new->l_res_link));
 
 	list_add(&new->l_res_link, &original->l_res_link);
+
+	if (res->lr_type == LDLM_EXTENT && original->l_wait_seq != 0)
+		ldlm_extent_add_waiting(res, new);
  out:;
 }
 
@@ -202,6 +202,71 @@ static u16 ll_dirent_type_get(struct lu_dirent *ent)
 	return type;
 }
 
+/**
+ * Refresh the cached inode of a directory entry from the attributes the
+ * MDT returned with it (readdir-plus).
+ *
+ * The attributes came with a PR LOOKUP|UPDATE lock on the entry, MDC put
+ * its handle in lda_lock. They are only applied while that lock is held,
+ * so they are never older than what another client changed. The lock then
+ * stays cached, so the next stat of the entry needs no getattr RPC.
+ *
+ * Only inodes already in the cache are updated, a dentry can not be set up
+ * from a directory entry alone.
+ *
+ * \retval true if @ent carried attributes
+ */
+static bool ll_dirent_attrs_update(struct inode *dir, struct lu_dirent *ent,
+				   const struct lu_fid *fid, __u64 ino)
+{
+	struct ll_sb_info *sbi = ll_i2sbi(dir);
+	__u32 attrs = le32_to_cpu(ent->lde_attrs);
+	struct luda_attrs *lda;
+	struct mdt_body body = { 0 };
+	struct lustre_md md = { .body = &body };
+	struct lustre_handle lockh;
+	struct inode *inode;
+
+	if (!(attrs & LUDA_ATTRS) || !(attrs & LUDA_FID))
+		return false;
+
+	lda = (void *)ent + lu_dirent_calc_size(le16_to_cpu(ent->lde_namelen),
+						attrs & ~LUDA_ATTRS);
+	lockh.cookie = le64_to_cpu(lda->lda_lock);
+	if (!fid_is_sane(fid) || ldlm_lock_addref_try(&lockh, LCK_PR) != 0)
+		return true;
+
+	inode = ilookup5(dir->i_sb, ino, ll_test_inode_by_fid, (void *)fid);
+	if (inode == NULL)
+		goto out;
+
+	body.mbo_fid1 = *fid;
+	body.mbo_valid = le64_to_cpu(lda->lda_valid) | OBD_MD_FLID;
+	body.mbo_size = le64_to_cpu(lda->lda_size);
+	body.mbo_blocks = le64_to_cpu(lda->lda_blocks);
+	body.mbo_mtime = le64_to_cpu(lda->lda_mtime);
+	body.mbo_atime = le64_to_cpu(lda->lda_atime);
+	body.mbo_ctime = le64_to_cpu(lda->lda_ctime);
+	body.mbo_mode = le32_to_cpu(lda->lda_mode);
+	body.mbo_uid = le32_to_cpu(lda->lda_uid);
+	body.mbo_gid = le32_to_cpu(lda->lda_gid);
+	body.mbo_nlink = le32_to_cpu(lda->lda_nlink);
+	body.mbo_flags = le32_to_cpu(lda->lda_flags);
+
+	/* the MDT can't tell the type changed under the same FID, and the
+	 * attributes of a striped directory are merged from all stripes */
+	if ((inode->i_mode & S_IFMT) == (body.mbo_mode & S_IFMT) &&
+	    !(S_ISDIR(inode->i_mode) && ll_i2info(inode)->lli_lsm_md != NULL)) {
+		md_set_lock_data(sbi->ll_md_exp, &lockh, inode, NULL);
+		ll_update_inode(inode, &md);
+	}
+
+	iput(inode);
+out:
+	ldlm_lock_decref(&lockh, LCK_PR);
+	return true;
+}
+
 #ifdef HAVE_DIR_CONTEXT
 int ll_dir_read(struct inode *inode, __u64 *ppos, struct md_op_data *op_data,
 		struct dir_context *ctx)
@@ -218,6 +283,7 @@ int ll_dir_read(struct inode *inode, __u64 *ppos, struct md_op_data *op_data,
 	struct page          *page;
 	struct ll_dir_chain   chain;
 	bool                  done = false;
+	bool                  has_attrs = false;
 	int                   rc = 0;
 	ENTRY;
 
@@ -268,6 +334,8 @@ int ll_dir_read(struct inode *inode, __u64 *ppos, struct md_op_data *op_data,
 			fid_le_to_cpu(&fid, &ent->lde_fid);
 			ino = cl_fid_build_ino(&fid, is_api32);
 			type = ll_dirent_type_get(ent);
+			if (ll_dirent_attrs_update(inode, ent, &fid, ino))
+				has_attrs = true;
 			/* For 'll_nfs_get_name_filldir()', it will try
 			 * to access the 'ent' through its 'lde_name',
 			 * so the parameter 'name' for 'filldir()' must
@@ -282,9 +350,11 @@ int ll_dir_read(struct inode *inode, __u64 *ppos, struct md_op_data *op_data,
 #endif
 		}
 
+		/* attributes in a page are only good for this readdir, don't
+		 * keep them in the page cache for later ones */
 		if (done) {
 			pos = hash;
-			ll_release_page(inode, page, false);
+			ll_release_page(inode, page, has_attrs);
 			break;
 		}
 
@@ -295,15 +365,16 @@ int ll_dir_read(struct inode *inode, __u64 *ppos, struct md_op_data *op_data,
 			 * End of directory reached.
 			 */
 			done = 1;
-			ll_release_page(inode, page, false);
+			ll_release_page(inode, page, has_attrs);
 		} else {
 			/*
 			 * Normal case: continue to the next
 			 * page.
 			 */
-			ll_release_page(inode, page,
+			ll_release_page(inode, page, has_attrs ||
 					le32_to_cpu(dp->ldp_flags) &
 					LDF_COLLIDE);
+			has_attrs = false;
 			next = pos;
 			page = ll_get_dir_page(inode, op_data, pos,
 					       &chain);
@@ -378,6 +449,8 @@ static int ll_readdir(struct file *filp, void *cookie, filldir_t filldir)
 		}
 	}
 	op_data->op_max_pages = sbi->ll_md_brw_pages;
+	if (ll_sbi_has_readdir_plus(sbi))
+		op_data->op_cli_flags |= CLI_READDIR_PLUS;
 #ifdef HAVE_DIR_CONTEXT
 	ctx->pos = pos;
 	rc = ll_dir_read(inode, &pos, op_data, ctx);
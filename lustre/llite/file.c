@@ -1104,6 +1104,41 @@ static void ll_io_init(struct cl_io *io, const struct file *file, int write)
 	io->ci_noatime = file_is_noatime(file);
 }
 
+/**
+ * Check whether buffered I/O described by \a args is big and aligned enough
+ * to be done as direct I/O, see ll_sb_info::ll_hybrid_io_threshold.
+ *
+ * Only whole pages taken straight from the user buffer qualify, so that the
+ * switch never adds copies. Files mapped into memory and appending writers
+ * keep using the page cache.
+ */
+static bool ll_hybrid_io_switch(struct file *file, struct vvp_io_args *args,
+				loff_t pos, size_t count)
+{
+#ifdef HAVE_KIOCB_IOCB_DIRECT
+	struct ll_sb_info *sbi = ll_i2sbi(file_inode(file));
+	__u64 threshold = sbi->ll_hybrid_io_threshold;
+
+	if (threshold == 0 || count < threshold)
+		return false;
+
+	if (args->via_io_subtype != IO_NORMAL ||
+	    args->u.normal.via_iocb->ki_flags & IOCB_DIRECT)
+		return false;
+
+	if (file->f_flags & O_APPEND || mapping_mapped(file->f_mapping))
+		return false;
+
+	if ((pos & ~PAGE_MASK) || (count & ~PAGE_MASK) ||
+	    (iov_iter_alignment(args->u.normal.via_iter) & ~PAGE_MASK))
+		return false;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 static ssize_t
 ll_file_io_generic(const struct lu_env *env, struct vvp_io_args *args,
 		   struct file *file, enum cl_io_type iot,
@@ -1117,6 +1152,8 @@ ll_file_io_generic(const struct lu_env *env, struct vvp_io_args *args,
 	ssize_t			result = 0;
 	int			rc = 0;
 	struct range_lock	range;
+	bool			is_dio;
+	bool			hybrid_dio;
 
 	ENTRY;
 
@@ -1127,6 +1164,20 @@ restart:
 	io = vvp_env_thread_io(env);
 	ll_io_init(io, file, iot == CIT_WRITE);
 
+	hybrid_dio = ll_hybrid_io_switch(file, args, *ppos, count);
+	is_dio = (file->f_flags & O_DIRECT) || hybrid_dio;
+#ifdef HAVE_KIOCB_IOCB_DIRECT
+	if (hybrid_dio) {
+		CDEBUG(D_VFSTRACE, "%s: %s of %zu bytes at %lld as direct IO\n",
+		       file_dentry(file)->d_name.name,
+		       iot == CIT_READ ? "read" : "write", count, *ppos);
+		/* like any direct I/O, the switched I/O is complete before
+		 * ll_direct_IO() returns, so an O_SYNC write is on disk
+		 * before generic_write_sync() and the size update */
+		args->u.normal.via_iocb->ki_flags |= IOCB_DIRECT;
+	}
+#endif
+
 	if (cl_io_rw_init(env, io, iot, *ppos, count) == 0) {
 		bool range_locked = false;
 
@@ -1145,8 +1196,7 @@ restart:
 			/* Direct IO reads must also take range lock,
 			 * or multiple reads will try to work on the same pages
 			 * See LU-6227 for details. */
-			if (((iot == CIT_WRITE) ||
-			    (iot == CIT_READ && (file->f_flags & O_DIRECT))) &&
+			if (((iot == CIT_WRITE) || (iot == CIT_READ && is_dio)) &&
 			    !(vio->vui_fd->fd_flags & LL_FILE_GROUP_LOCKED)) {
 				CDEBUG(D_VFSTRACE, "Range lock "RL_FMT"\n",
 				       RL_PARA(&range));
@@ -1166,6 +1216,14 @@ restart:
 			LBUG();
 		}
 
+		/* Issue direct I/O for all stripes before waiting for any
+		 * of it, so that a single writer keeps every OST busy. The
+		 * wait is still done before the size is updated, the data
+		 * synced and the locks released, see ll_direct_rw_pages(). */
+		if (is_dio && vio->vui_io_subtype == IO_NORMAL &&
+		    ll_sbi_has_parallel_dio(ll_i2sbi(inode)))
+			io->ci_parallel_dio = 1;
+
 		ll_cl_add(file, env, io, LCC_RW);
 		rc = cl_io_loop(env, io);
 		ll_cl_remove(file, env);
@@ -1193,6 +1251,11 @@ restart:
 out:
 	cl_io_fini(env, io);
 
+#ifdef HAVE_KIOCB_IOCB_DIRECT
+	if (hybrid_dio)
+		args->u.normal.via_iocb->ki_flags &= ~IOCB_DIRECT;
+#endif
+
 	if ((rc == 0 || rc == -ENODATA) && count > 0 && io->ci_need_restart) {
 		CDEBUG(D_VFSTRACE,
 		       "%s: restart %s from %lld, count:%zu, result: %zd\n",
@@ -2336,6 +2399,89 @@ static int ll_ladvise(struct inode *inode, struct file *file, __u64 flags,
 	RETURN(rc);
 }
 
+/*
+ * Lock ahead: request an extent lock before doing the I/O it is meant for
+ *
+ * The lock is enqueued speculatively and asynchronously, with exactly the
+ * extent given and without expansion. The server grants it only if it does
+ * not conflict with any other lock, so e.g. the ranks of a shared-file
+ * write can each take the locks on their own regions beforehand instead of
+ * revoking each other's expanded locks on their first writes. A granted
+ * lock stays in the LRU until the I/O matches it.
+ *
+ * The outcome of the enqueue is returned in lla_lockahead_result, the
+ * return value only reports an invalid advice.
+ */
+static int ll_file_lock_ahead(struct file *file,
+			      struct llapi_lu_ladvise *ladvise)
+{
+	struct inode *inode = file_inode(file);
+	struct lu_env *env;
+	struct cl_io *io;
+	struct cl_lock *lock;
+	struct cl_lock_descr *descr;
+	enum cl_lock_mode cl_mode;
+	__u16 refcheck;
+	int rc;
+	ENTRY;
+
+	switch (ladvise->lla_lockahead_mode) {
+	case MODE_READ_USER:
+		cl_mode = CLM_READ;
+		break;
+	case MODE_WRITE_USER:
+		cl_mode = CLM_WRITE;
+		break;
+	default:
+		RETURN(-EINVAL);
+	}
+
+	if (ladvise->lla_end <= ladvise->lla_start)
+		RETURN(-EINVAL);
+
+	CDEBUG(D_VFSTRACE, "Lock ahead: "DFID", mode %u, [%llu, %llu)\n",
+	       PFID(ll_inode2fid(inode)), ladvise->lla_lockahead_mode,
+	       ladvise->lla_start, ladvise->lla_end);
+
+	env = cl_env_get(&refcheck);
+	if (IS_ERR(env))
+		RETURN(PTR_ERR(env));
+
+	io = vvp_env_thread_io(env);
+	io->ci_obj = ll_i2info(inode)->lli_clob;
+
+	rc = cl_io_init(env, io, CIT_MISC, io->ci_obj);
+	if (rc > 0) {
+		rc = io->ci_result;
+	} else if (rc == 0) {
+		lock = vvp_env_lock(env);
+		descr = &lock->cll_descr;
+
+		descr->cld_obj = io->ci_obj;
+		descr->cld_start = cl_index(io->ci_obj, ladvise->lla_start);
+		descr->cld_end = cl_index(io->ci_obj, ladvise->lla_end - 1);
+		descr->cld_mode = cl_mode;
+		descr->cld_enq_flags = CEF_MUST | CEF_LOCK_NO_EXPAND |
+				       CEF_SPECULATIVE;
+
+		rc = cl_lock_request(env, io, lock);
+		if (rc == 0)
+			cl_lock_release(env, lock);
+	}
+	cl_io_fini(env, io);
+	cl_env_put(env, &refcheck);
+
+	/* the result is per extent, a failed one does not stop the others */
+	if (rc == -ECANCELED)
+		ladvise->lla_lockahead_result = LLA_RESULT_SAME;
+	else if (rc == 0)
+		ladvise->lla_lockahead_result = LLA_RESULT_SENT;
+	else
+		ladvise->lla_lockahead_result = rc;
+
+	RETURN(0);
+}
+
 static long
 ll_file_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -2686,6 +2832,7 @@ out:
 		int i;
 		int num_advise;
 		int alloc_size = sizeof(*ladvise_hdr);
+		bool lockahead = false;
 
 		rc = 0;
 		OBD_ALLOC_PTR(ladvise_hdr);
@@ -2721,12 +2868,27 @@ out:
 			GOTO(out_ladvise, rc = -EFAULT);
 
 		for (i = 0; i < num_advise; i++) {
-			rc = ll_ladvise(inode, file, ladvise_hdr->lah_flags,
-					&ladvise_hdr->lah_advise[i]);
+			struct llapi_lu_ladvise *advice;
+
+			advice = &ladvise_hdr->lah_advise[i];
+			if (advice->lla_advice == LU_LADVISE_LOCKAHEAD) {
+				rc = ll_file_lock_ahead(file, advice);
+				lockahead = true;
+			} else {
+				rc = ll_ladvise(inode, file,
+						ladvise_hdr->lah_flags,
+						advice);
+			}
 			if (rc)
 				break;
 		}
 
+		/* lock ahead reports its result in the advice itself */
+		if (rc == 0 && lockahead &&
+		    copy_to_user((struct llapi_ladvise_hdr __user *)arg,
+				 ladvise_hdr, alloc_size))
+			rc = -EFAULT;
+
 out_ladvise:
 		OBD_FREE(ladvise_hdr, alloc_size);
 		RETURN(rc);
@@ -2874,6 +3036,7 @@ int cl_sync_file_range(struct inode *inode, loff_t start, loff_t end,
 	struct lu_env *env;
 	struct cl_io *io;
 	struct cl_fsync_io *fio;
+	struct cl_sync_io anchor;
 	int result;
 	__u16 refcheck;
 	ENTRY;
@@ -2897,11 +3060,29 @@ int cl_sync_file_range(struct inode *inode, loff_t start, loff_t end,
 	fio->fi_fid = ll_inode2fid(inode);
 	fio->fi_mode = mode;
 	fio->fi_nr_written = 0;
+	fio->fi_anchor = NULL;
+	/* Sync all stripes in parallel: writeback is started on all of them
+	 * first, then each OST_SYNC is sent as soon as the writeback of its
+	 * stripe is done, and they are waited for together below. */
+	if (mode == CL_FSYNC_ALL) {
+		cl_sync_io_init(&anchor, 1, cl_sync_io_end);
+		fio->fi_anchor = &anchor;
+	}
 
 	if (cl_io_init(env, io, CIT_FSYNC, io->ci_obj) == 0)
 		result = cl_io_loop(env, io);
 	else
 		result = io->ci_result;
+	/* wait before cl_io_fini(), the replies are unpacked into the
+	 * sub-io of each stripe */
+	if (fio->fi_anchor != NULL) {
+		int rc;
+
+		cl_sync_io_note(env, &anchor, 0);
+		rc = cl_sync_io_wait(env, &anchor, 0);
+		if (result == 0)
+			result = rc;
+	}
 	if (result == 0)
 		result = fio->fi_nr_written;
 	cl_io_fini(env, io);
@@ -3407,7 +3588,7 @@ static int ll_inode_revalidate_fini(struct inode *inode, int rc)
 	return rc;
 }
 
-static int __ll_inode_revalidate(struct dentry *dentry, __u64 ibits)
+int __ll_inode_revalidate(struct dentry *dentry, __u64 ibits)
 {
         struct inode *inode = dentry->d_inode;
         struct ptlrpc_request *req = NULL;
@@ -158,7 +158,18 @@ struct ll_inode_info {
 			 * set upon dir open, and cleared when dir is closed,
 			 * statahead hit ratio is too low, or start statahead
 			 * thread failed. */
-			unsigned int			lli_sa_enabled:1;
+			unsigned int			lli_sa_enabled:1,
+			/* the dir was closed by "opendir_pid" before it
+			 * stat'ed anything, it may still walk the entries
+			 * it read with fstatat() until lli_sa_detach_time
+			 * plus LL_SA_DETACHED_TIMEOUT, see
+			 * ll_deauthorize_statahead() */
+							lli_sa_detached:1;
+			cfs_time_t			lli_sa_detach_time;
+			/* lookups which found no entry while the client had
+			 * no UPDATE lock on this dir, so the negative dentry
+			 * couldn't be cached, see ll_lookup_neg_lock() */
+			atomic_t			lli_neg_lookups;
 			/* generation for statahead */
 			unsigned int			lli_sa_generation;
 			/* directory stripe information */
@@ -330,6 +341,8 @@ enum ra_stat {
         RA_STAT_MAX_IN_FLIGHT,
         RA_STAT_WRONG_GRAB_PAGE,
 	RA_STAT_FAILED_REACH_END,
+	RA_STAT_ASYNC,
+	RA_STAT_STREAM_RESUMED,
 	_NR_RA_STAT,
 };
 
@@ -338,6 +351,12 @@ struct ll_ra_info {
 	unsigned long	ra_max_pages;
 	unsigned long	ra_max_pages_per_file;
 	unsigned long	ra_max_read_ahead_whole_pages;
+	/* read-ahead windows at least this large are issued from the
+	 * per-CPT read-ahead threads rather than by the reader, 0 disables */
+	unsigned long	ra_async_pages_per_file_threshold;
+	/* number of asynchronous read-ahead requests queued or running */
+	atomic_t	ra_async_inflight;
+	unsigned int	ra_async_max_active;
 };
 
 /* ra_io_arg will be filled in the beginning of ll_readahead with
@@ -423,6 +442,9 @@ enum stats_track_type {
 				       * suppress_pings */
 #define LL_SBI_FAST_READ     0x400000 /* fast read support */
 #define LL_SBI_FILE_SECCTX   0x800000 /* set file security context at create */
+#define LL_SBI_PARALLEL_DIO 0x1000000 /* issue direct I/O to all stripes
+				       * before waiting for completion */
+#define LL_SBI_READDIR_PLUS 0x2000000 /* entry attributes with readdir */
 
 #define LL_SBI_FLAGS { 	\
 	"nolck",	\
@@ -449,6 +471,8 @@ enum stats_track_type {
 	"always_ping",	\
 	"fast_read",	\
 	"file_secctx",	\
+	"parallel_dio",	\
+	"readdir_plus",	\
 }
 
 /* This is embedded into llite super-blocks to keep track of connect
@@ -499,6 +523,10 @@ struct ll_sb_info {
 
 	unsigned int              ll_md_brw_pages; /* readdir pages per RPC */
 
+	/* aligned buffered I/O at least this large is done as direct I/O,
+	 * 0 disables the switch */
+	__u64			  ll_hybrid_io_threshold;
+
         struct lu_site           *ll_site;
         struct cl_device         *ll_cl;
         /* Statistics */
@@ -520,8 +548,14 @@ struct ll_sb_info {
 						  * low hit ratio */
 	atomic_t		  ll_sa_running; /* running statahead thread
 						  * count */
+	atomic_t		  ll_sa_detached;/* statahead thread started
+						  * after dir close count */
 	atomic_t		  ll_agl_total;  /* AGL thread started count */
 
+	/* uncached negative lookups in a dir before its UPDATE lock is
+	 * taken to cache the negative dentries, 0 disables it */
+	unsigned int		  ll_neg_lookup_threshold;
+
 	dev_t			  ll_sdev_orig; /* save s_dev before assign for
 						 * clustred nfs */
 	/* root squash */
@@ -532,6 +566,25 @@ struct ll_sb_info {
 /*
  * per file-descriptor read-ahead data.
  */
+/*
+ * Sequential read-ahead state of a stream the application moved away from,
+ * kept so that read-ahead resumes with the same window when it comes back,
+ * see ll_readahead_state::ras_streams.
+ */
+struct ll_ra_stream {
+	unsigned long	rs_last_readpage;
+	unsigned long	rs_consecutive_pages;
+	unsigned long	rs_consecutive_requests;
+	unsigned long	rs_window_start;
+	unsigned long	rs_window_len;
+	unsigned long	rs_next_readahead;
+	/* ras_requests + 1 when the stream was parked, 0 if unused */
+	unsigned long	rs_stamp;
+};
+
+/* number of parked streams tracked per open file */
+#define LL_RA_STREAMS_MAX	4
+
 struct ll_readahead_state {
 	spinlock_t  ras_lock;
         /*
@@ -572,6 +625,14 @@ struct ll_readahead_state {
 	 * for each read-ahead.
 	 */
 	unsigned long	ras_rpc_size;
+	/*
+	 * Stripe size in pages and stripe count of the file as last reported
+	 * by the read-ahead of the lower layers, 0 if the file is not striped.
+	 * Used to grow the stride read-ahead window in per-OST RPC sized
+	 * steps.
+	 */
+	unsigned long	ras_stripe_pages;
+	unsigned int	ras_stripe_count;
         /*
          * Where next read-ahead should start at. This lies within read-ahead
          * window. Read-ahead window is read in pieces rather than at once
@@ -612,6 +673,13 @@ struct ll_readahead_state {
          * stride read-ahead will be enable
          */
         unsigned long   ras_consecutive_stride_requests;
+	/*
+	 * Sequential streams other than the current one. Applications
+	 * reading several regions of a file in turn through one file
+	 * descriptor (merge sorts, columnar formats) switch between them
+	 * instead of resetting the read-ahead window on each switch.
+	 */
+	struct ll_ra_stream ras_streams[LL_RA_STREAMS_MAX];
 };
 
 extern struct kmem_cache *ll_file_data_slab;
@@ -661,6 +729,16 @@ static inline bool ll_sbi_has_fast_read(struct ll_sb_info *sbi)
 	return !!(sbi->ll_flags & LL_SBI_FAST_READ);
 }
 
+static inline bool ll_sbi_has_parallel_dio(struct ll_sb_info *sbi)
+{
+	return !!(sbi->ll_flags & LL_SBI_PARALLEL_DIO);
+}
+
+static inline bool ll_sbi_has_readdir_plus(struct ll_sb_info *sbi)
+{
+	return !!(sbi->ll_flags & LL_SBI_READDIR_PLUS);
+}
+
 void ll_ras_enter(struct file *f);
 
 /* llite/lcommon_misc.c */
@@ -753,6 +831,10 @@ void ll_release_page(struct inode *inode, struct page *page, bool remove);
 /* llite/namei.c */
 extern const struct inode_operations ll_special_inode_operations;
 
+/* default for ll_neg_lookup_threshold, off: every create in the directory
+ * by another client would revoke its UPDATE lock */
+#define LL_NEG_LOOKUP_THRESHOLD_DEF	0
+
 struct inode *ll_iget(struct super_block *sb, ino_t hash,
                       struct lustre_md *lic);
 int ll_test_inode_by_fid(struct inode *inode, void *opaque);
@@ -767,6 +849,8 @@ int ll_writepage(struct page *page, struct writeback_control *wbc);
 int ll_writepages(struct address_space *, struct writeback_control *wbc);
 int ll_readpage(struct file *file, struct page *page);
 void ll_readahead_init(struct inode *inode, struct ll_readahead_state *ras);
+int ll_ra_sched_init(void);
+void ll_ra_sched_fini(void);
 int vvp_io_write_commit(const struct lu_env *env, struct cl_io *io);
 
 enum lcc_type;
@@ -787,6 +871,7 @@ extern int ll_have_md_lock(struct inode *inode, __u64 *bits,
 extern enum ldlm_mode ll_take_md_lock(struct inode *inode, __u64 bits,
 				      struct lustre_handle *lockh, __u64 flags,
 				      enum ldlm_mode mode);
+int __ll_inode_revalidate(struct dentry *dentry, __u64 ibits);
 
 int ll_file_open(struct inode *inode, struct file *file);
 int ll_file_release(struct inode *inode, struct file *file);
@@ -1107,6 +1192,9 @@ void ll_ra_stats_inc(struct inode *inode, enum ra_stat which);
 #define LL_SA_RPC_DEF           32
 #define LL_SA_RPC_MAX           8192
 
+/* seconds a walk of a closed dir may stay idle before statahead stops */
+#define LL_SA_DETACHED_TIMEOUT  1
+
 #define LL_SA_CACHE_BIT         5
 #define LL_SA_CACHE_SIZE        (1 << LL_SA_CACHE_BIT)
 #define LL_SA_CACHE_MASK        (LL_SA_CACHE_SIZE - 1)
@@ -1140,7 +1228,10 @@ struct ll_statahead_info {
 	unsigned int            sai_ls_all:1,   /* "ls -al", do stat-ahead for
 						 * hidden entries */
 				sai_agl_valid:1,/* AGL is valid for the dir */
-				sai_in_readpage:1;/* statahead is in readdir()*/
+				sai_in_readpage:1,/* statahead is in readdir()*/
+				sai_detached:1; /* dir was closed before
+						 * statahead started */
+	cfs_time_t		sai_access_time;/* last stat of the scanner */
 	wait_queue_head_t	sai_waitq;	/* stat-ahead wait queue */
 	struct ptlrpc_thread	sai_thread;	/* stat-ahead thread */
 	struct ptlrpc_thread	sai_agl_thread;	/* AGL thread */
@@ -1211,6 +1302,13 @@ dentry_may_statahead(struct inode *dir, struct dentry *dentry)
 	if (lli->lli_opendir_pid != current_pid())
 		return false;
 
+	/* dir was closed a while ago and the walk never started */
+	if (lli->lli_sa_detached && lli->lli_sai == NULL &&
+	    cfs_time_before(cfs_time_add(lli->lli_sa_detach_time,
+				cfs_time_seconds(LL_SA_DETACHED_TIMEOUT)),
+			    cfs_time_current()))
+		return false;
+
 	/*
 	 * When stating a dentry, kernel may trigger 'revalidate' or 'lookup'
 	 * multiple times, eg. for 'getattr', 'getxattr' and etc.
@@ -1296,6 +1394,7 @@ struct ll_dio_pages {
 extern ssize_t ll_direct_rw_pages(const struct lu_env *env, struct cl_io *io,
                                   int rw, struct inode *inode,
                                   struct ll_dio_pages *pv);
+void ll_dio_bounce_pool_fini(void);
 
 static inline int ll_file_nolock(const struct file *file)
 {
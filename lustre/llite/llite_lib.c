@@ -101,6 +101,10 @@ static struct ll_sb_info *ll_init_sbi(void)
 	sbi->ll_ra_info.ra_max_pages = sbi->ll_ra_info.ra_max_pages_per_file;
 	sbi->ll_ra_info.ra_max_read_ahead_whole_pages =
 					   SBI_DEFAULT_READAHEAD_WHOLE_MAX;
+	sbi->ll_ra_info.ra_async_pages_per_file_threshold =
+				sbi->ll_ra_info.ra_max_pages_per_file / 2;
+	atomic_set(&sbi->ll_ra_info.ra_async_inflight, 0);
+	sbi->ll_ra_info.ra_async_max_active = num_online_cpus();
 
         ll_generate_random_uuid(uuid);
         class_uuid_unparse(uuid, &sbi->ll_sb_uuid);
@@ -128,9 +132,12 @@ static struct ll_sb_info *ll_init_sbi(void)
 	atomic_set(&sbi->ll_sa_total, 0);
 	atomic_set(&sbi->ll_sa_wrong, 0);
 	atomic_set(&sbi->ll_sa_running, 0);
+	atomic_set(&sbi->ll_sa_detached, 0);
+	sbi->ll_neg_lookup_threshold = LL_NEG_LOOKUP_THRESHOLD_DEF;
 	atomic_set(&sbi->ll_agl_total, 0);
 	sbi->ll_flags |= LL_SBI_AGL_ENABLED;
 	sbi->ll_flags |= LL_SBI_FAST_READ;
+	sbi->ll_flags |= LL_SBI_PARALLEL_DIO;
 
 	/* root squash */
 	sbi->ll_squash.rsi_uid = 0;
@@ -254,6 +261,9 @@ static int client_common_fill_super(struct super_block *sb, char *md, char *dt,
 #ifdef HAVE_SECURITY_DENTRY_INIT_SECURITY
 	data->ocd_connect_flags2 |= OBD_CONNECT2_FILE_SECCTX;
 #endif /* HAVE_SECURITY_DENTRY_INIT_SECURITY */
+	data->ocd_connect_flags2 |= OBD_CONNECT2_READDIR_PLUS |
+				    OBD_CONNECT2_BL_AST_BATCH |
+				    OBD_CONNECT2_LOCK_CONVERT;
 
 	data->ocd_brw_size = MD_MAX_BRW_SIZE;
 
@@ -394,9 +404,12 @@ static int client_common_fill_super(struct super_block *sb, char *md, char *dt,
 				  OBD_CONNECT_JOBSTATS | OBD_CONNECT_LVB_TYPE |
 				  OBD_CONNECT_LAYOUTLOCK |
 				  OBD_CONNECT_PINGLESS | OBD_CONNECT_LFSCK |
-				  OBD_CONNECT_BULK_MBITS;
+				  OBD_CONNECT_BULK_MBITS | OBD_CONNECT_SHORTIO |
+				  OBD_CONNECT_FLAGS2;
 
-	data->ocd_connect_flags2 = 0;
+	data->ocd_connect_flags2 = OBD_CONNECT2_MULTIOBJ_BRW |
+				   OBD_CONNECT2_LOCKAHEAD |
+				   OBD_CONNECT2_BL_AST_BATCH;
 
 	if (!OBD_FAIL_CHECK(OBD_FAIL_OSC_CONNECT_GRANT_PARAM))
 		data->ocd_connect_flags |= OBD_CONNECT_GRANT_PARAM;
@@ -942,6 +955,9 @@ void ll_lli_init(struct ll_inode_info *lli)
 		spin_lock_init(&lli->lli_sa_lock);
 		lli->lli_opendir_pid = 0;
 		lli->lli_sa_enabled = 0;
+		lli->lli_sa_detached = 0;
+		lli->lli_sa_detach_time = 0;
+		atomic_set(&lli->lli_neg_lookups, 0);
 		lli->lli_def_stripe_offset = -1;
 	} else {
 		mutex_init(&lli->lli_size_mutex);
@@ -1417,6 +1433,12 @@ void ll_clear_inode(struct inode *inode)
 	       PFID(ll_inode2fid(inode)), inode);
 
         if (S_ISDIR(inode->i_mode)) {
+		/* closed dir still authorized for a walk that never came */
+		if (lli->lli_sa_detached) {
+			lli->lli_opendir_pid = 0;
+			lli->lli_sa_detached = 0;
+			lli->lli_sa_enabled = 0;
+		}
                 /* these should have been cleared in ll_file_release */
                 LASSERT(lli->lli_opendir_key == NULL);
                 LASSERT(lli->lli_sai == NULL);
@@ -338,6 +338,57 @@ ll_max_readahead_per_file_mb_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(ll_max_readahead_per_file_mb);
 
+static int
+ll_read_ahead_async_file_threshold_mb_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+	long pages_number;
+	int mult;
+
+	spin_lock(&sbi->ll_lock);
+	pages_number = sbi->ll_ra_info.ra_async_pages_per_file_threshold;
+	spin_unlock(&sbi->ll_lock);
+
+	mult = 1 << (20 - PAGE_SHIFT);
+	return lprocfs_seq_read_frac_helper(m, pages_number, mult);
+}
+
+static ssize_t
+ll_read_ahead_async_file_threshold_mb_seq_write(struct file *file,
+						const char __user *buffer,
+						size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+	int rc;
+	__s64 pages_number;
+
+	rc = lprocfs_str_with_units_to_s64(buffer, count, &pages_number, 'M');
+	if (rc)
+		return rc;
+
+	pages_number >>= PAGE_SHIFT;
+
+	if (pages_number < 0 ||
+	    pages_number > sbi->ll_ra_info.ra_max_pages_per_file) {
+		CERROR("%s: can't set read_ahead_async_file_threshold_mb=%lu "
+		       "> max_read_ahead_per_file_mb=%lu\n",
+		       ll_get_fsname(sb, NULL, 0),
+		       (unsigned long)pages_number >> (20 - PAGE_SHIFT),
+		       sbi->ll_ra_info.ra_max_pages_per_file >>
+		       (20 - PAGE_SHIFT));
+		return -ERANGE;
+	}
+
+	spin_lock(&sbi->ll_lock);
+	sbi->ll_ra_info.ra_async_pages_per_file_threshold = pages_number;
+	spin_unlock(&sbi->ll_lock);
+	return count;
+}
+LPROC_SEQ_FOPS(ll_read_ahead_async_file_threshold_mb);
+
 static int ll_max_read_ahead_whole_mb_seq_show(struct seq_file *m, void *v)
 {
 	struct super_block *sb = m->private;
@@ -711,14 +762,47 @@ static int ll_statahead_stats_seq_show(struct seq_file *m, void *v)
 
 	seq_printf(m, "statahead total: %u\n"
 		    "statahead wrong: %u\n"
+		    "statahead after close: %u\n"
 		    "agl total: %u\n",
 		    atomic_read(&sbi->ll_sa_total),
 		    atomic_read(&sbi->ll_sa_wrong),
+		    atomic_read(&sbi->ll_sa_detached),
 		    atomic_read(&sbi->ll_agl_total));
 	return 0;
 }
 LPROC_SEQ_FOPS_RO(ll_statahead_stats);
 
+static int ll_neg_lookup_threshold_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+
+	seq_printf(m, "%u\n", sbi->ll_neg_lookup_threshold);
+	return 0;
+}
+
+static ssize_t
+ll_neg_lookup_threshold_seq_write(struct file *file, const char __user *buffer,
+				  size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct ll_sb_info *sbi = ll_s2sbi((struct super_block *)m->private);
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	if (val < 0 || val > INT_MAX)
+		return -ERANGE;
+
+	sbi->ll_neg_lookup_threshold = val;
+
+	return count;
+}
+LPROC_SEQ_FOPS(ll_neg_lookup_threshold);
+
 static int ll_lazystatfs_seq_show(struct seq_file *m, void *v)
 {
 	struct super_block *sb = m->private;
@@ -894,6 +978,112 @@ ll_fast_read_seq_write(struct file *file, const char __user *buffer,
 }
 LPROC_SEQ_FOPS(ll_fast_read);
 
+static int ll_parallel_dio_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+
+	seq_printf(m, "%u\n", !!(sbi->ll_flags & LL_SBI_PARALLEL_DIO));
+	return 0;
+}
+
+static ssize_t
+ll_parallel_dio_seq_write(struct file *file, const char __user *buffer,
+			  size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	spin_lock(&sbi->ll_lock);
+	if (val == 1)
+		sbi->ll_flags |= LL_SBI_PARALLEL_DIO;
+	else
+		sbi->ll_flags &= ~LL_SBI_PARALLEL_DIO;
+	spin_unlock(&sbi->ll_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(ll_parallel_dio);
+
+static int ll_readdir_plus_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+
+	seq_printf(m, "%u\n", !!(sbi->ll_flags & LL_SBI_READDIR_PLUS));
+	return 0;
+}
+
+static ssize_t
+ll_readdir_plus_seq_write(struct file *file, const char __user *buffer,
+			  size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	spin_lock(&sbi->ll_lock);
+	if (val == 1)
+		sbi->ll_flags |= LL_SBI_READDIR_PLUS;
+	else
+		sbi->ll_flags &= ~LL_SBI_READDIR_PLUS;
+	spin_unlock(&sbi->ll_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(ll_readdir_plus);
+
+static int ll_hybrid_io_threshold_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+
+	seq_printf(m, "%llu\n", sbi->ll_hybrid_io_threshold);
+	return 0;
+}
+
+static ssize_t
+ll_hybrid_io_threshold_seq_write(struct file *file, const char __user *buffer,
+				 size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_with_units_to_s64(buffer, count, &val, '1');
+	if (rc)
+		return rc;
+
+	if (val < 0)
+		return -ERANGE;
+
+	/* only whole pages can be sent without copying */
+	if (val & ~PAGE_MASK)
+		val = (val | ~PAGE_MASK) + 1;
+
+	spin_lock(&sbi->ll_lock);
+	sbi->ll_hybrid_io_threshold = val;
+	spin_unlock(&sbi->ll_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(ll_hybrid_io_threshold);
+
 static int ll_unstable_stats_seq_show(struct seq_file *m, void *v)
 {
 	struct super_block	*sb    = m->private;
@@ -1039,6 +1229,8 @@ struct lprocfs_vars lprocfs_llite_obd_vars[] = {
 	  .fops	=	&ll_max_readahead_per_file_mb_fops	},
 	{ .name	=	"max_read_ahead_whole_mb",
 	  .fops	=	&ll_max_read_ahead_whole_mb_fops	},
+	{ .name	=	"read_ahead_async_file_threshold_mb",
+	  .fops	=	&ll_read_ahead_async_file_threshold_mb_fops },
 	{ .name	=	"max_cached_mb",
 	  .fops	=	&ll_max_cached_mb_fops			},
 	{ .name	=	"checksum_pages",
@@ -1055,6 +1247,8 @@ struct lprocfs_vars lprocfs_llite_obd_vars[] = {
 	  .fops	=	&ll_statahead_agl_fops			},
 	{ .name	=	"statahead_stats",
 	  .fops	=	&ll_statahead_stats_fops		},
+	{ .name	=	"neg_lookup_threshold",
+	  .fops	=	&ll_neg_lookup_threshold_fops		},
 	{ .name	=	"lazystatfs",
 	  .fops	=	&ll_lazystatfs_fops			},
 	{ .name	=	"max_easize",
@@ -1073,6 +1267,12 @@ struct lprocfs_vars lprocfs_llite_obd_vars[] = {
 	  .fops	=	&ll_nosquash_nids_fops			},
 	{ .name =       "fast_read",
 	  .fops =       &ll_fast_read_fops,                     },
+	{ .name	=	"parallel_dio",
+	  .fops	=	&ll_parallel_dio_fops			},
+	{ .name	=	"readdir_plus",
+	  .fops	=	&ll_readdir_plus_fops			},
+	{ .name	=	"hybrid_io_threshold",
+	  .fops	=	&ll_hybrid_io_threshold_fops		},
 	{ NULL }
 };
 
@@ -1160,7 +1360,9 @@ static const char *ra_stat_string[] = {
 	[RA_STAT_EOF] = "read-ahead to EOF",
 	[RA_STAT_MAX_IN_FLIGHT] = "hit max r-a issue",
 	[RA_STAT_WRONG_GRAB_PAGE] = "wrong page from grab_cache_page",
-	[RA_STAT_FAILED_REACH_END] = "failed to reach end"
+	[RA_STAT_FAILED_REACH_END] = "failed to reach end",
+	[RA_STAT_ASYNC] = "async readahead",
+	[RA_STAT_STREAM_RESUMED] = "resumed stream",
 };
 
 LPROC_SEQ_FOPS_RO_TYPE(llite, name);
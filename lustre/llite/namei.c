@@ -190,7 +190,7 @@ int ll_md_blocking_ast(struct ldlm_lock *lock, struct ldlm_lock_desc *desc,
 	switch (flag) {
 	case LDLM_CB_BLOCKING:
 		ldlm_lock2handle(lock, &lockh);
-		rc = ldlm_cli_cancel(&lockh, LCF_ASYNC);
+		rc = ldlm_cli_cancel(&lockh, LCF_ASYNC | LCF_CONVERT);
 		if (rc < 0) {
 			CDEBUG(D_INODE, "ldlm_cli_cancel: rc = %d\n", rc);
 			RETURN(rc);
@@ -208,7 +208,11 @@ int ll_md_blocking_ast(struct ldlm_lock *lock, struct ldlm_lock_desc *desc,
 			break;
 
 		/* Invalidate all dentries associated with this inode */
-		LASSERT(ldlm_is_canceling(lock));
+		LASSERT(ldlm_is_canceling(lock) || ldlm_is_converting(lock));
+
+		/* only the bits dropped by a lock conversion go away */
+		if (ldlm_is_converting(lock))
+			bits = lock->l_policy_data.l_inodebits.cancel_bits;
 
 		if (!fid_res_name_eq(ll_inode2fid(inode),
 				     &lock->l_resource->lr_name)) {
@@ -533,6 +537,8 @@ static int ll_lookup_it_finish(struct ptlrpc_request *request,
 				       NULL)) {
 			d_lustre_revalidate(*de);
 			ll_intent_release(&parent_it);
+		} else {
+			atomic_inc(&ll_i2info(parent)->lli_neg_lookups);
 		}
 	}
 
@@ -545,6 +551,45 @@ out:
 	return rc;
 }
 
+/**
+ * Take the UPDATE lock of a directory which keeps seeing lookups of names
+ * that don't exist, such as the entries of a search path.
+ *
+ * A negative dentry is only kept valid while the client holds the UPDATE
+ * lock of its parent (see ll_lookup_it_finish() and
+ * ll_invalidate_negative_children()), but walking a path only fetches the
+ * LOOKUP lock of the intermediate directories. So every such lookup would
+ * go to the MDT. Once ll_neg_lookup_threshold of them were not cached, fetch
+ * the UPDATE lock before the next lookup so that its result can be cached.
+ * The lock is taken before the lookup RPC rather than after, otherwise an
+ * entry created in between would be hidden by the negative dentry.
+ */
+static void ll_lookup_neg_lock(struct inode *parent, struct dentry *dentry)
+{
+	struct ll_inode_info *lli = ll_i2info(parent);
+	unsigned int threshold = ll_i2sbi(parent)->ll_neg_lookup_threshold;
+	struct dentry *dparent;
+	__u64 ibits = MDS_INODELOCK_UPDATE;
+
+	if (threshold == 0 || lli->lli_lsm_md != NULL ||
+	    atomic_read(&lli->lli_neg_lookups) < threshold)
+		return;
+
+	atomic_set(&lli->lli_neg_lookups, 0);
+	if (ll_have_md_lock(parent, &ibits, LCK_MINMODE))
+		return;
+
+	dparent = dget_parent(dentry);
+	if (dparent->d_inode == parent) {
+		int rc;
+
+		rc = __ll_inode_revalidate(dparent, MDS_INODELOCK_UPDATE);
+		CDEBUG(D_DENTRY, "take UPDATE lock of "DFID" for negative "
+		       "lookups: rc = %d\n", PFID(ll_inode2fid(parent)), rc);
+	}
+	dput(dparent);
+}
+
 static struct dentry *ll_lookup_it(struct inode *parent, struct dentry *dentry,
 				   struct lookup_intent *it)
 {
@@ -579,10 +624,12 @@ static struct dentry *ll_lookup_it(struct inode *parent, struct dentry *dentry,
 	    dentry->d_sb->s_flags & MS_RDONLY)
 		RETURN(ERR_PTR(-EROFS));
 
-	if (it->it_op & IT_CREAT)
+	if (it->it_op & IT_CREAT) {
 		opc = LUSTRE_OPC_CREATE;
-	else
+	} else {
 		opc = LUSTRE_OPC_ANY;
+		ll_lookup_neg_lock(parent, dentry);
+	}
 
 	op_data = ll_prep_md_op_data(NULL, parent, NULL, dentry->d_name.name,
 				     dentry->d_name.len, 0, opc, NULL);
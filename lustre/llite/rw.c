@@ -48,6 +48,7 @@
 #include <asm/uaccess.h>
 #include <linux/mm.h>
 #include <linux/pagemap.h>
+#include <linux/gcd.h>
 /* current_is_kswapd() */
 #include <linux/swap.h>
 
@@ -367,18 +368,27 @@ ll_read_ahead_pages(const struct lu_env *env, struct cl_io *io,
 				LASSERTF(ra.cra_end >= page_idx,
 					 "object: %p, indcies %lu / %lu\n",
 					 io->ci_obj, ra.cra_end, page_idx);
-				/* update read ahead RPC size.
+				/* update read ahead RPC size and layout.
 				 * NB: it's racy but doesn't matter */
 				if (ras->ras_rpc_size > ra.cra_rpc_size &&
 				    ra.cra_rpc_size > 0)
 					ras->ras_rpc_size = ra.cra_rpc_size;
-				/* trim it to align with optimal RPC size */
+				ras->ras_stripe_pages = ra.cra_stripe_pages;
+				ras->ras_stripe_count = ra.cra_stripe_count;
+				/* trim it to align with optimal RPC size, this
+				 * means nothing for the file offsets of a stride
+				 * window */
 				end = ras_align(ras, ria->ria_end + 1, NULL);
-				if (end > 0 && !ria->ria_eof)
+				if (end > 0 && !ria->ria_eof && !stride_ria)
 					ria->ria_end = end - 1;
 				if (ria->ria_end < ria->ria_end_min)
 					ria->ria_end = ria->ria_end_min;
-				if (ria->ria_end > ra.cra_end)
+				/* cra_end stops at the stripe boundary. A
+				 * stride window goes on, the lock of the next
+				 * stripe is looked up once page_idx gets
+				 * there, so that it is not cut at the first
+				 * stripe it crosses */
+				if (ria->ria_end > ra.cra_end && !stride_ria)
 					ria->ria_end = ra.cra_end;
 			}
 			if (page_idx > ria->ria_end)
@@ -421,9 +431,282 @@ ll_read_ahead_pages(const struct lu_env *env, struct cl_io *io,
 	return ra_end;
 }
 
+/**
+ * Update the read-ahead statistics and state once read-ahead of the pages
+ * [start, \a end] has been issued up to \a ra_end.
+ */
+static void ll_readahead_done(struct inode *inode,
+			      struct ll_readahead_state *ras,
+			      pgoff_t ra_end, pgoff_t end, __u64 kms)
+{
+	if (ra_end == end && ra_end == (kms >> PAGE_SHIFT))
+		ll_ra_stats_inc(inode, RA_STAT_EOF);
+
+	/* if we didn't get to the end of the region we reserved from
+	 * the ras we need to go back and update the ras so that the
+	 * next read-ahead tries from where we left off.  we only do so
+	 * if the region we failed to issue read-ahead on is still ahead
+	 * of the app and behind the next index to start read-ahead from */
+	CDEBUG(D_READA, "ra_end = %lu end = %lu\n", ra_end, end);
+
+	if (ra_end > 0 && ra_end != end) {
+		ll_ra_stats_inc(inode, RA_STAT_FAILED_REACH_END);
+		spin_lock(&ras->ras_lock);
+		if (ra_end <= ras->ras_next_readahead &&
+		    index_in_window(ra_end, ras->ras_window_start, 0,
+				    ras->ras_window_len)) {
+			ras->ras_next_readahead = ra_end + 1;
+			RAS_CDEBUG(ras);
+		}
+		spin_unlock(&ras->ras_lock);
+	}
+}
+
+/* one scheduler per CPU partition of cfs_cpt_table */
+static struct cfs_wi_sched **ll_ra_scheds;
+
+struct ll_readahead_work {
+	struct cfs_workitem	 lrw_wi;
+	struct cfs_wi_sched	*lrw_sched;
+	/** file to read ahead for, referenced until the work is done */
+	struct file		*lrw_file;
+	pgoff_t			 lrw_start;
+	pgoff_t			 lrw_end;
+	/** jobid of the reader, so that the RPCs are accounted to it */
+	char			 lrw_jobid[LUSTRE_JOBID_SIZE];
+};
+
+/**
+ * Issue read-ahead of the pages [lrw_start, lrw_end] from a read-ahead
+ * thread. The io goes through the normal cl_io lifecycle, but vvp does not
+ * take any lock nor read anything by itself for it (see
+ * cl_io::ci_async_readahead), so only the pages covered by DLM locks already
+ * cached on the client are read ahead, exactly as for synchronous
+ * read-ahead.
+ */
+static int ll_readahead_handle_work(struct cfs_workitem *wi)
+{
+	struct ll_readahead_work *work = container_of(wi,
+						      struct ll_readahead_work,
+						      lrw_wi);
+	struct file *file = work->lrw_file;
+	struct inode *inode = file_inode(file);
+	struct ll_file_data *fd = LUSTRE_FPRIVATE(file);
+	struct ll_readahead_state *ras = &fd->fd_ras;
+	struct ll_sb_info *sbi = ll_i2sbi(inode);
+	struct cl_object *clob = ll_i2info(inode)->lli_clob;
+	struct cl_attr *attr;
+	struct ra_io_arg *ria;
+	struct cl_2queue *queue;
+	struct vvp_io *vio;
+	struct lu_env *env;
+	struct cl_io *io;
+	pgoff_t ra_end = 0;
+	pgoff_t end;
+	unsigned long len;
+	__u16 refcheck;
+	__u64 kms;
+	int rc;
+	ENTRY;
+
+	cfs_wi_exit(work->lrw_sched, wi);
+
+	env = cl_env_get(&refcheck);
+	if (IS_ERR(env))
+		GOTO(out_free, rc = PTR_ERR(env));
+
+	io = vvp_env_thread_io(env);
+	io->ci_obj = clob;
+	io->ci_lockreq = CILR_NEVER;
+	io->ci_noatime = 1;
+	io->ci_async_readahead = 1;
+	io->ci_jobid = work->lrw_jobid;
+	len = work->lrw_end - work->lrw_start + 1;
+	rc = cl_io_rw_init(env, io, CIT_READ, cl_offset(clob, work->lrw_start),
+			   cl_offset(clob, len));
+	if (rc != 0)
+		GOTO(out_io_fini, rc);
+
+	vio = vvp_env_io(env);
+	vio->vui_fd = fd;
+	vio->vui_io_subtype = IO_NORMAL;
+
+	rc = cl_io_iter_init(env, io);
+	if (rc != 0)
+		GOTO(out_iter_fini, rc);
+
+	rc = cl_io_lock(env, io);
+	if (rc != 0)
+		GOTO(out_iter_fini, rc);
+
+	rc = cl_io_start(env, io);
+	if (rc != 0)
+		GOTO(out_io_end, rc);
+
+	attr = vvp_env_thread_attr(env);
+	cl_object_attr_lock(clob);
+	rc = cl_object_attr_get(env, clob, attr);
+	cl_object_attr_unlock(clob);
+	if (rc != 0)
+		GOTO(out_io_end, rc);
+
+	kms = attr->cat_kms;
+	if (kms == 0)
+		GOTO(out_io_end, rc = 0);
+
+	ria = &ll_env_info(env)->lti_ria;
+	memset(ria, 0, sizeof(*ria));
+	end = work->lrw_end;
+	if (end >= (kms - 1) >> PAGE_SHIFT) {
+		end = (kms - 1) >> PAGE_SHIFT;
+		ria->ria_eof = true;
+	}
+	if (end < work->lrw_start)
+		GOTO(out_io_end, rc = 0);
+
+	ria->ria_start = work->lrw_start;
+	ria->ria_end = end;
+	len = end - ria->ria_start + 1;
+	ria->ria_reserved = ll_ra_count_get(sbi, ria, len, 0);
+	if (ria->ria_reserved < len)
+		ll_ra_stats_inc(inode, RA_STAT_MAX_IN_FLIGHT);
+
+	queue = &io->ci_queue;
+	cl_2queue_init(queue);
+	ra_end = ll_read_ahead_pages(env, io, &queue->c2_qin, ras, ria);
+	if (ria->ria_reserved != 0)
+		ll_ra_count_put(sbi, ria->ria_reserved);
+
+	if (queue->c2_qin.pl_nr > 0)
+		rc = cl_io_submit_rw(env, io, CRT_READ, queue);
+
+	/* unlock unsent pages in case of error */
+	cl_page_list_disown(env, io, &queue->c2_qin);
+	cl_2queue_fini(env, queue);
+
+	ll_readahead_done(inode, ras, ra_end, end, kms);
+	ll_ra_stats_inc(inode, RA_STAT_ASYNC);
+	CDEBUG(D_READA, DFID": async read-ahead %lu-%lu up to %lu: rc = %d\n",
+	       PFID(ll_inode2fid(inode)), work->lrw_start, work->lrw_end,
+	       ra_end, rc);
+out_io_end:
+	cl_io_end(env, io);
+	cl_io_unlock(env, io);
+out_iter_fini:
+	cl_io_iter_fini(env, io);
+out_io_fini:
+	cl_io_fini(env, io);
+	cl_env_put(env, &refcheck);
+out_free:
+	atomic_dec(&sbi->ll_ra_info.ra_async_inflight);
+	fput(file);
+	OBD_FREE_PTR(work);
+
+	/* the work item has been freed */
+	RETURN(1);
+}
+
+/**
+ * Hand read-ahead of [\a start, \a end] over to a read-ahead thread.
+ *
+ * Only plain sequential read-ahead beyond the current read(2) is done
+ * asynchronously, once the read-ahead window of the file has grown to
+ * ll_ra_info::ra_async_pages_per_file_threshold. Stride and mmap read-ahead
+ * as well as the pages the application is waiting for are always read
+ * synchronously.
+ *
+ * \retval true if the read-ahead has been queued
+ */
+static bool ll_readahead_async(struct file *file, struct vvp_io *vio,
+			       struct ra_io_arg *ria,
+			       unsigned long window_len)
+{
+	struct inode *inode = file_inode(file);
+	struct ll_ra_info *ra = &ll_i2sbi(inode)->ll_ra_info;
+	struct ll_readahead_work *work;
+	int cpt;
+
+	if (ll_ra_scheds == NULL ||
+	    ra->ra_async_pages_per_file_threshold == 0 ||
+	    window_len < ra->ra_async_pages_per_file_threshold)
+		return false;
+
+	if (ria->ria_length != 0 || !vio->vui_ra_valid ||
+	    ria->ria_start < vio->vui_ra_start + vio->vui_ra_count)
+		return false;
+
+	if (atomic_inc_return(&ra->ra_async_inflight) >
+	    ra->ra_async_max_active) {
+		atomic_dec(&ra->ra_async_inflight);
+		return false;
+	}
+
+	OBD_ALLOC_PTR(work);
+	if (work == NULL) {
+		atomic_dec(&ra->ra_async_inflight);
+		return false;
+	}
+
+	cpt = cfs_cpt_current(cfs_cpt_table, 1);
+	work->lrw_sched = ll_ra_scheds[cpt];
+	work->lrw_file = get_file(file);
+	work->lrw_start = ria->ria_start;
+	work->lrw_end = ria->ria_end;
+	memcpy(work->lrw_jobid, ll_i2info(inode)->lli_jobid,
+	       LUSTRE_JOBID_SIZE);
+	cfs_wi_init(&work->lrw_wi, NULL, ll_readahead_handle_work);
+	cfs_wi_schedule(work->lrw_sched, &work->lrw_wi);
+
+	return true;
+}
+
+int ll_ra_sched_init(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int rc;
+	int i;
+
+	OBD_ALLOC(ll_ra_scheds, sizeof(ll_ra_scheds[0]) * ncpts);
+	if (ll_ra_scheds == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < ncpts; i++) {
+		int nthrs = max(cfs_cpt_weight(cfs_cpt_table, i) / 2, 1);
+
+		rc = cfs_wi_sched_create("ll_ra", cfs_cpt_table, i, nthrs,
+					 &ll_ra_scheds[i]);
+		if (rc != 0) {
+			CERROR("llite: failed to create read-ahead scheduler "
+			       "for CPT %d: rc = %d\n", i, rc);
+			ll_ra_sched_fini();
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+void ll_ra_sched_fini(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int i;
+
+	if (ll_ra_scheds == NULL)
+		return;
+
+	for (i = 0; i < ncpts; i++) {
+		if (ll_ra_scheds[i] != NULL)
+			cfs_wi_sched_destroy(ll_ra_scheds[i]);
+	}
+
+	OBD_FREE(ll_ra_scheds, sizeof(ll_ra_scheds[0]) * ncpts);
+	ll_ra_scheds = NULL;
+}
+
 static int ll_readahead(const struct lu_env *env, struct cl_io *io,
 			struct cl_page_list *queue,
-			struct ll_readahead_state *ras, bool hit)
+			struct ll_readahead_state *ras, bool hit,
+			struct file *file)
 {
 	struct vvp_io *vio = vvp_env_io(env);
 	struct ll_thread_info *lti = ll_env_info(env);
@@ -433,6 +716,7 @@ static int ll_readahead(const struct lu_env *env, struct cl_io *io,
 	struct inode *inode;
 	struct ra_io_arg *ria = &lti->lti_ria;
 	struct cl_object *clob;
+	unsigned long window_len;
 	int ret = 0;
 	__u64 kms;
 	ENTRY;
@@ -497,6 +781,7 @@ static int ll_readahead(const struct lu_env *env, struct cl_io *io,
                 ria->ria_length = ras->ras_stride_length;
                 ria->ria_pages = ras->ras_stride_pages;
         }
+	window_len = ras->ras_window_len;
 	spin_unlock(&ras->ras_lock);
 
 	if (end == 0) {
@@ -516,6 +801,9 @@ static int ll_readahead(const struct lu_env *env, struct cl_io *io,
 	       vio->vui_ra_valid ? vio->vui_ra_count : 0,
 	       hit);
 
+	if (ll_readahead_async(file, vio, ria, window_len))
+		RETURN(0);
+
 	/* at least to extend the readahead window to cover current read */
 	if (!hit && vio->vui_ra_valid &&
 	    vio->vui_ra_start + vio->vui_ra_count > ria->ria_start) {
@@ -543,28 +831,7 @@ static int ll_readahead(const struct lu_env *env, struct cl_io *io,
 	if (ria->ria_reserved != 0)
 		ll_ra_count_put(ll_i2sbi(inode), ria->ria_reserved);
 
-	if (ra_end == end && ra_end == (kms >> PAGE_SHIFT))
-		ll_ra_stats_inc(inode, RA_STAT_EOF);
-
-	/* if we didn't get to the end of the region we reserved from
-	 * the ras we need to go back and update the ras so that the
-	 * next read-ahead tries from where we left off.  we only do so
-	 * if the region we failed to issue read-ahead on is still ahead
-	 * of the app and behind the next index to start read-ahead from */
-	CDEBUG(D_READA, "ra_end = %lu end = %lu stride end = %lu pages = %d\n",
-	       ra_end, end, ria->ria_end, ret);
-
-	if (ra_end > 0 && ra_end != end) {
-		ll_ra_stats_inc(inode, RA_STAT_FAILED_REACH_END);
-		spin_lock(&ras->ras_lock);
-		if (ra_end <= ras->ras_next_readahead &&
-		    index_in_window(ra_end, ras->ras_window_start, 0,
-				    ras->ras_window_len)) {
-			ras->ras_next_readahead = ra_end + 1;
-			RAS_CDEBUG(ras);
-		}
-		spin_unlock(&ras->ras_lock);
-	}
+	ll_readahead_done(inode, ras, ra_end, end, kms);
 
 	RETURN(ret);
 }
@@ -602,8 +869,88 @@ void ll_readahead_init(struct inode *inode, struct ll_readahead_state *ras)
 {
 	spin_lock_init(&ras->ras_lock);
 	ras->ras_rpc_size = PTLRPC_MAX_BRW_PAGES;
+	ras->ras_stripe_pages = 0;
+	ras->ras_stripe_count = 0;
 	ras_reset(inode, ras, 0);
 	ras->ras_requests = 0;
+	memset(ras->ras_streams, 0, sizeof(ras->ras_streams));
+}
+
+static void ras_stream_save(struct ll_readahead_state *ras,
+			    struct ll_ra_stream *rs)
+{
+	rs->rs_last_readpage = ras->ras_last_readpage;
+	rs->rs_consecutive_pages = ras->ras_consecutive_pages;
+	rs->rs_consecutive_requests = ras->ras_consecutive_requests;
+	rs->rs_window_start = ras->ras_window_start;
+	rs->rs_window_len = ras->ras_window_len;
+	rs->rs_next_readahead = ras->ras_next_readahead;
+	rs->rs_stamp = ras->ras_requests + 1;
+}
+
+static void ras_stream_restore(struct ll_readahead_state *ras,
+			       struct ll_ra_stream *rs)
+{
+	ras->ras_last_readpage = rs->rs_last_readpage;
+	ras->ras_consecutive_pages = rs->rs_consecutive_pages;
+	ras->ras_consecutive_requests = rs->rs_consecutive_requests;
+	ras->ras_window_start = rs->rs_window_start;
+	ras->ras_window_len = rs->rs_window_len;
+	ras->ras_next_readahead = rs->rs_next_readahead;
+}
+
+/*
+ * Called with the ras_lock held when the application reads far away from
+ * the current stream. If \a index continues one of the parked streams, that
+ * stream becomes the current one and the current one is parked in its slot.
+ * Otherwise the current stream is parked in place of the least recently used
+ * one, if it got far enough to be worth resuming, and will be reset by the
+ * caller.
+ *
+ * \retval true if a parked stream has been resumed
+ */
+static bool ras_stream_switch(struct ll_sb_info *sbi,
+			      struct ll_readahead_state *ras,
+			      unsigned long index)
+{
+	struct ll_ra_stream *rs;
+	struct ll_ra_stream *lru = NULL;
+	struct ll_ra_stream tmp;
+	int i;
+
+	for (i = 0; i < LL_RA_STREAMS_MAX; i++) {
+		rs = &ras->ras_streams[i];
+		if (rs->rs_stamp != 0 &&
+		    index_in_window(index, rs->rs_last_readpage, 8, 8))
+			break;
+		if (lru == NULL || rs->rs_stamp < lru->rs_stamp)
+			lru = rs;
+	}
+
+	if (i == LL_RA_STREAMS_MAX) {
+		/* nothing useful to remember about a stream that
+		 * never read two requests in a row */
+		if (ras->ras_consecutive_requests > 1 ||
+		    ras->ras_window_len > 0) {
+			ras_stream_save(ras, lru);
+			if (ras->ras_request_index == 0)
+				lru->rs_consecutive_requests--;
+		}
+		return false;
+	}
+
+	ras_stream_save(ras, &tmp);
+	ras_stream_restore(ras, rs);
+	*rs = tmp;
+	/* ll_ras_enter() accounted this request to the parked stream */
+	if (ras->ras_request_index == 0) {
+		rs->rs_consecutive_requests--;
+		ras->ras_consecutive_requests++;
+	}
+	ll_ra_stats_inc_sbi(sbi, RA_STAT_STREAM_RESUMED);
+	RAS_CDEBUG(ras);
+
+	return true;
 }
 
 /*
@@ -703,16 +1050,49 @@ static void ras_stride_increase_window(struct ll_readahead_state *ras,
         RAS_CDEBUG(ras);
 }
 
+/*
+ * Number of OSTs the data chunks of the stride pattern land on, as far as the
+ * striping of the file reported by the last read-ahead tells.
+ */
+static unsigned int ras_stride_osts(struct ll_readahead_state *ras)
+{
+	unsigned long stripe_pages = ras->ras_stripe_pages;
+	unsigned int stripe_count = ras->ras_stripe_count;
+	unsigned long step;
+	unsigned long nr;
+
+	if (stripe_pages == 0 || stripe_count <= 1)
+		return 1;
+
+	/* chunks at arbitrary stripe offsets, assume they spread out */
+	if (ras->ras_stride_length % stripe_pages != 0)
+		return stripe_count;
+
+	/* stripe distance between two consecutive chunks */
+	step = (ras->ras_stride_length / stripe_pages) % stripe_count;
+	nr = step == 0 ? 1 : stripe_count / gcd(step, stripe_count);
+	/* and stripes covered by a single chunk */
+	nr *= DIV_ROUND_UP(ras->ras_stride_pages, stripe_pages);
+
+	return min_t(unsigned long, nr, stripe_count);
+}
+
 static void ras_increase_window(struct inode *inode,
 				struct ll_readahead_state *ras,
 				struct ll_ra_info *ra)
 {
-	/* The stretch of ra-window should be aligned with max rpc_size
-	 * but current clio architecture does not support retrieve such
-	 * information from lower layer. FIXME later
-	 */
 	if (stride_io_mode(ras)) {
-		ras_stride_increase_window(ras, ra, ras->ras_rpc_size);
+		unsigned long wlen = ras->ras_window_len;
+
+		/* Grow the stride window by a full RPC for each OST the
+		 * pattern touches, so that the stride read-ahead issues
+		 * full RPCs rather than a small piece on every OST. Fall
+		 * back to a single RPC once this would go beyond
+		 * ra_max_pages_per_file. */
+		ras_stride_increase_window(ras, ra, ras->ras_rpc_size *
+						    ras_stride_osts(ras));
+		if (ras->ras_window_len == wlen && ras_stride_osts(ras) > 1)
+			ras_stride_increase_window(ras, ra, ras->ras_rpc_size);
 	} else {
 		unsigned long wlen;
 
@@ -738,6 +1118,12 @@ static void ras_update(struct ll_sb_info *sbi, struct inode *inode,
 		       PFID(ll_inode2fid(inode)), index);
         ll_ra_stats_inc_sbi(sbi, hit ? RA_STAT_HIT : RA_STAT_MISS);
 
+	/* switch to the stream this read continues, if any. Stride
+	 * read-ahead tracks a single pattern and jumps by itself */
+	if (!index_in_window(index, ras->ras_last_readpage, 8, 8) &&
+	    !stride_io_mode(ras))
+		ras_stream_switch(sbi, ras, index);
+
         /* reset the read-ahead window in two cases.  First when the app seeks
          * or reads to some other part of the file.  Secondly if we get a
          * read-ahead miss that we think we've previously issued.  This can
@@ -1125,7 +1511,7 @@ static int ll_io_read_page(const struct lu_env *env, struct cl_io *io,
 		int rc2;
 
 		rc2 = ll_readahead(env, io, &queue->c2_qin, ras,
-				   uptodate);
+				   uptodate, file);
 		CDEBUG(D_READA, DFID "%d pages read ahead at %lu\n",
 		       PFID(ll_inode2fid(inode)), rc2, vvp_index(vpg));
 	}
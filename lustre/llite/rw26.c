@@ -193,6 +193,8 @@ ssize_t ll_direct_rw_pages(const struct lu_env *env, struct cl_io *io,
 	int page_count      = pv->ldp_nr;
 	struct page **pages = pv->ldp_pages;
 	size_t page_size    = cl_page_size(obj);
+	size_t from;
+	size_t to;
 	bool do_io;
 	int  io_pages       = 0;
 	ENTRY;
@@ -203,7 +205,13 @@ ssize_t ll_direct_rw_pages(const struct lu_env *env, struct cl_io *io,
                 if (pv->ldp_offsets)
                     file_offset = pv->ldp_offsets[i];
 
-                LASSERT(!(file_offset & (page_size - 1)));
+		/* only the first page of a sequential vector may start in
+		 * the middle, only the last one may end there */
+		LASSERT(ergo(i > 0 || pv->ldp_offsets != NULL,
+			     !(file_offset & (page_size - 1))));
+		from = file_offset & (page_size - 1);
+		to = min(from + size, page_size);
+
                 clp = cl_page_find(env, obj, cl_index(obj, file_offset),
                                    pv->ldp_pages[i], CPT_TRANSIENT);
                 if (IS_ERR(clp)) {
@@ -234,7 +242,7 @@ ssize_t ll_direct_rw_pages(const struct lu_env *env, struct cl_io *io,
 
                         src = ll_kmap_atomic(src_page, KM_USER0);
                         dst = ll_kmap_atomic(dst_page, KM_USER1);
-                        memcpy(dst, src, min(page_size, size));
+			memcpy(dst + from, src + from, to - from);
                         ll_kunmap_atomic(dst, KM_USER1);
                         ll_kunmap_atomic(src, KM_USER0);
 
@@ -259,15 +267,15 @@ ssize_t ll_direct_rw_pages(const struct lu_env *env, struct cl_io *io,
                          * Set page clip to tell transfer formation engine
                          * that page has to be sent even if it is beyond KMS.
                          */
-                        cl_page_clip(env, clp, 0, min(size, page_size));
+			cl_page_clip(env, clp, from, to);
 
                         ++io_pages;
                 }
 
                 /* drop the reference count for cl_page_find */
                 cl_page_put(env, clp);
-                size -= page_size;
-                file_offset += page_size;
+		size -= to - from;
+		file_offset += to - from;
         }
 
         if (rc == 0 && io_pages) {
@@ -300,6 +308,163 @@ ll_direct_IO_seg(const struct lu_env *env, struct cl_io *io, int rw,
 	return ll_direct_rw_pages(env, io, rw, inode, &pvec);
 }
 
+/* Largest amount of unaligned direct I/O staged in bounce pages at once */
+#define MAX_DIO_BOUNCE_SIZE	(4 * ONE_MB_BRW_SIZE)
+/* Bounce pages kept for reuse, enough for two chunks in flight */
+#define LL_DIO_BOUNCE_POOL_MAX	(2 * (MAX_DIO_BOUNCE_SIZE >> PAGE_SHIFT) + 2)
+
+static DEFINE_SPINLOCK(ll_dio_bounce_lock);
+static LIST_HEAD(ll_dio_bounce_pages);
+static unsigned int ll_dio_bounce_nr;
+
+/**
+ * Fill \a bpages with \a nr bounce pages, taken from the pool first so that
+ * a stream of misaligned direct I/O does not go to the page allocator for
+ * every page of every chunk.
+ */
+static int ll_dio_bounce_get(struct page **bpages, int nr)
+{
+	int i = 0;
+
+	spin_lock(&ll_dio_bounce_lock);
+	while (i < nr && !list_empty(&ll_dio_bounce_pages)) {
+		bpages[i] = list_entry(ll_dio_bounce_pages.next,
+				       struct page, lru);
+		list_del_init(&bpages[i]->lru);
+		ll_dio_bounce_nr--;
+		i++;
+	}
+	spin_unlock(&ll_dio_bounce_lock);
+
+	for (; i < nr; i++) {
+		bpages[i] = alloc_page(GFP_NOFS);
+		if (bpages[i] == NULL)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * Give the bounce pages in \a bpages back to the pool, the array may be
+ * terminated early by a NULL entry.
+ */
+static void ll_dio_bounce_put(struct page **bpages, int nr)
+{
+	int i;
+
+	spin_lock(&ll_dio_bounce_lock);
+	for (i = 0; i < nr && bpages[i] != NULL; i++) {
+		if (ll_dio_bounce_nr >= LL_DIO_BOUNCE_POOL_MAX)
+			break;
+		list_add(&bpages[i]->lru, &ll_dio_bounce_pages);
+		ll_dio_bounce_nr++;
+	}
+	spin_unlock(&ll_dio_bounce_lock);
+
+	for (; i < nr && bpages[i] != NULL; i++)
+		__free_page(bpages[i]);
+}
+
+void ll_dio_bounce_pool_fini(void)
+{
+	struct page *page;
+
+	while (!list_empty(&ll_dio_bounce_pages)) {
+		page = list_entry(ll_dio_bounce_pages.next, struct page, lru);
+		list_del(&page->lru);
+		__free_page(page);
+	}
+	ll_dio_bounce_nr = 0;
+}
+
+/**
+ * Copy \a size bytes between the pinned user buffer starting at \a offs
+ * in \a upages and the bounce pages starting at \a boffs in \a bpages.
+ */
+static void ll_dio_bounce_copy(struct page **upages, size_t offs,
+			       struct page **bpages, size_t boffs,
+			       size_t size, int rw)
+{
+	while (size > 0) {
+		size_t bytes = min_t(size_t, size,
+				     PAGE_SIZE - max(offs, boffs));
+		char *uaddr;
+		char *baddr;
+
+		uaddr = ll_kmap_atomic(*upages, KM_USER0);
+		baddr = ll_kmap_atomic(*bpages, KM_USER1);
+		if (rw == WRITE)
+			memcpy(baddr + boffs, uaddr + offs, bytes);
+		else
+			memcpy(uaddr + offs, baddr + boffs, bytes);
+		ll_kunmap_atomic(baddr, KM_USER1);
+		ll_kunmap_atomic(uaddr, KM_USER0);
+
+		size -= bytes;
+		offs += bytes;
+		boffs += bytes;
+		if (offs == PAGE_SIZE) {
+			offs = 0;
+			upages++;
+		}
+		if (boffs == PAGE_SIZE) {
+			boffs = 0;
+			bpages++;
+		}
+	}
+}
+
+/**
+ * Direct I/O for a user buffer whose offset within a page differs from the
+ * offset within a page of the file, so that no user page can be sent
+ * as-is. The data is staged through pooled kernel pages laid out like the
+ * file. Like any other direct I/O chunk it is sent to all its stripes at
+ * once, and it is complete on return so that read data can be copied back
+ * to the user pages before they are released.
+ *
+ * \retval number of bytes transferred, at most MAX_DIO_BOUNCE_SIZE
+ */
+static ssize_t
+ll_direct_IO_bounce(const struct lu_env *env, struct cl_io *io, int rw,
+		    struct inode *inode, size_t size, loff_t file_offset,
+		    struct page **upages, size_t offs)
+{
+	struct ll_dio_pages pvec = { .ldp_offsets	= NULL,
+				     .ldp_start_offset	= file_offset
+				   };
+	size_t boffs = file_offset & ~PAGE_MASK;
+	struct page **bpages;
+	ssize_t rc;
+	int nr;
+
+	size = min_t(size_t, size, MAX_DIO_BOUNCE_SIZE - boffs);
+	nr = DIV_ROUND_UP(boffs + size, PAGE_SIZE);
+
+	OBD_ALLOC(bpages, nr * sizeof(*bpages));
+	if (bpages == NULL)
+		return -ENOMEM;
+
+	rc = ll_dio_bounce_get(bpages, nr);
+	if (rc < 0)
+		GOTO(out, rc);
+
+	if (rw == WRITE)
+		ll_dio_bounce_copy(upages, offs, bpages, boffs, size, rw);
+
+	pvec.ldp_pages = bpages;
+	pvec.ldp_nr = nr;
+	pvec.ldp_size = size;
+	rc = ll_direct_rw_pages(env, io, rw, inode, &pvec);
+	if (rc > 0 && rw == READ)
+		ll_dio_bounce_copy(upages, offs, bpages, boffs, rc, rw);
+out:
+	ll_dio_bounce_put(bpages, nr);
+	OBD_FREE(bpages, nr * sizeof(*bpages));
+
+	return rc;
+}
+
 /*  ll_free_user_pages - tear down page struct array
  *  @pages: array of page struct pointers underlying target buffer */
 static void ll_free_user_pages(struct page **pages, int npages, int do_dirty)
@@ -357,20 +522,16 @@ ll_direct_IO(
 	ssize_t tot_bytes = 0, result = 0;
 	size_t size = MAX_DIO_SIZE;
 
-	/* FIXME: io smaller than PAGE_SIZE is broken on ia64 ??? */
-	if ((file_offset & ~PAGE_MASK) || (count & ~PAGE_MASK))
-		return -EINVAL;
-
 	CDEBUG(D_VFSTRACE, "VFS Op:inode="DFID"(%p), size=%zd (max %lu), "
 	       "offset=%lld=%llx, pages %zd (max %lu)\n",
 	       PFID(ll_inode2fid(inode)), inode, count, MAX_DIO_SIZE,
 	       file_offset, file_offset, count >> PAGE_SHIFT,
 	       MAX_DIO_SIZE >> PAGE_SHIFT);
 
-	/* Check that all user buffers are aligned as well */
-	if (iov_iter_alignment(iter) & ~PAGE_MASK)
-		return -EINVAL;
-
+	/* Unaligned offsets and sizes are fine: a partial head or tail page
+	 * is sent as a sub-page niobuf straight from the user page. Only a
+	 * user buffer misaligned against the file offset must be staged
+	 * through bounce pages, see ll_direct_IO_bounce(). */
 	lcc = ll_cl_find(file);
 	if (lcc == NULL)
 		RETURN(-EIO);
@@ -401,7 +562,16 @@ ll_direct_IO(
 		}
 
 		result = iov_iter_get_pages_alloc(iter, &pages, count, &offs);
-		if (likely(result > 0)) {
+		if (likely(result > 0) &&
+		    unlikely(offs != (file_offset & ~PAGE_MASK))) {
+			int n = DIV_ROUND_UP(result + offs, PAGE_SIZE);
+
+			result = ll_direct_IO_bounce(env, io, iov_iter_rw(iter),
+						     inode, result, file_offset,
+						     pages, offs);
+			ll_free_user_pages(pages, n,
+					   iov_iter_rw(iter) == READ);
+		} else if (likely(result > 0)) {
 			int n = DIV_ROUND_UP(result + offs, PAGE_SIZE);
 
 			result = ll_direct_IO_seg(env, io, iov_iter_rw(iter),
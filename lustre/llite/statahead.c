@@ -155,6 +155,18 @@ static inline int agl_list_empty(struct ll_statahead_info *sai)
 	return list_empty(&sai->sai_agls);
 }
 
+/*
+ * statahead of a closed dir has no dir release to stop it, it stops once the
+ * scanner has not stat'ed anything for LL_SA_DETACHED_TIMEOUT.
+ */
+static inline bool sa_idle(struct ll_statahead_info *sai)
+{
+	return sai->sai_detached &&
+	       cfs_time_before(cfs_time_add(sai->sai_access_time,
+				cfs_time_seconds(LL_SA_DETACHED_TIMEOUT)),
+			       cfs_time_current());
+}
+
 /**
  * (1) hit ratio less than 80%
  * or
@@ -281,6 +293,7 @@ sa_put(struct ll_statahead_info *sai, struct sa_entry *entry)
 {
 	struct sa_entry *tmp, *next;
 
+	sai->sai_access_time = cfs_time_current();
 	if (entry != NULL && entry->se_state == SA_ENTRY_SUCC) {
 		struct ll_sb_info *sbi = ll_i2sbi(sai->sai_dentry->d_inode);
 
@@ -408,6 +421,7 @@ static struct ll_statahead_info *ll_sai_alloc(struct dentry *dentry)
 	atomic_set(&sai->sai_refcount, 1);
 	sai->sai_max = LL_SA_RPC_MIN;
 	sai->sai_index = 1;
+	sai->sai_access_time = cfs_time_current();
 	init_waitqueue_head(&sai->sai_waitq);
 	init_waitqueue_head(&sai->sai_thread.t_ctl_waitq);
 	init_waitqueue_head(&sai->sai_agl_thread.t_ctl_waitq);
@@ -959,6 +973,22 @@ static void ll_start_agl(struct dentry *parent, struct ll_statahead_info *sai)
 	EXIT;
 }
 
+/* called by the statahead thread only */
+static void sa_stop_if_idle(struct ll_statahead_info *sai)
+{
+	struct ll_inode_info *lli = ll_i2info(sai->sai_dentry->d_inode);
+
+	if (!sa_idle(sai))
+		return;
+
+	CDEBUG(D_READA, "walk of closed dir "DFID" idle, stop statahead\n",
+	       PFID(&lli->lli_fid));
+	spin_lock(&lli->lli_sa_lock);
+	if (thread_is_running(&sai->sai_thread))
+		thread_set_flags(&sai->sai_thread, SVC_STOPPING);
+	spin_unlock(&lli->lli_sa_lock);
+}
+
 /* statahead thread main function */
 static int ll_statahead_thread(void *arg)
 {
@@ -973,6 +1003,7 @@ static int ll_statahead_thread(void *arg)
 	struct md_op_data *op_data;
 	struct ll_dir_chain chain;
 	struct l_wait_info lwi = { 0 };
+	struct l_wait_info sa_lwi = { 0 };
 	struct page *page = NULL;
 	__u64 pos = 0;
 	int rc = 0;
@@ -992,6 +1023,11 @@ static int ll_statahead_thread(void *arg)
 
 	op_data->op_max_pages = ll_i2sbi(dir)->ll_md_brw_pages;
 
+	/* wake up now and then to check whether the walk is over */
+	if (sai->sai_detached)
+		sa_lwi = LWI_TIMEOUT(cfs_time_seconds(LL_SA_DETACHED_TIMEOUT),
+				     NULL, NULL);
+
 	if (sbi->ll_flags & LL_SBI_AGL_ENABLED)
 		ll_start_agl(parent, sai);
 
@@ -1082,9 +1118,10 @@ static int ll_statahead_thread(void *arg)
 					     sa_has_callback(sai) ||
 					     !agl_list_empty(sai) ||
 					     !thread_is_running(sa_thread),
-					     &lwi);
+					     &sa_lwi);
 
 				sa_handle_callback(sai);
+				sa_stop_if_idle(sai);
 
 				spin_lock(&lli->lli_agl_lock);
 				while (sa_sent_full(sai) &&
@@ -1135,14 +1172,15 @@ static int ll_statahead_thread(void *arg)
 	}
 
 	/* statahead is finished, but statahead entries need to be cached, wait
-	 * for file release to stop me. */
+	 * for file release, or the walk of a closed dir to stop, to stop me. */
 	while (thread_is_running(sa_thread)) {
 		l_wait_event(sa_thread->t_ctl_waitq,
 			     sa_has_callback(sai) ||
 			     !thread_is_running(sa_thread),
-			     &lwi);
+			     &sa_lwi);
 
 		sa_handle_callback(sai);
+		sa_stop_if_idle(sai);
 	}
 
 	EXIT;
@@ -1178,6 +1216,13 @@ out:
 
 	spin_lock(&lli->lli_sa_lock);
 	thread_set_flags(sa_thread, SVC_STOPPED);
+	/* the walk of the closed dir is over, nobody else will clean up its
+	 * authorization */
+	if (sai->sai_detached && lli->lli_sa_detached) {
+		lli->lli_opendir_pid = 0;
+		lli->lli_sa_enabled = 0;
+		lli->lli_sa_detached = 0;
+	}
 	spin_unlock(&lli->lli_sa_lock);
 
 	CDEBUG(D_READA, "statahead thread stopped: sai %p, parent %.*s\n",
@@ -1200,11 +1245,13 @@ void ll_authorize_statahead(struct inode *dir, void *key)
 		/*
 		 * if lli_sai is not NULL, it means previous statahead is not
 		 * finished yet, we'd better not start a new statahead for now.
+		 * A closed dir whose walk never started is taken over.
 		 */
-		LASSERT(lli->lli_opendir_pid == 0);
+		LASSERT(lli->lli_opendir_pid == 0 || lli->lli_sa_detached);
 		lli->lli_opendir_key = key;
 		lli->lli_opendir_pid = current_pid();
 		lli->lli_sa_enabled = 1;
+		lli->lli_sa_detached = 0;
 	}
 	spin_unlock(&lli->lli_sa_lock);
 }
@@ -1212,6 +1259,12 @@ void ll_authorize_statahead(struct inode *dir, void *key)
 /*
  * deauthorize opened dir handle @key to statahead, and notify statahead thread
  * to quit if it's running.
+ *
+ * Tools like find, du and rsync read a whole directory, close it, and only
+ * then fstatat() the entries they read. If the owner closes the dir before
+ * any stat started statahead, it stays authorized for a walk starting within
+ * LL_SA_DETACHED_TIMEOUT, and the statahead thread stops by itself once the
+ * walk is over.
  */
 void ll_deauthorize_statahead(struct inode *dir, void *key)
 {
@@ -1226,6 +1279,13 @@ void ll_deauthorize_statahead(struct inode *dir, void *key)
 
 	spin_lock(&lli->lli_sa_lock);
 	lli->lli_opendir_key = NULL;
+	if (lli->lli_sai == NULL && lli->lli_sa_enabled &&
+	    lli->lli_opendir_pid == current_pid()) {
+		lli->lli_sa_detached = 1;
+		lli->lli_sa_detach_time = cfs_time_current();
+		spin_unlock(&lli->lli_sa_lock);
+		return;
+	}
 	lli->lli_opendir_pid = 0;
 	lli->lli_sa_enabled = 0;
 	sai = lli->lli_sai;
@@ -1552,18 +1612,22 @@ static int start_statahead_thread(struct inode *dir, struct dentry *dentry)
 
 	/* if current lli_opendir_key was deauthorized, or dir re-opened by
 	 * another process, don't start statahead, otherwise the newly spawned
-	 * statahead thread won't be notified to quit. */
+	 * statahead thread won't be notified to quit. A closed dir has no key,
+	 * the thread stops by itself when the walk is over. */
 	spin_lock(&lli->lli_sa_lock);
 	if (unlikely(lli->lli_sai != NULL ||
-		     lli->lli_opendir_key == NULL ||
+		     (lli->lli_opendir_key == NULL && !lli->lli_sa_detached) ||
 		     lli->lli_opendir_pid != current->pid)) {
 		spin_unlock(&lli->lli_sa_lock);
 		GOTO(out, rc = -EPERM);
 	}
 	lli->lli_sai = sai;
+	sai->sai_detached = lli->lli_sa_detached;
 	spin_unlock(&lli->lli_sa_lock);
 
 	atomic_inc(&ll_i2sbi(parent->d_inode)->ll_sa_running);
+	if (sai->sai_detached)
+		atomic_inc(&ll_i2sbi(parent->d_inode)->ll_sa_detached);
 
 	CDEBUG(D_READA, "start statahead thread: [pid %d] [parent %.*s]\n",
 	       current_pid(), parent->d_name.len, parent->d_name.name);
@@ -1594,6 +1658,12 @@ out:
 	spin_lock(&lli->lli_sa_lock);
 	lli->lli_sa_enabled = 0;
 	lli->lli_sai = NULL;
+	/* and forget a closed dir, nobody will deauthorize it */
+	if (lli->lli_sa_detached && lli->lli_opendir_pid == current->pid) {
+		lli->lli_opendir_pid = 0;
+		lli->lli_sa_enabled = 0;
+		lli->lli_sa_detached = 0;
+	}
 	spin_unlock(&lli->lli_sa_lock);
 
 	if (sai != NULL)
@@ -525,6 +525,10 @@ static int vvp_io_read_lock(const struct lu_env *env,
 	int result;
 
 	ENTRY;
+	/* read-ahead only uses the locks already cached on the client */
+	if (io->ci_async_readahead)
+		RETURN(0);
+
 	result = vvp_io_rw_lock(env, io, CLM_READ, rd->crw_pos,
 				rd->crw_pos + rd->crw_count - 1);
 	RETURN(result);
@@ -730,6 +734,10 @@ static int vvp_io_read_start(const struct lu_env *env,
 	if (!can_populate_pages(env, io, inode))
 		return 0;
 
+	/* pages are queued by the read-ahead thread itself */
+	if (io->ci_async_readahead)
+		return 0;
+
 	result = vvp_prep_size(env, obj, io, pos, tot, &exceed);
 	if (result != 0)
 		return result;
@@ -1400,9 +1408,11 @@ int vvp_io_init(const struct lu_env *env, struct cl_object *obj,
 		 * it'll be fetched by osc when building RPC.
 		 *
 		 * it's not accurate if the file is shared by different
-		 * jobs.
+		 * jobs. Read-ahead threads carry the jobid of the reader
+		 * in cl_io::ci_jobid and leave the inode one alone.
 		 */
-		lustre_get_jobid(lli->lli_jobid);
+		if (!io->ci_async_readahead)
+			lustre_get_jobid(lli->lli_jobid);
 	} else if (io->ci_type == CIT_SETATTR) {
 		if (!cl_io_is_trunc(io))
 			io->ci_lockreq = CILR_MANDATORY;
@@ -207,7 +207,9 @@ static void vvp_req_attr_set(const struct lu_env *env, struct cl_object *obj,
 	obdo_set_parent_fid(oa, &ll_i2info(inode)->lli_fid);
 	if (OBD_FAIL_CHECK(OBD_FAIL_LFSCK_INVALID_PFID))
 		oa->o_parent_oid++;
-	memcpy(attr->cra_jobid, ll_i2info(inode)->lli_jobid, LUSTRE_JOBID_SIZE);
+	if (attr->cra_jobid[0] == '\0')
+		memcpy(attr->cra_jobid, ll_i2info(inode)->lli_jobid,
+		       LUSTRE_JOBID_SIZE);
 }
 
 static const struct cl_object_operations vvp_ops = {
@@ -110,6 +110,7 @@ static void lov_io_sub_inherit(struct cl_io *io, struct lov_io *lio,
 		io->u.ci_fsync.fi_end = end;
 		io->u.ci_fsync.fi_fid = parent->u.ci_fsync.fi_fid;
 		io->u.ci_fsync.fi_mode = parent->u.ci_fsync.fi_mode;
+		io->u.ci_fsync.fi_anchor = parent->u.ci_fsync.fi_anchor;
 		break;
 	}
 	case CIT_READ:
@@ -430,8 +431,10 @@ static int lov_io_rw_iter_init(const struct lu_env *env,
         LASSERT(io->ci_type == CIT_READ || io->ci_type == CIT_WRITE);
         ENTRY;
 
-        /* fast path for common case. */
-        if (lio->lis_nr_subios != 1 && !cl_io_is_append(io)) {
+	/* fast path for common case. Parallel direct I/O is not cut at
+	 * stripe boundaries, it needs all its stripes at once. */
+	if (lio->lis_nr_subios != 1 && !cl_io_is_append(io) &&
+	    !io->ci_parallel_dio) {
 
 		lov_do_div64(start, ssize);
 		next = (start + 1) * ssize;
@@ -609,6 +612,9 @@ static int lov_io_read_ahead(const struct lu_env *env,
 	if (r0->lo_nr == 1) /* single stripe file */
 		RETURN(0);
 
+	ra->cra_stripe_pages = loo->lo_lsm->lsm_stripe_size >> PAGE_SHIFT;
+	ra->cra_stripe_count = r0->lo_nr;
+
 	/* cra_end is stripe level, convert it into file level */
 	ra_end = ra->cra_end;
 	if (ra_end != CL_PAGE_EOF)
@@ -230,11 +230,16 @@ static int lov_lock_enqueue(const struct lu_env *env,
 {
 	struct cl_lock          *lock   = slice->cls_lock;
 	struct lov_lock         *lovlck = cl2lov_lock(slice);
+	bool			speculative;
+	int			nr_sent = 0;
+	int			nr_same = 0;
+	int			err = 0;
 	int                     i;
 	int                     rc      = 0;
 
 	ENTRY;
 
+	speculative = lock->cll_descr.cld_enq_flags & CEF_SPECULATIVE;
 	for (i = 0; i < lovlck->lls_nr; ++i) {
 		struct lov_lock_sub     *lls = &lovlck->lls_sub[i];
 		struct lov_sublock_env  *subenv;
@@ -247,11 +252,27 @@ static int lov_lock_enqueue(const struct lu_env *env,
 
 		rc = cl_lock_enqueue(subenv->lse_env, subenv->lse_io,
 				     &lls->sub_lock, anchor);
+		if (rc != 0 && speculative) {
+			/* a lock ahead only gives up the stripes that are
+			 * already covered by a lock or failed to enqueue */
+			if (rc == -ECANCELED)
+				nr_same++;
+			else if (err == 0)
+				err = rc;
+			rc = 0;
+			continue;
+		}
 		if (rc != 0)
 			break;
 
 		lls->sub_is_enqueued = 1;
+		nr_sent++;
 	}
+
+	/* -ECANCELED only if every stripe is covered already */
+	if (rc == 0 && speculative && nr_sent == 0)
+		rc = err != 0 ? err : nr_same > 0 ? -ECANCELED : 0;
+
 	RETURN(rc);
 }
 
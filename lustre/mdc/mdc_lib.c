@@ -145,7 +145,7 @@ void mdc_file_secctx_pack(struct ptlrpc_request *req, const char *secctx_name,
 }
 
 void mdc_readdir_pack(struct ptlrpc_request *req, __u64 pgoff, size_t size,
-		      const struct lu_fid *fid)
+		      const struct lu_fid *fid, __u32 attrs)
 {
         struct mdt_body *b = req_capsule_client_get(&req->rq_pill,
                                                     &RMF_MDT_BODY);
@@ -154,7 +154,7 @@ void mdc_readdir_pack(struct ptlrpc_request *req, __u64 pgoff, size_t size,
 	b->mbo_size = pgoff;		       /* !! */
 	b->mbo_nlink = size;			/* !! */
 	__mdc_pack_body(b, -1);
-	b->mbo_mode = LUDA_FID | LUDA_TYPE;
+	b->mbo_mode = LUDA_FID | LUDA_TYPE | attrs;
 }
 
 /* packing of MDS records */
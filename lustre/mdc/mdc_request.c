@@ -866,12 +866,44 @@ out:
 	RETURN(rc < 0 ? rc : saved_rc);
 }
 
+/* lock handles sent with a readdir-plus MDS_READPAGE, for the entries */
+#define MDC_READDIR_PLUS_LOCKS_PER_PAGE	32
+#define MDC_READDIR_PLUS_LOCKS_MAX	256
+
+static void mdc_readdir_plus_drop(struct obd_export *exp,
+				  struct ldlm_enqueue_info *einfo,
+				  struct lustre_handle *lockh, int nlocks)
+{
+	int i;
+
+	for (i = 0; i < nlocks; i++) {
+		if (!lustre_handle_is_used(&lockh[i]))
+			continue;
+		ldlm_cli_lock_fini(exp, &lockh[i], einfo->ei_mode, NULL, NULL,
+				   NULL);
+		lockh[i].cookie = 0;
+	}
+}
+
+/**
+ * Read directory pages from the MDT.
+ *
+ * If \a nlocks is not 0, the attributes of the entries are asked for
+ * (readdir-plus) and \a nlocks client locks are created with \a einfo for
+ * the MDT to grant on them. They are sent again with each resend. On
+ * success the caller has to finish them with ldlm_cli_lock_fini(), on
+ * failure they are dropped already.
+ */
 static int mdc_getpage(struct obd_export *exp, const struct lu_fid *fid,
 		       u64 offset, struct page **pages, int npages,
+		       struct ldlm_enqueue_info *einfo,
+		       struct lustre_handle *lockh, int nlocks,
 		       struct ptlrpc_request **request)
 {
 	struct ptlrpc_request   *req;
 	struct ptlrpc_bulk_desc *desc;
+	struct ldlm_request	*dlm;
+	struct ldlm_res_id	 res_id;
 	int                      i;
 	wait_queue_head_t        waitq;
 	int                      resends = 0;
@@ -881,12 +913,17 @@ static int mdc_getpage(struct obd_export *exp, const struct lu_fid *fid,
 
 	*request = NULL;
 	init_waitqueue_head(&waitq);
+	fid_build_reg_res_name(fid, &res_id);
 
 restart_bulk:
 	req = ptlrpc_request_alloc(class_exp2cliimp(exp), &RQF_MDS_READPAGE);
 	if (req == NULL)
 		RETURN(-ENOMEM);
 
+	req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_CLIENT,
+			     nlocks == 0 ? 0 : sizeof(struct ldlm_request) +
+			     (nlocks - LDLM_LOCKREQ_HANDLES) *
+			     sizeof(struct lustre_handle));
 	rc = ptlrpc_request_pack(req, LUSTRE_MDS_VERSION, MDS_READPAGE);
 	if (rc) {
 		ptlrpc_request_free(req);
@@ -910,12 +947,28 @@ restart_bulk:
 		desc->bd_frag_ops->add_kiov_frag(desc, pages[i], 0,
 						 PAGE_SIZE);
 
-	mdc_readdir_pack(req, offset, PAGE_SIZE * npages, fid);
+	mdc_readdir_pack(req, offset, PAGE_SIZE * npages, fid,
+			 nlocks == 0 ? 0 : LUDA_ATTRS);
+
+	/* the locks are created on the directory, the reply moves each
+	 * granted one to its entry */
+	if (nlocks != 0) {
+		rc = ldlm_cli_lock_prep(exp, einfo, &res_id, lockh, nlocks);
+		if (rc) {
+			ptlrpc_request_free(req);
+			RETURN(rc);
+		}
+
+		dlm = req_capsule_client_get(&req->rq_pill, &RMF_DLM_REQ);
+		dlm->lock_count = nlocks;
+		memcpy(dlm->lock_handle, lockh, nlocks * sizeof(*lockh));
+	}
 
 	ptlrpc_request_set_replen(req);
 	rc = ptlrpc_queue_wait(req);
 	if (rc) {
 		ptlrpc_req_finished(req);
+		mdc_readdir_plus_drop(exp, einfo, lockh, nlocks);
 		if (rc != -ETIMEDOUT)
 			RETURN(rc);
 
@@ -936,6 +989,7 @@ restart_bulk:
 					  req->rq_bulk->bd_nob_transferred);
 	if (rc < 0) {
 		ptlrpc_req_finished(req);
+		mdc_readdir_plus_drop(exp, einfo, lockh, nlocks);
 		RETURN(rc);
 	}
 
@@ -944,6 +998,7 @@ restart_bulk:
 		       exp->exp_obd->obd_name, req->rq_bulk->bd_nob_transferred,
 		       PAGE_SIZE * npages);
 		ptlrpc_req_finished(req);
+		mdc_readdir_plus_drop(exp, einfo, lockh, nlocks);
 		RETURN(-EPROTO);
 	}
 
@@ -951,6 +1006,71 @@ restart_bulk:
 	RETURN(0);
 }
 
+/**
+ * Finish the locks the MDT granted on the entries of a readdir-plus reply.
+ *
+ * Each entry with LUDA_ATTRS names the client lock it was granted and the
+ * server handle of it. The lock is granted locally on the entry, and the
+ * server handle in the page is replaced with the client one for llite to
+ * find the lock. Entries whose lock can't be set up lose LUDA_ATTRS, the
+ * unused locks are dropped.
+ */
+static void mdc_readdir_plus_fini(struct obd_export *exp,
+				  struct ldlm_enqueue_info *einfo,
+				  struct lustre_handle *lockh, int nlocks,
+				  struct page **pages, int npages)
+{
+	union ldlm_policy_data policy = {
+		.l_inodebits = { MDS_INODELOCK_LOOKUP | MDS_INODELOCK_UPDATE }
+	};
+	struct lustre_handle	remote;
+	struct ldlm_res_id	res_id;
+	struct lu_dirpage	*dp;
+	struct lu_dirent	*ent;
+	struct luda_attrs	*lda;
+	struct lu_fid		fid;
+	__u32			attrs;
+	__u32			idx;
+	int			i;
+
+	for (i = 0; i < npages; i++) {
+		dp = kmap(pages[i]);
+		for (ent = lu_dirent_start(dp); ent != NULL;
+		     ent = lu_dirent_next(ent)) {
+			attrs = le32_to_cpu(ent->lde_attrs);
+			if (!(attrs & LUDA_ATTRS))
+				continue;
+
+			lda = (void *)ent +
+			      lu_dirent_calc_size(le16_to_cpu(ent->lde_namelen),
+						  attrs & ~LUDA_ATTRS);
+			idx = le32_to_cpu(lda->lda_lock_idx);
+			remote.cookie = le64_to_cpu(lda->lda_lock);
+			fid_le_to_cpu(&fid, &ent->lde_fid);
+			if (!(attrs & LUDA_FID) || idx >= nlocks ||
+			    !lustre_handle_is_used(&lockh[idx]) ||
+			    !lustre_handle_is_used(&remote)) {
+				ent->lde_attrs = cpu_to_le32(attrs &
+							     ~LUDA_ATTRS);
+				continue;
+			}
+
+			fid_build_reg_res_name(&fid, &res_id);
+			if (ldlm_cli_lock_fini(exp, &lockh[idx],
+					       einfo->ei_mode, &remote,
+					       &res_id, &policy) == 0)
+				lda->lda_lock = cpu_to_le64(lockh[idx].cookie);
+			else
+				ent->lde_attrs = cpu_to_le32(attrs &
+							     ~LUDA_ATTRS);
+			lockh[idx].cookie = 0;
+		}
+		kunmap(pages[i]);
+	}
+
+	mdc_readdir_plus_drop(exp, einfo, lockh, nlocks);
+}
+
 static void mdc_release_page(struct page *page, int remove)
 {
 	if (remove) {
@@ -1179,6 +1299,14 @@ static int mdc_read_page_remote(void *data, struct page *page0)
 	int			max_pages = op_data->op_max_pages;
 	struct inode		*inode;
 	struct lu_fid		*fid;
+	struct ldlm_enqueue_info einfo = {
+		.ei_type	= LDLM_IBITS,
+		.ei_mode	= LCK_PR,
+		.ei_cb_bl	= rp->rp_cb->md_blocking_ast,
+		.ei_cb_cp	= ldlm_completion_ast,
+	};
+	struct lustre_handle	*lockh = NULL;
+	int			nlocks = 0;
 	int			i;
 	int			rc;
 	ENTRY;
@@ -1203,7 +1331,19 @@ static int mdc_read_page_remote(void *data, struct page *page0)
 		page_pool[npages] = page;
 	}
 
-	rc = mdc_getpage(rp->rp_exp, fid, rp->rp_off, page_pool, npages, &req);
+	/* ask for the attributes of the entries (readdir-plus), with a lock
+	 * for each of them */
+	if (op_data->op_cli_flags & CLI_READDIR_PLUS &&
+	    exp_connect_flags2(rp->rp_exp) & OBD_CONNECT2_READDIR_PLUS) {
+		nlocks = min(npages * MDC_READDIR_PLUS_LOCKS_PER_PAGE,
+			     MDC_READDIR_PLUS_LOCKS_MAX);
+		OBD_ALLOC(lockh, sizeof(*lockh) * nlocks);
+		if (lockh == NULL)
+			nlocks = 0;
+	}
+
+	rc = mdc_getpage(rp->rp_exp, fid, rp->rp_off, page_pool, npages,
+			 &einfo, lockh, nlocks, &req);
 	if (rc < 0) {
 		/* page0 is special, which was added into page cache early */
 		delete_from_page_cache(page0);
@@ -1220,10 +1360,17 @@ static int mdc_read_page_remote(void *data, struct page *page0)
 
 		mdc_adjust_dirpages(page_pool, rd_pgs, lu_pgs);
 
+		if (nlocks != 0)
+			mdc_readdir_plus_fini(rp->rp_exp, &einfo, lockh,
+					      nlocks, page_pool, rd_pgs);
+
 		SetPageUptodate(page0);
 	}
 	unlock_page(page0);
 
+	if (lockh != NULL)
+		OBD_FREE(lockh, sizeof(*lockh) * nlocks);
+
 	ptlrpc_req_finished(req);
 	CDEBUG(D_CACHE, "read %d/%d pages\n", rd_pgs, npages);
 	for (i = 1; i < npages; i++) {
@@ -1345,6 +1492,7 @@ static int mdc_read_page(struct obd_export *exp, struct md_op_data *op_data,
 
 	rp_param.rp_exp = exp;
 	rp_param.rp_mod = op_data;
+	rp_param.rp_cb = cb_op;
 	page = read_cache_page(mapping,
 			       hash_x_index(rp_param.rp_off,
 					    rp_param.rp_hash64),
@@ -45,6 +45,7 @@
 #include <lprocfs_status.h>
 /* fid_be_cpu(), fid_cpu_to_be(). */
 #include <lustre_fid.h>
+#include <lustre_fld.h>
 #include <lustre_idmap.h>
 #include <lustre_param.h>
 #include <lustre_mds.h>
@@ -1895,6 +1896,115 @@ static int mdd_readpage_sanity_check(const struct lu_env *env,
         RETURN(rc);
 }
 
+/**
+ * Check whether \a fid is located on this MDT, using the local FLD cache
+ * only so that readdir never blocks on a remote lookup.
+ */
+static bool mdd_fid_is_local(const struct lu_env *env, struct mdd_device *mdd,
+			     const struct lu_fid *fid)
+{
+	struct seq_server_site	*ss = mdd_seq_site(mdd);
+	struct lu_seq_range	 range = { 0 };
+
+	if (!fid_seq_in_fldb(fid_seq(fid)))
+		return true;
+
+	if (ss->ss_server_fld == NULL)
+		return false;
+
+	fld_range_set_mdt(&range);
+	if (fld_local_lookup(env, ss->ss_server_fld, fid_seq(fid), &range))
+		return false;
+
+	return range.lsr_index == ss->ss_node_id;
+}
+
+/* readdir-plus arguments of mdd_dir_page_build() */
+struct mdd_rdpg_plus {
+	struct mdd_device	*mrp_mdd;
+	const struct lu_rdpg	*mrp_rdpg;
+};
+
+/**
+ * Append struct luda_attrs to the entry packed by the OSD for readdir-plus.
+ *
+ * The caller has reserved room for the attributes. They are only read once
+ * the caller was granted a lock on the target through rdpg->rp_lock, so the
+ * client learns of any later change. Entries whose target is remote, cannot
+ * be found or locked at once are left as they are, the client falls back to
+ * a normal getattr for them.
+ */
+static void mdd_dirent_attrs_fill(const struct lu_env *env,
+				  struct mdd_rdpg_plus *mrp,
+				  struct lu_dirent *ent)
+{
+	struct mdd_device	*mdd = mrp->mrp_mdd;
+	const struct lu_rdpg	*rdpg = mrp->mrp_rdpg;
+	struct lu_attr		*la = MDD_ENV_VAR(env, tattr);
+	struct lu_fid		*fid = &mdd_env_info(env)->mti_fid2;
+	struct mdd_object	*child;
+	struct luda_attrs	*lda;
+	__u32			 attrs = le32_to_cpu(ent->lde_attrs);
+	__u16			 namelen = le16_to_cpu(ent->lde_namelen);
+	__u64			 valid;
+	int			 rc;
+
+	if (!(attrs & LUDA_FID))
+		return;
+
+	fid_le_to_cpu(fid, &ent->lde_fid);
+	if (!fid_is_sane(fid) || fid_is_dot_lustre(fid) ||
+	    !mdd_fid_is_local(env, mdd, fid))
+		return;
+
+	child = mdd_object_find(env, mdd, fid);
+	if (IS_ERR(child))
+		return;
+
+	if (!mdd_object_exists(child) || mdd_object_remote(child))
+		GOTO(out, rc = 0);
+
+	lda = (void *)ent + lu_dirent_calc_size(namelen, attrs);
+	memset(lda, 0, sizeof(*lda));
+
+	rc = rdpg->rp_lock(env, rdpg->rp_lock_data, fid, lda);
+	if (rc != 0)
+		GOTO(out, rc);
+
+	rc = mdd_la_get(env, child, la);
+	if (rc != 0) {
+		/* the client would never adopt the lock */
+		rdpg->rp_unlock(env, rdpg->rp_lock_data, lda);
+		memset(lda, 0, sizeof(*lda));
+		GOTO(out, rc);
+	}
+
+	valid = OBD_MD_FLMODE | OBD_MD_FLTYPE | OBD_MD_FLUID | OBD_MD_FLGID |
+		OBD_MD_FLNLINK | OBD_MD_FLMTIME | OBD_MD_FLATIME |
+		OBD_MD_FLCTIME | OBD_MD_FLFLAGS;
+	/* size of a regular file is only known by the OSTs */
+	if (!S_ISREG(la->la_mode)) {
+		valid |= OBD_MD_FLSIZE | OBD_MD_FLBLOCKS;
+		lda->lda_size = cpu_to_le64(la->la_size);
+		lda->lda_blocks = cpu_to_le64(la->la_blocks);
+	}
+	lda->lda_valid = cpu_to_le64(valid);
+	lda->lda_mtime = cpu_to_le64(la->la_mtime);
+	lda->lda_atime = cpu_to_le64(la->la_atime);
+	lda->lda_ctime = cpu_to_le64(la->la_ctime);
+	lda->lda_mode = cpu_to_le32(la->la_mode);
+	lda->lda_uid = cpu_to_le32(la->la_uid);
+	lda->lda_gid = cpu_to_le32(la->la_gid);
+	lda->lda_nlink = cpu_to_le32(la->la_nlink);
+	lda->lda_flags = cpu_to_le32(la->la_flags);
+
+	attrs |= LUDA_ATTRS;
+	ent->lde_attrs = cpu_to_le32(attrs);
+	ent->lde_reclen = cpu_to_le16(lu_dirent_calc_size(namelen, attrs));
+out:
+	mdd_object_put(env, child);
+}
+
 static int mdd_dir_page_build(const struct lu_env *env, union lu_page *lp,
 			      size_t nob, const struct dt_it_ops *iops,
 			      struct dt_it *it, __u32 attr, void *arg)
@@ -1932,8 +2042,10 @@ static int mdd_dir_page_build(const struct lu_env *env, union lu_page *lp,
                         dp->ldp_hash_start = cpu_to_le64(hash);
                 }
 
-                /* calculate max space required for lu_dirent */
-                recsize = lu_dirent_calc_size(len, attr);
+		/* calculate max space required for lu_dirent, the attributes
+		 * for readdir-plus are appended after the OSD packed it */
+		recsize = lu_dirent_calc_size(len, arg != NULL ?
+					      attr | LUDA_ATTRS : attr);
 
                 if (nob >= recsize) {
                         result = iops->rec(env, it, (struct dt_rec *)ent, attr);
@@ -1951,6 +2063,11 @@ static int mdd_dir_page_build(const struct lu_env *env, union lu_page *lp,
 				if (fid_is_dot_lustre(&fid))
 					goto next;
 			}
+
+			if (arg != NULL) {
+				mdd_dirent_attrs_fill(env, arg, ent);
+				recsize = le16_to_cpu(ent->lde_reclen);
+			}
                 } else {
                         result = (last != NULL) ? 0 :-EINVAL;
                         goto out;
@@ -1984,6 +2101,9 @@ int mdd_readpage(const struct lu_env *env, struct md_object *obj,
                  const struct lu_rdpg *rdpg)
 {
         struct mdd_object *mdd_obj = md2mdd_obj(obj);
+	struct mdd_rdpg_plus mrp;
+	struct lu_rdpg	   rdpg_osd;
+	void		  *arg = NULL;
         int rc;
         ENTRY;
 
@@ -2023,8 +2143,25 @@ int mdd_readpage(const struct lu_env *env, struct md_object *obj,
                 GOTO(out_unlock, rc = LU_PAGE_SIZE);
         }
 
-	rc = dt_index_walk(env, mdd_object_child(mdd_obj), rdpg,
-			   mdd_dir_page_build, NULL);
+	/* LUDA_ATTRS is filled by MDD, the OSD only packs name, fid and type.
+	 * Attributes of the entries are only returned to a caller who may
+	 * look the names up anyway, and who can be given locks on them. */
+	rdpg_osd = *rdpg;
+	if (rdpg->rp_attrs & LUDA_ATTRS) {
+		struct lu_attr *la = MDD_ENV_VAR(env, cattr);
+
+		rdpg_osd.rp_attrs &= ~LUDA_ATTRS;
+		rc = mdd_la_get(env, mdd_obj, la);
+		if (rc == 0 && rdpg->rp_lock != NULL &&
+		    mdd_permission_internal(env, mdd_obj, la, MAY_EXEC) == 0) {
+			mrp.mrp_mdd = mdo2mdd(obj);
+			mrp.mrp_rdpg = rdpg;
+			arg = &mrp;
+		}
+	}
+
+	rc = dt_index_walk(env, mdd_object_child(mdd_obj), &rdpg_osd,
+			   mdd_dir_page_build, arg);
 	if (rc >= 0) {
 		struct lu_dirpage	*dp;
 
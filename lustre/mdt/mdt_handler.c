@@ -1746,6 +1746,122 @@ static int mdt_set_info(struct tgt_session_info *tsi)
 	RETURN(rc);
 }
 
+/**
+ * Grant the client a PR LOOKUP|UPDATE lock on the target of a readdir-plus
+ * entry, to the next lock handle it sent with the request.
+ *
+ * The lock is not waited for, an entry whose target is locked by someone
+ * else is returned without attributes. Once granted, the lock is handed
+ * over to the client, which learns of any later change through its
+ * blocking AST.
+ */
+static int mdt_readpage_lock(const struct lu_env *env, void *data,
+			     const struct lu_fid *fid, struct luda_attrs *lda)
+{
+	struct mdt_thread_info	*info = data;
+	union ldlm_policy_data	*policy = &info->mti_policy;
+	struct ldlm_res_id	*res_id = &info->mti_res_id;
+	struct lustre_handle	 lh = { 0 };
+	__u32			 idx = info->mti_u.rdpg.mti_lock_next;
+	int			 rc;
+	ENTRY;
+
+	if (idx >= info->mti_u.rdpg.mti_lock_count)
+		RETURN(-ENOSPC);
+
+	memset(policy, 0, sizeof(*policy));
+	policy->l_inodebits.bits = MDS_INODELOCK_LOOKUP | MDS_INODELOCK_UPDATE;
+	fid_build_reg_res_name(fid, res_id);
+	rc = mdt_fid_lock(info->mti_mdt->mdt_namespace, &lh, LCK_PR, policy,
+			  res_id, LDLM_FL_ATOMIC_CB | LDLM_FL_BLOCK_NOWAIT,
+			  &info->mti_exp->exp_handle.h_cookie);
+	if (rc != 0) {
+		if (lustre_handle_is_used(&lh))
+			mdt_fid_unlock(&lh, LCK_PR);
+		RETURN(rc);
+	}
+
+	rc = ldlm_lock_handover(&lh, LCK_PR, info->mti_exp,
+			&info->mti_u.rdpg.mti_lock_req->lock_handle[idx]);
+	if (rc != 0)
+		RETURN(rc);
+
+	info->mti_u.rdpg.mti_lock_next++;
+	lda->lda_lock_idx = cpu_to_le32(idx);
+	lda->lda_lock = cpu_to_le64(lh.cookie);
+
+	RETURN(0);
+}
+
+/**
+ * Cancel the lock mdt_readpage_lock() just handed over for an entry which
+ * is returned without attributes after all, the client never learns of it.
+ * Its lock handle is left for the next entry.
+ */
+static void mdt_readpage_unlock(const struct lu_env *env, void *data,
+				struct luda_attrs *lda)
+{
+	struct mdt_thread_info	*info = data;
+	struct lustre_handle	 lh = { .cookie = le64_to_cpu(lda->lda_lock) };
+	struct ldlm_lock	*lock;
+
+	LASSERT(info->mti_u.rdpg.mti_lock_next ==
+		le32_to_cpu(lda->lda_lock_idx) + 1);
+
+	lock = ldlm_handle2lock(&lh);
+	if (lock != NULL) {
+		ldlm_lock_cancel(lock);
+		LDLM_LOCK_PUT(lock);
+	}
+	info->mti_u.rdpg.mti_lock_next--;
+}
+
+/**
+ * Set up readdir-plus for the current MDS_READPAGE: the entries get
+ * attributes only with a lock, for which the client sent the handles.
+ *
+ * \retval true if the attributes can be returned
+ */
+static bool mdt_readpage_plus_init(struct mdt_thread_info *info,
+				   struct tgt_session_info *tsi,
+				   struct lu_rdpg *rdpg)
+{
+	struct req_capsule	*pill = tsi->tsi_pill;
+	const struct ldlm_request *dlm_req;
+	__u32			 size;
+	__u32			 count;
+
+	/* locks granted to a first attempt of the request are unknown to
+	 * the client, they are cancelled when they conflict */
+	if (lustre_msg_get_flags(mdt_info_req(info)->rq_reqmsg) & MSG_RESENT)
+		return false;
+
+	if (!req_capsule_field_present(pill, &RMF_DLM_REQ, RCL_CLIENT))
+		return false;
+
+	size = req_capsule_get_size(pill, &RMF_DLM_REQ, RCL_CLIENT);
+	if (size < sizeof(*dlm_req))
+		return false;
+
+	dlm_req = req_capsule_client_get(pill, &RMF_DLM_REQ);
+	if (dlm_req == NULL)
+		return false;
+
+	count = (size - offsetof(struct ldlm_request, lock_handle)) /
+		sizeof(struct lustre_handle);
+	info->mti_u.rdpg.mti_lock_req = dlm_req;
+	info->mti_u.rdpg.mti_lock_count = min(dlm_req->lock_count, count);
+	info->mti_u.rdpg.mti_lock_next = 0;
+	if (info->mti_u.rdpg.mti_lock_count == 0)
+		return false;
+
+	rdpg->rp_lock = mdt_readpage_lock;
+	rdpg->rp_unlock = mdt_readpage_unlock;
+	rdpg->rp_lock_data = info;
+
+	return true;
+}
+
 static int mdt_readpage(struct tgt_session_info *tsi)
 {
 	struct mdt_thread_info	*info = mdt_th_info(tsi->tsi_env);
@@ -1753,6 +1869,7 @@ static int mdt_readpage(struct tgt_session_info *tsi)
 	struct lu_rdpg		*rdpg = &info->mti_u.rdpg.mti_rdpg;
 	const struct mdt_body	*reqbody = tsi->tsi_mdt_body;
 	struct mdt_body		*repbody;
+	bool			 ucred = false;
 	int			 rc;
 	int			 i;
 
@@ -1794,6 +1911,25 @@ static int mdt_readpage(struct tgt_session_info *tsi)
                         GOTO(free_rdpg, rc = -ENOMEM);
         }
 
+	/* Attributes of the entries (readdir-plus) are only returned to the
+	 * clients which negotiated it, with a lock on each entry, and only if
+	 * the caller may search the directory, so set up its credentials for
+	 * MDD to check. */
+	rdpg->rp_lock = NULL;
+	rdpg->rp_unlock = NULL;
+	rdpg->rp_lock_data = NULL;
+	if (rdpg->rp_attrs & LUDA_ATTRS) {
+		rdpg->rp_attrs &= ~LUDA_ATTRS;
+		if (exp_connect_flags2(tsi->tsi_exp) &
+		    OBD_CONNECT2_READDIR_PLUS) {
+			info = tsi2mdt_info(tsi);
+			ucred = true;
+			if (mdt_init_ucred(info, (struct mdt_body *)reqbody) == 0 &&
+			    mdt_readpage_plus_init(info, tsi, rdpg))
+				rdpg->rp_attrs |= LUDA_ATTRS;
+		}
+	}
+
         /* call lower layers to fill allocated pages with directory data */
 	rc = mo_readpage(tsi->tsi_env, mdt_object_child(object), rdpg);
 	if (rc < 0)
@@ -1804,6 +1940,10 @@ static int mdt_readpage(struct tgt_session_info *tsi)
 
 	EXIT;
 free_rdpg:
+	if (ucred) {
+		mdt_exit_ucred(info);
+		mdt_thread_info_fini(info);
+	}
 
 	for (i = 0; i < rdpg->rp_npages; i++)
 		if (rdpg->rp_pages[i] != NULL)
@@ -406,6 +406,11 @@ struct mdt_thread_info {
                         struct lu_rdpg     mti_rdpg;
                         /* for mdt_sendpage()      */
                         struct l_wait_info mti_wait_info;
+			/* readdir-plus: client lock handles of the request
+			 * and how many were granted, see mdt_readpage_lock() */
+			const struct ldlm_request *mti_lock_req;
+			__u32		   mti_lock_count;
+			__u32		   mti_lock_next;
                 } rdpg;
 		struct {
 			struct md_attr attr;
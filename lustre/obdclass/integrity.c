@@ -0,0 +1,174 @@
+/*
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA
+ *
+ * GPL HEADER END
+ */
+/*
+ * T10 protection information guard tags of bulk data, for the
+ * OBD_CKSUM_T10* checksum types.
+ */
+
+#define DEBUG_SUBSYSTEM S_CLASS
+
+#include <linux/highmem.h>
+#if defined(CONFIG_CRC_T10DIF) || defined(CONFIG_CRC_T10DIF_MODULE)
+#include <linux/crc-t10dif.h>
+#endif
+#include <net/checksum.h>
+#include <obd_class.h>
+#include <obd_cksum.h>
+
+/* same as the guard of the T10-DIF-TYPE*-IP integrity profiles */
+__u16 obd_dif_ip_fn(void *data, unsigned int length)
+{
+	return ip_compute_csum(data, length);
+}
+EXPORT_SYMBOL(obd_dif_ip_fn);
+
+#if defined(CONFIG_CRC_T10DIF) || defined(CONFIG_CRC_T10DIF_MODULE)
+/* same as the guard of the T10-DIF-TYPE*-CRC integrity profiles */
+__u16 obd_dif_crc_fn(void *data, unsigned int length)
+{
+	return cpu_to_be16(crc_t10dif(data, length));
+}
+EXPORT_SYMBOL(obd_dif_crc_fn);
+#endif
+
+/**
+ * Compute the guard tags of the sectors of a page fragment.
+ *
+ * The fragment is cut in OBD_DIF_SECTOR_SIZE sectors from \a offset, the
+ * last one may be shorter.
+ *
+ * \param[in] obd_name		device name for error messages
+ * \param[in] page		page holding the fragment
+ * \param[in] offset		offset of the fragment in \a page
+ * \param[in] length		length of the fragment
+ * \param[out] guard_start	where to store the guard tags
+ * \param[in] guard_number	room in \a guard_start
+ * \param[out] used_number	number of guard tags stored
+ * \param[in] fn		guard function
+ *
+ * \retval		0 on success
+ * \retval		-E2BIG if \a guard_start is too small
+ */
+int obd_page_dif_generate_buffer(const char *obd_name, struct page *page,
+				 __u32 offset, __u32 length,
+				 __u16 *guard_start, int guard_number,
+				 int *used_number, obd_dif_csum_fn *fn)
+{
+	unsigned char *data_buf;
+	unsigned int data_size;
+	unsigned int i;
+	int used = 0;
+
+	data_buf = kmap(page) + offset;
+	for (i = 0; i < length; i += OBD_DIF_SECTOR_SIZE) {
+		if (used >= guard_number) {
+			kunmap(page);
+			CERROR("%s: no room for the guard tags of %u bytes at "
+			       "offset %u, %d tags: rc = %d\n", obd_name,
+			       length, offset, guard_number, -E2BIG);
+			return -E2BIG;
+		}
+
+		data_size = min_t(unsigned int, length - i,
+				  OBD_DIF_SECTOR_SIZE);
+		guard_start[used++] = fn(data_buf, data_size);
+		data_buf += data_size;
+	}
+	kunmap(page);
+
+	*used_number = used;
+	return 0;
+}
+EXPORT_SYMBOL(obd_page_dif_generate_buffer);
+
+/**
+ * Compute the checksum of a bulk for a T10 checksum type.
+ *
+ * The checksum is the adler32 of the guard tags of all the fragments, in
+ * order.  \a frag_guards stores the guard tags of one fragment, either by
+ * computing them with obd_page_dif_generate_buffer() or by taking those the
+ * disk returned with the data.
+ *
+ * \param[in] cksum_type	OBD_CKSUM_T10* type
+ * \param[in] data		opaque fragment vector passed to \a frag_guards
+ * \param[in] count		number of fragments in \a data
+ * \param[in] frag_guards	stores the guard tags of a fragment
+ * \param[out] cksum		checksum of the bulk
+ *
+ * \retval		0 on success
+ * \retval		negative errno on failure
+ */
+int obd_t10_cksum_bulk(cksum_type_t cksum_type, void *data, int count,
+		       obd_t10_frag_guards_t frag_guards, u32 *cksum)
+{
+	struct cfs_crypto_hash_desc *hdesc;
+	int guard_number = PAGE_SIZE / sizeof(__u16);
+	unsigned int bufsize = sizeof(*cksum);
+	int used_number;
+	__u16 *guards;
+	int used = 0;
+	int rc = 0;
+	int i;
+
+	LASSERT(cksum_type & OBD_CKSUM_T10_ALL);
+
+	guards = (__u16 *)__get_free_page(GFP_NOFS);
+	if (guards == NULL)
+		return -ENOMEM;
+
+	hdesc = cfs_crypto_hash_init(cksum_obd2cfs(cksum_type), NULL, 0);
+	if (IS_ERR(hdesc)) {
+		rc = PTR_ERR(hdesc);
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		/* a fragment is at most one page of sectors */
+		if (guard_number - used < PAGE_SIZE / OBD_DIF_SECTOR_SIZE) {
+			rc = cfs_crypto_hash_update(hdesc, guards,
+						    used * sizeof(*guards));
+			if (rc != 0)
+				break;
+			used = 0;
+		}
+
+		rc = frag_guards(data, i, guards + used, guard_number - used,
+				 &used_number);
+		if (rc != 0)
+			break;
+		used += used_number;
+	}
+
+	if (rc == 0 && used > 0)
+		rc = cfs_crypto_hash_update(hdesc, guards,
+					    used * sizeof(*guards));
+	if (rc == 0)
+		rc = cfs_crypto_hash_final(hdesc, (unsigned char *)cksum,
+					   &bufsize);
+	else
+		cfs_crypto_hash_final(hdesc, NULL, NULL);
+out:
+	free_page((unsigned long)guards);
+	return rc;
+}
+EXPORT_SYMBOL(obd_t10_cksum_bulk);
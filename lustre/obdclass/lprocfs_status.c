@@ -759,6 +759,11 @@ static const char *obd_connect_names[] = {
 	"second_flags",
 	/* flags2 names */
 	"file_secctx",
+	"readdir_plus",
+	"multiobj_brw",
+	"lockahead",
+	"bl_ast_batch",
+	"lock_convert",
 	NULL
 };
 
@@ -1963,6 +1963,8 @@ static int ofd_sync_hdl(struct tgt_session_info *tsi)
 			RETURN(PTR_ERR(fo));
 	}
 
+	OBD_FAIL_TIMEOUT(OBD_FAIL_OST_PAUSE_SYNC, cfs_fail_val);
+
 	rc = tgt_sync(tsi->tsi_env, tsi->tsi_tgt,
 		      fo != NULL ? ofd_object_child(fo) : NULL,
 		      repbody->oa.o_size, repbody->oa.o_blocks);
@@ -3021,6 +3023,7 @@ static int ofd_init0(const struct lu_env *env, struct ofd_device *m,
 		      OBD_FAIL_OST_ALL_REPLY_NET);
 	if (rc)
 		GOTO(err_free_ns, rc);
+	m->ofd_lut.lut_dt_t10_type = m->ofd_dt_conf.ddp_t10_cksum_type;
 
 	rc = ofd_fs_setup(env, m, obd);
 	if (rc)
@@ -41,6 +41,7 @@
 #define DEBUG_SUBSYSTEM S_FILTER
 
 #include <linux/kthread.h>
+#include <obd_cksum.h>
 #include "ofd_internal.h"
 
 struct ofd_inconsistency_item {
@@ -437,6 +438,27 @@ int ofd_verify_ff(const struct lu_env *env, struct ofd_object *fo,
  * \retval		0 on successful prepare
  * \retval		negative value on error
  */
+/**
+ * Whether the disk stores the guard tags of the checksum of a read.
+ *
+ * With a T10 checksum type matching the integrity profile of the disk, the
+ * guard tags read with the data make up the checksum of the reply, so that
+ * the data does not need to be hashed on the OST.
+ *
+ * \param[in] ofd	OFD device
+ * \param[in] oa	obdo of the read
+ *
+ * \retval		true if the OSD should return the guard tags
+ */
+static bool ofd_read_disk_guards(struct ofd_device *ofd, struct obdo *oa)
+{
+	cksum_type_t type = ofd->ofd_dt_conf.ddp_t10_cksum_type;
+
+	return type != 0 && (oa->o_valid & OBD_MD_FLCKSUM) &&
+	       (oa->o_valid & OBD_MD_FLFLAGS) &&
+	       cksum_type_unpack(oa->o_flags) == type;
+}
+
 static int ofd_preprw_read(const struct lu_env *env, struct obd_export *exp,
 			   struct ofd_device *ofd, const struct lu_fid *fid,
 			   struct lu_attr *la, struct obdo *oa, int niocount,
@@ -483,6 +505,10 @@ static int ofd_preprw_read(const struct lu_env *env, struct obd_export *exp,
 	if (unlikely(rc))
 		GOTO(buf_put, rc);
 
+	if (ofd_read_disk_guards(ofd, oa))
+		for (i = 0; i < *nr_local; i++)
+			lnb[i].lnb_guard_disk = 1;
+
 	rc = dt_read_prep(env, ofd_object_child(fo), lnb, *nr_local);
 	if (unlikely(rc))
 		GOTO(buf_put, rc);
@@ -120,6 +120,7 @@ static ssize_t osc_max_rpcs_in_flight_seq_write(struct file *file,
 
 	spin_lock(&cli->cl_loi_list_lock);
 	cli->cl_max_rpcs_in_flight = val;
+	cli->cl_rpc_adapt.cra_rif_base = val;
 	client_adjust_max_dirty(cli);
 	spin_unlock(&cli->cl_loi_list_lock);
 
@@ -176,7 +177,9 @@ static int osc_cached_mb_seq_show(struct seq_file *m, void *v)
 {
 	struct obd_device *dev = m->private;
 	struct client_obd *cli = &dev->u.cli;
+	struct cl_lru_cpt *clc;
 	int shift = 20 - PAGE_SHIFT;
+	int i;
 
 	seq_printf(m, "used_mb: %ld\n"
 		   "busy_cnt: %ld\n"
@@ -186,6 +189,12 @@ static int osc_cached_mb_seq_show(struct seq_file *m, void *v)
 		    atomic_long_read(&cli->cl_lru_busy),
 		   cli->cl_lru_reclaim);
 
+	/* LRU pages of each CPT partition */
+	seq_printf(m, "lru_cpt_pages:");
+	cfs_percpt_for_each(clc, i, cli->cl_lru_cpts)
+		seq_printf(m, " %ld", clc->clc_in_list);
+	seq_printf(m, "\n");
+
 	return 0;
 }
 
@@ -413,7 +422,7 @@ static ssize_t osc_checksum_type_seq_write(struct file *file,
 	struct obd_device *obd = ((struct seq_file *)file->private_data)->private;
 	int i;
 	DECLARE_CKSUM_NAME;
-	char kernbuf[10];
+	char kernbuf[16];
 
         if (obd == NULL)
                 return 0;
@@ -468,6 +477,106 @@ static ssize_t osc_resend_count_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(osc_resend_count);
 
+static int osc_short_io_bytes_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *obd = m->private;
+
+	seq_printf(m, "%u\n", obd->u.cli.cl_short_io_bytes);
+	return 0;
+}
+
+static ssize_t osc_short_io_bytes_seq_write(struct file *file,
+					    const char __user *buffer,
+					    size_t count, loff_t *off)
+{
+	struct obd_device *obd = ((struct seq_file *)file->private_data)->private;
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_with_units_to_s64(buffer, count, &val, '1');
+	if (rc)
+		return rc;
+
+	if (val < 0 || val > OBD_MAX_SHORT_IO_BYTES)
+		return -ERANGE;
+
+	obd->u.cli.cl_short_io_bytes = val;
+
+	return count;
+}
+LPROC_SEQ_FOPS(osc_short_io_bytes);
+
+static int osc_adaptive_rpcs_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *obd = m->private;
+
+	seq_printf(m, "%u\n", obd->u.cli.cl_rpc_adapt.cra_enabled);
+	return 0;
+}
+
+static ssize_t osc_adaptive_rpcs_seq_write(struct file *file,
+					   const char __user *buffer,
+					   size_t count, loff_t *off)
+{
+	struct obd_device *obd = ((struct seq_file *)file->private_data)->private;
+	struct client_obd *cli = &obd->u.cli;
+	struct client_rpc_adapt *cra = &cli->cl_rpc_adapt;
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+	if (val < 0 || val > 1)
+		return -ERANGE;
+
+	spin_lock(&cli->cl_loi_list_lock);
+	if (val && !cra->cra_enabled) {
+		/* the current settings are the ones to come back to */
+		memset(cra, 0, sizeof(*cra));
+		cra->cra_rif_base = cli->cl_max_rpcs_in_flight;
+		cra->cra_pages_base = cli->cl_max_pages_per_rpc;
+		cra->cra_enabled = 1;
+	} else if (!val && cra->cra_enabled) {
+		cra->cra_enabled = 0;
+		cli->cl_max_rpcs_in_flight = cra->cra_rif_base;
+		cli->cl_max_pages_per_rpc = cra->cra_pages_base;
+		client_adjust_max_dirty(cli);
+	}
+	spin_unlock(&cli->cl_loi_list_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(osc_adaptive_rpcs);
+
+static int osc_write_coalesce_us_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *obd = m->private;
+
+	seq_printf(m, "%u\n", obd->u.cli.cl_write_coalesce_us);
+	return 0;
+}
+
+static ssize_t osc_write_coalesce_us_seq_write(struct file *file,
+					       const char __user *buffer,
+					       size_t count, loff_t *off)
+{
+	struct obd_device *obd = ((struct seq_file *)file->private_data)->private;
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+	/* the window bounds the latency added to small writes */
+	if (val < 0 || val > OSC_WRITE_COALESCE_MAX_US)
+		return -ERANGE;
+
+	obd->u.cli.cl_write_coalesce_us = val;
+	return count;
+}
+LPROC_SEQ_FOPS(osc_write_coalesce_us);
+
 static int osc_contention_seconds_seq_show(struct seq_file *m, void *v)
 {
 	struct obd_device *obd = m->private;
@@ -574,6 +683,7 @@ static ssize_t osc_obd_max_pages_per_rpc_seq_write(struct file *file,
 	}
 	spin_lock(&cli->cl_loi_list_lock);
 	cli->cl_max_pages_per_rpc = val;
+	cli->cl_rpc_adapt.cra_pages_base = val;
 	client_adjust_max_dirty(cli);
 	spin_unlock(&cli->cl_loi_list_lock);
 
@@ -669,6 +779,12 @@ struct lprocfs_vars lprocfs_osc_obd_vars[] = {
 	  .fops	=	&osc_checksum_type_fops		},
 	{ .name	=	"resend_count",
 	  .fops	=	&osc_resend_count_fops		},
+	{ .name	=	"short_io_bytes",
+	  .fops	=	&osc_short_io_bytes_fops	},
+	{ .name	=	"adaptive_rpcs",
+	  .fops	=	&osc_adaptive_rpcs_fops		},
+	{ .name	=	"write_coalesce_us",
+	  .fops	=	&osc_write_coalesce_us_fops	},
 	{ .name	=	"timeouts",
 	  .fops	=	&osc_timeouts_fops		},
 	{ .name	=	"contention_seconds",
@@ -821,6 +937,10 @@ static int osc_stats_seq_show(struct seq_file *seq, void *v)
 		   stats->os_lockless_reads);
 	seq_printf(seq, "lockless_truncate\t\t%llu\n",
 		   stats->os_lockless_truncates);
+	seq_printf(seq, "short_io_write_bytes\t\t%llu\n",
+		   stats->os_short_io_writes);
+	seq_printf(seq, "short_io_read_bytes\t\t%llu\n",
+		   stats->os_short_io_reads);
 	return 0;
 }
 
@@ -55,6 +55,7 @@ static int osc_io_unplug_async(const struct lu_env *env,
 			       struct client_obd *cli, struct osc_object *osc);
 static void osc_free_grant(struct client_obd *cli, unsigned int nr_pages,
 			   unsigned int lost_grant, unsigned int dirty_grant);
+static int __osc_list_maint(struct client_obd *cli, struct osc_object *osc);
 
 static void osc_extent_tree_dump0(int level, struct osc_object *obj,
 				  const char *func, int line);
@@ -542,6 +543,11 @@ static int osc_extent_merge(const struct lu_env *env, struct osc_extent *cur,
 	/* only the following bits are needed to merge */
 	cur->oe_urgent   |= victim->oe_urgent;
 	cur->oe_memalloc |= victim->oe_memalloc;
+	/* the oldest data of both bounds the coalescing window */
+	if (victim->oe_coalesce_end != 0 &&
+	    (cur->oe_coalesce_end == 0 ||
+	     cfs_time_before(victim->oe_coalesce_end, cur->oe_coalesce_end)))
+		cur->oe_coalesce_end = victim->oe_coalesce_end;
 	list_splice_init(&victim->oe_pages, &cur->oe_pages);
 	list_del_init(&victim->oe_link);
 	victim->oe_nr_pages = 0;
@@ -554,6 +560,159 @@ static int osc_extent_merge(const struct lu_env *env, struct osc_extent *cur,
 	return 0;
 }
 
+/**
+ * Whether the write coalescing window holds \a ext back from write RPCs.
+ *
+ * With osc.*.write_coalesce_us set, a partial extent is not put in an RPC
+ * built for other extents for a short while after its pages were first
+ * cached, so that the small writes of concurrent appenders are merged into
+ * it and go in full RPCs, the way Nagle's algorithm packs small TCP
+ * segments.  Extents somebody is waiting for are never held, and held ones
+ * are sent once their window expired, see osc_makes_rpc().
+ */
+static bool osc_extent_coalescing(struct client_obd *cli,
+				  struct osc_extent *ext)
+{
+	if (ext->oe_coalesce_end == 0)
+		return false;
+
+	if (ext->oe_urgent || ext->oe_hp || ext->oe_fsync_wait ||
+	    ext->oe_memalloc || ext->oe_nr_pages >= ext->oe_mppr)
+		return false;
+
+	/* memory pressure and eviction win over coalescing */
+	if (!list_empty(&cli->cl_cache_waiters) ||
+	    cli->cl_import == NULL || cli->cl_import->imp_invalid)
+		return false;
+
+	return cfs_time_before(cfs_time_current(), ext->oe_coalesce_end);
+}
+
+/* arm the window timer of \a cli unless it fires before \a end already */
+static void osc_coalesce_timer_arm(struct client_obd *cli, cfs_time_t end)
+{
+	spin_lock(&cli->cl_loi_list_lock);
+	if (!cfs_timer_is_armed(&cli->cl_write_coalesce_timer) ||
+	    cfs_time_before(end,
+			    cfs_timer_deadline(&cli->cl_write_coalesce_timer)))
+		cfs_timer_arm(&cli->cl_write_coalesce_timer, end);
+	spin_unlock(&cli->cl_loi_list_lock);
+}
+
+/**
+ * Open the coalescing window of \a ext, which was just cached.
+ *
+ * \return the end of the window, 0 if the extent isn't held
+ */
+static cfs_time_t osc_extent_coalesce_start(struct client_obd *cli,
+					    struct osc_extent *ext)
+{
+	struct osc_object *obj = ext->oe_obj;
+	__u32 window = cli->cl_write_coalesce_us;
+
+	LASSERT(osc_object_is_locked(obj));
+	LASSERT(ext->oe_state == OES_CACHE);
+
+	if (window == 0 || ext->oe_urgent || ext->oe_nr_pages >= ext->oe_mppr)
+		return 0;
+
+	if (ext->oe_coalesce_end == 0)
+		ext->oe_coalesce_end = cfs_time_add(cfs_time_current(),
+					max_t(long, usecs_to_jiffies(window), 1));
+
+	if (obj->oo_coalesce_end == 0 ||
+	    cfs_time_before(ext->oe_coalesce_end, obj->oo_coalesce_end))
+		obj->oo_coalesce_end = ext->oe_coalesce_end;
+
+	return ext->oe_coalesce_end;
+}
+
+/**
+ * Recompute osc_object::oo_coalesce_end after an RPC was built from the
+ * extents of \a obj.  Cached extents whose window expired but didn't fit
+ * in the RPC keep it in the past, so that the next RPC takes them.
+ */
+static void osc_coalesce_update(struct osc_object *obj)
+{
+	struct osc_extent *ext;
+	cfs_time_t end = 0;
+
+	LASSERT(osc_object_is_locked(obj));
+
+	if (obj->oo_coalesce_end == 0)
+		return;
+
+	for (ext = first_extent(obj); ext != NULL; ext = next_extent(ext)) {
+		if (ext->oe_state != OES_CACHE || ext->oe_coalesce_end == 0)
+			continue;
+		if (end == 0 || cfs_time_before(ext->oe_coalesce_end, end))
+			end = ext->oe_coalesce_end;
+	}
+	obj->oo_coalesce_end = end;
+}
+
+/**
+ * Timer callback of the write coalescing window, runs in softirq context
+ * where ptlrpcd work can't be queued.
+ */
+static void osc_coalesce_timer_cb(unsigned long data)
+{
+	struct client_obd *cli = (struct client_obd *)data;
+
+	schedule_work(&cli->cl_write_coalesce_work);
+}
+
+/**
+ * Put the objects whose coalescing window expired on the ready list and
+ * unplug them, then rearm the timer for the next window to expire.
+ */
+static void osc_coalesce_work(struct work_struct *work)
+{
+	struct client_obd *cli = container_of(work, struct client_obd,
+					      cl_write_coalesce_work);
+	struct osc_object *osc;
+	struct osc_object *tmp;
+	cfs_time_t now = cfs_time_current();
+	cfs_time_t next = 0;
+
+	spin_lock(&cli->cl_loi_list_lock);
+	list_for_each_entry_safe(osc, tmp, &cli->cl_loi_write_list,
+				 oo_write_item) {
+		cfs_time_t end = osc->oo_coalesce_end;
+
+		if (end == 0)
+			continue;
+		if (cfs_time_before(now, end)) {
+			if (next == 0 || cfs_time_before(end, next))
+				next = end;
+			continue;
+		}
+		__osc_list_maint(cli, osc);
+	}
+	if (next != 0)
+		cfs_timer_arm(&cli->cl_write_coalesce_timer, next);
+	spin_unlock(&cli->cl_loi_list_lock);
+
+	if (cli->cl_writeback_work != NULL)
+		ptlrpcd_queue_work(cli->cl_writeback_work);
+}
+
+void osc_coalesce_init(struct client_obd *cli)
+{
+	cfs_timer_init(&cli->cl_write_coalesce_timer, osc_coalesce_timer_cb,
+		       cli);
+	INIT_WORK(&cli->cl_write_coalesce_work, osc_coalesce_work);
+}
+
+void osc_coalesce_fini(struct client_obd *cli)
+{
+	cli->cl_write_coalesce_us = 0;
+	del_timer_sync(&cli->cl_write_coalesce_timer);
+	cancel_work_sync(&cli->cl_write_coalesce_work);
+	/* the work may have rearmed the timer */
+	del_timer_sync(&cli->cl_write_coalesce_timer);
+}
+
 /**
  * Drop user count of osc_extent, and unplug IO asynchronously.
  */
@@ -561,6 +720,7 @@ int osc_extent_release(const struct lu_env *env, struct osc_extent *ext)
 {
 	struct osc_object *obj = ext->oe_obj;
 	struct client_obd *cli = osc_cli(obj);
+	cfs_time_t coalesce_end = 0;
 	int rc = 0;
 	ENTRY;
 
@@ -598,9 +758,12 @@ int osc_extent_release(const struct lu_env *env, struct osc_extent *ext)
 				list_move_tail(&ext->oe_link,
 					       &obj->oo_full_exts);
 			}
+			coalesce_end = osc_extent_coalesce_start(cli, ext);
 		}
 		osc_object_unlock(obj);
 
+		if (coalesce_end != 0)
+			osc_coalesce_timer_arm(cli, coalesce_end);
 		osc_io_unplug_async(env, cli, obj);
 	}
 	osc_extent_put(env, ext);
@@ -1701,7 +1864,14 @@ wakeup:
 static int osc_max_rpc_in_flight(struct client_obd *cli, struct osc_object *osc)
 {
 	int hprpc = !!list_empty(&osc->oo_hp_exts);
-	return rpcs_in_flight(cli) >= cli->cl_max_rpcs_in_flight + hprpc;
+
+	if (rpcs_in_flight(cli) >= cli->cl_max_rpcs_in_flight + hprpc) {
+		/* tell the adaptive RPC controller RPCs are held back */
+		cli->cl_rpc_adapt.cra_win[0].craw_limited = 1;
+		cli->cl_rpc_adapt.cra_win[1].craw_limited = 1;
+		return 1;
+	}
+	return 0;
 }
 
 /* This maintains the lists of pending pages to read/write for a given object
@@ -1746,6 +1916,12 @@ static int osc_makes_rpc(struct client_obd *cli, struct osc_object *osc,
 			CDEBUG(D_CACHE, "full extent ready, make an RPC\n");
 			RETURN(1);
 		}
+		if (osc->oo_coalesce_end != 0 &&
+		    cfs_time_aftereq(cfs_time_current(), osc->oo_coalesce_end)) {
+			CDEBUG(D_CACHE, "coalescing window expired, make an "
+			       "RPC\n");
+			RETURN(1);
+		}
 	} else {
 		if (atomic_read(&osc->oo_nr_reads) == 0)
 			RETURN(0);
@@ -2019,38 +2195,31 @@ static inline unsigned osc_max_write_chunks(const struct client_obd *cli)
  * 6. Above steps exit if there is no space in this RPC.
  */
 static unsigned int get_write_extents(struct osc_object *obj,
-				      struct list_head *rpclist)
+				      struct extent_rpc_data *data)
 {
 	struct client_obd *cli = osc_cli(obj);
 	struct osc_extent *ext;
-	struct extent_rpc_data data = {
-		.erd_rpc_list	= rpclist,
-		.erd_page_count	= 0,
-		.erd_max_pages	= cli->cl_max_pages_per_rpc,
-		.erd_max_chunks	= osc_max_write_chunks(cli),
-		.erd_max_extents = 256,
-	};
 
 	LASSERT(osc_object_is_locked(obj));
 	while (!list_empty(&obj->oo_hp_exts)) {
 		ext = list_entry(obj->oo_hp_exts.next, struct osc_extent,
 				 oe_link);
 		LASSERT(ext->oe_state == OES_CACHE);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
-		EASSERT(ext->oe_nr_pages <= data.erd_max_pages, ext);
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
+		EASSERT(ext->oe_nr_pages <= data->erd_max_pages, ext);
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	while (!list_empty(&obj->oo_urgent_exts)) {
 		ext = list_entry(obj->oo_urgent_exts.next,
 				 struct osc_extent, oe_link);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	/* One key difference between full extents and other extents: full
 	 * extents can usually only be added if the rpclist was empty, so if we
@@ -2060,27 +2229,107 @@ static unsigned int get_write_extents(struct osc_object *obj,
 	while (!list_empty(&obj->oo_full_exts)) {
 		ext = list_entry(obj->oo_full_exts.next,
 				 struct osc_extent, oe_link);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
+		if (!try_to_add_extent_for_io(cli, ext, data))
 			break;
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	ext = first_extent(obj);
 	while (ext != NULL) {
 		if ((ext->oe_state != OES_CACHE) ||
 		    /* this extent may be already in current rpclist */
-		    (!list_empty(&ext->oe_link) && ext->oe_owner != NULL)) {
+		    (!list_empty(&ext->oe_link) && ext->oe_owner != NULL) ||
+		    /* leave room for more writes to come */
+		    osc_extent_coalescing(cli, ext)) {
 			ext = next_extent(ext);
 			continue;
 		}
 
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
 
 		ext = next_extent(ext);
 	}
-	return data.erd_page_count;
+	return data->erd_page_count;
+}
+
+/**
+ * Fill the rest of a write RPC with the extents of other objects which are
+ * ready for I/O, so that the dirty pages of many small files on one OST go
+ * in a single BRW instead of one RPC per file.
+ *
+ * Called without any object lock held, as the object locks are taken one by
+ * one here.
+ *
+ * \return the number of pages added to the RPC
+ */
+static unsigned int get_write_extents_objs(const struct lu_env *env,
+					   struct client_obd *cli,
+					   struct osc_object *osc,
+					   struct extent_rpc_data *data)
+{
+	struct osc_object *objs[OBD_MAX_BRW_OBJS - 1];
+	struct osc_object *obj;
+	struct osc_extent *ext;
+	unsigned int page_count = 0;
+	int nr = 0;
+	int i;
+	ENTRY;
+
+	if (cli->cl_import == NULL || cli->cl_import->imp_invalid ||
+	    !imp_connect_multiobj_brw(cli->cl_import))
+		RETURN(0);
+
+	if (data->erd_page_count >= data->erd_max_pages)
+		RETURN(0);
+
+	spin_lock(&cli->cl_loi_list_lock);
+	list_for_each_entry(obj, &cli->cl_loi_ready_list, oo_ready_item) {
+		if (obj == osc)
+			continue;
+		cl_object_get(osc2cl(obj));
+		objs[nr++] = obj;
+		if (nr == ARRAY_SIZE(objs))
+			break;
+	}
+	spin_unlock(&cli->cl_loi_list_lock);
+
+	for (i = 0; i < nr; i++) {
+		struct list_head *tail = data->erd_rpc_list->prev;
+		unsigned int count = data->erd_page_count;
+
+		obj = objs[i];
+		osc_object_lock(obj);
+		if (data->erd_page_count < data->erd_max_pages &&
+		    osc_makes_rpc(cli, obj, OBD_BRW_WRITE))
+			count = get_write_extents(obj, data) - count;
+		else
+			count = 0;
+
+		if (count > 0) {
+			osc_update_pending(obj, OBD_BRW_WRITE, -count);
+			page_count += count;
+
+			ext = list_entry(tail, struct osc_extent, oe_link);
+			list_for_each_entry_continue(ext, data->erd_rpc_list,
+						     oe_link) {
+				LASSERT(ext->oe_state == OES_CACHE ||
+					ext->oe_state == OES_LOCK_DONE);
+				if (ext->oe_state == OES_CACHE)
+					osc_extent_state_set(ext, OES_LOCKING);
+				else
+					osc_extent_state_set(ext, OES_RPC);
+			}
+			osc_coalesce_update(obj);
+		}
+		osc_object_unlock(obj);
+
+		osc_list_maint(cli, obj);
+		cl_object_put(env, osc2cl(obj));
+	}
+
+	RETURN(page_count);
 }
 
 static int
@@ -2092,6 +2341,13 @@ __must_hold(osc)
 	struct osc_extent *ext;
 	struct osc_extent *tmp;
 	struct osc_extent *first = NULL;
+	struct extent_rpc_data data = {
+		.erd_rpc_list	= &rpclist,
+		.erd_page_count	= 0,
+		.erd_max_pages	= cli->cl_max_pages_per_rpc,
+		.erd_max_chunks	= osc_max_write_chunks(cli),
+		.erd_max_extents = 256,
+	};
 	unsigned int page_count = 0;
 	int srvlock = 0;
 	int rc = 0;
@@ -2099,11 +2355,13 @@ __must_hold(osc)
 
 	LASSERT(osc_object_is_locked(osc));
 
-	page_count = get_write_extents(osc, &rpclist);
+	page_count = get_write_extents(osc, &data);
 	LASSERT(equi(page_count == 0, list_empty(&rpclist)));
 
-	if (list_empty(&rpclist))
+	if (list_empty(&rpclist)) {
+		osc_coalesce_update(osc);
 		RETURN(0);
+	}
 
 	osc_update_pending(osc, OBD_BRW_WRITE, -page_count);
 
@@ -2115,11 +2373,17 @@ __must_hold(osc)
 		else
 			osc_extent_state_set(ext, OES_RPC);
 	}
+	osc_coalesce_update(osc);
 
 	/* we're going to grab page lock, so release object lock because
 	 * lock order is page lock -> object lock. */
 	osc_object_unlock(osc);
 
+	/* lockless I/O is never mixed with other objects */
+	ext = list_entry(rpclist.next, struct osc_extent, oe_link);
+	if (!ext->oe_srvlock)
+		page_count += get_write_extents_objs(env, cli, osc, &data);
+
 	list_for_each_entry_safe(ext, tmp, &rpclist, oe_link) {
 		if (ext->oe_state == OES_LOCKING) {
 			rc = osc_extent_make_ready(env, ext);
@@ -2717,8 +2981,9 @@ int osc_cancel_async_page(const struct lu_env *env, struct osc_page *ops)
 	RETURN(rc);
 }
 
-int osc_queue_sync_pages(const struct lu_env *env, struct osc_object *obj,
-			 struct list_head *list, int cmd, int brw_flags)
+int osc_queue_sync_pages(const struct lu_env *env, struct cl_io *io,
+			 struct osc_object *obj, struct list_head *list,
+			 int cmd, int brw_flags)
 {
 	struct client_obd     *cli = osc_cli(obj);
 	struct osc_extent     *ext;
@@ -2766,6 +3031,8 @@ int osc_queue_sync_pages(const struct lu_env *env, struct osc_object *obj,
 	ext->oe_srvlock = !!(brw_flags & OBD_BRW_SRVLOCK);
 	ext->oe_nr_pages = page_count;
 	ext->oe_mppr = mppr;
+	if (io->ci_jobid != NULL)
+		memcpy(ext->oe_jobid, io->ci_jobid, LUSTRE_JOBID_SIZE);
 	list_splice_init(list, &ext->oe_pages);
 
 	osc_object_lock(obj);
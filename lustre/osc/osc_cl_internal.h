@@ -145,6 +145,9 @@ struct osc_object {
 	struct list_head	oo_hp_exts;	/* list of hp extents */
 	struct list_head	oo_urgent_exts;	/* list of writeback extents */
 	struct list_head	oo_full_exts;
+	/** earliest end of the write coalescing window of the extents held
+	 * in cache, 0 if none.  Protected by oo_lock. */
+	cfs_time_t		oo_coalesce_end;
 
 	struct list_head	oo_reading_exts;
 
@@ -317,7 +320,12 @@ struct osc_lock {
         /**
          * For async glimpse lock.
          */
-                                 ols_agl:1;
+                                 ols_agl:1,
+	/**
+	 * speculative lock (lock ahead), enqueued asynchronously with no
+	 * cl_io waiting for it and left in the LRU once granted.
+	 */
+				 ols_speculative:1;
 };
 
 
@@ -353,6 +361,10 @@ struct osc_page {
 	 * Set if the page must be transferred with OBD_BRW_SRVLOCK.
 	 */
 			      ops_srvlock:1;
+	/**
+	 * CPT of the LRU list this page is on, see client_obd::cl_lru_cpts.
+	 */
+	int			ops_lru_cpt;
 	/**
 	 * lru page list. See osc_lru_{del|use}() in osc_page.c for usage.
 	 */
@@ -391,6 +403,7 @@ void osc_index2policy(union ldlm_policy_data *policy,
 int  osc_lvb_print(const struct lu_env *env, void *cookie,
 		   lu_printer_t p, const struct ost_lvb *lvb);
 
+void osc_lru_cpts_init(struct client_obd *cli);
 void osc_lru_add_batch(struct client_obd *cli, struct list_head *list);
 void osc_page_submit(const struct lu_env *env, struct osc_page *opg,
 		     enum cl_req_type crt, int brw_flags);
@@ -407,8 +420,9 @@ int osc_teardown_async_page(const struct lu_env *env, struct osc_object *obj,
 			    struct osc_page *ops);
 int osc_flush_async_page(const struct lu_env *env, struct cl_io *io,
 			 struct osc_page *ops);
-int osc_queue_sync_pages(const struct lu_env *env, struct osc_object *obj,
-			 struct list_head *list, int cmd, int brw_flags);
+int osc_queue_sync_pages(const struct lu_env *env, struct cl_io *io,
+			 struct osc_object *obj, struct list_head *list,
+			 int cmd, int brw_flags);
 int osc_cache_truncate_start(const struct lu_env *env, struct osc_object *obj,
 			     __u64 size, struct osc_extent **extp);
 void osc_cache_truncate_end(const struct lu_env *env, struct osc_extent *ext);
@@ -418,6 +432,8 @@ int osc_cache_wait_range(const struct lu_env *env, struct osc_object *obj,
 			 pgoff_t start, pgoff_t end);
 void osc_io_unplug(const struct lu_env *env, struct client_obd *cli,
 		   struct osc_object *osc);
+void osc_coalesce_init(struct client_obd *cli);
+void osc_coalesce_fini(struct client_obd *cli);
 int lru_queue_work(const struct lu_env *env, void *data);
 
 void osc_object_set_contended  (struct osc_object *obj);
@@ -656,6 +672,12 @@ struct osc_extent {
 	int			oe_rc;
 	/** max pages per rpc when this extent was created */
 	unsigned int		oe_mppr;
+	/** end of the write coalescing window of this extent, 0 if it was
+	 * never held, see osc_extent_coalescing() */
+	cfs_time_t		oe_coalesce_end;
+	/** jobid of the io which queued this sync extent, if it is not the
+	 * one of the inode, see cl_io::ci_jobid */
+	char			oe_jobid[LUSTRE_JOBID_SIZE];
 };
 
 int osc_extent_finish(const struct lu_env *env, struct osc_extent *ext,
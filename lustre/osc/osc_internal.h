@@ -35,6 +35,9 @@
 
 #define OAP_MAGIC 8675309
 
+/* upper limit of osc.*.write_coalesce_us */
+#define OSC_WRITE_COALESCE_MAX_US	1000000
+
 extern atomic_t osc_pool_req_count;
 extern unsigned int osc_reqpool_maxreqcount;
 extern struct ptlrpc_request_pool *osc_rq_pool;
@@ -183,6 +186,8 @@ struct osc_device {
                 uint64_t     os_lockless_writes;          /* by bytes */
                 uint64_t     os_lockless_reads;           /* by bytes */
                 uint64_t     os_lockless_truncates;       /* by times */
+		uint64_t     os_short_io_writes;	  /* by bytes */
+		uint64_t     os_short_io_reads;		  /* by bytes */
         } od_stats;
 
         /* configuration item(s) */
@@ -200,15 +200,16 @@ static int osc_io_submit(const struct lu_env *env,
 
 		if (++queued == max_pages) {
 			queued = 0;
-			result = osc_queue_sync_pages(env, osc, &list, cmd,
-						      brw_flags);
+			result = osc_queue_sync_pages(env, io, osc, &list,
+						      cmd, brw_flags);
 			if (result < 0)
 				break;
 		}
 	}
 
 	if (queued > 0)
-		result = osc_queue_sync_pages(env, osc, &list, cmd, brw_flags);
+		result = osc_queue_sync_pages(env, io, osc, &list, cmd,
+					      brw_flags);
 
 	/* Update c/mtime for sync write. LU-7310 */
 	if (qout->pl_nr > 0 && result == 0) {
@@ -758,6 +759,14 @@ static int osc_io_write_start(const struct lu_env *env,
 	RETURN(rc);
 }
 
+static int osc_fsync_upcall(void *a, int rc)
+{
+	struct cl_sync_io *anchor = a;
+
+	cl_sync_io_note(NULL, anchor, rc);
+	return 0;
+}
+
 static int osc_fsync_ost(const struct lu_env *env, struct osc_object *obj,
 			 struct cl_fsync_io *fio)
 {
@@ -779,6 +788,17 @@ static int osc_fsync_ost(const struct lu_env *env, struct osc_object *obj,
 
 	obdo_set_parent_fid(oa, fio->fi_fid);
 
+	if (fio->fi_anchor != NULL) {
+		/* the caller holds a reference on the anchor until it waits,
+		 * so it can't complete under us */
+		atomic_inc(&fio->fi_anchor->csi_sync_nr);
+		rc = osc_sync_base(obj, oa, osc_fsync_upcall, fio->fi_anchor,
+				   PTLRPCD_SET);
+		if (rc < 0)
+			cl_sync_io_note(env, fio->fi_anchor, rc);
+		RETURN(rc);
+	}
+
 	init_completion(&cbargs->opc_sync);
 
 	rc = osc_sync_base(obj, oa, osc_async_upcall, cbargs, PTLRPCD_SET);
@@ -806,14 +826,14 @@ static int osc_io_fsync_start(const struct lu_env *env,
 		fio->fi_nr_written += result;
 		result = 0;
 	}
-	if (fio->fi_mode == CL_FSYNC_ALL) {
+	if (fio->fi_mode == CL_FSYNC_ALL && fio->fi_anchor == NULL) {
 		int rc;
 
 		/* we have to wait for writeback to finish before we can
 		 * send OST_SYNC RPC. This is bad because it causes extents
-		 * to be written osc by osc. However, we usually start
-		 * writeback before CL_FSYNC_ALL so this won't have any real
-		 * problem. */
+		 * to be written osc by osc. With an anchor this is left to
+		 * osc_io_fsync_end(), after writeback was started on all
+		 * stripes. */
 		rc = osc_cache_wait_range(env, osc, start, end);
 		if (result == 0)
 			result = rc;
@@ -836,6 +856,16 @@ static void osc_io_fsync_end(const struct lu_env *env,
 
 	if (fio->fi_mode == CL_FSYNC_LOCAL) {
 		result = osc_cache_wait_range(env, cl2osc(obj), start, end);
+	} else if (fio->fi_mode == CL_FSYNC_ALL && fio->fi_anchor != NULL) {
+		int rc;
+
+		/* Writeback of all the stripes is in flight by now, send the
+		 * OST_SYNC of this one as soon as its pages are written and
+		 * let the caller wait for all of them together. */
+		result = osc_cache_wait_range(env, cl2osc(obj), start, end);
+		rc = osc_fsync_ost(env, cl2osc(obj), fio);
+		if (result == 0)
+			result = rc;
 	} else if (fio->fi_mode == CL_FSYNC_ALL) {
 		struct osc_io           *oio    = cl2osc_io(env, slice);
 		struct osc_async_cbargs *cbargs = &oio->oi_cbarg;
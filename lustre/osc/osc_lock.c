@@ -171,6 +171,10 @@ static __u64 osc_enq2ldlm_flags(__u32 enqflags)
 		result |= LDLM_FL_TEST_LOCK;
 	if (enqflags & CEF_LOCK_MATCH)
 		result |= LDLM_FL_MATCH_LOCK;
+	if (enqflags & CEF_LOCK_NO_EXPAND)
+		result |= LDLM_FL_NO_EXPANSION;
+	if (enqflags & CEF_SPECULATIVE)
+		result |= LDLM_FL_SPECULATIVE;
 	return result;
 }
 
@@ -374,7 +378,7 @@ static int osc_lock_upcall_agl(void *cookie, struct lustre_handle *lockh,
 	lock_res_and_lock(dlmlock);
 	LASSERT(dlmlock->l_granted_mode == dlmlock->l_req_mode);
 
-	/* there is no osc_lock associated with AGL lock */
+	/* there is no osc_lock associated with AGL or lock ahead locks */
 	osc_lock_lvb_update(env, osc, dlmlock, NULL);
 
 	unlock_res_and_lock(dlmlock);
@@ -952,6 +956,18 @@ static int osc_lock_enqueue(const struct lu_env *env,
 		GOTO(enqueue_base, 0);
 	}
 
+	if (oscl->ols_speculative) {
+		/* an old server would expand the lock and revoke the
+		 * conflicting ones instead of refusing it */
+		if (!(exp_connect_flags2(osc_export(osc)) &
+		      OBD_CONNECT2_LOCKAHEAD))
+			GOTO(out, result = -EOPNOTSUPP);
+
+		LASSERT(anchor == NULL);
+		async = true;
+		GOTO(enqueue_base, 0);
+	}
+
 	result = osc_lock_enqueue_wait(env, osc, oscl);
 	if (result < 0)
 		GOTO(out, result);
@@ -979,7 +995,7 @@ enqueue_base:
 	 */
 	ostid_build_res_name(&osc->oo_oinfo->loi_oi, resname);
 	osc_lock_build_policy(env, lock, policy);
-	if (oscl->ols_agl) {
+	if (oscl->ols_agl || oscl->ols_speculative) {
 		oscl->ols_einfo.ei_cbdata = NULL;
 		/* hold a reference for callback */
 		cl_object_get(osc2cl(osc));
@@ -991,7 +1007,7 @@ enqueue_base:
 				  osc->oo_oinfo->loi_kms_valid,
 				  upcall, cookie,
 				  &oscl->ols_einfo, PTLRPCD_SET, async,
-				  oscl->ols_agl);
+				  oscl->ols_agl || oscl->ols_speculative);
 	if (result == 0) {
 		if (osc_lock_is_lockless(oscl)) {
 			oio->oi_lockless = 1;
@@ -1003,6 +1019,9 @@ enqueue_base:
 	} else if (oscl->ols_agl) {
 		cl_object_put(env, osc2cl(osc));
 		result = 0;
+	} else if (oscl->ols_speculative) {
+		/* -ECANCELED if a cached lock already covers the extent */
+		cl_object_put(env, osc2cl(osc));
 	}
 
 out:
@@ -1177,6 +1196,7 @@ int osc_lock_init(const struct lu_env *env,
 	oscl->ols_agl = !!(enqflags & CEF_AGL);
 	if (oscl->ols_agl)
 		oscl->ols_flags |= LDLM_FL_BLOCK_NOWAIT;
+	oscl->ols_speculative = !!(enqflags & CEF_SPECULATIVE);
 	if (oscl->ols_flags & LDLM_FL_HAS_INTENT) {
 		oscl->ols_flags |= LDLM_FL_BLOCK_GRANTED;
 		oscl->ols_glimpse = 1;
@@ -407,12 +407,32 @@ int lru_queue_work(const struct lu_env *env, void *data)
 	RETURN(0);
 }
 
+void osc_lru_cpts_init(struct client_obd *cli)
+{
+	struct cl_lru_cpt *clc;
+	int i;
+
+	cfs_percpt_for_each(clc, i, cli->cl_lru_cpts) {
+		INIT_LIST_HEAD(&clc->clc_list);
+		spin_lock_init(&clc->clc_lock);
+		clc->clc_in_list = 0;
+		atomic_set(&clc->clc_shrinkers, 0);
+	}
+}
+
+/**
+ * Pages are added to the LRU list of the CPT the adding thread runs on, and
+ * each page remembers its list in osc_page::ops_lru_cpt.
+ */
 void osc_lru_add_batch(struct client_obd *cli, struct list_head *plist)
 {
 	struct list_head lru = LIST_HEAD_INIT(lru);
 	struct osc_async_page *oap;
+	struct cl_lru_cpt *clc;
 	long npages = 0;
+	int cpt;
 
+	cpt = cfs_cpt_current(cfs_cpt_table, 0);
 	list_for_each_entry(oap, plist, oap_pending_item) {
 		struct osc_page *opg = oap2osc_page(oap);
 
@@ -421,26 +441,33 @@ void osc_lru_add_batch(struct client_obd *cli, struct list_head *plist)
 
 		++npages;
 		LASSERT(list_empty(&opg->ops_lru));
+		opg->ops_lru_cpt = cpt;
 		list_add(&opg->ops_lru, &lru);
 	}
 
 	if (npages > 0) {
-		spin_lock(&cli->cl_lru_list_lock);
-		list_splice_tail(&lru, &cli->cl_lru_list);
+		clc = cli->cl_lru_cpts[cpt];
+		spin_lock(&clc->clc_lock);
+		list_splice_tail(&lru, &clc->clc_list);
+		clc->clc_in_list += npages;
+		spin_unlock(&clc->clc_lock);
+
 		atomic_long_sub(npages, &cli->cl_lru_busy);
 		atomic_long_add(npages, &cli->cl_lru_in_list);
 		cli->cl_lru_last_used = cfs_time_current_sec();
-		spin_unlock(&cli->cl_lru_list_lock);
 
 		if (waitqueue_active(&osc_lru_waitq))
 			(void)ptlrpcd_queue_work(cli->cl_lru_work);
 	}
 }
 
-static void __osc_lru_del(struct client_obd *cli, struct osc_page *opg)
+static void __osc_lru_del(struct client_obd *cli, struct cl_lru_cpt *clc,
+			  struct osc_page *opg)
 {
+	LASSERT(clc->clc_in_list > 0);
 	LASSERT(atomic_long_read(&cli->cl_lru_in_list) > 0);
 	list_del_init(&opg->ops_lru);
+	clc->clc_in_list--;
 	atomic_long_dec(&cli->cl_lru_in_list);
 }
 
@@ -451,14 +478,20 @@ static void __osc_lru_del(struct client_obd *cli, struct osc_page *opg)
 static void osc_lru_del(struct client_obd *cli, struct osc_page *opg)
 {
 	if (opg->ops_in_lru) {
-		spin_lock(&cli->cl_lru_list_lock);
-		if (!list_empty(&opg->ops_lru)) {
-			__osc_lru_del(cli, opg);
-		} else {
+		struct cl_lru_cpt *clc = cli->cl_lru_cpts[opg->ops_lru_cpt];
+		bool busy = false;
+
+		spin_lock(&clc->clc_lock);
+		if (!list_empty(&opg->ops_lru))
+			__osc_lru_del(cli, clc, opg);
+		else
+			busy = true;
+		spin_unlock(&clc->clc_lock);
+
+		if (busy) {
 			LASSERT(atomic_long_read(&cli->cl_lru_busy) > 0);
 			atomic_long_dec(&cli->cl_lru_busy);
 		}
-		spin_unlock(&cli->cl_lru_list_lock);
 
 		atomic_long_inc(cli->cl_lru_left);
 		/* this is a great place to release more LRU pages if
@@ -482,9 +515,11 @@ static void osc_lru_use(struct client_obd *cli, struct osc_page *opg)
 	/* If page is being transferred for the first time,
 	 * ops_lru should be empty */
 	if (opg->ops_in_lru && !list_empty(&opg->ops_lru)) {
-		spin_lock(&cli->cl_lru_list_lock);
-		__osc_lru_del(cli, opg);
-		spin_unlock(&cli->cl_lru_list_lock);
+		struct cl_lru_cpt *clc = cli->cl_lru_cpts[opg->ops_lru_cpt];
+
+		spin_lock(&clc->clc_lock);
+		__osc_lru_del(cli, clc, opg);
+		spin_unlock(&clc->clc_lock);
 		atomic_long_inc(&cli->cl_lru_busy);
 	}
 }
@@ -530,61 +565,56 @@ static inline bool lru_page_busy(struct client_obd *cli, struct cl_page *page)
 }
 
 /**
- * Drop @target of pages from LRU at most.
+ * Drop @target of pages from the LRU list of one CPT at most.
+ *
+ * Only one asynchronous shrinker scans a CPT at a time, shrinkers of other
+ * CPTs go on in parallel.
  */
-long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
-		   long target, bool force)
+static long osc_lru_shrink_cpt(const struct lu_env *env,
+			       struct client_obd *cli, struct cl_lru_cpt *clc,
+			       long target, bool force)
 {
 	struct cl_io *io;
 	struct cl_object *clobj = NULL;
 	struct cl_page **pvec;
 	struct osc_page *opg;
 	long count = 0;
-	int maxscan = 0;
+	long maxscan = 0;
 	int index = 0;
 	int rc = 0;
 	ENTRY;
 
-	LASSERT(atomic_long_read(&cli->cl_lru_in_list) >= 0);
-	if (atomic_long_read(&cli->cl_lru_in_list) == 0 || target <= 0)
-		RETURN(0);
-
-	CDEBUG(D_CACHE, "%s: shrinkers: %d, force: %d\n",
-	       cli_name(cli), atomic_read(&cli->cl_lru_shrinkers), force);
 	if (!force) {
-		if (atomic_read(&cli->cl_lru_shrinkers) > 0)
+		if (atomic_read(&clc->clc_shrinkers) > 0)
 			RETURN(-EBUSY);
 
-		if (atomic_inc_return(&cli->cl_lru_shrinkers) > 1) {
-			atomic_dec(&cli->cl_lru_shrinkers);
+		if (atomic_inc_return(&clc->clc_shrinkers) > 1) {
+			atomic_dec(&clc->clc_shrinkers);
 			RETURN(-EBUSY);
 		}
 	} else {
-		atomic_inc(&cli->cl_lru_shrinkers);
+		atomic_inc(&clc->clc_shrinkers);
 	}
 
 	pvec = (struct cl_page **)osc_env_info(env)->oti_pvec;
 	io = &osc_env_info(env)->oti_io;
 
-	spin_lock(&cli->cl_lru_list_lock);
-	if (force)
-		cli->cl_lru_reclaim++;
-	maxscan = min(target << 1, atomic_long_read(&cli->cl_lru_in_list));
-	while (!list_empty(&cli->cl_lru_list)) {
+	spin_lock(&clc->clc_lock);
+	maxscan = min(target << 1, clc->clc_in_list);
+	while (!list_empty(&clc->clc_list)) {
 		struct cl_page *page;
 		bool will_free = false;
 
-		if (!force && atomic_read(&cli->cl_lru_shrinkers) > 1)
+		if (!force && atomic_read(&clc->clc_shrinkers) > 1)
 			break;
 
 		if (--maxscan < 0)
 			break;
 
-		opg = list_entry(cli->cl_lru_list.next, struct osc_page,
-				 ops_lru);
+		opg = list_entry(clc->clc_list.next, struct osc_page, ops_lru);
 		page = opg->ops_cl.cpl_page;
 		if (lru_page_busy(cli, page)) {
-			list_move_tail(&opg->ops_lru, &cli->cl_lru_list);
+			list_move_tail(&opg->ops_lru, &clc->clc_list);
 			continue;
 		}
 
@@ -593,7 +623,7 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 			struct cl_object *tmp = page->cp_obj;
 
 			cl_object_get(tmp);
-			spin_unlock(&cli->cl_lru_list_lock);
+			spin_unlock(&clc->clc_lock);
 
 			if (clobj != NULL) {
 				discard_pagevec(env, io, pvec, index);
@@ -609,7 +639,7 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 			io->ci_ignore_layout = 1;
 			rc = cl_io_init(env, io, CIT_MISC, clobj);
 
-			spin_lock(&cli->cl_lru_list_lock);
+			spin_lock(&clc->clc_lock);
 
 			if (rc != 0)
 				break;
@@ -622,7 +652,7 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 			if (!lru_page_busy(cli, page)) {
 				/* remove it from lru list earlier to avoid
 				 * lock contention */
-				__osc_lru_del(cli, opg);
+				__osc_lru_del(cli, clc, opg);
 				opg->ops_in_lru = 0; /* will be discarded */
 
 				cl_page_get(page);
@@ -633,24 +663,24 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 		}
 
 		if (!will_free) {
-			list_move_tail(&opg->ops_lru, &cli->cl_lru_list);
+			list_move_tail(&opg->ops_lru, &clc->clc_list);
 			continue;
 		}
 
-		/* Don't discard and free the page with cl_lru_list held */
+		/* Don't discard and free the page with clc_lock held */
 		pvec[index++] = page;
 		if (unlikely(index == OTI_PVEC_SIZE)) {
-			spin_unlock(&cli->cl_lru_list_lock);
+			spin_unlock(&clc->clc_lock);
 			discard_pagevec(env, io, pvec, index);
 			index = 0;
 
-			spin_lock(&cli->cl_lru_list_lock);
+			spin_lock(&clc->clc_lock);
 		}
 
 		if (++count >= target)
 			break;
 	}
-	spin_unlock(&cli->cl_lru_list_lock);
+	spin_unlock(&clc->clc_lock);
 
 	if (clobj != NULL) {
 		discard_pagevec(env, io, pvec, index);
@@ -659,12 +689,77 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 		cl_object_put(env, clobj);
 	}
 
+	atomic_dec(&clc->clc_shrinkers);
+	RETURN(count > 0 ? count : rc);
+}
+
+/**
+ * Drop @target of pages from LRU at most.
+ *
+ * The target is spread over the CPTs by their share of the LRU pages first,
+ * so that no partition is drained while the others keep their pages, then
+ * whatever is still missing is taken from any CPT. A forced reclaim starts
+ * from the CPT of the calling thread, an asynchronous shrink from the CPT
+ * after the one the previous shrink started from.
+ */
+long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
+		   long target, bool force)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	long count = 0;
+	long total;
+	int start;
+	int pass;
+	int rc = 0;
+	int i;
+	ENTRY;
+
+	total = atomic_long_read(&cli->cl_lru_in_list);
+	LASSERT(total >= 0);
+	if (total == 0 || target <= 0)
+		RETURN(0);
+
+	CDEBUG(D_CACHE, "%s: shrinkers: %d, force: %d\n",
+	       cli_name(cli), atomic_read(&cli->cl_lru_shrinkers), force);
+
+	atomic_inc(&cli->cl_lru_shrinkers);
+	if (force) {
+		cli->cl_lru_reclaim++;
+		start = cfs_cpt_current(cfs_cpt_table, 0);
+	} else {
+		start = cli->cl_lru_shrink_cpt++ % ncpts;
+	}
+
+	for (pass = 0; pass < 2 && count < target; pass++) {
+		for (i = 0; i < ncpts && count < target; i++) {
+			struct cl_lru_cpt *clc;
+			long nr;
+
+			clc = cli->cl_lru_cpts[(start + i) % ncpts];
+			nr = ACCESS_ONCE(clc->clc_in_list);
+			if (nr == 0)
+				continue;
+
+			nr = pass == 0 ? DIV_ROUND_UP(target * nr, total) :
+					 target - count;
+			rc = osc_lru_shrink_cpt(env, cli, clc,
+						min(nr, target - count), force);
+			if (rc > 0) {
+				count += rc;
+				rc = 0;
+			} else if (rc < 0 && rc != -EBUSY) {
+				GOTO(out, rc);
+			}
+		}
+	}
+	EXIT;
+out:
 	atomic_dec(&cli->cl_lru_shrinkers);
 	if (count > 0) {
 		atomic_long_add(count, cli->cl_lru_left);
 		wake_up_all(&osc_lru_waitq);
 	}
-	RETURN(count > 0 ? count : rc);
+	return count > 0 ? count : rc;
 }
 
 /**
@@ -937,12 +1032,16 @@ void osc_inc_unstable_pages(struct ptlrpc_request *req)
 {
 	struct ptlrpc_bulk_desc *desc = req->rq_bulk;
 	struct client_obd       *cli  = &req->rq_import->imp_obd->u.cli;
-	long			 page_count = desc->bd_iov_count;
+	long			 page_count;
 
-	/* No unstable page tracking */
-	if (cli->cl_cache == NULL || !cli->cl_cache->ccc_unstable_check)
+	/* No unstable page tracking, short io writes keep their own copy
+	 * of the data in the request and don't pin the pages */
+	if (desc == NULL || cli->cl_cache == NULL ||
+	    !cli->cl_cache->ccc_unstable_check)
 		return;
 
+	page_count = desc->bd_iov_count;
+
 	add_unstable_page_accounting(desc);
 	atomic_long_add(page_count, &cli->cl_unstable_count);
 	atomic_long_add(page_count, &cli->cl_cache->ccc_unstable_nr);
@@ -60,6 +60,14 @@ struct ptlrpc_request_pool *osc_rq_pool;
 static unsigned int osc_reqpool_mem_max = 5;
 module_param(osc_reqpool_mem_max, uint, 0444);
 
+/* Objects packed into one OST_WRITE, see OBD_CONNECT2_MULTIOBJ_BRW */
+struct osc_brw_objs {
+	u32			  obo_count;	/* number of objects */
+	u32			 *obo_pages;	/* pages of each object in ppga */
+	struct obdo		 *obo_oa;	/* attributes of objects 1.. */
+	int			 *obo_rc;	/* result of each object */
+};
+
 struct osc_brw_async_args {
 	struct obdo		 *aa_oa;
 	int			  aa_requested_nob;
@@ -70,6 +78,7 @@ struct osc_brw_async_args {
 	struct client_obd	 *aa_cli;
 	struct list_head	  aa_oaps;
 	struct list_head	  aa_exts;
+	struct osc_brw_objs	 *aa_objs;
 };
 
 #define osc_grant_args osc_brw_async_args
@@ -997,12 +1006,23 @@ static void handle_short_read(int nob_read, size_t page_count,
 	}
 }
 
+/**
+ * Check the niobuf return codes of a write reply.
+ *
+ * The objects of a multi-object write succeed or fail on their own, the
+ * result of each one is saved in \a objs, and the write only fails if all
+ * of them did.
+ */
 static int check_write_rcs(struct ptlrpc_request *req,
 			   int requested_nob, int niocount,
-			   size_t page_count, struct brw_page **pga)
+			   size_t page_count, struct brw_page **pga,
+			   struct osc_brw_objs *objs)
 {
-        int     i;
-        __u32   *remote_rcs;
+	struct obd_ioobj *ioobj = NULL;
+	int	i;
+	int	obj_end = 0;
+	u32	j;
+	__u32	*remote_rcs;
 
         remote_rcs = req_capsule_server_sized_get(&req->rq_pill, &RMF_RCS,
                                                   sizeof(*remote_rcs) *
@@ -1012,10 +1032,24 @@ static int check_write_rcs(struct ptlrpc_request *req,
                 return(-EPROTO);
         }
 
+	if (objs != NULL) {
+		ioobj = req_capsule_client_get(&req->rq_pill, &RMF_OBD_IOOBJ);
+		memset(objs->obo_rc, 0, sizeof(*objs->obo_rc) * objs->obo_count);
+		obj_end = ioobj[0].ioo_bufcnt;
+	}
+
         /* return error if any niobuf was in error */
-        for (i = 0; i < niocount; i++) {
-                if ((int)remote_rcs[i] < 0)
-                        return(remote_rcs[i]);
+	for (i = j = 0; i < niocount; i++) {
+		if (objs != NULL && i == obj_end)
+			obj_end += ioobj[++j].ioo_bufcnt;
+
+		if ((int)remote_rcs[i] < 0) {
+			if (objs == NULL)
+				return remote_rcs[i];
+			if (objs->obo_rc[j] == 0)
+				objs->obo_rc[j] = remote_rcs[i];
+			continue;
+		}
 
                 if (remote_rcs[i] != 0) {
                         CDEBUG(D_INFO, "rc[%d] invalid (%d) req %p\n",
@@ -1024,12 +1058,21 @@ static int check_write_rcs(struct ptlrpc_request *req,
                 }
         }
 
-        if (req->rq_bulk->bd_nob_transferred != requested_nob) {
+        if (req->rq_bulk != NULL &&
+            req->rq_bulk->bd_nob_transferred != requested_nob) {
                 CERROR("Unexpected # bytes transferred: %d (requested %d)\n",
                        req->rq_bulk->bd_nob_transferred, requested_nob);
                 return(-EPROTO);
         }
 
+	if (objs != NULL) {
+		for (j = 0; j < objs->obo_count; j++) {
+			if (objs->obo_rc[j] == 0)
+				return 0;
+		}
+		return objs->obo_rc[0];
+	}
+
         return (0);
 }
 
@@ -1053,51 +1096,94 @@ static inline int can_merge_pages(struct brw_page *p1, struct brw_page *p2)
         return (p1->off + p1->count == p2->off);
 }
 
+struct osc_cksum_frags {
+	struct brw_page	**ocf_pga;
+	int		  ocf_count;
+	/* the bulk may end in the middle of its last page */
+	unsigned int	  ocf_last_len;
+	/* guard function of the T10 checksum types */
+	obd_dif_csum_fn	 *ocf_dif_fn;
+};
+
+static void osc_checksum_get_frag(void *data, int idx, struct page **page,
+				  unsigned int *offset, unsigned int *len)
+{
+	struct osc_cksum_frags *frags = data;
+	struct brw_page *pg = frags->ocf_pga[idx];
+
+	*page = pg->pg;
+	*offset = pg->off & ~PAGE_MASK;
+	*len = idx == frags->ocf_count - 1 ? frags->ocf_last_len : pg->count;
+	LL_CDEBUG_PAGE(D_PAGE, pg->pg, "off %d\n", (int)*offset);
+}
+
+static int osc_checksum_frag_guards(void *data, int idx, __u16 *guards,
+				    int guard_number, int *used_number)
+{
+	struct osc_cksum_frags *frags = data;
+	struct page *page;
+	unsigned int offset;
+	unsigned int len;
+
+	osc_checksum_get_frag(data, idx, &page, &offset, &len);
+	return obd_page_dif_generate_buffer("osc", page, offset, len, guards,
+					    guard_number, used_number,
+					    frags->ocf_dif_fn);
+}
+
 static u32 osc_checksum_bulk(int nob, size_t pg_count,
 			     struct brw_page **pga, int opc,
 			     cksum_type_t cksum_type)
 {
 	u32				cksum;
-	int				i = 0;
-	struct cfs_crypto_hash_desc	*hdesc;
 	unsigned int			bufsize;
 	unsigned char			cfs_alg = cksum_obd2cfs(cksum_type);
+	struct osc_cksum_frags		frags = { .ocf_pga = pga };
+	int				rc;
 
 	LASSERT(pg_count > 0);
 
-	hdesc = cfs_crypto_hash_init(cfs_alg, NULL, 0);
-	if (IS_ERR(hdesc)) {
-		CERROR("Unable to initialize checksum hash %s\n",
-		       cfs_crypto_hash_name(cfs_alg));
-		return PTR_ERR(hdesc);
-	}
-
 	while (nob > 0 && pg_count > 0) {
-		unsigned int count = pga[i]->count > nob ? nob : pga[i]->count;
-
-		/* corrupt the data before we compute the checksum, to
-		 * simulate an OST->client data error */
-		if (i == 0 && opc == OST_READ &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OSC_CHECKSUM_RECEIVE)) {
-			unsigned char *ptr = kmap(pga[i]->pg);
-			int off = pga[i]->off & ~PAGE_MASK;
-
-			memcpy(ptr + off, "bad1", min_t(typeof(nob), 4, nob));
-			kunmap(pga[i]->pg);
-		}
-		cfs_crypto_hash_update_page(hdesc, pga[i]->pg,
-					    pga[i]->off & ~PAGE_MASK,
-					    count);
-		LL_CDEBUG_PAGE(D_PAGE, pga[i]->pg, "off %d\n",
-			       (int)(pga[i]->off & ~PAGE_MASK));
-
-		nob -= pga[i]->count;
+		frags.ocf_last_len = min_t(unsigned int, nob,
+					   pga[frags.ocf_count]->count);
+		nob -= pga[frags.ocf_count]->count;
 		pg_count--;
-		i++;
+		frags.ocf_count++;
 	}
 
-	bufsize = sizeof(cksum);
-	cfs_crypto_hash_final(hdesc, (unsigned char *)&cksum, &bufsize);
+	/* corrupt the data before we compute the checksum, to
+	 * simulate an OST->client data error */
+	if (frags.ocf_count > 0 && opc == OST_READ &&
+	    OBD_FAIL_CHECK(OBD_FAIL_OSC_CHECKSUM_RECEIVE)) {
+		unsigned char *ptr = kmap(pga[0]->pg);
+		int off = pga[0]->off & ~PAGE_MASK;
+
+		memcpy(ptr + off, "bad1",
+		       min_t(unsigned int, 4, frags.ocf_count > 1 ?
+			     pga[0]->count : frags.ocf_last_len));
+		kunmap(pga[0]->pg);
+	}
+
+	if (cksum_type & OBD_CKSUM_T10_ALL) {
+		frags.ocf_dif_fn = obd_t10_cksum2dif(cksum_type);
+		if (frags.ocf_dif_fn == NULL)
+			rc = -EOPNOTSUPP;
+		else
+			rc = obd_t10_cksum_bulk(cksum_type, &frags,
+						frags.ocf_count,
+						osc_checksum_frag_guards,
+						&cksum);
+	} else {
+		bufsize = sizeof(cksum);
+		rc = cfs_crypto_hash_pages(cfs_alg, &frags, frags.ocf_count,
+					   osc_checksum_get_frag,
+					   (unsigned char *)&cksum, &bufsize);
+	}
+	if (rc != 0) {
+		CERROR("Unable to compute checksum hash %s: rc = %d\n",
+		       cfs_crypto_hash_name(cfs_alg), rc);
+		return rc;
+	}
 
 	/* For sending we only compute the wrong checksum instead
 	 * of corrupting the data so it is still correct on a redo */
@@ -1107,9 +1193,60 @@ static u32 osc_checksum_bulk(int nob, size_t pg_count,
 	return cksum;
 }
 
+static void osc_brw_objs_free(struct osc_brw_objs *objs)
+{
+	if (objs->obo_pages != NULL)
+		OBD_FREE(objs->obo_pages,
+			 sizeof(*objs->obo_pages) * objs->obo_count);
+	if (objs->obo_oa != NULL)
+		OBD_FREE(objs->obo_oa,
+			 sizeof(*objs->obo_oa) * (objs->obo_count - 1));
+	if (objs->obo_rc != NULL)
+		OBD_FREE(objs->obo_rc, sizeof(*objs->obo_rc) * objs->obo_count);
+	OBD_FREE_PTR(objs);
+}
+
+static struct osc_brw_objs *osc_brw_objs_alloc(u32 count)
+{
+	struct osc_brw_objs *objs;
+
+	LASSERT(count > 1 && count <= OBD_MAX_BRW_OBJS);
+
+	OBD_ALLOC_PTR(objs);
+	if (objs == NULL)
+		return NULL;
+
+	objs->obo_count = count;
+	OBD_ALLOC(objs->obo_pages, sizeof(*objs->obo_pages) * count);
+	OBD_ALLOC(objs->obo_oa, sizeof(*objs->obo_oa) * (count - 1));
+	OBD_ALLOC(objs->obo_rc, sizeof(*objs->obo_rc) * count);
+	if (objs->obo_pages == NULL || objs->obo_oa == NULL ||
+	    objs->obo_rc == NULL) {
+		osc_brw_objs_free(objs);
+		return NULL;
+	}
+
+	return objs;
+}
+
+/* number of pages of the \a idx-th object of a BRW */
+static inline u32 osc_brw_obj_pages(struct osc_brw_objs *objs, u32 idx,
+				    u32 page_count)
+{
+	return objs != NULL ? objs->obo_pages[idx] : page_count;
+}
+
+/* attributes of the \a idx-th object of a BRW */
+static inline struct obdo *osc_brw_obj_oa(struct obdo *oa,
+					  struct osc_brw_objs *objs, u32 idx)
+{
+	return idx == 0 ? oa : &objs->obo_oa[idx - 1];
+}
+
 static int
 osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
 		     u32 page_count, struct brw_page **pga,
+		     struct osc_brw_objs *objs,
 		     struct ptlrpc_request **reqp, int resend)
 {
         struct ptlrpc_request   *req;
@@ -1117,10 +1254,15 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         struct ost_body         *body;
         struct obd_ioobj        *ioobj;
         struct niobuf_remote    *niobuf;
+	struct niobuf_remote	*obj_niobuf;
         int niocount, i, requested_nob, opc, rc;
         struct osc_brw_async_args *aa;
         struct req_capsule      *pill;
         struct brw_page *pg_prev;
+	unsigned char *short_io_buf = NULL;
+	int short_io_size = 0;
+	u32 nr_objs = objs != NULL ? objs->obo_count : 1;
+	u32 obj_start, obj_end, j;
 
         ENTRY;
         if (OBD_FAIL_CHECK(OBD_FAIL_OSC_BRW_PREP_REQ))
@@ -1140,16 +1282,41 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         if (req == NULL)
                 RETURN(-ENOMEM);
 
-        for (niocount = i = 1; i < page_count; i++) {
-                if (!can_merge_pages(pga[i - 1], pga[i]))
-                        niocount++;
-        }
+	LASSERT(objs == NULL || opc == OST_WRITE);
+	/* pages of different objects never share a niobuf */
+	for (niocount = 0, i = 0, j = 0; j < nr_objs; j++) {
+		obj_end = i + osc_brw_obj_pages(objs, j, page_count);
+		for (niocount++, i++; i < obj_end; i++) {
+			if (!can_merge_pages(pga[i - 1], pga[i]))
+				niocount++;
+		}
+	}
+	LASSERT(i == page_count);
+
+	/* small I/Os carry their data in the RPC itself, which saves the
+	 * bulk setup and the extra LNet round trip */
+	if (imp_connect_shortio(cli->cl_import)) {
+		for (i = 0; i < page_count; i++)
+			short_io_size += pga[i]->count;
+		if (short_io_size > cli->cl_short_io_bytes)
+			short_io_size = 0;
+	}
 
         pill = &req->rq_pill;
         req_capsule_set_size(pill, &RMF_OBD_IOOBJ, RCL_CLIENT,
-                             sizeof(*ioobj));
+                             nr_objs * sizeof(*ioobj));
+	req_capsule_set_size(pill, &RMF_OST_OBDOS, RCL_CLIENT,
+			     (nr_objs - 1) * sizeof(struct obdo));
         req_capsule_set_size(pill, &RMF_NIOBUF_REMOTE, RCL_CLIENT,
                              niocount * sizeof(*niobuf));
+	req_capsule_set_size(pill, &RMF_SHORT_IO, RCL_CLIENT,
+			     opc == OST_WRITE ? short_io_size : 0);
+	if (opc == OST_WRITE)
+		req_capsule_set_size(pill, &RMF_OST_OBDOS, RCL_SERVER,
+				     (nr_objs - 1) * sizeof(struct obdo));
+	if (opc == OST_READ)
+		req_capsule_set_size(pill, &RMF_SHORT_IO, RCL_SERVER,
+				     short_io_size);
 
         rc = ptlrpc_request_pack(req, LUSTRE_OST_VERSION, opc);
         if (rc) {
@@ -1162,17 +1329,26 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
 	 * retry logic */
 	req->rq_no_retry_einprogress = 1;
 
-	desc = ptlrpc_prep_bulk_imp(req, page_count,
-		cli->cl_import->imp_connect_data.ocd_brw_size >> LNET_MTU_BITS,
-		(opc == OST_WRITE ? PTLRPC_BULK_GET_SOURCE :
-			PTLRPC_BULK_PUT_SINK) |
-			PTLRPC_BULK_BUF_KIOV,
-		OST_BULK_PORTAL,
-		&ptlrpc_bulk_kiov_pin_ops);
-
-        if (desc == NULL)
-                GOTO(out, rc = -ENOMEM);
-        /* NB request now owns desc and will free it when it gets freed */
+	if (short_io_size != 0) {
+		desc = NULL;
+		if (opc == OST_WRITE)
+			short_io_buf = req_capsule_client_get(pill,
+							      &RMF_SHORT_IO);
+	} else {
+		desc = ptlrpc_prep_bulk_imp(req, page_count,
+			cli->cl_import->imp_connect_data.ocd_brw_size >>
+				LNET_MTU_BITS,
+			(opc == OST_WRITE ? PTLRPC_BULK_GET_SOURCE :
+				PTLRPC_BULK_PUT_SINK) |
+				PTLRPC_BULK_BUF_KIOV,
+			OST_BULK_PORTAL,
+			&ptlrpc_bulk_kiov_pin_ops);
+
+		if (desc == NULL)
+			GOTO(out, rc = -ENOMEM);
+		/* NB request now owns desc and will free it when it gets
+		 * freed */
+	}
 
         body = req_capsule_client_get(pill, &RMF_OST_BODY);
         ioobj = req_capsule_client_get(pill, &RMF_OBD_IOOBJ);
@@ -1180,31 +1356,65 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         LASSERT(body != NULL && ioobj != NULL && niobuf != NULL);
 
 	lustre_set_wire_obdo(&req->rq_import->imp_connect_data, &body->oa, oa);
+	/* a resend may no longer qualify for short I/O */
+	body->oa.o_flags &= ~OBD_FL_SHORT_IO;
 
 	obdo_to_ioobj(oa, ioobj);
-	ioobj->ioo_bufcnt = niocount;
+	if (objs != NULL) {
+		struct obdo *obdos = req_capsule_client_get(pill,
+							    &RMF_OST_OBDOS);
+
+		LASSERT(obdos != NULL);
+		for (j = 1; j < nr_objs; j++) {
+			lustre_set_wire_obdo(&req->rq_import->imp_connect_data,
+					     &obdos[j - 1], &objs->obo_oa[j - 1]);
+			obdos[j - 1].o_flags &= ~OBD_FL_SHORT_IO;
+			if (resend) {
+				if ((obdos[j - 1].o_valid & OBD_MD_FLFLAGS) ==
+				    0) {
+					obdos[j - 1].o_valid |= OBD_MD_FLFLAGS;
+					obdos[j - 1].o_flags = 0;
+				}
+				obdos[j - 1].o_flags |= OBD_FL_RECOV_RESEND;
+			}
+			obdo_to_ioobj(&objs->obo_oa[j - 1], &ioobj[j]);
+		}
+	}
 	/* The high bits of ioo_max_brw tells server _maximum_ number of bulks
 	 * that might be send for this request.  The actual number is decided
 	 * when the RPC is finally sent in ptlrpc_register_bulk(). It sends
 	 * "max - 1" for old client compatibility sending "0", and also so the
 	 * the actual maximum is a power-of-two number, not one less. LU-1431 */
-	ioobj_max_brw_set(ioobj, desc->bd_md_max_brw);
+	for (j = 0; j < nr_objs; j++)
+		ioobj_max_brw_set(&ioobj[j],
+				  desc != NULL ? desc->bd_md_max_brw : 1);
 	LASSERT(page_count > 0);
 	pg_prev = pga[0];
-        for (requested_nob = i = 0; i < page_count; i++, niobuf++) {
+	obj_niobuf = niobuf;
+	obj_start = 0;
+	obj_end = osc_brw_obj_pages(objs, 0, page_count);
+        for (requested_nob = i = j = 0; i < page_count; i++, niobuf++) {
                 struct brw_page *pg = pga[i];
 		int poff = pg->off & ~PAGE_MASK;
 
+		if (i == obj_end) {
+			/* first page of the next object */
+			ioobj[j].ioo_bufcnt = niobuf - obj_niobuf;
+			obj_niobuf = niobuf;
+			obj_start = obj_end;
+			obj_end += osc_brw_obj_pages(objs, ++j, page_count);
+		}
+
                 LASSERT(pg->count > 0);
                 /* make sure there is no gap in the middle of page array */
-		LASSERTF(page_count == 1 ||
-			 (ergo(i == 0, poff + pg->count == PAGE_SIZE) &&
-			  ergo(i > 0 && i < page_count - 1,
+		LASSERTF(obj_end - obj_start == 1 ||
+			 (ergo(i == obj_start, poff + pg->count == PAGE_SIZE) &&
+			  ergo(i > obj_start && i < obj_end - 1,
 			       poff == 0 && pg->count == PAGE_SIZE)   &&
-			  ergo(i == page_count - 1, poff == 0)),
+			  ergo(i == obj_end - 1, poff == 0)),
 			 "i: %d/%d pg: %p off: %llu, count: %u\n",
 			 i, page_count, pg, pg->off, pg->count);
-                LASSERTF(i == 0 || pg->off > pg_prev->off,
+                LASSERTF(i == obj_start || pg->off > pg_prev->off,
 			 "i %d p_c %u pg %p [pri %lu ind %lu] off %llu"
 			 " prev_pg %p [pri %lu ind %lu] off %llu\n",
                          i, page_count,
@@ -1214,10 +1424,19 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
                 LASSERT((pga[0]->flag & OBD_BRW_SRVLOCK) ==
                         (pg->flag & OBD_BRW_SRVLOCK));
 
-		desc->bd_frag_ops->add_kiov_frag(desc, pg->pg, poff, pg->count);
+		if (desc != NULL) {
+			desc->bd_frag_ops->add_kiov_frag(desc, pg->pg, poff,
+							 pg->count);
+		} else if (short_io_buf != NULL) {
+			unsigned char *ptr = kmap(pg->pg);
+
+			memcpy(short_io_buf + requested_nob, ptr + poff,
+			       pg->count);
+			kunmap(pg->pg);
+		}
                 requested_nob += pg->count;
 
-                if (i > 0 && can_merge_pages(pg_prev, pg)) {
+		if (i > obj_start && can_merge_pages(pg_prev, pg)) {
                         niobuf--;
 			niobuf->rnb_len += pg->count;
 		} else {
@@ -1227,6 +1446,8 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
                 }
                 pg_prev = pg;
         }
+	LASSERT(j == nr_objs - 1);
+	ioobj[j].ioo_bufcnt = niobuf - obj_niobuf;
 
         LASSERTF((void *)(niobuf - niocount) ==
                 req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE),
@@ -1286,6 +1507,24 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
                         body->oa.o_valid |= OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
                 }
         }
+
+	if (short_io_size != 0) {
+		struct osc_stats *stats =
+			&obd2osc_dev(cli->cl_import->imp_obd)->od_stats;
+
+		if (opc == OST_WRITE)
+			stats->os_short_io_writes += short_io_size;
+		else
+			stats->os_short_io_reads += short_io_size;
+
+		if ((body->oa.o_valid & OBD_MD_FLFLAGS) == 0) {
+			body->oa.o_valid |= OBD_MD_FLFLAGS;
+			body->oa.o_flags = 0;
+		}
+		body->oa.o_flags |= OBD_FL_SHORT_IO;
+		CDEBUG(D_CACHE, "short io %s of %d bytes\n",
+		       opc == OST_WRITE ? "write" : "read", short_io_size);
+	}
         ptlrpc_request_set_replen(req);
 
         CLASSERT(sizeof(*aa) <= sizeof(req->rq_async_args));
@@ -1297,6 +1536,7 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         aa->aa_resends = 0;
         aa->aa_ppga = pga;
         aa->aa_cli = cli;
+	aa->aa_objs = objs;
 	INIT_LIST_HEAD(&aa->aa_oaps);
 
 	*reqp = req;
@@ -1356,6 +1596,88 @@ static int check_write_checksum(struct obdo *oa, const lnet_process_id_t *peer,
 	return 1;
 }
 
+/**
+ * Copy the data of a short read from the reply buffer into the pages,
+ * returns \a nob on success.
+ */
+static int osc_brw_short_io_read(struct ptlrpc_request *req,
+				 struct osc_brw_async_args *aa, int nob)
+{
+	unsigned char *buf;
+	int count, i;
+
+	if (nob == 0)
+		return 0;
+
+	buf = req_capsule_server_sized_get(&req->rq_pill, &RMF_SHORT_IO, nob);
+	if (buf == NULL) {
+		CERROR("%s: short io reply has less than %d bytes\n",
+		       req->rq_import->imp_obd->obd_name, nob);
+		return -EPROTO;
+	}
+
+	for (i = 0, count = 0; i < aa->aa_page_count && count < nob; i++) {
+		struct brw_page *pg = aa->aa_ppga[i];
+		int len = min_t(int, pg->count, nob - count);
+		unsigned char *ptr = kmap(pg->pg);
+
+		memcpy(ptr + (pg->off & ~PAGE_MASK), buf + count, len);
+		kunmap(pg->pg);
+		count += len;
+	}
+
+	return nob;
+}
+
+/* set/clear the over quota flags from the objects after the first one of a
+ * multi-object write, each may have another owner */
+static void osc_brw_objs_setdq(struct ptlrpc_request *req,
+			       struct client_obd *cli,
+			       struct osc_brw_objs *objs)
+{
+	struct obdo *obdos;
+	u32 j;
+
+	obdos = req_capsule_server_sized_get(&req->rq_pill, &RMF_OST_OBDOS,
+					     sizeof(*obdos) *
+					     (objs->obo_count - 1));
+	if (obdos == NULL)
+		return;
+
+	for (j = 0; j < objs->obo_count - 1; j++) {
+		unsigned int qid[LL_MAXQUOTAS] = { obdos[j].o_uid,
+						   obdos[j].o_gid };
+
+		if (!(obdos[j].o_valid &
+		      (OBD_MD_FLUSRQUOTA | OBD_MD_FLGRPQUOTA)))
+			continue;
+
+		CDEBUG(D_QUOTA, "setdq for [%u %u] with valid %#llx, flags %x\n",
+		       obdos[j].o_uid, obdos[j].o_gid, obdos[j].o_valid,
+		       obdos[j].o_flags);
+		osc_quota_setdq(cli, qid, obdos[j].o_valid, obdos[j].o_flags);
+	}
+}
+
+/* result of the object of \a ext in a multi-object write */
+static int osc_brw_obj_rc(struct osc_brw_async_args *aa,
+			  struct osc_extent *ext)
+{
+	u32 end = 0;
+	u32 j;
+
+	if (aa->aa_objs == NULL)
+		return 0;
+
+	for (j = 0; j < aa->aa_objs->obo_count; j++) {
+		end += aa->aa_objs->obo_pages[j];
+		if (brw_page2oap(aa->aa_ppga[end - 1])->oap_obj == ext->oe_obj)
+			return aa->aa_objs->obo_rc[j];
+	}
+
+	return 0;
+}
+
 /* Note rc enters this function as number of bytes transferred */
 static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
 {
@@ -1391,6 +1713,11 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                 osc_quota_setdq(cli, qid, body->oa.o_valid, body->oa.o_flags);
         }
 
+	/* and for the other objects of a multi-object write */
+	if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE &&
+	    aa->aa_objs != NULL)
+		osc_brw_objs_setdq(req, cli, aa->aa_objs);
+
         osc_update_grant(cli, body);
 
         if (rc < 0)
@@ -1404,10 +1731,12 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                         CERROR("Unexpected +ve rc %d\n", rc);
                         RETURN(-EPROTO);
                 }
-                LASSERT(req->rq_bulk->bd_nob == aa->aa_requested_nob);
+		if (req->rq_bulk != NULL) {
+			LASSERT(req->rq_bulk->bd_nob == aa->aa_requested_nob);
 
-                if (sptlrpc_cli_unwrap_bulk_write(req, req->rq_bulk))
-                        RETURN(-EAGAIN);
+			if (sptlrpc_cli_unwrap_bulk_write(req, req->rq_bulk))
+				RETURN(-EAGAIN);
+		}
 
                 if ((aa->aa_oa->o_valid & OBD_MD_FLCKSUM) && client_cksum &&
                     check_write_checksum(&body->oa, peer, client_cksum,
@@ -1416,17 +1745,20 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                                          cksum_type_unpack(aa->aa_oa->o_flags)))
                         RETURN(-EAGAIN);
 
-                rc = check_write_rcs(req, aa->aa_requested_nob,aa->aa_nio_count,
-                                     aa->aa_page_count, aa->aa_ppga);
+		rc = check_write_rcs(req, aa->aa_requested_nob,
+				     aa->aa_nio_count, aa->aa_page_count,
+				     aa->aa_ppga, aa->aa_objs);
                 GOTO(out, rc);
         }
 
         /* The rest of this function executes only for OST_READs */
 
-        /* if unwrap_bulk failed, return -EAGAIN to retry */
-        rc = sptlrpc_cli_unwrap_bulk_read(req, req->rq_bulk, rc);
-        if (rc < 0)
-                GOTO(out, rc = -EAGAIN);
+	if (req->rq_bulk != NULL) {
+		/* if unwrap_bulk failed, return -EAGAIN to retry */
+		rc = sptlrpc_cli_unwrap_bulk_read(req, req->rq_bulk, rc);
+		if (rc < 0)
+			GOTO(out, rc = -EAGAIN);
+	}
 
         if (rc > aa->aa_requested_nob) {
                 CERROR("Unexpected rc %d (%d requested)\n", rc,
@@ -1434,7 +1766,11 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                 RETURN(-EPROTO);
         }
 
-        if (rc != req->rq_bulk->bd_nob_transferred) {
+	if (req->rq_bulk == NULL) {
+		rc = osc_brw_short_io_read(req, aa, rc);
+		if (rc < 0)
+			RETURN(rc);
+	} else if (rc != req->rq_bulk->bd_nob_transferred) {
                 CERROR ("Unexpected rc %d (%d transferred)\n",
                         rc, req->rq_bulk->bd_nob_transferred);
                 return (-EPROTO);
@@ -1456,7 +1792,8 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
                                                  aa->aa_ppga, OST_READ,
                                                  cksum_type);
 
-		if (peer->nid != req->rq_bulk->bd_sender) {
+		if (req->rq_bulk != NULL &&
+		    peer->nid != req->rq_bulk->bd_sender) {
 			via = " via ";
 			router = libcfs_nid2str(req->rq_bulk->bd_sender);
 		}
@@ -1521,7 +1858,7 @@ static int osc_brw_redo_request(struct ptlrpc_request *request,
 	rc = osc_brw_prep_request(lustre_msg_get_opc(request->rq_reqmsg) ==
 				OST_WRITE ? OBD_BRW_WRITE : OBD_BRW_READ,
 				  aa->aa_cli, aa->aa_oa, aa->aa_page_count,
-				  aa->aa_ppga, &new_req, 1);
+				  aa->aa_ppga, aa->aa_objs, &new_req, 1);
         if (rc)
                 RETURN(rc);
 
@@ -1613,6 +1950,121 @@ static void osc_release_ppga(struct brw_page **ppga, size_t count)
         OBD_FREE(ppga, sizeof(*ppga) * count);
 }
 
+/* the RPCs of a window are queueing on the OST once their round trip time
+ * reaches OSC_RPC_ADAPT_QUEUED/8 of the baseline, and the OST has capacity
+ * to spare while it stays below OSC_RPC_ADAPT_IDLE/8 of it. In between the
+ * limits are left alone. */
+#define OSC_RPC_ADAPT_QUEUED	16
+#define OSC_RPC_ADAPT_IDLE	10
+/* windows without growth after the limits were cut */
+#define OSC_RPC_ADAPT_HOLD	4
+/* windows after which the baseline is refreshed */
+#define OSC_RPC_ADAPT_BASE_AGE	64
+
+/**
+ * Adaptive RPC controller, run for every BRW RPC completed without error
+ * when osc.*.adaptive_rpcs is set.
+ *
+ * Reads and writes are tracked apart. Each works on windows of
+ * max_rpcs_in_flight completions and compares the average round trip time
+ * per page of a window with a baseline: the lowest average seen over the
+ * last OSC_RPC_ADAPT_BASE_AGE windows. The baseline follows a path which
+ * got slower once it is refreshed, but never creeps up with the queueing
+ * it is meant to detect.
+ *
+ * As long as RPCs are held back by the in-flight limit and the round trip
+ * time stays close to the baseline, the network and the OST have capacity
+ * to spare: one more RPC is allowed in flight per window, up to 4 times the
+ * configured count, then the RPC size is doubled up to the BRW size agreed
+ * with the OST. This opens the window quickly on high latency links.
+ *
+ * Once the round trip time doubles, RPCs are queueing on the OST: the RPC
+ * size goes back to the configured one first, then the in-flight count is
+ * cut by a quarter per window. The limits that queued are remembered until
+ * the baseline is refreshed and the next growth stops short of them, and
+ * nothing grows for OSC_RPC_ADAPT_HOLD windows after a cut. So under a
+ * steady load the limits settle below the point where queueing starts
+ * instead of swinging around it.
+ */
+static void osc_rpc_adapt(struct client_obd *cli, int write, __u64 rtt,
+			  u32 page_count)
+__must_hold(&cli->cl_loi_list_lock)
+{
+	struct client_rpc_adapt *cra = &cli->cl_rpc_adapt;
+	struct client_rpc_adapt_win *win = &cra->cra_win[!!write];
+	struct obd_connect_data *ocd = &cli->cl_import->imp_connect_data;
+	__u32 rif = cli->cl_max_rpcs_in_flight;
+	__u32 pages = cli->cl_max_pages_per_rpc;
+	__u32 rif_max;
+	__u32 pages_max;
+	__u64 avg;
+
+	win->craw_rtt_sum += div_u64(rtt * NSEC_PER_USEC, max(page_count, 1U));
+	if (++win->craw_count < rif)
+		return;
+
+	avg = div_u64(win->craw_rtt_sum, win->craw_count);
+	if (win->craw_rtt_min == 0 || avg < win->craw_rtt_min)
+		win->craw_rtt_min = avg;
+	if (win->craw_rtt_base == 0 || avg < win->craw_rtt_base ||
+	    ++win->craw_age >= OSC_RPC_ADAPT_BASE_AGE) {
+		/* probe above the remembered limits again only once the
+		 * baseline is refreshed */
+		if (win->craw_rtt_base != 0 && avg >= win->craw_rtt_base) {
+			cra->cra_rif_ceil = 0;
+			cra->cra_pages_ceil = 0;
+		}
+		win->craw_rtt_base = win->craw_rtt_min;
+		win->craw_rtt_min = 0;
+		win->craw_age = 0;
+	}
+
+	rif_max = min(cra->cra_rif_base * 4, (__u32)OSC_MAX_RIF_MAX);
+	if (cra->cra_rif_ceil != 0)
+		rif_max = min(rif_max, cra->cra_rif_ceil - 1);
+	pages_max = ocd->ocd_brw_size != 0 ?
+		    ocd->ocd_brw_size >> PAGE_SHIFT : PTLRPC_MAX_BRW_PAGES;
+	if (cra->cra_pages_ceil != 0)
+		pages_max = min(pages_max, cra->cra_pages_ceil - 1);
+
+	if (avg * 8 >= win->craw_rtt_base * OSC_RPC_ADAPT_QUEUED) {
+		if (pages > cra->cra_pages_base) {
+			cra->cra_pages_ceil = pages;
+			pages = max(pages / 2, cra->cra_pages_base);
+		} else if (rif > 1) {
+			cra->cra_rif_ceil = rif;
+			rif -= max(rif / 4, 1U);
+		}
+		/* the limits are shared by reads and writes */
+		cra->cra_win[0].craw_hold = OSC_RPC_ADAPT_HOLD;
+		cra->cra_win[1].craw_hold = OSC_RPC_ADAPT_HOLD;
+	} else if (win->craw_hold > 0) {
+		win->craw_hold--;
+	} else if (win->craw_limited &&
+		   avg * 8 <= win->craw_rtt_base * OSC_RPC_ADAPT_IDLE) {
+		if (rif < rif_max)
+			rif++;
+		else if (pages * 2 <= pages_max)
+			pages *= 2;
+	}
+
+	if (rif != cli->cl_max_rpcs_in_flight ||
+	    pages != cli->cl_max_pages_per_rpc) {
+		CDEBUG(D_CACHE, "%s: %s rtt %llu/%llu nsec per page, rpcs in "
+		       "flight %u->%u, pages per rpc %u->%u\n", cli_name(cli),
+		       write ? "write" : "read", avg, win->craw_rtt_base,
+		       cli->cl_max_rpcs_in_flight, rif,
+		       cli->cl_max_pages_per_rpc, pages);
+		cli->cl_max_rpcs_in_flight = rif;
+		cli->cl_max_pages_per_rpc = pages;
+		client_adjust_max_dirty(cli);
+	}
+
+	win->craw_count = 0;
+	win->craw_rtt_sum = 0;
+	win->craw_limited = 0;
+}
+
 static int brw_interpret(const struct lu_env *env,
                          struct ptlrpc_request *req, void *data, int rc)
 {
@@ -1620,6 +2072,8 @@ static int brw_interpret(const struct lu_env *env,
 	struct osc_extent *ext;
 	struct osc_extent *tmp;
 	struct client_obd *cli = aa->aa_cli;
+	struct timeval now;
+	long rtt = 0;
         ENTRY;
 
         rc = osc_brw_fini_request(req, rc);
@@ -1652,53 +2106,68 @@ static int brw_interpret(const struct lu_env *env,
 	if (rc == 0) {
 		struct obdo *oa = aa->aa_oa;
 		struct cl_attr *attr = &osc_env_info(env)->oti_attr;
-		unsigned long valid = 0;
+		unsigned long valid;
 		struct cl_object *obj;
 		struct osc_async_page *last;
-
-		last = brw_page2oap(aa->aa_ppga[aa->aa_page_count - 1]);
-		obj = osc2cl(last->oap_obj);
-
-		cl_object_attr_lock(obj);
-		if (oa->o_valid & OBD_MD_FLBLOCKS) {
-			attr->cat_blocks = oa->o_blocks;
-			valid |= CAT_BLOCKS;
-		}
-		if (oa->o_valid & OBD_MD_FLMTIME) {
-			attr->cat_mtime = oa->o_mtime;
-			valid |= CAT_MTIME;
-		}
-		if (oa->o_valid & OBD_MD_FLATIME) {
-			attr->cat_atime = oa->o_atime;
-			valid |= CAT_ATIME;
-		}
-		if (oa->o_valid & OBD_MD_FLCTIME) {
-			attr->cat_ctime = oa->o_ctime;
-			valid |= CAT_CTIME;
-		}
-
-		if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE) {
-			struct lov_oinfo *loi = cl2osc(obj)->oo_oinfo;
-			loff_t last_off = last->oap_count + last->oap_obj_off +
-				last->oap_page_off;
-
-			/* Change file size if this is an out of quota or
-			 * direct IO write and it extends the file size */
-			if (loi->loi_lvb.lvb_size < last_off) {
-				attr->cat_size = last_off;
-				valid |= CAT_SIZE;
+		u32 nr_objs = aa->aa_objs != NULL ? aa->aa_objs->obo_count : 1;
+		u32 end = 0;
+		u32 j;
+
+		/* the reply only carries the attributes of the first object,
+		 * the others just get their size and KMS updated, unless
+		 * they were not written */
+		for (j = 0; j < nr_objs; j++) {
+			end += osc_brw_obj_pages(aa->aa_objs, j,
+						 aa->aa_page_count);
+			if (aa->aa_objs != NULL && aa->aa_objs->obo_rc[j] != 0)
+				continue;
+			last = brw_page2oap(aa->aa_ppga[end - 1]);
+			obj = osc2cl(last->oap_obj);
+			valid = 0;
+
+			cl_object_attr_lock(obj);
+			if (j == 0 && oa->o_valid & OBD_MD_FLBLOCKS) {
+				attr->cat_blocks = oa->o_blocks;
+				valid |= CAT_BLOCKS;
 			}
-			/* Extend KMS if it's not a lockless write */
-			if (loi->loi_kms < last_off &&
-			    oap2osc_page(last)->ops_srvlock == 0) {
-				attr->cat_kms = last_off;
-				valid |= CAT_KMS;
+			if (j == 0 && oa->o_valid & OBD_MD_FLMTIME) {
+				attr->cat_mtime = oa->o_mtime;
+				valid |= CAT_MTIME;
+			}
+			if (j == 0 && oa->o_valid & OBD_MD_FLATIME) {
+				attr->cat_atime = oa->o_atime;
+				valid |= CAT_ATIME;
+			}
+			if (j == 0 && oa->o_valid & OBD_MD_FLCTIME) {
+				attr->cat_ctime = oa->o_ctime;
+				valid |= CAT_CTIME;
 			}
-		}
 
-		if (valid != 0)
-			cl_object_attr_update(env, obj, attr, valid);
-		cl_object_attr_unlock(obj);
+			if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE) {
+				struct lov_oinfo *loi = cl2osc(obj)->oo_oinfo;
+				loff_t last_off = last->oap_count +
+						  last->oap_obj_off +
+						  last->oap_page_off;
+
+				/* Change file size if this is an out of quota
+				 * or direct IO write and it extends the file
+				 * size */
+				if (loi->loi_lvb.lvb_size < last_off) {
+					attr->cat_size = last_off;
+					valid |= CAT_SIZE;
+				}
+				/* Extend KMS if it's not a lockless write */
+				if (loi->loi_kms < last_off &&
+				    oap2osc_page(last)->ops_srvlock == 0) {
+					attr->cat_kms = last_off;
+					valid |= CAT_KMS;
+				}
+			}
+
+			if (valid != 0)
+				cl_object_attr_update(env, obj, attr, valid);
+			cl_object_attr_unlock(obj);
+		}
 	}
 	OBDO_FREE(aa->aa_oa);
 
@@ -1707,15 +2176,28 @@ static int brw_interpret(const struct lu_env *env,
 
 	list_for_each_entry_safe(ext, tmp, &aa->aa_exts, oe_link) {
 		list_del_init(&ext->oe_link);
-		osc_extent_finish(env, ext, 1, rc);
+		osc_extent_finish(env, ext, 1,
+				  rc != 0 ? rc : osc_brw_obj_rc(aa, ext));
 	}
 	LASSERT(list_empty(&aa->aa_exts));
 	LASSERT(list_empty(&aa->aa_oaps));
 
 	osc_release_ppga(aa->aa_ppga, aa->aa_page_count);
-	ptlrpc_lprocfs_brw(req, req->rq_bulk->bd_nob_transferred);
+	if (aa->aa_objs != NULL)
+		osc_brw_objs_free(aa->aa_objs);
+	ptlrpc_lprocfs_brw(req, req->rq_bulk != NULL ?
+			   req->rq_bulk->bd_nob_transferred :
+			   aa->aa_requested_nob);
+
+	if (rc == 0 && aa->aa_resends == 0) {
+		do_gettimeofday(&now);
+		rtt = cfs_timeval_sub(&now, &req->rq_sent_tv, NULL);
+	}
 
 	spin_lock(&cli->cl_loi_list_lock);
+	if (rtt > 0 && cli->cl_rpc_adapt.cra_enabled)
+		osc_rpc_adapt(cli, lustre_msg_get_opc(req->rq_reqmsg) ==
+				   OST_WRITE, rtt, aa->aa_page_count);
 	/* We need to decrement before osc_ap_completion->osc_wake_cache_waiters
 	 * is called so we know whether to go to sync BRWs or wait for more
 	 * RPCs to complete */
@@ -1763,30 +2245,39 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 	struct obdo			*oa = NULL;
 	struct osc_async_page		*oap;
 	struct osc_object		*obj = NULL;
+	struct osc_object		*ext_obj = NULL;
+	struct osc_brw_objs		*objs = NULL;
 	struct cl_req_attr		*crattr = NULL;
 	loff_t				starting_offset = OBD_OBJECT_EOF;
 	loff_t				ending_offset = 0;
+	loff_t				obj_start;
+	loff_t				obj_end;
 	int				mpflag = 0;
 	int				mem_tight = 0;
 	int				page_count = 0;
 	bool				soft_sync = false;
 	bool				interrupted = false;
 	int				i;
-	int				grant = 0;
+	u32				nr_objs = 0;
+	u32				j;
 	int				rc;
 	struct list_head		rpc_list = LIST_HEAD_INIT(rpc_list);
 	struct ost_body			*body;
 	ENTRY;
 	LASSERT(!list_empty(ext_list));
 
-	/* add pages into rpc_list to build BRW rpc */
+	/* add pages into rpc_list to build BRW rpc, the extents of one
+	 * object are adjacent in the list */
 	list_for_each_entry(ext, ext_list, oe_link) {
 		LASSERT(ext->oe_state == OES_RPC);
 		mem_tight |= ext->oe_memalloc;
-		grant += ext->oe_grants;
 		page_count += ext->oe_nr_pages;
 		if (obj == NULL)
 			obj = ext->oe_obj;
+		if (ext->oe_obj != ext_obj) {
+			ext_obj = ext->oe_obj;
+			nr_objs++;
+		}
 	}
 
 	soft_sync = osc_over_unstable_soft_limit(cli);
@@ -1801,8 +2292,52 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 	if (oa == NULL)
 		GOTO(out, rc = -ENOMEM);
 
+	if (nr_objs > 1) {
+		LASSERT(cmd == OBD_BRW_WRITE);
+		objs = osc_brw_objs_alloc(nr_objs);
+		if (objs == NULL)
+			GOTO(out, rc = -ENOMEM);
+	}
+
+	crattr = &osc_env_info(env)->oti_req_attr;
+	memset(crattr, 0, sizeof(*crattr));
+	crattr->cra_type = (cmd & OBD_BRW_WRITE) ? CRT_WRITE : CRT_READ;
+	/* sync extents queued on behalf of another job, e.g. by read-ahead
+	 * threads, are accounted to it rather than to the inode jobid */
+	list_for_each_entry(ext, ext_list, oe_link) {
+		if (ext->oe_jobid[0] != '\0') {
+			memcpy(crattr->cra_jobid, ext->oe_jobid,
+			       LUSTRE_JOBID_SIZE);
+			break;
+		}
+	}
+
 	i = 0;
+	j = 0;
+	ext_obj = NULL;
+	obj_start = OBD_OBJECT_EOF;
+	obj_end = 0;
 	list_for_each_entry(ext, ext_list, oe_link) {
+		if (ext->oe_obj != ext_obj) {
+			if (ext_obj != NULL) {
+				j++;
+				obj_start = OBD_OBJECT_EOF;
+				obj_end = 0;
+			}
+			ext_obj = ext->oe_obj;
+
+			/* first page of this object */
+			oap = list_entry(ext->oe_pages.next, typeof(*oap),
+					 oap_pending_item);
+			crattr->cra_flags = ~0ULL;
+			crattr->cra_page = oap2cl_page(oap);
+			crattr->cra_oa = osc_brw_obj_oa(oa, objs, j);
+			cl_req_attr_set(env, osc2cl(ext_obj), crattr);
+		}
+		if (cmd == OBD_BRW_WRITE)
+			osc_brw_obj_oa(oa, objs, j)->o_grant_used +=
+				ext->oe_grants;
+
 		list_for_each_entry(oap, &ext->oe_pages, oap_pending_item) {
 			if (mem_tight)
 				oap->oap_brw_flags |= OBD_BRW_MEMALLOC;
@@ -1811,45 +2346,48 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 			pga[i] = &oap->oap_brw_page;
 			pga[i]->off = oap->oap_obj_off + oap->oap_page_off;
 			i++;
+			if (objs != NULL)
+				objs->obo_pages[j]++;
 
 			list_add_tail(&oap->oap_rpc_item, &rpc_list);
-			if (starting_offset == OBD_OBJECT_EOF ||
-			    starting_offset > oap->oap_obj_off)
-				starting_offset = oap->oap_obj_off;
+			if (obj_start == OBD_OBJECT_EOF ||
+			    obj_start > oap->oap_obj_off)
+				obj_start = oap->oap_obj_off;
 			else
 				LASSERT(oap->oap_page_off == 0);
-			if (ending_offset < oap->oap_obj_off + oap->oap_count)
-				ending_offset = oap->oap_obj_off +
-						oap->oap_count;
+			if (obj_end < oap->oap_obj_off + oap->oap_count)
+				obj_end = oap->oap_obj_off + oap->oap_count;
 			else
 				LASSERT(oap->oap_page_off + oap->oap_count ==
 					PAGE_SIZE);
 			if (oap->oap_interrupted)
 				interrupted = true;
 		}
+		if (j == 0) {
+			starting_offset = obj_start;
+			ending_offset = obj_end;
+		}
 	}
+	LASSERT(j == nr_objs - 1);
 
-	/* first page in the list */
-	oap = list_entry(rpc_list.next, typeof(*oap), oap_rpc_item);
+	/* disk allocation on the target goes object by object */
+	for (i = 0, j = 0; j < nr_objs; j++) {
+		u32 count = osc_brw_obj_pages(objs, j, page_count);
 
-	crattr = &osc_env_info(env)->oti_req_attr;
-	memset(crattr, 0, sizeof(*crattr));
-	crattr->cra_type = (cmd & OBD_BRW_WRITE) ? CRT_WRITE : CRT_READ;
-	crattr->cra_flags = ~0ULL;
-	crattr->cra_page = oap2cl_page(oap);
-	crattr->cra_oa = oa;
-	cl_req_attr_set(env, osc2cl(obj), crattr);
-
-	if (cmd == OBD_BRW_WRITE)
-		oa->o_grant_used = grant;
+		sort_brw_pages(pga + i, count);
+		i += count;
+	}
 
-	sort_brw_pages(pga, page_count);
-	rc = osc_brw_prep_request(cmd, cli, oa, page_count, pga, &req, 0);
+	rc = osc_brw_prep_request(cmd, cli, oa, page_count, pga, objs,
+				  &req, 0);
 	if (rc != 0) {
 		CERROR("prep_req failed: %d\n", rc);
 		GOTO(out, rc);
 	}
 
+	/* first page in the list */
+	oap = list_entry(rpc_list.next, typeof(*oap), oap_rpc_item);
+
 	req->rq_commit_cb = brw_commit;
 	req->rq_interpret_reply = brw_interpret;
 	req->rq_memalloc = mem_tight != 0;
@@ -1865,7 +2403,25 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 	body = req_capsule_client_get(&req->rq_pill, &RMF_OST_BODY);
 	crattr->cra_oa = &body->oa;
 	crattr->cra_flags = OBD_MD_FLMTIME|OBD_MD_FLCTIME|OBD_MD_FLATIME;
+	crattr->cra_page = oap2cl_page(oap);
 	cl_req_attr_set(env, osc2cl(obj), crattr);
+	if (objs != NULL) {
+		struct obdo *obdos = req_capsule_client_get(&req->rq_pill,
+							    &RMF_OST_OBDOS);
+
+		for (i = 0, j = 0; j < nr_objs; j++) {
+			if (j > 0) {
+				struct osc_async_page *first;
+
+				first = brw_page2oap(pga[i]);
+				crattr->cra_oa = &obdos[j - 1];
+				crattr->cra_page = oap2cl_page(first);
+				cl_req_attr_set(env, osc2cl(first->oap_obj),
+						crattr);
+			}
+			i += objs->obo_pages[j];
+		}
+	}
 	lustre_msg_set_jobid(req->rq_reqmsg, crattr->cra_jobid);
 
 	CLASSERT(sizeof(*aa) <= sizeof(req->rq_async_args));
@@ -1910,6 +2466,8 @@ out:
 
 		if (oa)
 			OBDO_FREE(oa);
+		if (objs != NULL)
+			osc_brw_objs_free(objs);
 		if (pga)
 			OBD_FREE(pga, sizeof(*pga) * page_count);
 		/* this should happen rarely and is pretty bad, it makes the
@@ -2747,9 +3305,16 @@ int osc_setup(struct obd_device *obd, struct lustre_cfg *lcfg)
 	if (rc)
 		GOTO(out_ptlrpcd, rc);
 
+	cli->cl_lru_cpts = cfs_percpt_alloc(cfs_cpt_table,
+					    sizeof(**cli->cl_lru_cpts));
+	if (cli->cl_lru_cpts == NULL)
+		GOTO(out_client_setup, rc = -ENOMEM);
+	osc_lru_cpts_init(cli);
+	osc_coalesce_init(cli);
+
 	handler = ptlrpcd_alloc_work(cli->cl_import, brw_queue_work, cli);
 	if (IS_ERR(handler))
-		GOTO(out_client_setup, rc = PTR_ERR(handler));
+		GOTO(out_lru_cpts, rc = PTR_ERR(handler));
 	cli->cl_writeback_work = handler;
 
 	handler = ptlrpcd_alloc_work(cli->cl_import, lru_queue_work, cli);
@@ -2826,6 +3391,9 @@ out_ptlrpcd_work:
 		ptlrpcd_destroy_work(cli->cl_lru_work);
 		cli->cl_lru_work = NULL;
 	}
+out_lru_cpts:
+	cfs_percpt_free(cli->cl_lru_cpts);
+	cli->cl_lru_cpts = NULL;
 out_client_setup:
 	client_obd_cleanup(obd);
 out_ptlrpcd:
@@ -2848,6 +3416,7 @@ static int osc_precleanup(struct obd_device *obd)
 	 *   client_disconnect_export()
 	 */
 	obd_zombie_barrier();
+	osc_coalesce_fini(cli);
 	if (cli->cl_writeback_work) {
 		ptlrpcd_destroy_work(cli->cl_writeback_work);
 		cli->cl_writeback_work = NULL;
@@ -2886,6 +3455,11 @@ int osc_cleanup(struct obd_device *obd)
 		cli->cl_cache = NULL;
 	}
 
+	if (cli->cl_lru_cpts != NULL) {
+		cfs_percpt_free(cli->cl_lru_cpts);
+		cli->cl_lru_cpts = NULL;
+	}
+
 	/* free memory of osc quota cache */
 	osc_quota_cleanup(obd);
 
@@ -2055,6 +2055,7 @@ static void osd_conf_get(const struct lu_env *env,
 	param->ddp_max_extent_blks = EXT_INIT_MAX_LEN >> 2;
 	/* worst-case extent insertion metadata overhead */
 	param->ddp_extent_tax = 6 * LDISKFS_BLOCK_SIZE(sb);
+	param->ddp_t10_cksum_type = osd_dt_dev(dev)->od_t10_type;
 	param->ddp_mntopts      = 0;
         if (test_opt(sb, XATTR_USER))
                 param->ddp_mntopts |= MNTOPT_USERXATTR;
@@ -6593,6 +6594,8 @@ static void osd_key_fini(const struct lu_context *ctx,
 	OBD_FREE(info->oti_it_ea_buf, OSD_IT_EA_BUFSIZE);
 	lu_buf_free(&info->oti_iobuf.dr_pg_buf);
 	lu_buf_free(&info->oti_iobuf.dr_bl_buf);
+	lu_buf_free(&info->oti_iobuf.dr_lnb_buf);
+	osd_iobuf_pi_free(&info->oti_iobuf);
 	lu_buf_free(&info->oti_big_buf);
 	if (idc != NULL) {
 		LASSERT(info->oti_ins_cache_size > 0);
@@ -6849,6 +6852,11 @@ static int osd_mount(const struct lu_env *env,
 		GOTO(out_mnt, rc = -EINVAL);
 	}
 
+	o->od_t10_type = osd_t10_type(osd_sb(o)->s_bdev);
+	if (o->od_t10_type != 0)
+		CDEBUG(D_CONFIG, "%s: device %s stores T10 guard tags %#x\n",
+		       name, dev, o->od_t10_type);
+
 #ifdef LDISKFS_MOUNT_DIRDATA
 	if (LDISKFS_HAS_INCOMPAT_FEATURE(o->od_mnt->mnt_sb,
 					 LDISKFS_FEATURE_INCOMPAT_DIRDATA))
@@ -300,6 +300,10 @@ struct osd_device {
 
 	/* a list of orphaned agent inodes, protected with od_osfs_lock */
 	struct list_head	 od_orphan_list;
+
+	/* OBD_CKSUM_T10* type matching the integrity profile of the block
+	 * device, 0 if the device does not store protection information */
+	cksum_type_t		 od_t10_type;
 };
 
 enum osd_full_scrub_ratio {
@@ -498,8 +502,16 @@ struct osd_iobuf {
 	unsigned int       dr_ignore_quota:1;
 	unsigned int       dr_elapsed_valid:1; /* we really did count time */
 	unsigned int       dr_rw:1;
+	/* carry the guard tags of the local buffers to/from the disk */
+	unsigned int	   dr_pi:1;
 	struct lu_buf	   dr_pg_buf;
 	struct page      **dr_pages;
+	struct lu_buf	   dr_lnb_buf;
+	struct niobuf_local **dr_lnbs;
+	/* pages holding the protection information tuples of the I/O */
+	struct lu_buf	   dr_pi_buf;
+	struct page	 **dr_pi_pages;
+	int		   dr_pi_npages;
 	struct lu_buf	   dr_bl_buf;
 	sector_t	  *dr_blocks;
 	unsigned long      dr_start_time;
@@ -1231,5 +1243,7 @@ void ldiskfs_inc_count(handle_t *handle, struct inode *inode);
 void ldiskfs_dec_count(handle_t *handle, struct inode *inode);
 
 void osd_fini_iobuf(struct osd_device *d, struct osd_iobuf *iobuf);
+void osd_iobuf_pi_free(struct osd_iobuf *iobuf);
+cksum_type_t osd_t10_type(struct block_device *bdev);
 
 #endif /* _OSD_INTERNAL_H */
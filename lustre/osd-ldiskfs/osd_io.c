@@ -50,6 +50,7 @@
  * OBD_FAIL_CHECK
  */
 #include <obd_support.h>
+#include <obd_cksum.h>
 
 #include "osd_internal.h"
 
@@ -76,12 +77,15 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 	iobuf->dr_elapsed = 0;
 	/* must be counted before, so assert */
 	iobuf->dr_rw = rw;
+	iobuf->dr_pi = 0;
 	iobuf->dr_init_at = line;
 
 	blocks = pages * (PAGE_SIZE >> osd_sb(d)->s_blocksize_bits);
 	if (iobuf->dr_bl_buf.lb_len >= blocks * sizeof(iobuf->dr_blocks[0])) {
 		LASSERT(iobuf->dr_pg_buf.lb_len >=
 			pages * sizeof(iobuf->dr_pages[0]));
+		LASSERT(iobuf->dr_lnb_buf.lb_len >=
+			pages * sizeof(iobuf->dr_lnbs[0]));
 		return 0;
 	}
 
@@ -108,6 +112,11 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 	if (unlikely(iobuf->dr_pages == NULL))
 		return -ENOMEM;
 
+	lu_buf_realloc(&iobuf->dr_lnb_buf, pages * sizeof(iobuf->dr_lnbs[0]));
+	iobuf->dr_lnbs = iobuf->dr_lnb_buf.lb_buf;
+	if (unlikely(iobuf->dr_lnbs == NULL))
+		return -ENOMEM;
+
 	iobuf->dr_max_pages = pages;
 
 	return 0;
@@ -115,10 +124,12 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 #define osd_init_iobuf(dev, iobuf, rw, pages) \
 	__osd_init_iobuf(dev, iobuf, rw, __LINE__, pages)
 
-static void osd_iobuf_add_page(struct osd_iobuf *iobuf, struct page *page)
+static void osd_iobuf_add_page(struct osd_iobuf *iobuf,
+			       struct niobuf_local *lnb)
 {
-        LASSERT(iobuf->dr_npages < iobuf->dr_max_pages);
-        iobuf->dr_pages[iobuf->dr_npages++] = page;
+	LASSERT(iobuf->dr_npages < iobuf->dr_max_pages);
+	iobuf->dr_lnbs[iobuf->dr_npages] = lnb;
+	iobuf->dr_pages[iobuf->dr_npages++] = lnb->lnb_page;
 }
 
 void osd_fini_iobuf(struct osd_device *d, struct osd_iobuf *iobuf)
@@ -251,6 +262,248 @@ static int can_be_merged(struct bio *bio, sector_t sector)
 	return bio_end_sector(bio) == sector ? 1 : 0;
 }
 
+#ifdef CONFIG_BLK_DEV_INTEGRITY
+/* protection information tuple of the T10 DIF type 1 integrity profiles */
+struct osd_dif_tuple {
+	__be16	odt_guard_tag;
+	__be16	odt_app_tag;
+	__be32	odt_ref_tag;
+};
+
+#define OSD_DIF_TUPLES_PER_PAGE	(PAGE_SIZE / sizeof(struct osd_dif_tuple))
+
+/**
+ * OBD_CKSUM_T10* type matching the integrity profile of \a bdev.
+ *
+ * The guard tags of the type 1 profiles protecting 512-byte sectors are the
+ * ones of the T10 checksum types, so the guard tags a client computed can be
+ * stored as is.  The reference tag is the sector number.
+ *
+ * \param[in] bdev	block device of the OSD
+ *
+ * \retval		OBD_CKSUM_T10* type of the device, 0 if none
+ */
+cksum_type_t osd_t10_type(struct block_device *bdev)
+{
+	struct blk_integrity *bi = bdev_get_integrity(bdev);
+	const char *name;
+
+	if (bi == NULL || bi->tuple_size != sizeof(struct osd_dif_tuple) ||
+	    bdev_logical_block_size(bdev) != OBD_DIF_SECTOR_SIZE)
+		return 0;
+
+#ifdef HAVE_BLK_INTEGRITY_PROFILE
+	name = bi->profile != NULL ? bi->profile->name : NULL;
+#else
+	name = bi->name;
+#endif
+	if (name == NULL)
+		return 0;
+
+	if (strcmp(name, "T10-DIF-TYPE1-IP") == 0)
+		return OBD_CKSUM_T10IP512;
+	if (strcmp(name, "T10-DIF-TYPE1-CRC") == 0 &&
+	    obd_t10_cksum2dif(OBD_CKSUM_T10CRC512) != NULL)
+		return OBD_CKSUM_T10CRC512;
+
+	return 0;
+}
+
+/* make room for the tuples of all the sectors of the pages of \a iobuf */
+static int osd_iobuf_pi_alloc(struct osd_iobuf *iobuf)
+{
+	int npages = DIV_ROUND_UP(iobuf->dr_npages * OBD_GUARDS_PER_PAGE,
+				  OSD_DIF_TUPLES_PER_PAGE);
+	int rc;
+
+	if (npages <= iobuf->dr_pi_npages)
+		return 0;
+
+	rc = lu_buf_check_and_grow(&iobuf->dr_pi_buf,
+				   npages * sizeof(iobuf->dr_pi_pages[0]));
+	if (rc != 0)
+		return rc;
+	iobuf->dr_pi_pages = iobuf->dr_pi_buf.lb_buf;
+
+	while (iobuf->dr_pi_npages < npages) {
+		struct page *page = alloc_page(GFP_NOFS);
+
+		if (page == NULL)
+			return -ENOMEM;
+		iobuf->dr_pi_pages[iobuf->dr_pi_npages++] = page;
+	}
+
+	return 0;
+}
+
+void osd_iobuf_pi_free(struct osd_iobuf *iobuf)
+{
+	while (iobuf->dr_pi_npages > 0)
+		__free_page(iobuf->dr_pi_pages[--iobuf->dr_pi_npages]);
+	lu_buf_free(&iobuf->dr_pi_buf);
+	iobuf->dr_pi_pages = NULL;
+}
+
+/* attach the protection information of \a iobuf to a new \a bio */
+static int osd_bio_pi_start(struct osd_iobuf *iobuf, struct bio *bio,
+			    sector_t sector)
+{
+	struct bio_integrity_payload *bip;
+
+	if (!iobuf->dr_pi)
+		return 0;
+
+	bip = bio_integrity_alloc(bio, GFP_NOIO, bio->bi_max_vecs);
+	if (bip == NULL)
+		return -ENOMEM;
+#ifdef HAVE_BVEC_ITER
+	bip->bip_iter.bi_sector = sector;
+#else
+	bip->bip_sector = sector;
+#endif
+	return 0;
+}
+
+/*
+ * Add the tuples of the \a len bytes at \a page_offset of the page_idx-th
+ * page of \a iobuf to \a bio.  For a write the tuples are filled with the
+ * guard tags the client sent, or computed here for the sectors it did not
+ * send, e.g. those read in by osd_write_prep().
+ */
+static int osd_bio_pi_add(struct osd_device *osd, struct osd_iobuf *iobuf,
+			  struct bio *bio, int page_idx,
+			  unsigned int page_offset, unsigned int len,
+			  sector_t sector)
+{
+	struct bio_integrity_payload *bip = bio->bi_integrity;
+	int sector_idx = page_offset / OBD_DIF_SECTOR_SIZE;
+	int nr = len / OBD_DIF_SECTOR_SIZE;
+	int idx = page_idx * OBD_GUARDS_PER_PAGE + sector_idx;
+	struct page *pi_page = iobuf->dr_pi_pages[idx / OSD_DIF_TUPLES_PER_PAGE];
+	unsigned int pi_offset = (idx % OSD_DIF_TUPLES_PER_PAGE) *
+				 sizeof(struct osd_dif_tuple);
+	unsigned int pi_len = nr * sizeof(struct osd_dif_tuple);
+
+	if (!iobuf->dr_pi)
+		return 0;
+
+	if (iobuf->dr_rw == 1) {
+		struct niobuf_local *lnb = iobuf->dr_lnbs[page_idx];
+		obd_dif_csum_fn *fn = obd_t10_cksum2dif(osd->od_t10_type);
+		int first = lnb->lnb_page_offset / OBD_DIF_SECTOR_SIZE;
+		int last = (lnb->lnb_page_offset + lnb->lnb_len) /
+			   OBD_DIF_SECTOR_SIZE;
+		struct osd_dif_tuple *tuple;
+		unsigned char *data = NULL;
+		int i;
+
+		tuple = kmap(pi_page) + pi_offset;
+		for (i = 0; i < nr; i++, tuple++) {
+			int s = sector_idx + i;
+
+			if (lnb->lnb_guard_rpc && s >= first && s < last) {
+				tuple->odt_guard_tag = lnb->lnb_guards[s];
+			} else {
+				if (data == NULL)
+					data = kmap(iobuf->dr_pages[page_idx]);
+				tuple->odt_guard_tag =
+					fn(data + s * OBD_DIF_SECTOR_SIZE,
+					   OBD_DIF_SECTOR_SIZE);
+			}
+			tuple->odt_app_tag = 0;
+			tuple->odt_ref_tag = cpu_to_be32(sector + i);
+		}
+		if (data != NULL)
+			kunmap(iobuf->dr_pages[page_idx]);
+		kunmap(pi_page);
+	}
+
+	if (bio_integrity_add_page(bio, pi_page, pi_len, pi_offset) < pi_len)
+		return -ENOMEM;
+#ifdef HAVE_BVEC_ITER
+	bip->bip_iter.bi_size += pi_len;
+#else
+	bip->bip_size += pi_len;
+#endif
+	return 0;
+}
+
+/*
+ * Return the guard tags a read got from the disk in the local buffers that
+ * asked for them, the sectors of holes have none.
+ */
+static void osd_iobuf_pi_complete(struct osd_iobuf *iobuf,
+				  int blocks_per_page)
+{
+	int page_idx;
+
+	for (page_idx = 0; page_idx < iobuf->dr_npages; page_idx++) {
+		struct niobuf_local *lnb = iobuf->dr_lnbs[page_idx];
+		int idx = page_idx * OBD_GUARDS_PER_PAGE;
+		struct page *pi_page;
+		struct osd_dif_tuple *tuple;
+		int i;
+
+		if (!lnb->lnb_guard_disk)
+			continue;
+
+		for (i = 0; i < blocks_per_page; i++)
+			if (iobuf->dr_blocks[page_idx * blocks_per_page + i] ==
+			    0)
+				break;
+		if (!iobuf->dr_pi || iobuf->dr_error != 0 ||
+		    i < blocks_per_page) {
+			lnb->lnb_guard_disk = 0;
+			continue;
+		}
+
+		pi_page = iobuf->dr_pi_pages[idx / OSD_DIF_TUPLES_PER_PAGE];
+		tuple = kmap(pi_page) + (idx % OSD_DIF_TUPLES_PER_PAGE) *
+					sizeof(*tuple);
+		for (i = 0; i < OBD_GUARDS_PER_PAGE; i++)
+			lnb->lnb_guards[i] = tuple[i].odt_guard_tag;
+		kunmap(pi_page);
+	}
+}
+#else /* !CONFIG_BLK_DEV_INTEGRITY */
+cksum_type_t osd_t10_type(struct block_device *bdev)
+{
+	return 0;
+}
+
+static inline int osd_iobuf_pi_alloc(struct osd_iobuf *iobuf)
+{
+	return -EOPNOTSUPP;
+}
+
+void osd_iobuf_pi_free(struct osd_iobuf *iobuf)
+{
+}
+
+static inline int osd_bio_pi_start(struct osd_iobuf *iobuf, struct bio *bio,
+				   sector_t sector)
+{
+	return 0;
+}
+
+static inline int osd_bio_pi_add(struct osd_device *osd,
+				 struct osd_iobuf *iobuf, struct bio *bio,
+				 int page_idx, unsigned int page_offset,
+				 unsigned int len, sector_t sector)
+{
+	return 0;
+}
+
+static void osd_iobuf_pi_complete(struct osd_iobuf *iobuf,
+				  int blocks_per_page)
+{
+	int page_idx;
+
+	for (page_idx = 0; page_idx < iobuf->dr_npages; page_idx++)
+		iobuf->dr_lnbs[page_idx]->lnb_guard_disk = 0;
+}
+#endif /* CONFIG_BLK_DEV_INTEGRITY */
+
 static int osd_do_bio(struct osd_device *osd, struct inode *inode,
                       struct osd_iobuf *iobuf)
 {
@@ -274,8 +527,12 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
 
         LASSERT(iobuf->dr_npages == npages);
 
-        osd_brw_stats_update(osd, iobuf);
-        iobuf->dr_start_time = cfs_time_current();
+	osd_brw_stats_update(osd, iobuf);
+	iobuf->dr_start_time = cfs_time_current();
+
+	/* without room for the tuples let the block layer handle them */
+	if (iobuf->dr_pi && osd_iobuf_pi_alloc(iobuf) != 0)
+		iobuf->dr_pi = 0;
 
         for (page_idx = 0, block_idx = 0;
              page_idx < npages;
@@ -308,11 +565,18 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
                                 sector_bits))
                                 nblocks++;
 
-                        if (bio != NULL &&
-                            can_be_merged(bio, sector) &&
-                            bio_add_page(bio, page,
-                                         blocksize * nblocks, page_offset) != 0)
-                                continue;       /* added this frag OK */
+			if (bio != NULL &&
+			    can_be_merged(bio, sector) &&
+			    bio_add_page(bio, page,
+					 blocksize * nblocks, page_offset) != 0) {
+				rc = osd_bio_pi_add(osd, iobuf, bio, page_idx,
+						    page_offset,
+						    blocksize * nblocks,
+						    sector);
+				if (rc != 0)
+					goto out_put;
+				continue;       /* added this frag OK */
+			}
 
 			if (bio != NULL) {
 				struct request_queue *q =
@@ -350,9 +614,19 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
 			bio->bi_end_io = dio_complete_routine;
 			bio->bi_private = iobuf;
 
+			rc = osd_bio_pi_start(iobuf, bio, sector);
+			if (rc != 0)
+				goto out_put;
+
 			rc = bio_add_page(bio, page,
 					  blocksize * nblocks, page_offset);
 			LASSERT(rc != 0);
+
+			rc = osd_bio_pi_add(osd, iobuf, bio, page_idx,
+					    page_offset, blocksize * nblocks,
+					    sector);
+			if (rc != 0)
+				goto out_put;
 		}
 	}
 
@@ -361,7 +635,12 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
 		osd_submit_bio(iobuf->dr_rw, bio);
 		rc = 0;
 	}
+	goto out;
 
+out_put:
+	CERROR("%s: can't attach protection information to bio: rc = %d\n",
+	       osd_name(osd), rc);
+	bio_put(bio);
 out:
 	/* in order to achieve better IO throughput, we don't wait for writes
 	 * completion here. instead we proceed with transaction commit in
@@ -371,6 +650,7 @@ out:
 		wait_event(iobuf->dr_wait,
 			   atomic_read(&iobuf->dr_numreqs) == 0);
 		osd_fini_iobuf(osd, iobuf);
+		osd_iobuf_pi_complete(iobuf, blocks_per_page);
 	}
 
 	if (rc == 0)
@@ -398,6 +678,8 @@ static int osd_map_remote_to_local(loff_t offset, ssize_t len, int *nrpages,
 		lnb->lnb_flags = 0;
 		lnb->lnb_page = NULL;
 		lnb->lnb_rc = 0;
+		lnb->lnb_guard_rpc = 0;
+		lnb->lnb_guard_disk = 0;
 
                 LASSERTF(plen <= len, "plen %u, len %lld\n", plen,
                          (long long) len);
@@ -1003,7 +1285,7 @@ static int osd_write_prep(const struct lu_env *env, struct dt_object *dt,
 			continue;
 
 		if (maxidx >= lnb[i].lnb_page->index) {
-			osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+			osd_iobuf_add_page(iobuf, &lnb[i]);
 		} else {
 			long off;
 			char *p = kmap(lnb[i].lnb_page);
@@ -1254,7 +1536,10 @@ static int osd_write_commit(const struct lu_env *env, struct dt_object *dt,
 
 		SetPageUptodate(lnb[i].lnb_page);
 
-		osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+		if (osd->od_t10_type != 0 && lnb[i].lnb_guard_rpc)
+			iobuf->dr_pi = 1;
+
+		osd_iobuf_add_page(iobuf, &lnb[i]);
         }
 
 	osd_trans_exec_op(env, thandle, OSD_OT_WRITE);
@@ -1344,9 +1629,13 @@ static int osd_read_prep(const struct lu_env *env, struct dt_object *dt,
 
 		if (PageUptodate(lnb[i].lnb_page)) {
 			cache_hits++;
+			/* the guard tags are only read with the data */
+			lnb[i].lnb_guard_disk = 0;
 		} else {
 			cache_misses++;
-			osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+			if (osd->od_t10_type != 0 && lnb[i].lnb_guard_disk)
+				iobuf->dr_pi = 1;
+			osd_iobuf_add_page(iobuf, &lnb[i]);
 		}
 
 		if (cache == 0)
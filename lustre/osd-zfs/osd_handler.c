@@ -606,6 +606,8 @@ static void osd_conf_get(const struct lu_env *env,
 	param->ddp_max_extent_blks =
 		(1 << (DN_MAX_INDBLKSHIFT - SPA_BLKPTRSHIFT));
 	param->ddp_extent_tax = osd_blk_insert_cost(osd);
+	/* DMU blocks are checksummed by ZFS itself */
+	param->ddp_t10_cksum_type = 0;
 }
 
 /*
@@ -62,6 +62,8 @@ EXPORT_SYMBOL(ptlrpc_bulk_kvec_ops);
 
 static int ptlrpc_send_new_req(struct ptlrpc_request *req);
 static int ptlrpcd_check_work(struct ptlrpc_request *req);
+static struct ptlrpc_request *
+ptlrpc_set_changed_next(struct ptlrpc_request *req);
 static int ptlrpc_unregister_reply(struct ptlrpc_request *request, int async);
 
 /**
@@ -1046,6 +1048,13 @@ void ptlrpc_set_destroy(struct ptlrpc_request_set *set)
 
 	LASSERT(atomic_read(&set->set_remaining) == 0);
 
+	while (set->set_changed != NULL) {
+		struct ptlrpc_request *req = set->set_changed;
+
+		set->set_changed = ptlrpc_set_changed_next(req);
+		ptlrpc_req_finished(req);
+	}
+
 	ptlrpc_reqset_put(set);
 	EXIT;
 }
@@ -1133,6 +1142,9 @@ void ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
 		 *      no other better choice. It maybe fixed in future. */
 		for (i = 0; i < pc->pc_npartners; i++)
 			wake_up(&pc->pc_partners[i]->pc_set->set_waitq);
+	} else {
+		/* the thread is busy, let an idle one steal some */
+		ptlrpcd_wake_idle(pc, count);
 	}
 }
 
@@ -1665,420 +1677,536 @@ static inline int ptlrpc_set_producer(struct ptlrpc_request_set *set)
 }
 
 /**
- * this sends any unsent RPCs in \a set and returns 1 if all are sent
- * and no more replies are expected.
- * (it is possible to get less replies than requests sent e.g. due to timed out
- * requests or requests that we had trouble to send out)
+ * Move request \a req of \a set along its state machine, called by
+ * ptlrpc_check_set().  Completed requests are moved to \a comp_reqs.
  *
- * NOTE: This function contains a potential schedule point (cond_resched()).
+ * \retval 1 if the set timeout needs to be recalculated
  */
-int ptlrpc_check_set(const struct lu_env *env, struct ptlrpc_request_set *set)
+static int ptlrpc_check_req(const struct lu_env *env,
+			    struct ptlrpc_request_set *set,
+			    struct ptlrpc_request *req,
+			    struct list_head *comp_reqs)
 {
-	struct list_head *tmp, *next;
-	struct list_head  comp_reqs;
+	struct obd_import *imp = req->rq_import;
 	int force_timer_recalc = 0;
-	ENTRY;
-
-	if (atomic_read(&set->set_remaining) == 0)
-		RETURN(1);
-
-	INIT_LIST_HEAD(&comp_reqs);
-	list_for_each_safe(tmp, next, &set->set_requests) {
-		struct ptlrpc_request *req =
-			list_entry(tmp, struct ptlrpc_request,
-				   rq_set_chain);
-		struct obd_import *imp = req->rq_import;
-		int unregistered = 0;
-		int async = 1;
-		int rc = 0;
-
-		if (req->rq_phase == RQ_PHASE_COMPLETE) {
-			list_move_tail(&req->rq_set_chain, &comp_reqs);
-			continue;
-		}
+	int unregistered = 0;
+	int async = 1;
+	int rc = 0;
 
-		/* This schedule point is mainly for the ptlrpcd caller of this
-		 * function.  Most ptlrpc sets are not long-lived and unbounded
-		 * in length, but at the least the set used by the ptlrpcd is.
-		 * Since the processing time is unbounded, we need to insert an
-		 * explicit schedule point to make the thread well-behaved.
-		 */
-		cond_resched();
+	if (req->rq_phase == RQ_PHASE_COMPLETE) {
+		list_move_tail(&req->rq_set_chain, comp_reqs);
+		return force_timer_recalc;
+	}
 
-		/* If the caller requires to allow to be interpreted by force
-		 * and it has really been interpreted, then move the request
-		 * to RQ_PHASE_INTERPRET phase in spite of what the current
-		 * phase is. */
-		if (unlikely(req->rq_allow_intr && req->rq_intr)) {
-			req->rq_status = -EINTR;
-			ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
+	/* This schedule point is mainly for the ptlrpcd caller of this
+	 * function.  Most ptlrpc sets are not long-lived and unbounded
+	 * in length, but at the least the set used by the ptlrpcd is.
+	 * Since the processing time is unbounded, we need to insert an
+	 * explicit schedule point to make the thread well-behaved.
+	 */
+	cond_resched();
 
-			/* Since it is interpreted and we have to wait for
-			 * the reply to be unlinked, then use sync mode. */
-			async = 0;
+	/* If the caller requires to allow to be interpreted by force
+	 * and it has really been interpreted, then move the request
+	 * to RQ_PHASE_INTERPRET phase in spite of what the current
+	 * phase is. */
+	if (unlikely(req->rq_allow_intr && req->rq_intr)) {
+		req->rq_status = -EINTR;
+		ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
 
-			GOTO(interpret, req->rq_status);
-		}
+		/* Since it is interpreted and we have to wait for
+		 * the reply to be unlinked, then use sync mode. */
+		async = 0;
 
-		if (req->rq_phase == RQ_PHASE_NEW && ptlrpc_send_new_req(req))
-			force_timer_recalc = 1;
+		GOTO(interpret, req->rq_status);
+	}
 
-		/* delayed send - skip */
-		if (req->rq_phase == RQ_PHASE_NEW && req->rq_sent)
-			continue;
+	if (req->rq_phase == RQ_PHASE_NEW && ptlrpc_send_new_req(req))
+		force_timer_recalc = 1;
 
-		/* delayed resend - skip */
-		if (req->rq_phase == RQ_PHASE_RPC && req->rq_resend &&
-		    req->rq_sent > cfs_time_current_sec())
-			continue;
+	/* delayed send - skip */
+	if (req->rq_phase == RQ_PHASE_NEW && req->rq_sent)
+		return force_timer_recalc;
 
-		if (!(req->rq_phase == RQ_PHASE_RPC ||
-		      req->rq_phase == RQ_PHASE_BULK ||
-		      req->rq_phase == RQ_PHASE_INTERPRET ||
-		      req->rq_phase == RQ_PHASE_UNREG_RPC ||
-		      req->rq_phase == RQ_PHASE_UNREG_BULK)) {
-			DEBUG_REQ(D_ERROR, req, "bad phase %x", req->rq_phase);
-			LBUG();
-		}
+	/* delayed resend - skip */
+	if (req->rq_phase == RQ_PHASE_RPC && req->rq_resend &&
+	    req->rq_sent > cfs_time_current_sec())
+		return force_timer_recalc;
 
-		if (req->rq_phase == RQ_PHASE_UNREG_RPC ||
-		    req->rq_phase == RQ_PHASE_UNREG_BULK) {
-			LASSERT(req->rq_next_phase != req->rq_phase);
-			LASSERT(req->rq_next_phase != RQ_PHASE_UNDEFINED);
-
-			if (req->rq_req_deadline &&
-			    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REQ_UNLINK))
-				req->rq_req_deadline = 0;
-			if (req->rq_reply_deadline &&
-			    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK))
-				req->rq_reply_deadline = 0;
-			if (req->rq_bulk_deadline &&
-			    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK))
-				req->rq_bulk_deadline = 0;
+	if (!(req->rq_phase == RQ_PHASE_RPC ||
+	      req->rq_phase == RQ_PHASE_BULK ||
+	      req->rq_phase == RQ_PHASE_INTERPRET ||
+	      req->rq_phase == RQ_PHASE_UNREG_RPC ||
+	      req->rq_phase == RQ_PHASE_UNREG_BULK)) {
+		DEBUG_REQ(D_ERROR, req, "bad phase %x", req->rq_phase);
+		LBUG();
+	}
 
-			/*
-			 * Skip processing until reply is unlinked. We
-			 * can't return to pool before that and we can't
-			 * call interpret before that. We need to make
-			 * sure that all rdma transfers finished and will
-			 * not corrupt any data.
-			 */
-			if (req->rq_phase == RQ_PHASE_UNREG_RPC &&
-			    ptlrpc_client_recv_or_unlink(req))
-				continue;
-			if (req->rq_phase == RQ_PHASE_UNREG_BULK &&
-			    ptlrpc_client_bulk_active(req))
-				continue;
+	if (req->rq_phase == RQ_PHASE_UNREG_RPC ||
+	    req->rq_phase == RQ_PHASE_UNREG_BULK) {
+		LASSERT(req->rq_next_phase != req->rq_phase);
+		LASSERT(req->rq_next_phase != RQ_PHASE_UNDEFINED);
+
+		if (req->rq_req_deadline &&
+		    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REQ_UNLINK))
+			req->rq_req_deadline = 0;
+		if (req->rq_reply_deadline &&
+		    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK))
+			req->rq_reply_deadline = 0;
+		if (req->rq_bulk_deadline &&
+		    !OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK))
+			req->rq_bulk_deadline = 0;
 
-                        /*
-                         * Turn fail_loc off to prevent it from looping
-                         * forever.
-                         */
-                        if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK)) {
-                                OBD_FAIL_CHECK_ORSET(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK,
-                                                     OBD_FAIL_ONCE);
-                        }
-                        if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK)) {
-                                OBD_FAIL_CHECK_ORSET(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK,
-                                                     OBD_FAIL_ONCE);
-                        }
+		/*
+		 * Skip processing until reply is unlinked. We
+		 * can't return to pool before that and we can't
+		 * call interpret before that. We need to make
+		 * sure that all rdma transfers finished and will
+		 * not corrupt any data.
+		 */
+		if (req->rq_phase == RQ_PHASE_UNREG_RPC &&
+		    ptlrpc_client_recv_or_unlink(req))
+			return force_timer_recalc;
+		if (req->rq_phase == RQ_PHASE_UNREG_BULK &&
+		    ptlrpc_client_bulk_active(req))
+			return force_timer_recalc;
 
-                        /*
-                         * Move to next phase if reply was successfully
-                         * unlinked.
-                         */
-                        ptlrpc_rqphase_move(req, req->rq_next_phase);
+                /*
+                 * Turn fail_loc off to prevent it from looping
+                 * forever.
+                 */
+                if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK)) {
+                        OBD_FAIL_CHECK_ORSET(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK,
+                                             OBD_FAIL_ONCE);
+                }
+                if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK)) {
+                        OBD_FAIL_CHECK_ORSET(OBD_FAIL_PTLRPC_LONG_BULK_UNLINK,
+                                             OBD_FAIL_ONCE);
                 }
-
-                if (req->rq_phase == RQ_PHASE_INTERPRET)
-                        GOTO(interpret, req->rq_status);
 
                 /*
-                 * Note that this also will start async reply unlink.
+                 * Move to next phase if reply was successfully
+                 * unlinked.
                  */
-                if (req->rq_net_err && !req->rq_timedout) {
-                        ptlrpc_expire_one_request(req, 1);
+                ptlrpc_rqphase_move(req, req->rq_next_phase);
+        }
 
-                        /*
-                         * Check if we still need to wait for unlink.
-                         */
-                        if (ptlrpc_client_recv_or_unlink(req) ||
-                            ptlrpc_client_bulk_active(req))
-                                continue;
-                        /* If there is no need to resend, fail it now. */
-                        if (req->rq_no_resend) {
-                                if (req->rq_status == 0)
-                                        req->rq_status = -EIO;
-                                ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
-                                GOTO(interpret, req->rq_status);
-                        } else {
-                                continue;
-                        }
-                }
+        if (req->rq_phase == RQ_PHASE_INTERPRET)
+                GOTO(interpret, req->rq_status);
 
-                if (req->rq_err) {
-			spin_lock(&req->rq_lock);
-			req->rq_replied = 0;
-			spin_unlock(&req->rq_lock);
+        /*
+         * Note that this also will start async reply unlink.
+         */
+        if (req->rq_net_err && !req->rq_timedout) {
+                ptlrpc_expire_one_request(req, 1);
+
+                /*
+                 * Check if we still need to wait for unlink.
+                 */
+                if (ptlrpc_client_recv_or_unlink(req) ||
+                    ptlrpc_client_bulk_active(req))
+                        return force_timer_recalc;
+                /* If there is no need to resend, fail it now. */
+                if (req->rq_no_resend) {
                         if (req->rq_status == 0)
                                 req->rq_status = -EIO;
                         ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
                         GOTO(interpret, req->rq_status);
+                } else {
+                        return force_timer_recalc;
                 }
+        }
 
-                /* ptlrpc_set_wait->l_wait_event sets lwi_allow_intr
-                 * so it sets rq_intr regardless of individual rpc
-		 * timeouts. The synchronous IO waiting path sets
-                 * rq_intr irrespective of whether ptlrpcd
-                 * has seen a timeout.  Our policy is to only interpret
-                 * interrupted rpcs after they have timed out, so we
-                 * need to enforce that here.
-                 */
+        if (req->rq_err) {
+		spin_lock(&req->rq_lock);
+		req->rq_replied = 0;
+		spin_unlock(&req->rq_lock);
+                if (req->rq_status == 0)
+                        req->rq_status = -EIO;
+                ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
+                GOTO(interpret, req->rq_status);
+        }
 
-                if (req->rq_intr && (req->rq_timedout || req->rq_waiting ||
-                                     req->rq_wait_ctx)) {
-                        req->rq_status = -EINTR;
-                        ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
-                        GOTO(interpret, req->rq_status);
-                }
+        /* ptlrpc_set_wait->l_wait_event sets lwi_allow_intr
+         * so it sets rq_intr regardless of individual rpc
+	 * timeouts. The synchronous IO waiting path sets
+         * rq_intr irrespective of whether ptlrpcd
+         * has seen a timeout.  Our policy is to only interpret
+         * interrupted rpcs after they have timed out, so we
+         * need to enforce that here.
+         */
 
-                if (req->rq_phase == RQ_PHASE_RPC) {
-                        if (req->rq_timedout || req->rq_resend ||
-                            req->rq_waiting || req->rq_wait_ctx) {
-                                int status;
+        if (req->rq_intr && (req->rq_timedout || req->rq_waiting ||
+                             req->rq_wait_ctx)) {
+                req->rq_status = -EINTR;
+                ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
+                GOTO(interpret, req->rq_status);
+        }
 
-				if (!ptlrpc_unregister_reply(req, 1)) {
-					ptlrpc_unregister_bulk(req, 1);
-					continue;
-				}
+        if (req->rq_phase == RQ_PHASE_RPC) {
+                if (req->rq_timedout || req->rq_resend ||
+                    req->rq_waiting || req->rq_wait_ctx) {
+                        int status;
 
-				spin_lock(&imp->imp_lock);
-				if (ptlrpc_import_delay_req(imp, req, &status)){
-					/* put on delay list - only if we wait
-					 * recovery finished - before send */
-					list_del_init(&req->rq_list);
-					list_add_tail(&req->rq_list,
-							  &imp->
-							  imp_delayed_list);
-					spin_unlock(&imp->imp_lock);
-                                        continue;
-                                }
-
-                                if (status != 0)  {
-                                        req->rq_status = status;
-                                        ptlrpc_rqphase_move(req,
-                                                RQ_PHASE_INTERPRET);
-					spin_unlock(&imp->imp_lock);
-					GOTO(interpret, req->rq_status);
-				}
-				if (ptlrpc_no_resend(req) &&
-				    !req->rq_wait_ctx) {
-					req->rq_status = -ENOTCONN;
-					ptlrpc_rqphase_move(req,
-							    RQ_PHASE_INTERPRET);
-					spin_unlock(&imp->imp_lock);
-					GOTO(interpret, req->rq_status);
-				}
+			if (!ptlrpc_unregister_reply(req, 1)) {
+				ptlrpc_unregister_bulk(req, 1);
+				return force_timer_recalc;
+			}
 
+			spin_lock(&imp->imp_lock);
+			if (ptlrpc_import_delay_req(imp, req, &status)){
+				/* put on delay list - only if we wait
+				 * recovery finished - before send */
 				list_del_init(&req->rq_list);
 				list_add_tail(&req->rq_list,
-						  &imp->imp_sending_list);
+						  &imp->
+						  imp_delayed_list);
+				spin_unlock(&imp->imp_lock);
+                                return force_timer_recalc;
+                        }
 
+                        if (status != 0)  {
+                                req->rq_status = status;
+                                ptlrpc_rqphase_move(req,
+                                        RQ_PHASE_INTERPRET);
+				spin_unlock(&imp->imp_lock);
+				GOTO(interpret, req->rq_status);
+			}
+			if (ptlrpc_no_resend(req) &&
+			    !req->rq_wait_ctx) {
+				req->rq_status = -ENOTCONN;
+				ptlrpc_rqphase_move(req,
+						    RQ_PHASE_INTERPRET);
 				spin_unlock(&imp->imp_lock);
+				GOTO(interpret, req->rq_status);
+			}
+
+			list_del_init(&req->rq_list);
+			list_add_tail(&req->rq_list,
+					  &imp->imp_sending_list);
 
+			spin_unlock(&imp->imp_lock);
+
+			spin_lock(&req->rq_lock);
+			req->rq_waiting = 0;
+			spin_unlock(&req->rq_lock);
+
+			if (req->rq_timedout || req->rq_resend) {
+				/* This is re-sending anyways,
+				 * let's mark req as resend. */
 				spin_lock(&req->rq_lock);
-				req->rq_waiting = 0;
+				req->rq_resend = 1;
 				spin_unlock(&req->rq_lock);
 
-				if (req->rq_timedout || req->rq_resend) {
-					/* This is re-sending anyways,
-					 * let's mark req as resend. */
-					spin_lock(&req->rq_lock);
-					req->rq_resend = 1;
-					spin_unlock(&req->rq_lock);
-
-					if (req->rq_bulk != NULL &&
-					    !ptlrpc_unregister_bulk(req, 1))
-						continue;
-                                }
-                                /*
-                                 * rq_wait_ctx is only touched by ptlrpcd,
-                                 * so no lock is needed here.
-                                 */
-                                status = sptlrpc_req_refresh_ctx(req, -1);
-                                if (status) {
-                                        if (req->rq_err) {
-                                                req->rq_status = status;
-						spin_lock(&req->rq_lock);
-						req->rq_wait_ctx = 0;
-						spin_unlock(&req->rq_lock);
-						force_timer_recalc = 1;
-					} else {
-						spin_lock(&req->rq_lock);
-						req->rq_wait_ctx = 1;
-						spin_unlock(&req->rq_lock);
-					}
-
-					continue;
-				} else {
+				if (req->rq_bulk != NULL &&
+				    !ptlrpc_unregister_bulk(req, 1))
+					return force_timer_recalc;
+                        }
+                        /*
+                         * rq_wait_ctx is only touched by ptlrpcd,
+                         * so no lock is needed here.
+                         */
+                        status = sptlrpc_req_refresh_ctx(req, -1);
+                        if (status) {
+                                if (req->rq_err) {
+                                        req->rq_status = status;
 					spin_lock(&req->rq_lock);
 					req->rq_wait_ctx = 0;
 					spin_unlock(&req->rq_lock);
-				}
-
-				rc = ptl_send_rpc(req, 0);
-				if (rc == -ENOMEM) {
-					spin_lock(&imp->imp_lock);
-					if (!list_empty(&req->rq_list))
-						list_del_init(&req->rq_list);
-					spin_unlock(&imp->imp_lock);
-					ptlrpc_rqphase_move(req, RQ_PHASE_NEW);
-					continue;
-				}
-				if (rc) {
-					DEBUG_REQ(D_HA, req,
-						  "send failed: rc = %d", rc);
 					force_timer_recalc = 1;
+				} else {
 					spin_lock(&req->rq_lock);
-					req->rq_net_err = 1;
+					req->rq_wait_ctx = 1;
 					spin_unlock(&req->rq_lock);
-					continue;
 				}
-				/* need to reset the timeout */
-				force_timer_recalc = 1;
-			}
 
-			spin_lock(&req->rq_lock);
-
-			if (ptlrpc_client_early(req)) {
-				ptlrpc_at_recv_early_reply(req);
+				return force_timer_recalc;
+			} else {
+				spin_lock(&req->rq_lock);
+				req->rq_wait_ctx = 0;
 				spin_unlock(&req->rq_lock);
-				continue;
 			}
 
-			/* Still waiting for a reply? */
-			if (ptlrpc_client_recv(req)) {
-				spin_unlock(&req->rq_lock);
-				continue;
+			rc = ptl_send_rpc(req, 0);
+			if (rc == -ENOMEM) {
+				spin_lock(&imp->imp_lock);
+				if (!list_empty(&req->rq_list))
+					list_del_init(&req->rq_list);
+				spin_unlock(&imp->imp_lock);
+				ptlrpc_rqphase_move(req, RQ_PHASE_NEW);
+				return force_timer_recalc;
 			}
-
-			/* Did we actually receive a reply? */
-			if (!ptlrpc_client_replied(req)) {
+			if (rc) {
+				DEBUG_REQ(D_HA, req,
+					  "send failed: rc = %d", rc);
+				force_timer_recalc = 1;
+				spin_lock(&req->rq_lock);
+				req->rq_net_err = 1;
 				spin_unlock(&req->rq_lock);
-				continue;
+				return force_timer_recalc;
 			}
+			/* need to reset the timeout */
+			force_timer_recalc = 1;
+		}
+
+		spin_lock(&req->rq_lock);
 
+		if (ptlrpc_client_early(req)) {
+			ptlrpc_at_recv_early_reply(req);
 			spin_unlock(&req->rq_lock);
+			return force_timer_recalc;
+		}
 
-                        /* unlink from net because we are going to
-                         * swab in-place of reply buffer */
-                        unregistered = ptlrpc_unregister_reply(req, 1);
-                        if (!unregistered)
-                                continue;
+		/* Still waiting for a reply? */
+		if (ptlrpc_client_recv(req)) {
+			spin_unlock(&req->rq_lock);
+			return force_timer_recalc;
+		}
 
-                        req->rq_status = after_reply(req);
-                        if (req->rq_resend)
-                                continue;
+		/* Did we actually receive a reply? */
+		if (!ptlrpc_client_replied(req)) {
+			spin_unlock(&req->rq_lock);
+			return force_timer_recalc;
+		}
 
-                        /* If there is no bulk associated with this request,
-                         * then we're done and should let the interpreter
-                         * process the reply. Similarly if the RPC returned
-                         * an error, and therefore the bulk will never arrive.
-                         */
-                        if (req->rq_bulk == NULL || req->rq_status < 0) {
-                                ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
-                                GOTO(interpret, req->rq_status);
-                        }
+		spin_unlock(&req->rq_lock);
+
+                /* unlink from net because we are going to
+                 * swab in-place of reply buffer */
+                unregistered = ptlrpc_unregister_reply(req, 1);
+                if (!unregistered)
+                        return force_timer_recalc;
+
+                req->rq_status = after_reply(req);
+                if (req->rq_resend)
+                        return force_timer_recalc;
 
-                        ptlrpc_rqphase_move(req, RQ_PHASE_BULK);
+                /* If there is no bulk associated with this request,
+                 * then we're done and should let the interpreter
+                 * process the reply. Similarly if the RPC returned
+                 * an error, and therefore the bulk will never arrive.
+                 */
+                if (req->rq_bulk == NULL || req->rq_status < 0) {
+                        ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
+                        GOTO(interpret, req->rq_status);
                 }
 
-                LASSERT(req->rq_phase == RQ_PHASE_BULK);
-                if (ptlrpc_client_bulk_active(req))
-                        continue;
+                ptlrpc_rqphase_move(req, RQ_PHASE_BULK);
+        }
 
-		if (req->rq_bulk->bd_failure) {
-			/* The RPC reply arrived OK, but the bulk screwed
-			 * up!  Dead weird since the server told us the RPC
-			 * was good after getting the REPLY for her GET or
-			 * the ACK for her PUT. */
-			DEBUG_REQ(D_ERROR, req, "bulk transfer failed");
-			req->rq_status = -EIO;
-		}
+        LASSERT(req->rq_phase == RQ_PHASE_BULK);
+        if (ptlrpc_client_bulk_active(req))
+                return force_timer_recalc;
+
+	if (req->rq_bulk->bd_failure) {
+		/* The RPC reply arrived OK, but the bulk screwed
+		 * up!  Dead weird since the server told us the RPC
+		 * was good after getting the REPLY for her GET or
+		 * the ACK for her PUT. */
+		DEBUG_REQ(D_ERROR, req, "bulk transfer failed");
+		req->rq_status = -EIO;
+	}
 
-		ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
+	ptlrpc_rqphase_move(req, RQ_PHASE_INTERPRET);
 
-	interpret:
-		LASSERT(req->rq_phase == RQ_PHASE_INTERPRET);
+interpret:
+	LASSERT(req->rq_phase == RQ_PHASE_INTERPRET);
 
-		/* This moves to "unregistering" phase we need to wait for
-		 * reply unlink. */
-		if (!unregistered && !ptlrpc_unregister_reply(req, async)) {
-			/* start async bulk unlink too */
-			ptlrpc_unregister_bulk(req, 1);
-			continue;
-		}
+	/* This moves to "unregistering" phase we need to wait for
+	 * reply unlink. */
+	if (!unregistered && !ptlrpc_unregister_reply(req, async)) {
+		/* start async bulk unlink too */
+		ptlrpc_unregister_bulk(req, 1);
+		return force_timer_recalc;
+	}
 
-		if (!ptlrpc_unregister_bulk(req, async))
-			continue;
+	if (!ptlrpc_unregister_bulk(req, async))
+		return force_timer_recalc;
 
-		/* When calling interpret receiving already should be
-		 * finished. */
-		LASSERT(!req->rq_receiving_reply);
+	/* When calling interpret receiving already should be
+	 * finished. */
+	LASSERT(!req->rq_receiving_reply);
 
-		ptlrpc_req_interpret(env, req, req->rq_status);
+	ptlrpc_req_interpret(env, req, req->rq_status);
 
-		if (ptlrpcd_check_work(req)) {
-			atomic_dec(&set->set_remaining);
-			continue;
-		}
-		ptlrpc_rqphase_move(req, RQ_PHASE_COMPLETE);
+	if (ptlrpcd_check_work(req)) {
+		atomic_dec(&set->set_remaining);
+		return force_timer_recalc;
+	}
+	ptlrpc_rqphase_move(req, RQ_PHASE_COMPLETE);
 
-		CDEBUG(req->rq_reqmsg != NULL ? D_RPCTRACE : 0,
-			"Completed RPC pname:cluuid:pid:xid:nid:"
-			"opc %s:%s:%d:%llu:%s:%d\n",
-			current_comm(), imp->imp_obd->obd_uuid.uuid,
-			lustre_msg_get_status(req->rq_reqmsg), req->rq_xid,
-			libcfs_nid2str(imp->imp_connection->c_peer.nid),
-			lustre_msg_get_opc(req->rq_reqmsg));
+	CDEBUG(req->rq_reqmsg != NULL ? D_RPCTRACE : 0,
+		"Completed RPC pname:cluuid:pid:xid:nid:"
+		"opc %s:%s:%d:%llu:%s:%d\n",
+		current_comm(), imp->imp_obd->obd_uuid.uuid,
+		lustre_msg_get_status(req->rq_reqmsg), req->rq_xid,
+		libcfs_nid2str(imp->imp_connection->c_peer.nid),
+		lustre_msg_get_opc(req->rq_reqmsg));
 
-		spin_lock(&imp->imp_lock);
-		/* Request already may be not on sending or delaying list. This
-		 * may happen in the case of marking it erroneous for the case
-		 * ptlrpc_import_delay_req(req, status) find it impossible to
-		 * allow sending this rpc and returns *status != 0. */
-		if (!list_empty(&req->rq_list)) {
-			list_del_init(&req->rq_list);
-			atomic_dec(&imp->imp_inflight);
-		}
-		list_del_init(&req->rq_unreplied_list);
-		spin_unlock(&imp->imp_lock);
+	spin_lock(&imp->imp_lock);
+	/* Request already may be not on sending or delaying list. This
+	 * may happen in the case of marking it erroneous for the case
+	 * ptlrpc_import_delay_req(req, status) find it impossible to
+	 * allow sending this rpc and returns *status != 0. */
+	if (!list_empty(&req->rq_list)) {
+		list_del_init(&req->rq_list);
+		atomic_dec(&imp->imp_inflight);
+	}
+	list_del_init(&req->rq_unreplied_list);
+	spin_unlock(&imp->imp_lock);
 
-		atomic_dec(&set->set_remaining);
-		wake_up_all(&imp->imp_recovery_waitq);
+	atomic_dec(&set->set_remaining);
+	wake_up_all(&imp->imp_recovery_waitq);
 
-		if (set->set_producer) {
-			/* produce a new request if possible */
-			if (ptlrpc_set_producer(set) > 0)
-				force_timer_recalc = 1;
+	if (set->set_producer) {
+		/* produce a new request if possible */
+		if (ptlrpc_set_producer(set) > 0)
+			force_timer_recalc = 1;
 
-			/* free the request that has just been completed
-			 * in order not to pollute set->set_requests */
-			list_del_init(&req->rq_set_chain);
-			spin_lock(&req->rq_lock);
-			req->rq_set = NULL;
-			req->rq_invalid_rqset = 0;
-			spin_unlock(&req->rq_lock);
+		/* free the request that has just been completed
+		 * in order not to pollute set->set_requests */
+		list_del_init(&req->rq_set_chain);
+		spin_lock(&req->rq_lock);
+		req->rq_set = NULL;
+		req->rq_invalid_rqset = 0;
+		spin_unlock(&req->rq_lock);
 
-			/* record rq_status to compute the final status later */
-			if (req->rq_status != 0)
-				set->set_rc = req->rq_status;
-			ptlrpc_req_finished(req);
+		/* record rq_status to compute the final status later */
+		if (req->rq_status != 0)
+			set->set_rc = req->rq_status;
+		ptlrpc_req_finished(req);
+	} else {
+		list_move_tail(&req->rq_set_chain, comp_reqs);
+	}
+
+	return force_timer_recalc;
+}
+
+/**
+ * Take request \a req off the list of changed requests of its set, and
+ * return the next one.  New changes of \a req queue it again from now on,
+ * which reuses its link, so the caller must not follow it any more.  The
+ * caller drops the reference of the list with ptlrpc_req_finished().
+ */
+static struct ptlrpc_request *
+ptlrpc_set_changed_next(struct ptlrpc_request *req)
+{
+	struct ptlrpc_request *next = req->rq_cli.cr_changed_next;
+
+	req->rq_cli.cr_changed_next = NULL;
+	/* a full barrier: the state is read after the bit is cleared */
+	test_and_clear_bit(0, &req->rq_cli.cr_changed);
+	return next;
+}
+
+/**
+ * Queue \a req on the changed list of its set, so that the next
+ * ptlrpc_check_set() of a set with set_changed_only looks at it.
+ *
+ * Called from the network event callbacks and whoever else changes the
+ * state of a request before waking up its set, so it doesn't take any lock:
+ * the list is a stack pushed with cmpxchg() and taken whole with xchg() by
+ * the set owner.  A request is on the list at most once, and holds a
+ * reference while on it.
+ */
+void ptlrpc_set_req_changed(struct ptlrpc_request *req)
+{
+	struct ptlrpc_request_set *set = req->rq_set;
+	struct ptlrpc_request *head;
+
+	if (set == NULL || !set->set_changed_only)
+		return;
+
+	if (test_and_set_bit(0, &req->rq_cli.cr_changed))
+		return;
+
+	ptlrpc_request_addref(req);
+	do {
+		head = ACCESS_ONCE(set->set_changed);
+		req->rq_cli.cr_changed_next = head;
+	} while (cmpxchg(&set->set_changed, head, req) != head);
+}
+EXPORT_SYMBOL(ptlrpc_set_req_changed);
+
+/**
+ * this sends any unsent RPCs in \a set and returns 1 if all are sent
+ * and no more replies are expected.
+ * (it is possible to get less replies than requests sent e.g. due to timed out
+ * requests or requests that we had trouble to send out)
+ *
+ * A set with set_changed_only only looks at the requests queued by
+ * ptlrpc_set_req_changed(), unless a full scan is due: after new requests
+ * were added or requests expired (set_rescan), when one of the changed
+ * requests still has to be sent, and every PTLRPC_SET_SCAN_INTERVAL to
+ * catch the time based transitions (delayed sends and resends).
+ *
+ * NOTE: This function contains a potential schedule point (cond_resched()).
+ */
+int ptlrpc_check_set(const struct lu_env *env, struct ptlrpc_request_set *set)
+{
+	struct list_head *tmp, *next;
+	struct list_head  comp_reqs;
+	struct ptlrpc_request *changed = NULL;
+	struct ptlrpc_request *req;
+	int force_timer_recalc = 0;
+	bool full = true;
+	ENTRY;
+
+	if (atomic_read(&set->set_remaining) == 0)
+		RETURN(1);
+
+	INIT_LIST_HEAD(&comp_reqs);
+	if (set->set_changed_only) {
+		cfs_time_t now = cfs_time_current();
+
+		changed = xchg(&set->set_changed, NULL);
+		full = set->set_rescan ||
+		       cfs_time_aftereq(now, set->set_next_scan);
+		for (req = changed; req != NULL && !full;
+		     req = req->rq_cli.cr_changed_next) {
+			if (req->rq_set == set &&
+			    req->rq_phase == RQ_PHASE_NEW)
+				full = true;
+		}
+		if (full) {
+			set->set_rescan = 0;
+			set->set_next_scan = cfs_time_add(now,
+				cfs_time_seconds(PTLRPC_SET_SCAN_INTERVAL));
+			set->set_full_scans++;
 		} else {
-			list_move_tail(&req->rq_set_chain, &comp_reqs);
+			set->set_changed_scans++;
 		}
 	}
 
+	if (full) {
+		/* the scan covers the changed requests */
+		while (changed != NULL) {
+			req = changed;
+			changed = ptlrpc_set_changed_next(req);
+			ptlrpc_req_finished(req);
+		}
+
+		list_for_each_safe(tmp, next, &set->set_requests) {
+			req = list_entry(tmp, struct ptlrpc_request,
+					 rq_set_chain);
+			force_timer_recalc |= ptlrpc_check_req(env, set, req,
+							       &comp_reqs);
+			set->set_checked_reqs++;
+		}
+	}
+
+	while (changed != NULL) {
+		req = changed;
+		changed = ptlrpc_set_changed_next(req);
+		/* moved to another set, or already released */
+		if (req->rq_set == set && !list_empty(&req->rq_set_chain)) {
+			force_timer_recalc |= ptlrpc_check_req(env, set, req,
+							       &comp_reqs);
+			set->set_checked_reqs++;
+		}
+		ptlrpc_req_finished(req);
+	}
+
 	/* move completed request at the head of list so it's easier for
 	 * caller to find them */
 	list_splice(&comp_reqs, &set->set_requests);
@@ -2173,6 +2301,9 @@ int ptlrpc_expired_set(void *data)
 
 	LASSERT(set != NULL);
 
+	/* delayed sends and resends are due, expired requests changed */
+	set->set_rescan = 1;
+
 	/*
 	 * A timeout expired. See which reqs it applies to...
 	 */
@@ -2216,6 +2347,7 @@ void ptlrpc_mark_interrupted(struct ptlrpc_request *req)
 	spin_lock(&req->rq_lock);
 	req->rq_intr = 1;
 	spin_unlock(&req->rq_lock);
+	ptlrpc_set_req_changed(req);
 }
 EXPORT_SYMBOL(ptlrpc_mark_interrupted);
 
@@ -109,6 +109,14 @@ static const struct req_msg_field *mdt_body_capa[] = {
         &RMF_CAPA1
 };
 
+/* the DLM request carries the lock handles for readdir-plus entries */
+static const struct req_msg_field *mds_readpage_client[] = {
+	&RMF_PTLRPC_BODY,
+	&RMF_MDT_BODY,
+	&RMF_CAPA1,
+	&RMF_DLM_REQ
+};
+
 static const struct req_msg_field *quotactl_only[] = {
         &RMF_PTLRPC_BODY,
         &RMF_OBD_QUOTACTL
@@ -619,18 +627,22 @@ static const struct req_msg_field *ost_brw_client[] = {
         &RMF_OST_BODY,
         &RMF_OBD_IOOBJ,
         &RMF_NIOBUF_REMOTE,
-        &RMF_CAPA1
+        &RMF_CAPA1,
+	&RMF_SHORT_IO,
+	&RMF_OST_OBDOS
 };
 
 static const struct req_msg_field *ost_brw_read_server[] = {
         &RMF_PTLRPC_BODY,
-        &RMF_OST_BODY
+        &RMF_OST_BODY,
+	&RMF_SHORT_IO
 };
 
 static const struct req_msg_field *ost_brw_write_server[] = {
         &RMF_PTLRPC_BODY,
         &RMF_OST_BODY,
-        &RMF_RCS
+	&RMF_RCS,
+	&RMF_OST_OBDOS
 };
 
 static const struct req_msg_field *ost_get_info_generic_server[] = {
@@ -1144,6 +1156,18 @@ struct req_msg_field RMF_RCS =
                     lustre_swab_generic_32s, dump_rcs);
 EXPORT_SYMBOL(RMF_RCS);
 
+/* OST_READ/OST_WRITE data carried inline instead of a bulk transfer */
+struct req_msg_field RMF_SHORT_IO =
+	DEFINE_MSGF("short_io", 0, -1, NULL, NULL);
+EXPORT_SYMBOL(RMF_SHORT_IO);
+
+/* attributes of the objects after the first one in a multi-object write,
+ * the reply returns them with the quota flags of each object */
+struct req_msg_field RMF_OST_OBDOS =
+	DEFINE_MSGF("obdo_array", RMF_F_STRUCT_ARRAY, sizeof(struct obdo),
+		    lustre_swab_obdo, NULL);
+EXPORT_SYMBOL(RMF_OST_OBDOS);
+
 struct req_msg_field RMF_EAVALS_LENS =
 	DEFINE_MSGF("eavals_lens", RMF_F_STRUCT_ARRAY, sizeof(__u32),
 		lustre_swab_generic_32s, NULL);
@@ -1569,8 +1593,8 @@ struct req_format RQF_MDS_INTENT_CLOSE =
 EXPORT_SYMBOL(RQF_MDS_INTENT_CLOSE);
 
 struct req_format RQF_MDS_READPAGE =
-        DEFINE_REQ_FMT0("MDS_READPAGE",
-                        mdt_body_capa, mdt_body_only);
+	DEFINE_REQ_FMT0("MDS_READPAGE",
+			mds_readpage_client, mdt_body_only);
 EXPORT_SYMBOL(RQF_MDS_READPAGE);
 
 struct req_format RQF_MDS_HSM_ACTION =
@@ -210,6 +210,196 @@ void lustre_init_msg_v2(struct lustre_msg_v2 *msg, int count, __u32 *lens,
 }
 EXPORT_SYMBOL(lustre_init_msg_v2);
 
+/*
+ * Message buffer pools.
+ *
+ * The security policies allocate request and reply buffers rounded up to
+ * a power of two, so the buffers of a given RPC format always fall into
+ * the same size class. Freed buffers of the small classes are kept on a
+ * per-CPT free list and handed out again instead of going back to the
+ * kernel allocator for every RPC.
+ */
+#define MSGBUF_POOL_MIN_SHIFT	8	/* 256 bytes */
+#define MSGBUF_POOL_MAX_SHIFT	14	/* 16KB */
+#define MSGBUF_POOL_NR_CLASSES	(MSGBUF_POOL_MAX_SHIFT - \
+				 MSGBUF_POOL_MIN_SHIFT + 1)
+
+static unsigned int msgbuf_pool_max = 64;
+module_param(msgbuf_pool_max, uint, 0644);
+MODULE_PARM_DESC(msgbuf_pool_max,
+		 "Max free message buffers kept per size class and CPT");
+
+struct msgbuf_pool {
+	spinlock_t		mp_lock;
+	struct list_head	mp_list;
+	unsigned int		mp_free;
+	/* statistics */
+	unsigned long		mp_hits;
+	unsigned long		mp_misses;
+	unsigned long		mp_drops;
+};
+
+struct msgbuf_pool_cpt {
+	struct msgbuf_pool	mpc_pools[MSGBUF_POOL_NR_CLASSES];
+};
+
+static struct msgbuf_pool_cpt **msgbuf_pools;
+
+static int msgbuf_pool_class(int size)
+{
+	int shift;
+
+	if (size < (1 << MSGBUF_POOL_MIN_SHIFT) ||
+	    size > (1 << MSGBUF_POOL_MAX_SHIFT) || (size & (size - 1)) != 0)
+		return -1;
+
+	shift = ffs(size) - 1;
+	return shift - MSGBUF_POOL_MIN_SHIFT;
+}
+
+static struct msgbuf_pool *msgbuf_pool_get(int size)
+{
+	int idx = msgbuf_pool_class(size);
+	int cpt;
+
+	if (idx < 0 || msgbuf_pools == NULL)
+		return NULL;
+
+	cpt = cfs_cpt_current(cfs_cpt_table, 0);
+	return &msgbuf_pools[cpt]->mpc_pools[idx];
+}
+
+/**
+ * Allocate a zeroed message buffer of \a size bytes, as rounded up by
+ * size_roundup_power2(). The buffer must be released by
+ * ptlrpc_msgbuf_free() with the same size.
+ */
+void *ptlrpc_msgbuf_alloc(int size)
+{
+	struct msgbuf_pool	*pool = msgbuf_pool_get(size);
+	struct list_head	*buf = NULL;
+
+	if (pool != NULL) {
+		spin_lock(&pool->mp_lock);
+		if (!list_empty(&pool->mp_list)) {
+			buf = pool->mp_list.next;
+			list_del(buf);
+			pool->mp_free--;
+			pool->mp_hits++;
+		} else {
+			pool->mp_misses++;
+		}
+		spin_unlock(&pool->mp_lock);
+	}
+
+	if (buf != NULL)
+		memset(buf, 0, size);
+	else
+		OBD_ALLOC_LARGE(buf, size);
+
+	return buf;
+}
+
+void ptlrpc_msgbuf_free(void *buf, int size)
+{
+	struct msgbuf_pool *pool = msgbuf_pool_get(size);
+
+	if (pool != NULL) {
+		spin_lock(&pool->mp_lock);
+		if (pool->mp_free < msgbuf_pool_max) {
+			list_add(buf, &pool->mp_list);
+			pool->mp_free++;
+			buf = NULL;
+		} else {
+			pool->mp_drops++;
+		}
+		spin_unlock(&pool->mp_lock);
+	}
+
+	if (buf != NULL)
+		OBD_FREE_LARGE(buf, size);
+}
+
+int ptlrpc_msgbuf_pool_seq_show(struct seq_file *m, void *v)
+{
+	struct msgbuf_pool_cpt	*mpc;
+	int			 i;
+	int			 j;
+
+	seq_printf(m, "%-8s %10s %16s %16s %16s\n",
+		   "size", "free", "hits", "misses", "drops");
+
+	for (j = 0; j < MSGBUF_POOL_NR_CLASSES; j++) {
+		unsigned long free = 0;
+		unsigned long hits = 0;
+		unsigned long misses = 0;
+		unsigned long drops = 0;
+
+		cfs_percpt_for_each(mpc, i, msgbuf_pools) {
+			struct msgbuf_pool *pool = &mpc->mpc_pools[j];
+
+			spin_lock(&pool->mp_lock);
+			free += pool->mp_free;
+			hits += pool->mp_hits;
+			misses += pool->mp_misses;
+			drops += pool->mp_drops;
+			spin_unlock(&pool->mp_lock);
+		}
+
+		seq_printf(m, "%-8d %10lu %16lu %16lu %16lu\n",
+			   1 << (j + MSGBUF_POOL_MIN_SHIFT),
+			   free, hits, misses, drops);
+	}
+	return 0;
+}
+
+int ptlrpc_msgbuf_pool_init(void)
+{
+	struct msgbuf_pool_cpt	*mpc;
+	int			 i;
+	int			 j;
+
+	msgbuf_pools = cfs_percpt_alloc(cfs_cpt_table, sizeof(*mpc));
+	if (msgbuf_pools == NULL)
+		return -ENOMEM;
+
+	cfs_percpt_for_each(mpc, i, msgbuf_pools) {
+		for (j = 0; j < MSGBUF_POOL_NR_CLASSES; j++) {
+			spin_lock_init(&mpc->mpc_pools[j].mp_lock);
+			INIT_LIST_HEAD(&mpc->mpc_pools[j].mp_list);
+		}
+	}
+	return 0;
+}
+
+void ptlrpc_msgbuf_pool_fini(void)
+{
+	struct msgbuf_pool_cpt	*mpc;
+	struct list_head	*buf;
+	int			 i;
+	int			 j;
+
+	if (msgbuf_pools == NULL)
+		return;
+
+	cfs_percpt_for_each(mpc, i, msgbuf_pools) {
+		for (j = 0; j < MSGBUF_POOL_NR_CLASSES; j++) {
+			struct msgbuf_pool *pool = &mpc->mpc_pools[j];
+
+			while (!list_empty(&pool->mp_list)) {
+				buf = pool->mp_list.next;
+				list_del(buf);
+				OBD_FREE_LARGE(buf,
+					1 << (j + MSGBUF_POOL_MIN_SHIFT));
+			}
+			pool->mp_free = 0;
+		}
+	}
+
+	cfs_percpt_free(msgbuf_pools);
+	msgbuf_pools = NULL;
+}
+
 static int lustre_pack_request_v2(struct ptlrpc_request *req,
                                   int count, __u32 *lens, char **bufs)
 {
@@ -65,6 +65,9 @@ extern struct mutex pinger_mutex;
 int ptlrpc_start_thread(struct ptlrpc_service_part *svcpt, int wait);
 /* ptlrpcd.c */
 int ptlrpcd_start(struct ptlrpcd_ctl *pc);
+void ptlrpcd_wake_idle(struct ptlrpcd_ctl *pc, int count);
+int ptlrpcd_lproc_init(void);
+void ptlrpcd_lproc_fini(void);
 
 /* client.c */
 void ptlrpc_at_adj_net_latency(struct ptlrpc_request *req,
@@ -264,6 +267,11 @@ void ptlrpc_fill_bulk_md(lnet_md_t *md, struct ptlrpc_bulk_desc *desc,
 struct ptlrpc_reply_state *
 lustre_get_emerg_rs(struct ptlrpc_service_part *svcpt);
 void lustre_put_emerg_rs(struct ptlrpc_reply_state *rs);
+void *ptlrpc_msgbuf_alloc(int size);
+void ptlrpc_msgbuf_free(void *buf, int size);
+int ptlrpc_msgbuf_pool_seq_show(struct seq_file *m, void *v);
+int ptlrpc_msgbuf_pool_init(void);
+void ptlrpc_msgbuf_pool_fini(void);
 
 /* pinger.c */
 int ptlrpc_start_pinger(void);
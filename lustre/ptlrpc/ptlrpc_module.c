@@ -77,10 +77,14 @@ static __init int ptlrpc_init(void)
 	if (rc)
 		GOTO(err_hr, rc);
 
-	rc = ptlrpc_init_portals();
+	rc = ptlrpc_msgbuf_pool_init();
 	if (rc)
 		GOTO(err_cache, rc);
 
+	rc = ptlrpc_init_portals();
+	if (rc)
+		GOTO(err_msgbuf, rc);
+
 	rc = ptlrpc_connection_init();
 	if (rc)
 		GOTO(err_portals, rc);
@@ -107,7 +111,13 @@ static __init int ptlrpc_init(void)
 	if (rc)
 		GOTO(err_nrs, rc);
 
+	rc = ptlrpcd_lproc_init();
+	if (rc)
+		GOTO(err_nodemap, rc);
+
 	RETURN(0);
+err_nodemap:
+	nodemap_mod_exit();
 err_nrs:
 	ptlrpc_nrs_fini();
 err_sptlrpc:
@@ -120,6 +130,8 @@ err_conn:
 	ptlrpc_connection_fini();
 err_portals:
 	ptlrpc_exit_portals();
+err_msgbuf:
+	ptlrpc_msgbuf_pool_fini();
 err_cache:
 	ptlrpc_request_cache_fini();
 err_hr:
@@ -133,12 +145,14 @@ err_layout:
 
 static void __exit ptlrpc_exit(void)
 {
+	ptlrpcd_lproc_fini();
 	nodemap_mod_exit();
 	ptlrpc_nrs_fini();
 	sptlrpc_fini();
 	ldlm_exit();
 	ptlrpc_stop_pinger();
 	ptlrpc_exit_portals();
+	ptlrpc_msgbuf_pool_fini();
 	ptlrpc_request_cache_fini();
 	ptlrpc_hr_fini();
 	ptlrpc_connection_fini();
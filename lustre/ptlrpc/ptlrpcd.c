@@ -116,6 +116,24 @@ module_param(ptlrpcd_partner_group_size, int, 0644);
 MODULE_PARM_DESC(ptlrpcd_partner_group_size,
 		 "Number of ptlrpcd threads in a partner group.");
 
+/*
+ * ptlrpcd_work_stealing: let an idle ptlrpcd thread take new requests from
+ * any ptlrpcd thread of its CPT, not only from its partners.
+ */
+static int ptlrpcd_work_stealing = 1;
+module_param(ptlrpcd_work_stealing, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_work_stealing,
+		 "Idle ptlrpcd threads steal requests from their whole CPT.");
+
+/*
+ * ptlrpcd_check_changed: only check the requests whose state changed on a
+ * wakeup of a ptlrpcd thread, instead of its whole request set.
+ */
+static int ptlrpcd_check_changed = 1;
+module_param(ptlrpcd_check_changed, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_check_changed,
+		 "Only check the changed requests on ptlrpcd wakeups.");
+
 /*
  * ptlrpcd_cpts: A CPT string describing the CPU partitions that
  * ptlrpcd threads should run on. Used to make ptlrpcd threads run on
@@ -161,6 +179,7 @@ void ptlrpcd_wake(struct ptlrpc_request *req)
 	struct ptlrpc_request_set *set = req->rq_set;
 
 	LASSERT(set != NULL);
+	ptlrpc_set_req_changed(req);
 	wake_up(&set->set_waitq);
 }
 EXPORT_SYMBOL(ptlrpcd_wake);
@@ -229,36 +248,164 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 		 *      no other better choice. It maybe fixed in future. */
 		for (i = 0; i < pc->pc_npartners; i++)
 			wake_up(&pc->pc_partners[i]->pc_set->set_waitq);
+	} else {
+		ptlrpcd_wake_idle(pc, count);
 	}
 }
 
+static inline void ptlrpc_reqset_get(struct ptlrpc_request_set *set)
+{
+	atomic_inc(&set->set_refcount);
+}
+
 /**
+ * Steal half of the new requests of \a src into \a des.
+ *
+ * set_new_requests works as the deque of a ptlrpcd thread: its owner takes
+ * the oldest requests from the head, thieves take the newest ones from the
+ * tail, so that the owner keeps the requests it is about to send.
+ *
  * Return transferred RPCs count.
  */
 static int ptlrpcd_steal_rqset(struct ptlrpc_request_set *des,
                                struct ptlrpc_request_set *src)
 {
-	struct list_head *tmp, *pos;
+	struct list_head stolen = LIST_HEAD_INIT(stolen);
 	struct ptlrpc_request *req;
 	int rc = 0;
+	int i;
 
 	spin_lock(&src->set_new_req_lock);
 	if (likely(!list_empty(&src->set_new_requests))) {
-		list_for_each_safe(pos, tmp, &src->set_new_requests) {
-			req = list_entry(pos, struct ptlrpc_request,
-					 rq_set_chain);
+		rc = (atomic_read(&src->set_new_count) + 1) / 2;
+		for (i = 0; i < rc; i++) {
+			req = list_entry(src->set_new_requests.prev,
+					 struct ptlrpc_request, rq_set_chain);
 			req->rq_set = des;
+			list_move(&req->rq_set_chain, &stolen);
 		}
-		list_splice_init(&src->set_new_requests,
-				 &des->set_requests);
-		rc = atomic_read(&src->set_new_count);
+		list_splice_tail(&stolen, &des->set_requests);
 		atomic_add(rc, &des->set_remaining);
-		atomic_set(&src->set_new_count, 0);
+		atomic_sub(rc, &src->set_new_count);
+		des->set_rescan = 1;
 	}
 	spin_unlock(&src->set_new_req_lock);
 	return rc;
 }
 
+/* the per-CPT pool of the ptlrpcd thread \a pc, NULL for recovery */
+static struct ptlrpcd *ptlrpcd_pc2pd(struct ptlrpcd_ctl *pc)
+{
+	int idx;
+
+	if (test_bit(LIOD_RECOVERY, &pc->pc_flags) || ptlrpcds == NULL)
+		return NULL;
+
+	idx = ptlrpcds_cpt_idx == NULL ? pc->pc_cpt :
+					 ptlrpcds_cpt_idx[pc->pc_cpt];
+	return ptlrpcds[idx];
+}
+
+/* the request set of \a pc with a reference, NULL if it isn't running */
+static struct ptlrpc_request_set *ptlrpcd_get_set(struct ptlrpcd_ctl *pc)
+{
+	struct ptlrpc_request_set *set;
+
+	spin_lock(&pc->pc_lock);
+	set = pc->pc_set;
+	if (set != NULL)
+		ptlrpc_reqset_get(set);
+	spin_unlock(&pc->pc_lock);
+
+	return set;
+}
+
+/**
+ * Steal new requests from the most loaded ptlrpcd thread of the CPT of
+ * \a pc, not only from its partners, so that the RPCs of a single busy
+ * application thread are spread over all the ptlrpcd threads of its node.
+ *
+ * Return transferred RPCs count.
+ */
+static int ptlrpcd_steal_cpt(struct ptlrpcd_ctl *pc)
+{
+	struct ptlrpcd *pd = ptlrpcd_pc2pd(pc);
+	struct ptlrpcd_ctl *victim = NULL;
+	struct ptlrpc_request_set *ps;
+	int max = 0;
+	int rc = 0;
+	int i;
+
+	if (pd == NULL || !ptlrpcd_work_stealing)
+		return 0;
+
+	for (i = 0; i < pd->pd_nthreads; i++) {
+		struct ptlrpcd_ctl *c = &pd->pd_threads[i];
+		int count;
+
+		if (c == pc)
+			continue;
+
+		ps = ptlrpcd_get_set(c);
+		if (ps == NULL)
+			continue;
+		count = atomic_read(&ps->set_new_count);
+		ptlrpc_reqset_put(ps);
+
+		if (count > max) {
+			max = count;
+			victim = c;
+		}
+	}
+
+	if (victim == NULL)
+		return 0;
+
+	ps = ptlrpcd_get_set(victim);
+	if (ps != NULL) {
+		rc = ptlrpcd_steal_rqset(pc->pc_set, ps);
+		if (rc > 0) {
+			CDEBUG(D_RPCTRACE, "steal %d async RPCs [%d->%d]\n",
+			       rc, victim->pc_index, pc->pc_index);
+			pc->pc_cpt_stolen += rc;
+		}
+		ptlrpc_reqset_put(ps);
+	}
+
+	return rc;
+}
+
+/**
+ * Wake up an idle ptlrpcd thread of the CPT of \a pc to steal some of
+ * its \a count new requests.  Done each time the backlog doubles, as one
+ * thief takes half of it.
+ */
+void ptlrpcd_wake_idle(struct ptlrpcd_ctl *pc, int count)
+{
+	struct ptlrpcd *pd;
+	int i;
+
+	if (count < 2 || (count & (count - 1)) != 0 || !ptlrpcd_work_stealing)
+		return;
+
+	pd = ptlrpcd_pc2pd(pc);
+	if (pd == NULL)
+		return;
+
+	for (i = 0; i < pd->pd_nthreads; i++) {
+		struct ptlrpcd_ctl *c = &pd->pd_threads[i];
+
+		if (c == pc || !test_and_clear_bit(LIOD_IDLE, &c->pc_flags))
+			continue;
+
+		spin_lock(&c->pc_lock);
+		if (c->pc_set != NULL)
+			wake_up(&c->pc_set->set_waitq);
+		spin_unlock(&c->pc_lock);
+		break;
+	}
+}
+
 /**
  * Requests that are added to the ptlrpcd queue are sent via
  * ptlrpcd_check->ptlrpc_check_set().
@@ -287,6 +434,8 @@ void ptlrpcd_add_req(struct ptlrpc_request *req)
 		/* ptlrpc_check_set will decrease the count */
 		atomic_inc(&req->rq_set->set_remaining);
 		spin_unlock(&req->rq_lock);
+		/* a new request makes ptlrpc_check_set() scan the set */
+		ptlrpc_set_req_changed(req);
 		wake_up(&req->rq_set->set_waitq);
 		return;
 	} else {
@@ -302,11 +451,6 @@ void ptlrpcd_add_req(struct ptlrpc_request *req)
 }
 EXPORT_SYMBOL(ptlrpcd_add_req);
 
-static inline void ptlrpc_reqset_get(struct ptlrpc_request_set *set)
-{
-	atomic_inc(&set->set_refcount);
-}
-
 /**
  * Check if there is more work to do on ptlrpcd set.
  * Returns 1 if yes.
@@ -328,6 +472,7 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 			atomic_add(atomic_read(&set->set_new_count),
 				   &set->set_remaining);
 			atomic_set(&set->set_new_count, 0);
+			set->set_rescan = 1;
 			/*
 			 * Need to calculate its timeout.
 			 */
@@ -402,17 +547,29 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 
 				if (atomic_read(&ps->set_new_count)) {
 					rc = ptlrpcd_steal_rqset(set, ps);
-					if (rc > 0)
+					if (rc > 0) {
 						CDEBUG(D_RPCTRACE, "transfer %d"
 						       " async RPCs [%d->%d]\n",
 						       rc, partner->pc_index,
 						       pc->pc_index);
+						pc->pc_partner_stolen += rc;
+					}
 				}
 				ptlrpc_reqset_put(ps);
 			} while (rc == 0 && pc->pc_cursor != first);
 		}
+
+		/* then from any thread of the node */
+		if (rc == 0)
+			rc = ptlrpcd_steal_cpt(pc);
 	}
 
+	/* ptlrpcd_wake_idle() looks for a thief among the idle threads */
+	if (rc == 0)
+		set_bit(LIOD_IDLE, &pc->pc_flags);
+	else
+		clear_bit(LIOD_IDLE, &pc->pc_flags);
+
 	RETURN(rc);
 }
 
@@ -446,6 +603,7 @@ static int ptlrpcd(void *arg)
 	set = ptlrpc_prep_set();
 	if (set == NULL)
 		GOTO(failed, rc = -ENOMEM);
+	set->set_changed_only = !!ptlrpcd_check_changed;
 	spin_lock(&pc->pc_lock);
 	pc->pc_set = set;
 	spin_unlock(&pc->pc_lock);
@@ -478,9 +636,15 @@ static int ptlrpcd(void *arg)
                 struct l_wait_info lwi;
                 int timeout;
 
-                timeout = ptlrpc_set_next_timeout(set);
-                lwi = LWI_TIMEOUT(cfs_time_seconds(timeout ? timeout : 1),
-                                  ptlrpc_expired_set, set);
+		/* with set_changed_only, ptlrpc_expired_set() must run at
+		 * least once per scan interval to time requests out, and
+		 * computing the next timeout would walk the whole set */
+		if (set->set_changed_only)
+			timeout = PTLRPC_SET_SCAN_INTERVAL;
+		else
+			timeout = ptlrpc_set_next_timeout(set);
+		lwi = LWI_TIMEOUT(cfs_time_seconds(timeout ? timeout : 1),
+				  ptlrpc_expired_set, set);
 
 		lu_context_enter(&env.le_ctx);
 		lu_context_enter(env.le_ses);
@@ -527,6 +691,8 @@ static void ptlrpcd_ctl_init(struct ptlrpcd_ctl *pc, int index, int cpt)
 
 	pc->pc_index = index;
 	pc->pc_cpt = cpt;
+	pc->pc_partner_stolen = 0;
+	pc->pc_cpt_stolen = 0;
 	init_completion(&pc->pc_starting);
 	init_completion(&pc->pc_finishing);
 	spin_lock_init(&pc->pc_lock);
@@ -938,6 +1104,71 @@ out:
 	RETURN(rc);
 }
 
+#ifdef CONFIG_PROC_FS
+static void ptlrpcd_stats_show_pc(struct seq_file *m, struct ptlrpcd_ctl *pc)
+{
+	struct ptlrpc_request_set *set = ptlrpcd_get_set(pc);
+
+	if (set == NULL)
+		return;
+
+	seq_printf(m, "%-16s %14lu %14lu %14lu %14lu %14lu\n", pc->pc_name,
+		   set->set_full_scans, set->set_changed_scans,
+		   set->set_checked_reqs, pc->pc_partner_stolen,
+		   pc->pc_cpt_stolen);
+	ptlrpc_reqset_put(set);
+}
+
+/*
+ * How the ptlrpcd threads walked their request sets: the full scans, the
+ * wakeups that only checked the changed requests, and the requests that
+ * were checked in total.  Then the new requests each thread stole from
+ * its partners and from the other threads of its CPT.
+ */
+static int ptlrpcd_stats_seq_show(struct seq_file *m, void *v)
+{
+	int i;
+	int j;
+
+	seq_printf(m, "%-16s %14s %14s %14s %14s %14s\n", "thread",
+		   "full_scans", "changed_scans", "checked_reqs",
+		   "partner_stolen", "cpt_stolen");
+
+	mutex_lock(&ptlrpcd_mutex);
+	if (ptlrpcd_users > 0) {
+		for (i = 0; i < ptlrpcds_num; i++) {
+			if (ptlrpcds[i] == NULL)
+				break;
+			for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
+				ptlrpcd_stats_show_pc(m,
+						&ptlrpcds[i]->pd_threads[j]);
+		}
+		ptlrpcd_stats_show_pc(m, &ptlrpcd_rcv);
+	}
+	mutex_unlock(&ptlrpcd_mutex);
+
+	return 0;
+}
+LPROC_SEQ_FOPS_RO(ptlrpcd_stats);
+#endif /* CONFIG_PROC_FS */
+
+int ptlrpcd_lproc_init(void)
+{
+#ifdef CONFIG_PROC_FS
+	return lprocfs_seq_create(proc_lustre_root, "ptlrpcd_stats", 0444,
+				  &ptlrpcd_stats_fops, NULL);
+#else
+	return 0;
+#endif
+}
+
+void ptlrpcd_lproc_fini(void)
+{
+#ifdef CONFIG_PROC_FS
+	lprocfs_remove_proc_entry("ptlrpcd_stats", proc_lustre_root);
+#endif
+}
+
 int ptlrpcd_addref(void)
 {
         int rc = 0;
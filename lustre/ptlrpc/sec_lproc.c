@@ -173,9 +173,12 @@ int sptlrpc_lprocfs_cliobd_attach(struct obd_device *dev)
 EXPORT_SYMBOL(sptlrpc_lprocfs_cliobd_attach);
 
 LPROC_SEQ_FOPS_RO(sptlrpc_proc_enc_pool);
+LPROC_SEQ_FOPS_RO(ptlrpc_msgbuf_pool);
 static struct lprocfs_vars sptlrpc_lprocfs_vars[] = {
 	{ .name	=	"encrypt_page_pools",
 	  .fops	=	&sptlrpc_proc_enc_pool_fops	},
+	{ .name	=	"msgbuf_pools",
+	  .fops	=	&ptlrpc_msgbuf_pool_fops	},
 	{ NULL }
 };
 
@@ -570,7 +570,7 @@ int plain_alloc_reqbuf(struct ptlrpc_sec *sec,
 		LASSERT(!req->rq_pool);
 
 		alloc_len = size_roundup_power2(alloc_len);
-		OBD_ALLOC_LARGE(req->rq_reqbuf, alloc_len);
+		req->rq_reqbuf = ptlrpc_msgbuf_alloc(alloc_len);
 		if (!req->rq_reqbuf)
 			RETURN(-ENOMEM);
 
@@ -596,7 +596,7 @@ void plain_free_reqbuf(struct ptlrpc_sec *sec,
 {
 	ENTRY;
 	if (!req->rq_pool) {
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = NULL;
 		req->rq_reqbuf_len = 0;
 	}
@@ -627,7 +627,7 @@ int plain_alloc_repbuf(struct ptlrpc_sec *sec,
 
         alloc_len = size_roundup_power2(alloc_len);
 
-	OBD_ALLOC_LARGE(req->rq_repbuf, alloc_len);
+	req->rq_repbuf = ptlrpc_msgbuf_alloc(alloc_len);
 	if (!req->rq_repbuf)
 		RETURN(-ENOMEM);
 
@@ -640,7 +640,7 @@ void plain_free_repbuf(struct ptlrpc_sec *sec,
                        struct ptlrpc_request *req)
 {
         ENTRY;
-        OBD_FREE_LARGE(req->rq_repbuf, req->rq_repbuf_len);
+        ptlrpc_msgbuf_free(req->rq_repbuf, req->rq_repbuf_len);
         req->rq_repbuf = NULL;
         req->rq_repbuf_len = 0;
         EXIT;
@@ -681,7 +681,7 @@ int plain_enlarge_reqbuf(struct ptlrpc_sec *sec,
 	if (req->rq_reqbuf_len < newbuf_size) {
 		newbuf_size = size_roundup_power2(newbuf_size);
 
-		OBD_ALLOC_LARGE(newbuf, newbuf_size);
+		newbuf = ptlrpc_msgbuf_alloc(newbuf_size);
 		if (newbuf == NULL)
 			RETURN(-ENOMEM);
 
@@ -696,7 +696,7 @@ int plain_enlarge_reqbuf(struct ptlrpc_sec *sec,
 
 		memcpy(newbuf, req->rq_reqbuf, req->rq_reqbuf_len);
 
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = newbuf;
 		req->rq_reqbuf_len = newbuf_size;
 		req->rq_reqmsg = lustre_msg_buf(req->rq_reqbuf,
@@ -579,6 +579,8 @@ void lustre_assert_wire_constants(void)
 		(unsigned)LUDA_TYPE);
 	LASSERTF(LUDA_64BITHASH == 0x00000004UL, "found 0x%.8xUL\n",
 		(unsigned)LUDA_64BITHASH);
+	LASSERTF(LUDA_ATTRS == 0x00000008UL, "found 0x%.8xUL\n",
+		(unsigned)LUDA_ATTRS);
 
 	/* Checks for struct luda_type */
 	LASSERTF((int)sizeof(struct luda_type) == 2, "found %lld\n",
@@ -588,6 +590,62 @@ void lustre_assert_wire_constants(void)
 	LASSERTF((int)sizeof(((struct luda_type *)0)->lt_type) == 2, "found %lld\n",
 		 (long long)(int)sizeof(((struct luda_type *)0)->lt_type));
 
+	/* Checks for struct luda_attrs */
+	LASSERTF((int)sizeof(struct luda_attrs) == 80, "found %lld\n",
+		 (long long)(int)sizeof(struct luda_attrs));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_valid) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_valid));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_valid) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_valid));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_size) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_size));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_size) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_size));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_blocks) == 16, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_blocks));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_blocks) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_blocks));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_mtime) == 24, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_mtime));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_mtime) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_mtime));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_atime) == 32, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_atime));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_atime) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_atime));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_ctime) == 40, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_ctime));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_ctime) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_ctime));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_mode) == 48, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_mode));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_mode) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_mode));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_uid) == 52, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_uid));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_uid) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_uid));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_gid) == 56, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_gid));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_gid) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_gid));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_nlink) == 60, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_nlink));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_nlink) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_nlink));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_flags) == 64, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_flags));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_flags) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_flags));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_lock_idx) == 68, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_lock_idx));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_lock_idx) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_lock_idx));
+	LASSERTF((int)offsetof(struct luda_attrs, lda_lock) == 72, "found %lld\n",
+		 (long long)(int)offsetof(struct luda_attrs, lda_lock));
+	LASSERTF((int)sizeof(((struct luda_attrs *)0)->lda_lock) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct luda_attrs *)0)->lda_lock));
+
 	/* Checks for struct lu_dirpage */
 	LASSERTF((int)sizeof(struct lu_dirpage) == 24, "found %lld\n",
 		 (long long)(int)sizeof(struct lu_dirpage));
@@ -1204,12 +1262,26 @@ void lustre_assert_wire_constants(void)
 		 OBD_CONNECT_FLAGS2);
 	LASSERTF(OBD_CONNECT2_FILE_SECCTX == 0x1ULL, "found 0x%.16llxULL\n",
 		 OBD_CONNECT2_FILE_SECCTX);
+	LASSERTF(OBD_CONNECT2_READDIR_PLUS == 0x2ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_READDIR_PLUS);
+	LASSERTF(OBD_CONNECT2_MULTIOBJ_BRW == 0x4ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_MULTIOBJ_BRW);
+	LASSERTF(OBD_CONNECT2_LOCKAHEAD == 0x8ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_LOCKAHEAD);
+	LASSERTF(OBD_CONNECT2_BL_AST_BATCH == 0x10ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_BL_AST_BATCH);
+	LASSERTF(OBD_CONNECT2_LOCK_CONVERT == 0x20ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_LOCK_CONVERT);
 	LASSERTF(OBD_CKSUM_CRC32 == 0x00000001UL, "found 0x%.8xUL\n",
 		(unsigned)OBD_CKSUM_CRC32);
 	LASSERTF(OBD_CKSUM_ADLER == 0x00000002UL, "found 0x%.8xUL\n",
 		(unsigned)OBD_CKSUM_ADLER);
 	LASSERTF(OBD_CKSUM_CRC32C == 0x00000004UL, "found 0x%.8xUL\n",
 		(unsigned)OBD_CKSUM_CRC32C);
+	LASSERTF(OBD_CKSUM_T10IP512 == 0x00000008UL, "found 0x%.8xUL\n",
+		(unsigned)OBD_CKSUM_T10IP512);
+	LASSERTF(OBD_CKSUM_T10CRC512 == 0x00000010UL, "found 0x%.8xUL\n",
+		(unsigned)OBD_CKSUM_T10CRC512);
 
 	/* Checks for struct obdo */
 	LASSERTF((int)sizeof(struct obdo) == 208, "found %lld\n",
@@ -1424,6 +1496,8 @@ void lustre_assert_wire_constants(void)
 	CLASSERT(OBD_FL_CKSUM_CRC32 == 0x00001000);
 	CLASSERT(OBD_FL_CKSUM_ADLER == 0x00002000);
 	CLASSERT(OBD_FL_CKSUM_CRC32C == 0x00004000);
+	CLASSERT(OBD_FL_CKSUM_T10IP512 == 0x00005000);
+	CLASSERT(OBD_FL_CKSUM_T10CRC512 == 0x00006000);
 	CLASSERT(OBD_FL_CKSUM_RSVD2 == 0x00008000);
 	CLASSERT(OBD_FL_CKSUM_RSVD3 == 0x00010000);
 	CLASSERT(OBD_FL_SHRINK_GRANT == 0x00020000);
@@ -3022,12 +3096,16 @@ void lustre_assert_wire_constants(void)
 		 (long long)(int)sizeof(((struct ldlm_extent *)0)->gid));
 
 	/* Checks for struct ldlm_inodebits */
-	LASSERTF((int)sizeof(struct ldlm_inodebits) == 8, "found %lld\n",
+	LASSERTF((int)sizeof(struct ldlm_inodebits) == 16, "found %lld\n",
 		 (long long)(int)sizeof(struct ldlm_inodebits));
 	LASSERTF((int)offsetof(struct ldlm_inodebits, bits) == 0, "found %lld\n",
 		 (long long)(int)offsetof(struct ldlm_inodebits, bits));
 	LASSERTF((int)sizeof(((struct ldlm_inodebits *)0)->bits) == 8, "found %lld\n",
 		 (long long)(int)sizeof(((struct ldlm_inodebits *)0)->bits));
+	LASSERTF((int)offsetof(struct ldlm_inodebits, cancel_bits) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct ldlm_inodebits, cancel_bits));
+	LASSERTF((int)sizeof(((struct ldlm_inodebits *)0)->cancel_bits) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct ldlm_inodebits *)0)->cancel_bits));
 
 	/* Checks for struct ldlm_flock_wire */
 	LASSERTF((int)sizeof(struct ldlm_flock_wire) == 32, "found %lld\n",
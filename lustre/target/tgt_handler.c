@@ -185,12 +185,75 @@ out:
 }
 EXPORT_SYMBOL(tgt_validate_obdo);
 
+/**
+ * Unpack the objects after the first one of a multi-object write, see
+ * OBD_CONNECT2_MULTIOBJ_BRW. Their attributes come in RMF_OST_OBDOS and are
+ * validated and mapped just like the ost_body of the request.
+ */
+static int tgt_io_objs_unpack(struct tgt_session_info *tsi,
+			      struct obd_ioobj *ioo, int obj_count)
+{
+	struct req_capsule	*pill = tsi->tsi_pill;
+	struct lu_nodemap	*nodemap;
+	struct obdo		*obdos;
+	int			 rc = 0;
+	int			 i;
+
+	ENTRY;
+
+	if (!(exp_connect_flags2(tsi->tsi_exp) & OBD_CONNECT2_MULTIOBJ_BRW) ||
+	    lustre_msg_get_opc(tgt_ses_req(tsi)->rq_reqmsg) != OST_WRITE ||
+	    obj_count > OBD_MAX_BRW_OBJS) {
+		CERROR("%s: too many ioobjs (%d)\n", tgt_name(tsi->tsi_tgt),
+		       obj_count);
+		RETURN(-EPROTO);
+	}
+
+	if (req_capsule_get_size(pill, &RMF_OST_OBDOS, RCL_CLIENT) !=
+	    (obj_count - 1) * sizeof(*obdos)) {
+		CERROR("%s: %d ioobjs without matching obdos\n",
+		       tgt_name(tsi->tsi_tgt), obj_count);
+		RETURN(-EPROTO);
+	}
+
+	obdos = req_capsule_client_get(pill, &RMF_OST_OBDOS);
+	if (obdos == NULL)
+		RETURN(-EPROTO);
+
+	nodemap = nodemap_get_from_exp(tsi->tsi_exp);
+	if (IS_ERR(nodemap))
+		RETURN(PTR_ERR(nodemap));
+
+	for (i = 1; i < obj_count; i++) {
+		struct obdo *oa = &obdos[i - 1];
+
+		if (!(oa->o_valid & OBD_MD_FLID))
+			GOTO(out, rc = -EPROTO);
+
+		rc = tgt_validate_obdo(tsi, oa);
+		if (rc != 0)
+			GOTO(out, rc);
+
+		oa->o_uid = nodemap_map_id(nodemap, NODEMAP_UID,
+					   NODEMAP_CLIENT_TO_FS, oa->o_uid);
+		oa->o_gid = nodemap_map_id(nodemap, NODEMAP_GID,
+					   NODEMAP_CLIENT_TO_FS, oa->o_gid);
+		ioo[i].ioo_oid = oa->o_oi;
+	}
+	EXIT;
+out:
+	nodemap_putref(nodemap);
+	return rc;
+}
+
 static int tgt_io_data_unpack(struct tgt_session_info *tsi, struct ost_id *oi)
 {
 	unsigned		 max_brw;
 	struct niobuf_remote	*rnb;
 	struct obd_ioobj	*ioo;
 	int			 obj_count;
+	int			 rc;
+	int			 i;
 
 	ENTRY;
 
@@ -218,21 +281,24 @@ static int tgt_io_data_unpack(struct tgt_session_info *tsi, struct ost_id *oi)
 		CERROR("%s: short ioobj\n", tgt_name(tsi->tsi_tgt));
 		RETURN(-EPROTO);
 	} else if (obj_count > 1) {
-		CERROR("%s: too many ioobjs (%d)\n", tgt_name(tsi->tsi_tgt),
-		       obj_count);
-		RETURN(-EPROTO);
+		rc = tgt_io_objs_unpack(tsi, ioo, obj_count);
+		if (rc != 0)
+			RETURN(rc);
 	}
 
-	if (ioo->ioo_bufcnt == 0) {
-		CERROR("%s: ioo has zero bufcnt\n", tgt_name(tsi->tsi_tgt));
-		RETURN(-EPROTO);
-	}
+	for (i = 0; i < obj_count; i++) {
+		if (ioo[i].ioo_bufcnt == 0) {
+			CERROR("%s: ioo has zero bufcnt\n",
+			       tgt_name(tsi->tsi_tgt));
+			RETURN(-EPROTO);
+		}
 
-	if (ioo->ioo_bufcnt > PTLRPC_MAX_BRW_PAGES) {
-		DEBUG_REQ(D_RPCTRACE, tgt_ses_req(tsi),
-			  "bulk has too many pages (%d)",
-			  ioo->ioo_bufcnt);
-		RETURN(-EPROTO);
+		if (ioo[i].ioo_bufcnt > PTLRPC_MAX_BRW_PAGES) {
+			DEBUG_REQ(D_RPCTRACE, tgt_ses_req(tsi),
+				  "bulk has too many pages (%d)",
+				  ioo[i].ioo_bufcnt);
+			RETURN(-EPROTO);
+		}
 	}
 
 	RETURN(0);
@@ -366,6 +432,35 @@ static int tgt_request_preprocess(struct tgt_session_info *tsi,
 	RETURN(rc);
 }
 
+/**
+ * Return the number of bytes an OST_READ/OST_WRITE carries inline in its
+ * request or reply buffer (OBD_FL_SHORT_IO), or 0 for a bulk transfer.
+ */
+static int tgt_short_io_size(struct tgt_session_info *tsi)
+{
+	struct ost_body		*body = tsi->tsi_ost_body;
+	struct niobuf_remote	*rnb;
+	int			 niocount, size = 0, i;
+
+	if (body == NULL || !(body->oa.o_valid & OBD_MD_FLFLAGS) ||
+	    !(body->oa.o_flags & OBD_FL_SHORT_IO))
+		return 0;
+
+	rnb = req_capsule_client_get(tsi->tsi_pill, &RMF_NIOBUF_REMOTE);
+	if (rnb == NULL)
+		return -EPROTO;
+
+	niocount = req_capsule_get_size(tsi->tsi_pill, &RMF_NIOBUF_REMOTE,
+					RCL_CLIENT) / sizeof(*rnb);
+	for (i = 0; i < niocount; i++) {
+		if (rnb[i].rnb_len > OBD_MAX_SHORT_IO_BYTES - size)
+			return -EPROTO;
+		size += rnb[i].rnb_len;
+	}
+
+	return size;
+}
+
 /*
  * Invoke handler for this request opc. Also do necessary preprocessing
  * (according to handler ->th_flags), and post-processing (setting of
@@ -426,8 +521,19 @@ static int tgt_handle_request0(struct tgt_session_info *tsi,
 					  RCL_SERVER))
 			req_capsule_set_size(tsi->tsi_pill, &RMF_LOGCOOKIES,
 					     RCL_SERVER, 0);
+		if (req_capsule_has_field(tsi->tsi_pill, &RMF_SHORT_IO,
+					  RCL_SERVER)) {
+			rc = tgt_short_io_size(tsi);
+			if (rc >= 0) {
+				req_capsule_set_size(tsi->tsi_pill,
+						     &RMF_SHORT_IO,
+						     RCL_SERVER, rc);
+				rc = 0;
+			}
+		}
 
-		rc = req_capsule_server_pack(tsi->tsi_pill);
+		if (rc == 0)
+			rc = req_capsule_server_pack(tsi->tsi_pill);
 	}
 
 	if (likely(rc == 0)) {
@@ -1636,86 +1742,183 @@ void tgt_brw_unlock(struct obd_ioobj *obj, struct niobuf_remote *niob,
 	EXIT;
 }
 
+static void tgt_checksum_get_frag(void *data, int idx, struct page **page,
+				  unsigned int *offset, unsigned int *len)
+{
+	struct ptlrpc_bulk_desc *desc = data;
+
+	*page = BD_GET_KIOV(desc, idx).kiov_page;
+	*offset = BD_GET_KIOV(desc, idx).kiov_offset & ~PAGE_MASK;
+	*len = BD_GET_KIOV(desc, idx).kiov_len;
+}
+
+struct tgt_cksum_frags {
+	struct lu_target	*tcf_tgt;
+	struct ptlrpc_bulk_desc	*tcf_desc;
+	/* local buffers backing the bulk fragments, in the same order */
+	struct niobuf_local	*tcf_lnb;
+	obd_dif_csum_fn		*tcf_dif_fn;
+	/* keep the guard tags of the write for the OSD */
+	bool			 tcf_store;
+};
+
+/*
+ * Guard tags of one bulk fragment for a T10 checksum type.  The guard tags
+ * a read returned from the disk are used as is, and those of a write are
+ * kept in the local buffer so that the OSD stores them without computing
+ * them again.  Only whole sectors can be shared with the disk.
+ */
+static int tgt_checksum_frag_guards(void *data, int idx, __u16 *guards,
+				    int guard_number, int *used_number)
+{
+	struct tgt_cksum_frags *frags = data;
+	struct niobuf_local *lnb = &frags->tcf_lnb[idx];
+	struct page *page;
+	unsigned int offset;
+	unsigned int len;
+	bool shared;
+	int rc;
+
+	tgt_checksum_get_frag(frags->tcf_desc, idx, &page, &offset, &len);
+	/* the fault injection code may have swapped the page */
+	shared = (offset | len) % OBD_DIF_SECTOR_SIZE == 0 &&
+		 lnb->lnb_page == page;
+
+	if (lnb->lnb_guard_disk && shared) {
+		*used_number = len / OBD_DIF_SECTOR_SIZE;
+		if (*used_number > guard_number)
+			return -E2BIG;
+		memcpy(guards, lnb->lnb_guards + offset / OBD_DIF_SECTOR_SIZE,
+		       *used_number * sizeof(*guards));
+		return 0;
+	}
+
+	rc = obd_page_dif_generate_buffer(tgt_name(frags->tcf_tgt), page,
+					  offset, len, guards, guard_number,
+					  used_number, frags->tcf_dif_fn);
+	if (rc == 0 && frags->tcf_store && shared) {
+		memcpy(lnb->lnb_guards + offset / OBD_DIF_SECTOR_SIZE, guards,
+		       *used_number * sizeof(*guards));
+		lnb->lnb_guard_rpc = 1;
+	}
+
+	return rc;
+}
+
 static __u32 tgt_checksum_bulk(struct lu_target *tgt,
 			       struct ptlrpc_bulk_desc *desc, int opc,
-			       cksum_type_t cksum_type)
+			       cksum_type_t cksum_type,
+			       struct niobuf_local *local_nb)
 {
-	struct cfs_crypto_hash_desc	*hdesc;
 	unsigned int			bufsize;
-	int				i, err;
+	int				err;
 	unsigned char			cfs_alg = cksum_obd2cfs(cksum_type);
 	__u32				cksum;
 
 	LASSERT(ptlrpc_is_bulk_desc_kiov(desc->bd_type));
 
-	hdesc = cfs_crypto_hash_init(cfs_alg, NULL, 0);
-	if (IS_ERR(hdesc)) {
-		CERROR("%s: unable to initialize checksum hash %s\n",
-		       tgt_name(tgt), cfs_crypto_hash_name(cfs_alg));
-		return PTR_ERR(hdesc);
-	}
-
 	CDEBUG(D_INFO, "Checksum for algo %s\n", cfs_crypto_hash_name(cfs_alg));
-	for (i = 0; i < desc->bd_iov_count; i++) {
-		/* corrupt the data before we compute the checksum, to
-		 * simulate a client->OST data error */
-		if (i == 0 && opc == OST_WRITE &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_RECEIVE)) {
-			int off = BD_GET_KIOV(desc, i).kiov_offset &
-				~PAGE_MASK;
-			int len = BD_GET_KIOV(desc, i).kiov_len;
-			struct page *np = tgt_page_to_corrupt;
-			char *ptr = kmap(BD_GET_KIOV(desc, i).kiov_page) + off;
-
-			if (np) {
-				char *ptr2 = kmap(np) + off;
-
-				memcpy(ptr2, ptr, len);
-				memcpy(ptr2, "bad3", min(4, len));
-				kunmap(np);
-				BD_GET_KIOV(desc, i).kiov_page = np;
-			} else {
-				CERROR("%s: can't alloc page for corruption\n",
-				       tgt_name(tgt));
-			}
-		}
-		cfs_crypto_hash_update_page(hdesc,
-				  BD_GET_KIOV(desc, i).kiov_page,
-				  BD_GET_KIOV(desc, i).kiov_offset &
-					~PAGE_MASK,
-				  BD_GET_KIOV(desc, i).kiov_len);
-
-		 /* corrupt the data after we compute the checksum, to
-		 * simulate an OST->client data error */
-		if (i == 0 && opc == OST_READ &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_SEND)) {
-			int off = BD_GET_KIOV(desc, i).kiov_offset
-			  & ~PAGE_MASK;
-			int len = BD_GET_KIOV(desc, i).kiov_len;
-			struct page *np = tgt_page_to_corrupt;
-			char *ptr =
-			  kmap(BD_GET_KIOV(desc, i).kiov_page) + off;
-
-			if (np) {
-				char *ptr2 = kmap(np) + off;
-
-				memcpy(ptr2, ptr, len);
-				memcpy(ptr2, "bad4", min(4, len));
-				kunmap(np);
-				BD_GET_KIOV(desc, i).kiov_page = np;
-			} else {
-				CERROR("%s: can't alloc page for corruption\n",
-				       tgt_name(tgt));
-			}
+
+	/* corrupt the data before we compute the checksum, to
+	 * simulate a client->OST data error */
+	if (desc->bd_iov_count > 0 && opc == OST_WRITE &&
+	    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_RECEIVE)) {
+		int off = BD_GET_KIOV(desc, 0).kiov_offset & ~PAGE_MASK;
+		int len = BD_GET_KIOV(desc, 0).kiov_len;
+		struct page *np = tgt_page_to_corrupt;
+		char *ptr = kmap(BD_GET_KIOV(desc, 0).kiov_page) + off;
+
+		if (np) {
+			char *ptr2 = kmap(np) + off;
+
+			memcpy(ptr2, ptr, len);
+			memcpy(ptr2, "bad3", min(4, len));
+			kunmap(np);
+			BD_GET_KIOV(desc, 0).kiov_page = np;
+		} else {
+			CERROR("%s: can't alloc page for corruption\n",
+			       tgt_name(tgt));
 		}
 	}
 
-	bufsize = sizeof(cksum);
-	err = cfs_crypto_hash_final(hdesc, (unsigned char *)&cksum, &bufsize);
+	if (cksum_type & OBD_CKSUM_T10_ALL) {
+		struct tgt_cksum_frags frags = {
+			.tcf_tgt	= tgt,
+			.tcf_desc	= desc,
+			.tcf_lnb	= local_nb,
+			.tcf_dif_fn	= obd_t10_cksum2dif(cksum_type),
+			.tcf_store	= opc == OST_WRITE &&
+					  cksum_type == tgt->lut_dt_t10_type,
+		};
+
+		if (frags.tcf_dif_fn == NULL)
+			err = -EOPNOTSUPP;
+		else
+			err = obd_t10_cksum_bulk(cksum_type, &frags,
+						 desc->bd_iov_count,
+						 tgt_checksum_frag_guards,
+						 &cksum);
+	} else {
+		bufsize = sizeof(cksum);
+		err = cfs_crypto_hash_pages(cfs_alg, desc, desc->bd_iov_count,
+					    tgt_checksum_get_frag,
+					    (unsigned char *)&cksum, &bufsize);
+	}
+	if (err != 0) {
+		CERROR("%s: unable to compute checksum hash %s: rc = %d\n",
+		       tgt_name(tgt), cfs_crypto_hash_name(cfs_alg), err);
+		return err;
+	}
+
+	/* corrupt the data after we compute the checksum, to
+	 * simulate an OST->client data error */
+	if (desc->bd_iov_count > 0 && opc == OST_READ &&
+	    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_SEND)) {
+		int off = BD_GET_KIOV(desc, 0).kiov_offset & ~PAGE_MASK;
+		int len = BD_GET_KIOV(desc, 0).kiov_len;
+		struct page *np = tgt_page_to_corrupt;
+		char *ptr = kmap(BD_GET_KIOV(desc, 0).kiov_page) + off;
+
+		if (np) {
+			char *ptr2 = kmap(np) + off;
+
+			memcpy(ptr2, ptr, len);
+			memcpy(ptr2, "bad4", min(4, len));
+			kunmap(np);
+			BD_GET_KIOV(desc, 0).kiov_page = np;
+		} else {
+			CERROR("%s: can't alloc page for corruption\n",
+			       tgt_name(tgt));
+		}
+	}
 
 	return cksum;
 }
 
+/**
+ * Move the data of a short I/O between the pages of \a desc and the inline
+ * RPC buffer \a buf, in place of the bulk transfer.
+ */
+static void tgt_short_io_copy(struct ptlrpc_bulk_desc *desc,
+			      unsigned char *buf, bool to_buf)
+{
+	int i;
+
+	for (i = 0; i < desc->bd_iov_count; i++) {
+		lnet_kiov_t	*kiov = &BD_GET_KIOV(desc, i);
+		unsigned char	*ptr = kmap(kiov->kiov_page) +
+				       (kiov->kiov_offset & ~PAGE_MASK);
+
+		if (to_buf)
+			memcpy(buf, ptr, kiov->kiov_len);
+		else
+			memcpy(ptr, buf, kiov->kiov_len);
+		kunmap(kiov->kiov_page);
+		buf += kiov->kiov_len;
+	}
+	desc->bd_nob_transferred = desc->bd_nob;
+}
+
 int tgt_brw_read(struct tgt_session_info *tsi)
 {
 	struct ptlrpc_request	*req = tgt_ses_req(tsi);
@@ -1728,6 +1931,7 @@ int tgt_brw_read(struct tgt_session_info *tsi)
 	struct l_wait_info	 lwi;
 	struct lustre_handle	 lockh = { 0 };
 	int			 npages, nob = 0, rc, i, no_reply = 0;
+	int			 short_io_size;
 	struct tgt_thread_big_cache *tbc = req->rq_svc_thread->t_data;
 
 	ENTRY;
@@ -1773,6 +1977,11 @@ int tgt_brw_read(struct tgt_session_info *tsi)
 	remote_nb = req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE);
 	LASSERT(remote_nb != NULL); /* must exists after tgt_ost_body_unpack */
 
+	/* the reply buffer was sized by tgt_handle_request0() */
+	short_io_size = tgt_short_io_size(tsi);
+	if (short_io_size < 0)
+		RETURN(short_io_size);
+
 	local_nb = tbc->local;
 
 	rc = tgt_brw_lock(exp->exp_obd->obd_namespace, &tsi->tsi_resid, ioo,
@@ -1848,7 +2057,8 @@ int tgt_brw_read(struct tgt_session_info *tsi)
 		repbody->oa.o_flags = cksum_type_pack(cksum_type);
 		repbody->oa.o_valid = OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
 		repbody->oa.o_cksum = tgt_checksum_bulk(tsi->tsi_tgt, desc,
-							OST_READ, cksum_type);
+							OST_READ, cksum_type,
+							local_nb);
 		CDEBUG(D_PAGE, "checksum at read origin: %x\n",
 		       repbody->oa.o_cksum);
 	} else {
@@ -1858,7 +2068,15 @@ int tgt_brw_read(struct tgt_session_info *tsi)
 
 	/* Check if client was evicted while we were doing i/o before touching
 	 * network */
-	if (likely(rc == 0 &&
+	if (rc == 0 && short_io_size != 0) {
+		unsigned char *buf;
+
+		buf = req_capsule_server_get(&req->rq_pill, &RMF_SHORT_IO);
+		if (buf == NULL || nob > short_io_size)
+			rc = -EPROTO;
+		else
+			tgt_short_io_copy(desc, buf, true);
+	} else if (likely(rc == 0 &&
 		   !CFS_FAIL_PRECHECK(OBD_FAIL_PTLRPC_CLIENT_BULK_CB2) &&
 		   !CFS_FAIL_CHECK(OBD_FAIL_PTLRPC_DROP_BULK))) {
 		rc = target_bulk_io(exp, desc, &lwi);
@@ -1876,6 +2094,9 @@ out_lock:
 		ptlrpc_free_bulk(desc);
 
 	LASSERT(rc <= 0);
+	if (short_io_size != 0 && !no_reply)
+		req_capsule_shrink(&req->rq_pill, &RMF_SHORT_IO,
+				   rc == 0 ? nob : 0, RCL_SERVER);
 	if (rc == 0) {
 		rc = nob;
 		ptlrpc_lprocfs_brw(req, nob);
@@ -1951,6 +2172,62 @@ static void tgt_warn_on_cksum(struct ptlrpc_request *req,
 			   client_cksum, server_cksum);
 }
 
+/**
+ * Set up pages to receive the data of an object of a multi-object write
+ * whose preparation failed, so that the other objects of the RPC can still
+ * be written. The data is dropped by tgt_brw_scratch_put().
+ *
+ * \param[in] ioo	the object
+ * \param[in] rnb	its remote niobufs
+ * \param[out] lnb	local niobufs to set up
+ * \param[out] npages	number of local niobufs set up
+ */
+static int tgt_brw_scratch_get(struct obd_ioobj *ioo,
+			       struct niobuf_remote *rnb,
+			       struct niobuf_local *lnb, int *npages)
+{
+	int i;
+	int n = 0;
+
+	for (i = 0; i < ioo->ioo_bufcnt; i++) {
+		__u64 offset = rnb[i].rnb_offset;
+		int len = rnb[i].rnb_len;
+
+		while (len > 0) {
+			int poff = offset & ~PAGE_MASK;
+			int plen = min_t(int, len, PAGE_SIZE - poff);
+
+			memset(&lnb[n], 0, sizeof(lnb[n]));
+			lnb[n].lnb_page = alloc_page(GFP_NOFS);
+			if (lnb[n].lnb_page == NULL) {
+				while (n-- > 0)
+					__free_page(lnb[n].lnb_page);
+				return -ENOMEM;
+			}
+			lnb[n].lnb_file_offset = offset;
+			lnb[n].lnb_page_offset = poff;
+			lnb[n].lnb_len = plen;
+			lnb[n].lnb_flags = rnb[i].rnb_flags;
+			offset += plen;
+			len -= plen;
+			n++;
+		}
+	}
+	*npages = n;
+
+	return 0;
+}
+
+static void tgt_brw_scratch_put(struct niobuf_local *lnb, int npages)
+{
+	int i;
+
+	for (i = 0; i < npages; i++) {
+		__free_page(lnb[i].lnb_page);
+		lnb[i].lnb_page = NULL;
+	}
+}
+
 int tgt_brw_write(struct tgt_session_info *tsi)
 {
 	struct ptlrpc_request	*req = tgt_ses_req(tsi);
@@ -1960,11 +2237,17 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 	struct niobuf_local	*local_nb;
 	struct obd_ioobj	*ioo;
 	struct ost_body		*body, *repbody;
+	struct obdo		*obdos = NULL;
+	struct obdo		*rep_obdos = NULL;
 	struct l_wait_info	 lwi;
 	struct lustre_handle	 lockh = {0};
 	__u32			*rcs;
 	int			 objcount, niocount, npages;
-	int			 rc, i, j;
+	int			 obj_pages[OBD_MAX_BRW_OBJS];
+	int			 obj_rc[OBD_MAX_BRW_OBJS];
+	int			 prepped;
+	int			 short_io_size;
+	int			 rc, i, j, k;
 	cksum_type_t		 cksum_type = OBD_CKSUM_CRC32;
 	bool			 no_reply = false, mmap;
 	struct tgt_thread_big_cache *tbc = req->rq_svc_thread->t_data;
@@ -2020,18 +2303,46 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 			sizeof(*remote_nb))
 		RETURN(err_serious(-EPROTO));
 
+	if (objcount > 1) {
+		/* lockless writes are never sent for several objects, and
+		 * all their pages have to fit into the local buffers */
+		for (npages = i = 0; i < niocount; i++) {
+			if (remote_nb[i].rnb_flags & OBD_BRW_SRVLOCK)
+				RETURN(err_serious(-EPROTO));
+			npages += ((remote_nb[i].rnb_offset +
+				    remote_nb[i].rnb_len - 1) >> PAGE_SHIFT) -
+				  (remote_nb[i].rnb_offset >> PAGE_SHIFT) + 1;
+		}
+		if (npages > PTLRPC_MAX_BRW_PAGES)
+			RETURN(err_serious(-EPROTO));
+
+		obdos = req_capsule_client_get(&req->rq_pill, &RMF_OST_OBDOS);
+		LASSERT(obdos != NULL); /* checked by tgt_io_data_unpack */
+	}
+
+	short_io_size = tgt_short_io_size(tsi);
+	if (short_io_size < 0 ||
+	    short_io_size != req_capsule_get_size(&req->rq_pill, &RMF_SHORT_IO,
+						  RCL_CLIENT))
+		RETURN(err_serious(-EPROTO));
+
 	if ((remote_nb[0].rnb_flags & OBD_BRW_MEMALLOC) &&
 	    (exp->exp_connection->c_peer.nid == exp->exp_connection->c_self))
 		memory_pressure_set();
 
 	req_capsule_set_size(&req->rq_pill, &RMF_RCS, RCL_SERVER,
 			     niocount * sizeof(*rcs));
+	req_capsule_set_size(&req->rq_pill, &RMF_OST_OBDOS, RCL_SERVER,
+			     (objcount - 1) * sizeof(*rep_obdos));
 	rc = req_capsule_server_pack(&req->rq_pill);
 	if (rc != 0)
 		GOTO(out, rc = err_serious(rc));
 
 	CFS_FAIL_TIMEOUT(OBD_FAIL_OST_BRW_PAUSE_PACK, cfs_fail_val);
 	rcs = req_capsule_server_get(&req->rq_pill, &RMF_RCS);
+	if (objcount > 1)
+		rep_obdos = req_capsule_server_get(&req->rq_pill,
+						   &RMF_OST_OBDOS);
 
 	local_nb = tbc->local;
 
@@ -2069,11 +2380,34 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 		GOTO(out_lock, rc = -ENOMEM);
 	repbody->oa = body->oa;
 
-	npages = PTLRPC_MAX_BRW_PAGES;
-	rc = obd_preprw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
-			objcount, ioo, remote_nb, &npages, local_nb);
-	if (rc < 0)
+	/* each object is prepared and committed on its own, the pages of all
+	 * of them follow each other in local_nb and go in one bulk. An object
+	 * of a multi-object write which can't be prepared still gets its data
+	 * received, into scratch pages, so the others can be written */
+	for (npages = i = j = 0; i < objcount; j += ioo[i].ioo_bufcnt, i++) {
+		obj_pages[i] = PTLRPC_MAX_BRW_PAGES - npages;
+		obj_rc[i] = obd_preprw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+				       i == 0 ? &repbody->oa : &obdos[i - 1],
+				       1, &ioo[i], remote_nb + j,
+				       &obj_pages[i], local_nb + npages);
+		rc = obj_rc[i];
+		if (rc < 0 && objcount > 1) {
+			CDEBUG(D_INODE, "%s: object "DOSTID" of %d not "
+			       "written: rc = %d\n", tgt_name(tsi->tsi_tgt),
+			       POSTID(&ioo[i].ioo_oid), objcount, rc);
+			rc = tgt_brw_scratch_get(&ioo[i], remote_nb + j,
+						 local_nb + npages,
+						 &obj_pages[i]);
+		}
+		if (rc < 0)
+			break;
+		npages += obj_pages[i];
+	}
+	prepped = i;
+	if (prepped == 0)
 		GOTO(out_lock, rc);
+	if (rc < 0)
+		GOTO(skip_transfer, rc);
 
 	desc = ptlrpc_prep_bulk_exp(req, npages, ioobj_max_brw_get(ioo),
 				    PTLRPC_BULK_GET_SINK | PTLRPC_BULK_BUF_KIOV,
@@ -2089,12 +2423,22 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 						 local_nb[i].lnb_page_offset,
 						 local_nb[i].lnb_len);
 
-	rc = sptlrpc_svc_prep_bulk(req, desc);
-	if (rc != 0)
-		GOTO(skip_transfer, rc);
+	if (short_io_size != 0) {
+		unsigned char *buf;
 
-	rc = target_bulk_io(exp, desc, &lwi);
-	no_reply = rc != 0;
+		buf = req_capsule_client_get(&req->rq_pill, &RMF_SHORT_IO);
+		if (buf == NULL || desc->bd_nob != short_io_size)
+			GOTO(skip_transfer, rc = -EPROTO);
+		tgt_short_io_copy(desc, buf, false);
+		desc->bd_sender = req->rq_peer.nid;
+	} else {
+		rc = sptlrpc_svc_prep_bulk(req, desc);
+		if (rc != 0)
+			GOTO(skip_transfer, rc);
+
+		rc = target_bulk_io(exp, desc, &lwi);
+		no_reply = rc != 0;
+	}
 
 skip_transfer:
 	if (body->oa.o_valid & OBD_MD_FLCKSUM && rc == 0) {
@@ -2107,7 +2451,8 @@ skip_transfer:
 		repbody->oa.o_flags &= ~OBD_FL_CKSUM_ALL;
 		repbody->oa.o_flags |= cksum_type_pack(cksum_type);
 		repbody->oa.o_cksum = tgt_checksum_bulk(tsi->tsi_tgt, desc,
-							OST_WRITE, cksum_type);
+							OST_WRITE, cksum_type,
+							local_nb);
 		cksum_counter++;
 
 		if (unlikely(body->oa.o_cksum != repbody->oa.o_cksum)) {
@@ -2127,8 +2472,32 @@ skip_transfer:
 	}
 
 	/* Must commit after prep above in all cases */
-	rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
-			  objcount, ioo, remote_nb, npages, local_nb, rc);
+	for (i = j = k = 0; i < prepped;
+	     j += ioo[i].ioo_bufcnt, k += obj_pages[i], i++) {
+		if (obj_rc[i] < 0) {
+			tgt_brw_scratch_put(local_nb + k, obj_pages[i]);
+			continue;
+		}
+		obj_rc[i] = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+					 i == 0 ? &repbody->oa : &obdos[i - 1],
+					 1, &ioo[i], remote_nb + j,
+					 obj_pages[i], local_nb + k, rc);
+	}
+
+	/* a multi-object write only fails as a whole if none of its objects
+	 * was written, the result of each one goes in the rcs of its niobufs
+	 * and its attributes with the quota flags in rep_obdos */
+	rc = obj_rc[0];
+	for (i = 1; i < prepped; i++) {
+		if (obj_rc[i] == 0)
+			rc = 0;
+		rep_obdos[i - 1] = obdos[i - 1];
+		rep_obdos[i - 1].o_valid &= ~(OBD_MD_FLMTIME | OBD_MD_FLATIME);
+	}
+	for (i = 0; i < prepped; i++) {
+		if (obj_rc[i] == -ENOTCONN)
+			rc = -ENOTCONN;
+	}
 	if (rc == -ENOTCONN)
 		/* quota acquire process has been given up because
 		 * either the client has been evicted or the client
@@ -2144,13 +2513,17 @@ skip_transfer:
 
 	if (rc == 0) {
 		int nob = 0;
+		int obj_end = ioo[0].ioo_bufcnt;
 
 		/* set per-requested niobuf return codes */
-		for (i = j = 0; i < niocount; i++) {
+		for (i = j = k = 0; i < niocount; i++) {
 			int len = remote_nb[i].rnb_len;
 
-			nob += len;
-			rcs[i] = 0;
+			if (i == obj_end)
+				obj_end += ioo[++k].ioo_bufcnt;
+			rcs[i] = obj_rc[k];
+			if (rcs[i] == 0)
+				nob += len;
 			do {
 				LASSERT(j < npages);
 				if (local_nb[j].lnb_rc < 0)
@@ -53,11 +53,38 @@ static size_t check_bytes(const char *buf, int byte, size_t len)
         return p - buf;
 }
 
+/* the pattern byte of file offset \a off, it does not repeat with the
+ * page size so data landing at the wrong offset is caught */
+static char pattern_byte(off64_t off)
+{
+	return off % 251;
+}
+
+static void fill_pattern(char *buf, off64_t seek, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern_byte(seek + i);
+}
+
+/* return index of the first byte not matching the pattern
+ * or buffer size if all bytes are matching */
+static size_t check_pattern(const char *buf, off64_t seek, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != pattern_byte(seek + i))
+			break;
+	return i;
+}
+
 int main(int argc, char **argv)
 {
 #ifdef O_DIRECT
         int fd;
-        char *buf, *fname;
+        char *map, *buf, *fname;
         int blocks, seek_blocks;
         long len;
         off64_t seek;
@@ -65,9 +92,11 @@ int main(int argc, char **argv)
         char pad = 0xba;
         int action;
         int rc;
+	long buf_offset = 0;
+	int pattern = 0;
 
-        if (argc < 5 || argc > 6) {
-                printf("Usage: %s <read/write/rdwr/readhole> file seek nr_blocks [blocksize]\n", argv[0]);
+	if (argc < 5 || argc > 7) {
+		printf("Usage: %s <read/write/rdwr/readhole> file seek nr_blocks [blocksize [buf_offset]]\n", argv[0]);
                 return 1;
         }
 
@@ -106,18 +135,30 @@ int main(int argc, char **argv)
                 return 1;
         }
 
+	/* with a buffer offset the data is a pattern depending on the file
+	 * offset, so that misplaced data is caught as well */
+	if (argc >= 7) {
+		buf_offset = strtoul(argv[6], 0, 0);
+		pattern = pad != 0;
+	}
+
         printf("directio on %s for %dx%lu bytes \n", fname, blocks,
                st.st_blksize);
 
         seek = (off64_t)seek_blocks * (off64_t)st.st_blksize;
         len = blocks * st.st_blksize;
 
-        buf = mmap(0, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, 0, 0);
-        if (buf == MAP_FAILED) {
+	map = mmap(0, len + buf_offset, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MAP_ANON, 0, 0);
+	if (map == MAP_FAILED) {
                 printf("No memory %s\n", strerror(errno));
                 return 1;
         }
-        memset(buf, pad, len);
+	buf = map + buf_offset;
+	if (pattern)
+		fill_pattern(buf, seek, len);
+	else
+		memset(buf, pad, len);
 
         if (action == O_WRONLY || action == O_RDWR) {
                 if (lseek64(fd, seek, SEEK_SET) < 0) {
@@ -146,7 +187,8 @@ int main(int argc, char **argv)
                         return 1;
                 }
 
-                if (check_bytes(buf, pad, len) != len) {
+		if ((pattern ? check_pattern(buf, seek, len) :
+			       check_bytes(buf, pad, len)) != len) {
                         printf("Data mismatch\n");
                         return 1;
                 }
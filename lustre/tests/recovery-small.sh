@@ -2634,6 +2634,77 @@ test_134() {
 }
 run_test 134 "MDT<>OST recovery don't block multistripe file creation"
 
+test_135() {
+	local ncpts
+	local before
+	local after
+	local bl_timeout
+	local enqueue_min
+	local start
+	local elapsed
+	local umount2=false
+	local i
+
+	remote_ost_nodsh && skip "remote OST with nodsh" && return 0
+
+	ncpts=$(do_facet ost1 $LCTL get_param -n ldlm.waiting_locks |
+		awk 'NR > 1' | wc -l)
+	[ $ncpts -lt 2 ] && skip "needs >= 2 CPTs on ost1" && return 0
+
+	test_mkdir -p $DIR/$tdir
+	$SETSTRIPE -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+	# cache PW locks on many objects so the waiting locks hash to
+	# every CPT wheel, not only to CPT 0
+	for ((i = 0; i < 32; i++)); do
+		dd if=/dev/zero of=$DIR/$tdir/$tfile-$i bs=4k count=1 \
+			conv=notrunc 2>/dev/null || error "dd $i failed"
+	done
+
+	if ! is_mounted $MOUNT2; then
+		mount_client $MOUNT2 || error "mount $MOUNT2 failed"
+		umount2=true
+	fi
+
+	before=$(do_facet ost1 $LCTL get_param -n ldlm.waiting_locks |
+		awk 'NR > 1 { print $3 }')
+	enqueue_min=$(do_facet ost1 \
+		cat /sys/module/ptlrpc/parameters/ldlm_enqueue_min)
+	bl_timeout=$((TIMEOUT * 3 / 2))
+	[ $bl_timeout -lt $enqueue_min ] && bl_timeout=$enqueue_min
+
+#define OBD_FAIL_LDLM_BL_CALLBACK_NET	0x305
+	$LCTL set_param fail_loc=0x305
+	start=$SECONDS
+	for ((i = 0; i < 32; i++)); do
+		dd if=/dev/zero of=$MOUNT2/$tdir/$tfile-$i bs=4k count=1 \
+			conv=notrunc 2>/dev/null &
+	done
+	wait
+	elapsed=$((SECONDS - start))
+	$LCTL set_param fail_loc=0
+	client_reconnect
+
+	after=$(do_facet ost1 $LCTL get_param -n ldlm.waiting_locks |
+		awk 'NR > 1 { print $3 }')
+
+	# some lock on a CPT other than 0 must have timed out ...
+	paste <(echo "$before") <(echo "$after") |
+		awk 'NR > 1 && $2 > $1 { found = 1 } END { exit !found }' ||
+		error "no waiting lock timed out on a non-zero CPT"
+	# ... and every wheel must have fired within a second of the
+	# lock deadline
+	do_facet ost1 $LCTL get_param -n ldlm.waiting_locks |
+		awk 'NR > 1 && $4 > 1 { exit 1 }' ||
+		error "waiting lock expired late"
+	[ $elapsed -le $((bl_timeout + TIMEOUT)) ] ||
+		error "eviction took ${elapsed}s, limit $((bl_timeout + TIMEOUT))s"
+
+	$umount2 && umount_client $MOUNT2
+	rm -rf $DIR/$tdir
+	return 0
+}
+run_test 135 "waiting lock on a non-zero CPT times out on time"
+
 complete $SECONDS
 check_and_cleanup_lustre
 exit_status
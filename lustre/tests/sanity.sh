@@ -8563,6 +8563,32 @@ test_123b () { # statahead(bug 15027)
 }
 run_test 123b "not panic with network error in statahead enqueue (bug 15027)"
 
+test_123c() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$LCTL get_param -n llite.*.statahead_stats |
+		grep -q "statahead after close" ||
+		{ skip "no statahead after dir close" && return; }
+
+	local before
+	local after
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/$tfile-%d 1000 || error "createmany failed"
+	cancel_lru_locks mdc
+	cancel_lru_locks osc
+
+	before=$($LCTL get_param -n llite.*.statahead_stats |
+		 awk '/statahead after close:/ { print $4 }' | head -n 1)
+	# du reads the whole dir and closes it before stating the entries
+	du -s $DIR/$tdir > /dev/null || error "du failed"
+	after=$($LCTL get_param -n llite.*.statahead_stats |
+		awk '/statahead after close:/ { print $4 }' | head -n 1)
+	[ $after -gt $before ] || error "no statahead for du"
+
+	rm -rf $DIR/$tdir
+}
+run_test 123c "statahead after the dir is closed (find, du)"
+
 test_124a() {
 	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
 	[ -z "$($LCTL get_param -n mdc.*.connect_flags | grep lru_resize)" ] &&
@@ -15787,6 +15813,1032 @@ test_408() {
 }
 run_test 408 "drop_caches should not hang due to page leaks"
 
+test_409() {
+	[[ $OSTCOUNT -lt 2 ]] && skip_env "needs >= 2 OSTs" && return
+
+	local pdio_sav=$($LCTL get_param -n llite.*.parallel_dio 2>/dev/null |
+			 head -n 1)
+	[ -z "$pdio_sav" ] && skip "no parallel DIO support" && return
+
+	local ref=$TMP/$tfile.ref
+	dd if=/dev/urandom of=$ref bs=1M count=16 || error "create $ref"
+
+	$SETSTRIPE -c -1 -S 1M $DIR/$tfile || error "setstripe $tfile"
+	for val in 1 0; do
+		$LCTL set_param -n llite.*.parallel_dio=$val
+		dd if=$ref of=$DIR/$tfile bs=16M count=1 oflag=direct ||
+			error "direct write with parallel_dio=$val failed"
+		cancel_lru_locks osc
+		cmp $ref $DIR/$tfile ||
+			error "data mismatch with parallel_dio=$val write"
+		dd if=$DIR/$tfile of=$ref.dio bs=16M count=1 iflag=direct ||
+			error "direct read with parallel_dio=$val failed"
+		cmp $ref $ref.dio ||
+			error "data mismatch with parallel_dio=$val read"
+		rm -f $ref.dio
+
+		# a synchronous write extending the file must be complete
+		# once it returns, the size included
+		rm -f $DIR/$tfile
+		$SETSTRIPE -c -1 -S 1M $DIR/$tfile || error "setstripe $tfile"
+		dd if=$ref of=$DIR/$tfile bs=16M count=1 oflag=direct,sync ||
+			error "O_SYNC direct write with parallel_dio=$val failed"
+		[ $(stat -c %s $DIR/$tfile) -eq $((16 * 1048576)) ] ||
+			error "bad size after parallel_dio=$val O_SYNC write"
+		cancel_lru_locks osc
+		cmp $ref $DIR/$tfile ||
+			error "data mismatch with parallel_dio=$val O_SYNC write"
+	done
+
+	$LCTL set_param -n llite.*.parallel_dio=$pdio_sav
+	rm -f $ref $DIR/$tfile
+}
+run_test 409 "parallel direct I/O across all stripes"
+
+test_410() {
+	local ref=$TMP/$tfile.ref
+	local bs
+
+	dd if=/dev/urandom of=$ref bs=1M count=3 || error "create $ref"
+
+	# dd buffers are page aligned, so an unaligned block size makes
+	# both the file offsets and the lengths unaligned
+	for bs in 512 4097 65535 1000000; do
+		rm -f $DIR/$tfile
+		dd if=$ref of=$DIR/$tfile bs=$bs oflag=direct ||
+			error "unaligned direct write bs=$bs failed"
+		cancel_lru_locks osc
+		cmp $ref $DIR/$tfile ||
+			error "data mismatch after direct write bs=$bs"
+		dd if=$DIR/$tfile of=$ref.dio bs=$bs iflag=direct ||
+			error "unaligned direct read bs=$bs failed"
+		cmp $ref $ref.dio ||
+			error "data mismatch after direct read bs=$bs"
+		rm -f $ref.dio
+	done
+
+	# user buffers misaligned against the file offset go through bounce
+	# pages, the data is a pattern of the file offset so that anything
+	# landing at the wrong place is caught as well
+	local args
+	for args in "1 3 4097 123" "3 700 4099 1" "0 5 1048577 4095"; do
+		rm -f $DIR/$tfile
+		$DIRECTIO write $DIR/$tfile $args ||
+			error "misaligned direct write $args failed"
+		# read back with a different buffer misalignment
+		$DIRECTIO read $DIR/$tfile ${args% *} 7 ||
+			error "misaligned direct read $args failed"
+		cancel_lru_locks osc
+		$DIRECTIO read $DIR/$tfile ${args% *} 2048 ||
+			error "direct read after cache drop $args failed"
+
+		# and with buffered I/O at a few offsets
+		local bs=$(echo $args | awk '{ print $3 }')
+		local seek=$(($(echo $args | awk '{ print $1 }') * bs))
+		local off
+		for off in $((seek + 1)) $((seek + bs * 2 + 4095)) \
+			   $((seek + bs * 3 - 1)); do
+			[ $(od -An -tu1 -j $off -N1 $DIR/$tfile) -eq \
+			  $((off % 251)) ] ||
+				error "bad byte at $off after direct write $args"
+		done
+	done
+
+	rm -f $ref $DIR/$tfile
+}
+run_test 410 "unaligned direct I/O"
+
+test_411() {
+	local thresh_sav=$($LCTL get_param -n llite.*.hybrid_io_threshold \
+			   2>/dev/null | head -n 1)
+	[ -z "$thresh_sav" ] && skip "no hybrid IO support" && return
+
+	local ref=$TMP/$tfile.ref
+	local used
+
+	dd if=/dev/urandom of=$ref bs=4M count=4 || error "create $ref"
+
+	$LCTL set_param -n llite.*.hybrid_io_threshold=1M
+	cancel_lru_locks osc
+	dd if=$ref of=$DIR/$tfile bs=4M || error "large buffered write failed"
+	used=$($LCTL get_param -n llite.*.max_cached_mb |
+	       awk '/used_mb/ { print $2 }' | head -n 1)
+	[ $used -lt 8 ] ||
+		error "large writes cached $used MB with hybrid IO enabled"
+
+	cancel_lru_locks osc
+	cmp $ref $DIR/$tfile || error "data mismatch after hybrid write"
+
+	# an extending O_SYNC write switched to direct I/O must be complete,
+	# size included, once it returns
+	rm -f $DIR/$tfile
+	dd if=$ref of=$DIR/$tfile bs=4M oflag=sync ||
+		error "large O_SYNC write failed"
+	[ $(stat -c %s $DIR/$tfile) -eq $((16 * 1048576)) ] ||
+		error "bad size after hybrid O_SYNC write"
+	cancel_lru_locks osc
+	cmp $ref $DIR/$tfile || error "data mismatch after hybrid O_SYNC write"
+
+	# small I/O still goes through the page cache
+	dd if=$DIR/$tfile of=/dev/null bs=4k || error "small read failed"
+	used=$($LCTL get_param -n llite.*.max_cached_mb |
+	       awk '/used_mb/ { print $2 }' | head -n 1)
+	[ $used -ge 8 ] || error "small reads were not cached ($used MB)"
+
+	$LCTL set_param -n llite.*.hybrid_io_threshold=$thresh_sav
+	rm -f $ref $DIR/$tfile
+}
+run_test 411 "switch large aligned buffered I/O to direct I/O"
+
+test_412() {
+	local thresh_sav=$($LCTL get_param -n \
+			   llite.*.read_ahead_async_file_threshold_mb \
+			   2>/dev/null | head -n 1)
+	[ -z "$thresh_sav" ] && skip "no async readahead support" && return
+
+	local ref=$TMP/$tfile.ref
+	local async
+
+	dd if=/dev/urandom of=$ref bs=1M count=64 || error "create $ref"
+	cp $ref $DIR/$tfile || error "copy to $DIR/$tfile failed"
+
+	$LCTL set_param -n llite.*.read_ahead_async_file_threshold_mb=1
+	$LCTL set_param -n llite.*.read_ahead_stats=0
+	cancel_lru_locks osc
+	cmp $ref $DIR/$tfile || error "data mismatch with async read-ahead"
+	async=$($LCTL get_param -n llite.*.read_ahead_stats |
+		awk '/async readahead/ { print $3 }' | head -n 1)
+	[ -n "$async" ] && [ $async -gt 0 ] ||
+		error "no async read-ahead issued"
+
+	$LCTL set_param -n llite.*.read_ahead_async_file_threshold_mb=$thresh_sav
+	rm -f $ref $DIR/$tfile
+}
+run_test 412 "sequential read-ahead is issued asynchronously"
+
+test_413() {
+	$LCTL get_param -n llite.*.read_ahead_stats | grep -q "resumed stream" ||
+		{ skip "no multi-stream read-ahead support" && return; }
+
+	local resumed
+	local misses
+	local i
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 || error "dd failed"
+	cancel_lru_locks osc
+	$LCTL set_param -n llite.*.read_ahead_stats=0
+
+	# read two distant regions in turn through the same file descriptor
+	exec 3< $DIR/$tfile
+	for ((i = 0; i < 16; i++)); do
+		dd bs=64k count=16 skip=$((i * 16)) of=/dev/null <&3 ||
+			error "read at $i MB failed"
+		dd bs=64k count=16 skip=$((512 + i * 16)) of=/dev/null <&3 ||
+			error "read at $((i + 32)) MB failed"
+	done
+	exec 3<&-
+
+	resumed=$($LCTL get_param -n llite.*.read_ahead_stats |
+		  awk '/resumed stream/ { print $3 }' | head -n 1)
+	misses=$($LCTL get_param -n llite.*.read_ahead_stats |
+		 awk '/^misses/ { print $2 }' | head -n 1)
+	[ -n "$resumed" ] && [ $resumed -gt 0 ] ||
+		error "read-ahead streams were never resumed"
+	# without stream tracking every 64k read after a switch misses
+	[ ${misses:-0} -lt 512 ] ||
+		error "too many read-ahead misses: $misses"
+
+	rm -f $DIR/$tfile
+}
+run_test 413 "read-ahead tracks interleaved streams on one descriptor"
+
+test_414() {
+	$LCTL get_param -n mdc.*.connect_flags | grep -q readdir_plus ||
+		{ skip "MDS does not support readdir-plus" && return; }
+
+	local rdp=$($LCTL get_param -n llite.*.readdir_plus | head -n 1)
+	local sa_max=$($LCTL get_param -n llite.*.statahead_max | head -n 1)
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/$tfile-%d 100 || error "createmany failed"
+	createmany -d $DIR/$tdir/d- 10 || error "createmany -d failed"
+	chmod 0600 $DIR/$tdir/$tfile-1* || error "chmod failed"
+	chown $RUNAS_ID $DIR/$tdir/$tfile-2* || error "chown failed"
+	ls -l $DIR/$tdir > $TMP/$tfile.ref || error "ls -l failed"
+
+	$LCTL set_param -n llite.*.statahead_max=0
+	$LCTL set_param -n llite.*.readdir_plus=1
+	cancel_lru_locks mdc
+
+	ls -l $DIR/$tdir > $TMP/$tfile.rdp || error "ls -l with rdp failed"
+	diff $TMP/$tfile.ref $TMP/$tfile.rdp ||
+		error "readdir-plus returned different attributes"
+
+	# attributes changed after readdir must not be hidden
+	chmod 0640 $DIR/$tdir/$tfile-3* || error "chmod 0640 failed"
+	[ $(ls -l $DIR/$tdir | grep -c "^-rw-r-----") -eq 11 ] ||
+		error "stale mode after chmod"
+
+	$LCTL set_param -n llite.*.readdir_plus=$rdp
+	$LCTL set_param -n llite.*.statahead_max=$sa_max
+	rm -f $TMP/$tfile.ref $TMP/$tfile.rdp
+	rm -rf $DIR/$tdir
+}
+run_test 414 "readdir-plus attributes match getattr"
+
+test_415() {
+	$LCTL get_param -n llite.*.neg_lookup_threshold > /dev/null 2>&1 ||
+		{ skip "no negative lookup caching" && return; }
+
+	local threshold=$($LCTL get_param -n llite.*.neg_lookup_threshold |
+			  head -n 1)
+	local before
+	local after
+	local i
+
+	test_mkdir -p $DIR/$tdir/sub
+	$LCTL set_param -n llite.*.neg_lookup_threshold=4
+	cancel_lru_locks mdc
+
+	before=$($LCTL get_param -n mdc.*.stats |
+		 awk '/^ldlm_ibits_enqueue/ { sum += $2 } END { print sum }')
+	# lookups through the path only fetch the LOOKUP lock of "sub"
+	for i in $(seq 100); do
+		stat $DIR/$tdir/sub/nonexist-$((i % 10)) > /dev/null 2>&1 &&
+			error "nonexist-$((i % 10)) found"
+	done
+	after=$($LCTL get_param -n mdc.*.stats |
+		awk '/^ldlm_ibits_enqueue/ { sum += $2 } END { print sum }')
+	echo "$((after - before)) enqueues for 100 negative lookups"
+	[ $((after - before)) -lt 50 ] ||
+		error "negative dentries not cached: $((after - before)) RPCs"
+
+	# the cached negative dentry must go away when the entry is created
+	touch $DIR/$tdir/sub/nonexist-1 || error "touch failed"
+	stat $DIR/$tdir/sub/nonexist-1 > /dev/null ||
+		error "nonexist-1 not found after create"
+
+	$LCTL set_param -n llite.*.neg_lookup_threshold=$threshold
+	rm -rf $DIR/$tdir
+}
+run_test 415 "negative dentries cached under the dir UPDATE lock"
+
+test_416() {
+	$LCTL get_param -n osc.*.import | grep -q short_io ||
+		{ skip "no short io support on the OSTs" && return; }
+
+	local size=$($LCTL get_param -n osc.*.short_io_bytes | head -n 1)
+	local tmp=$TMP/$tfile
+
+	$LCTL set_param -n osc.*.short_io_bytes=4096
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	dd if=/dev/urandom of=$tmp bs=3000 count=1 ||
+		error "dd to $tmp failed"
+	# sync writes and uncached reads both go through short io
+	$LCTL set_param osc.*.osc_stats=0 > /dev/null
+	dd if=$tmp of=$DIR/$tfile bs=3000 count=1 oflag=sync ||
+		error "dd to $DIR/$tfile failed"
+	cancel_lru_locks osc
+	cmp $tmp $DIR/$tfile || error "data mismatch after short io"
+
+	local stats=$($LCTL get_param -n osc.*.osc_stats)
+	local writes=$(echo "$stats" |
+		       awk '/^short_io_write_bytes/ { sum += $2 }
+			    END { print sum + 0 }')
+	local reads=$(echo "$stats" |
+		      awk '/^short_io_read_bytes/ { sum += $2 }
+			   END { print sum + 0 }')
+	echo "short io: $writes bytes written, $reads bytes read"
+	[ $writes -gt 0 ] || error "write did not use short io"
+	[ $reads -gt 0 ] || error "read did not use short io"
+
+	$LCTL set_param -n osc.*.short_io_bytes=0
+	$LCTL set_param osc.*.osc_stats=0 > /dev/null
+	cancel_lru_locks osc
+	cmp $tmp $DIR/$tfile || error "data mismatch with short io disabled"
+	$LCTL get_param -n osc.*.osc_stats |
+		awk '/^short_io_(write|read)_bytes/ { sum += $2 }
+		     END { exit sum != 0 }' ||
+		error "short io used while disabled"
+
+	$LCTL set_param -n osc.*.short_io_bytes=$size
+	rm -f $tmp $DIR/$tfile
+}
+run_test 416 "small reads and writes carried inline in the BRW RPC"
+
+test_417() {
+	$LCTL get_param -n osc.*.import | grep -q multiobj_brw ||
+		{ skip "no multi-object BRW support on the OSTs" && return; }
+
+	local nfiles=8
+	local before
+	local after
+	local i
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+	cancel_lru_locks osc
+	before=$(count_ost_writes)
+	for i in $(seq $nfiles); do
+		echo "file $i" > $DIR/$tdir/f$i || error "write f$i failed"
+	done
+	sync
+	after=$(count_ost_writes)
+	# the small files should share write RPCs instead of one each
+	(( after - before < nfiles )) ||
+		error "$((after - before)) write RPCs for $nfiles files"
+
+	cancel_lru_locks osc
+	for i in $(seq $nfiles); do
+		[ "$(cat $DIR/$tdir/f$i)" == "file $i" ] ||
+			error "data mismatch in f$i"
+	done
+	rm -rf $DIR/$tdir
+}
+run_test 417 "small files on one OST are written in one BRW"
+
+# check that the limits set by the adaptive RPC controller of osc $1 stay
+# within the bounds it works in, whatever the round trip times were:
+# max_rpcs_in_flight in [1, 4 * $2] and max_pages_per_rpc a power of 2
+# multiple of $3 up to the BRW size agreed with the OST
+osc_rpc_adapt_check() {
+	local osc=$1
+	local rif_base=$2
+	local ppr_base=$3
+	local rif=$($LCTL get_param -n $osc.max_rpcs_in_flight)
+	local ppr=$($LCTL get_param -n $osc.max_pages_per_rpc)
+	local brw=$($LCTL get_param -n $osc.import |
+		    awk '/max_brw_size:/ { print $2 }')
+	local rif_max=$((rif_base * 4))
+	local ppr_max=$ppr
+	local ratio
+
+	# OSC_MAX_RIF_MAX
+	[ $rif_max -gt 256 ] && rif_max=256
+	[ -n "$brw" ] && ppr_max=$((brw / $(getconf PAGE_SIZE)))
+	[ $ppr_max -lt $ppr_base ] && ppr_max=$ppr_base
+
+	[ $rif -ge 1 -a $rif -le $rif_max ] ||
+		error "max_rpcs_in_flight $rif not in [1, $rif_max]"
+	[ $ppr -ge $ppr_base -a $ppr -le $ppr_max ] ||
+		error "max_pages_per_rpc $ppr not in [$ppr_base, $ppr_max]"
+	ratio=$((ppr / ppr_base))
+	[ $((ratio * ppr_base)) -eq $ppr -a $((ratio & (ratio - 1))) -eq 0 ] ||
+		error "max_pages_per_rpc $ppr not $ppr_base times a power of 2"
+}
+
+test_418() {
+	local osc=$($LCTL list_param osc.*-osc-[^M]* | head -n 1)
+
+	$LCTL get_param -n $osc.adaptive_rpcs > /dev/null 2>&1 ||
+		{ skip "no adaptive RPC controller" && return; }
+
+	local rif=$($LCTL get_param -n $osc.max_rpcs_in_flight)
+	local ppr=$($LCTL get_param -n $osc.max_pages_per_rpc)
+
+	$LCTL set_param $osc.adaptive_rpcs=1
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	# a fixed number of BRW RPCs each way, at least one per MiB
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 oflag=direct ||
+		error "dd write failed"
+	dd if=$DIR/$tfile of=/dev/null bs=1M iflag=direct ||
+		error "dd read failed"
+	osc_rpc_adapt_check $osc $rif $ppr
+
+	# turning the controller off restores the configured values
+	$LCTL set_param $osc.adaptive_rpcs=0
+	[ $($LCTL get_param -n $osc.max_rpcs_in_flight) -eq $rif ] ||
+		error "max_rpcs_in_flight not restored to $rif"
+	[ $($LCTL get_param -n $osc.max_pages_per_rpc) -eq $ppr ] ||
+		error "max_pages_per_rpc not restored to $ppr"
+	rm -f $DIR/$tfile
+}
+run_test 418 "adaptive max_rpcs_in_flight and max_pages_per_rpc"
+
+test_419() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$GSS && skip "could not run with gss" && return
+
+	local types=$(lctl get_param -n osc.*osc-[^mM]*.checksum_type |
+		      head -n1)
+	local algo
+
+	[[ "$types" == *t10* ]] ||
+		{ skip "no T10 checksum types on the OSTs" && return; }
+	[ ! -f $F77_TMP ] && setup_f77
+	set_checksums 1
+	for algo in t10ip512 t10crc512; do
+		[[ "$types" == *$algo* ]] || continue
+		set_checksum_type $algo
+		dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ conv=fsync ||
+			error "dd write with $algo failed"
+		cancel_lru_locks osc
+		cmp $F77_TMP $DIR/$tfile || error "file compare with $algo failed"
+		#define OBD_FAIL_OSC_CHECKSUM_RECEIVE    0x408
+		$LCTL set_param fail_loc=0x80000408
+		cancel_lru_locks osc
+		cmp $F77_TMP $DIR/$tfile ||
+			error "file compare with $algo after resend failed"
+		$LCTL set_param fail_loc=0
+		rm -f $DIR/$tfile
+	done
+	set_checksum_type $ORIG_CSUM_TYPE
+	set_checksums 0
+}
+run_test 419 "T10-PI guard tag checksum types"
+
+test_420() {
+	local osc=$($LCTL list_param osc.*-osc-[^M]* | head -n 1)
+
+	$LCTL get_param -n $osc.write_coalesce_us > /dev/null 2>&1 ||
+		{ skip "no write coalescing window" && return; }
+
+	local window=$($LCTL get_param -n $osc.write_coalesce_us)
+	local nproc=16
+	local nrec=64
+	local i
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	$LCTL set_param $osc.write_coalesce_us=100000
+	for i in $(seq $nproc); do
+		(for j in $(seq $nrec); do
+			echo "record $i $j" >> $DIR/$tfile
+		done) &
+	done
+	wait
+	# held extents are written once their window expired
+	sleep 2
+	[ $($LCTL get_param -n $osc.cur_dirty_bytes) -eq 0 ] ||
+		error "dirty pages left after the window expired"
+	$LCTL set_param $osc.write_coalesce_us=$window
+
+	cancel_lru_locks osc
+	[ $(wc -l < $DIR/$tfile) -eq $((nproc * nrec)) ] ||
+		error "$(wc -l < $DIR/$tfile) records, expect $((nproc * nrec))"
+	for i in $(seq $nproc); do
+		[ $(grep -c "^record $i " $DIR/$tfile) -eq $nrec ] ||
+			error "records of appender $i lost"
+	done
+	rm -f $DIR/$tfile
+}
+run_test 420 "write coalescing window for concurrent appenders"
+
+test_421() {
+	$LCTL get_param -n sptlrpc.msgbuf_pools > /dev/null 2>&1 ||
+		{ skip "no message buffer pools" && return; }
+
+	local hits_sum='NR > 1 { sum += $3 } END { print sum }'
+	local before=$($LCTL get_param -n sptlrpc.msgbuf_pools |
+		       awk "$hits_sum")
+	local after
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/f 1000 || error "createmany failed"
+	unlinkmany $DIR/$tdir/f 1000 || error "unlinkmany failed"
+
+	after=$($LCTL get_param -n sptlrpc.msgbuf_pools | awk "$hits_sum")
+	[ $after -gt $before ] ||
+		error "no message buffer reused ($before -> $after)"
+	rm -rf $DIR/$tdir
+}
+run_test 421 "request and reply buffers are reused from the pools"
+
+test_422() {
+	$LCTL get_param -n osc.*.import | grep -q lockahead ||
+		{ skip "no lock ahead support on the OSTs" && return; }
+
+	local ns=$($LCTL list_param ldlm.namespaces.*-OST0000-osc-[^M]* |
+		   head -n 1)
+	local count
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	cancel_lru_locks osc
+	$LFS ladvise -a lockahead -m WRITE -s 1M -l 1M $DIR/$tfile ||
+		error "lockahead failed"
+	sleep 1
+	count=$($LCTL get_param -n $ns.lock_count)
+	[ $count -eq 1 ] || error "$count locks after lockahead, expect 1"
+
+	# the lock covers exactly the range asked for
+	$LFS ladvise -a lockahead -m WRITE -s 1M -l 4k $DIR/$tfile |
+		grep -q "already covers" || error "lock not matched"
+	$LFS ladvise -a lockahead -m WRITE -s 0 -l 4k $DIR/$tfile ||
+		error "second lockahead failed"
+	sleep 1
+	count=$($LCTL get_param -n $ns.lock_count)
+	[ $count -eq 2 ] || error "$count locks, expect 2: lock was expanded"
+
+	# writes within the locked range reuse the lock
+	dd if=/dev/zero of=$DIR/$tfile bs=1M seek=1 count=1 conv=notrunc ||
+		error "dd failed"
+	count=$($LCTL get_param -n $ns.lock_count)
+	[ $count -eq 2 ] || error "$count locks after write, expect 2"
+	rm -f $DIR/$tfile
+}
+run_test 422 "lock ahead takes exact non-expanded extent locks"
+
+test_423() {
+	local nr=32
+	local pids=""
+	local i
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	# overlapping writers and readers pile up on the waiting queue of
+	# one resource, every one of them has to be granted eventually
+	for i in $(seq 0 $((nr - 1))); do
+		dd if=/dev/zero of=$DIR/$tfile bs=64k seek=$((i / 2)) \
+			count=2 conv=notrunc 2>/dev/null &
+		pids="$pids $!"
+		dd if=$DIR/$tfile of=/dev/null bs=64k skip=$((i / 4)) \
+			count=4 2>/dev/null &
+		pids="$pids $!"
+	done
+	for i in $pids; do
+		wait $i || error "I/O process $i failed"
+	done
+
+	local size=$(stat -c %s $DIR/$tfile)
+
+	[ $size -eq $(((nr / 2 + 1) * 65536)) ] ||
+		error "wrong file size $size"
+	rm -f $DIR/$tfile
+}
+run_test 423 "overlapping conflicting extent locks are all granted"
+
+test_424() {
+	$LCTL get_param -n osc.*.import | grep -q bl_ast_batch ||
+		{ skip "no batched blocking AST support" && return; }
+	$LCTL get_param -n osc.*.import | grep -q lockahead ||
+		{ skip "no lock ahead support on the OSTs" && return; }
+
+	local ns=$($LCTL list_param ldlm.namespaces.*-OST0000-osc-[^M]* |
+		   head -n 1)
+	local nr=32
+	local count
+	local i
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	cancel_lru_locks osc
+	for i in $(seq 0 $((nr - 1))); do
+		$LFS ladvise -a lockahead -m READ -s $((i * 8))k -l 4k \
+			$DIR/$tfile || error "lockahead $i failed"
+	done
+	sleep 1
+	count=$($LCTL get_param -n $ns.lock_count)
+	[ $count -ge $nr ] || error "$count locks, expect at least $nr"
+
+	# one write revokes all of the read locks at once
+	dd if=/dev/zero of=$DIR/$tfile bs=$((nr * 8))k count=1 conv=notrunc ||
+		error "dd failed"
+	count=$($LCTL get_param -n $ns.lock_count)
+	[ $count -le 2 ] || error "$count locks left after write"
+	rm -f $DIR/$tfile
+}
+run_test 424 "blocking ASTs of one client are batched"
+
+test_425() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$LCTL get_param -n mdc.*.import | grep -q lock_convert ||
+		{ skip "no inodebits lock convert support" && return; }
+
+	local mounted=false
+	local cvt1
+	local cvt2
+
+	if ! is_mounted $MOUNT2; then
+		mount_client $MOUNT2 || error "mount $MOUNT2 failed"
+		mounted=true
+	fi
+
+	touch $DIR/$tfile || error "touch failed"
+	cancel_lru_locks mdc
+	stat $DIR/$tfile > /dev/null || error "stat failed"
+	$LCTL set_param mdc.*.stats=clear > /dev/null
+
+	# chmod only conflicts with the UPDATE and PERM bits, the first
+	# client drops them and keeps its LOOKUP bit
+	chmod 0600 $MOUNT2/$tfile || error "chmod failed"
+	cvt1=$($LCTL get_param -n mdc.*.stats |
+	       awk '/ldlm_convert/ { sum += $2 } END { print sum + 0 }')
+	[ $cvt1 -gt 0 ] || error "lock was cancelled, not converted"
+
+	# the converted lock is good for another conflict
+	stat $DIR/$tfile > /dev/null || error "stat failed"
+	chmod 0644 $MOUNT2/$tfile || error "chmod failed"
+	cvt2=$($LCTL get_param -n mdc.*.stats |
+	       awk '/ldlm_convert/ { sum += $2 } END { print sum + 0 }')
+	[ $cvt2 -gt $cvt1 ] || error "second conflict did not convert"
+	[ $(stat -c %a $DIR/$tfile) == "644" ] || error "stale mode"
+
+	$mounted && umount_client $MOUNT2
+	rm -f $DIR/$tfile
+}
+run_test 425 "inodebits locks drop conflicting bits instead of cancel"
+
+test_426() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	[[ $OSTCOUNT -lt 2 ]] &&
+		skip_env "needs >= 2 OSTs for a stride across stripes" && return
+
+	local STRIPE_SIZE=1048576
+	# every other stripe row, a chunk of two stripes starting on the
+	# second stripe, so that each chunk crosses a stripe boundary
+	local STRIDE_SIZE=$((STRIPE_SIZE * OSTCOUNT * 2))
+	local FILE_LENGTH=$((STRIDE_SIZE * 17))
+	local BSIZE=$((STRIPE_SIZE / 4))
+	local ITERATION=16
+
+	setup_test101bc $STRIPE_SIZE $FILE_LENGTH
+	cancel_lru_locks osc
+	$LCTL set_param -n llite.*.read_ahead_stats 0
+	$READS -f $DIR/$tfile -l $((STRIDE_SIZE / BSIZE)) \
+		-o $((STRIPE_SIZE / BSIZE)) -s $FILE_LENGTH \
+		-b $((STRIPE_SIZE * 2)) -a 8 -n $ITERATION ||
+		error "stride reads failed"
+
+	local stats=$($LCTL get_param -n llite.*.read_ahead_stats)
+	local total=$((ITERATION * STRIPE_SIZE * 2 / 4096))
+	local misses=$(echo "$stats" | get_named_value 'misses' |
+		       cut -d" " -f1 | calc_total)
+	local discard=$(echo "$stats" | get_named_value 'read but discarded' |
+			cut -d" " -f1 | calc_total)
+
+	echo "$total pages read, $misses misses, $discard discarded"
+	# once the stride is detected the chunks come from read-ahead, also
+	# past the stripe boundary in their middle
+	[ $misses -lt $((total / 2)) ] || {
+		echo "$stats"
+		error "too many misses ($misses of $total) for a stride read"
+	}
+	# and the gaps between the chunks are not read
+	[ $discard -lt $((total / 8)) ] || {
+		echo "$stats"
+		error "too many pages discarded ($discard) for a stride read"
+	}
+
+	cleanup_test101bc
+	true
+}
+run_test 426 "stride read-ahead across stripe boundaries"
+
+test_427() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$LCTL get_param -n mdc.*.connect_flags | grep -q readdir_plus ||
+		{ skip "MDS does not support readdir-plus" && return; }
+
+	local rdp=$($LCTL get_param -n llite.*.readdir_plus | head -n 1)
+	local sa_max=$($LCTL get_param -n llite.*.statahead_max | head -n 1)
+	local mounted=false
+	local rpcs0
+	local rpcs1
+
+	if ! is_mounted $MOUNT2; then
+		mount_client $MOUNT2 || error "mount $MOUNT2 failed"
+		mounted=true
+	fi
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/$tfile-%d 100 || error "createmany failed"
+	$LCTL set_param -n llite.*.statahead_max=0
+
+	# RPCs for the attributes of "ls -l", without and with readdir-plus
+	$LCTL set_param -n llite.*.readdir_plus=0
+	cancel_lru_locks mdc
+	$LCTL set_param mdc.*.stats=clear > /dev/null
+	ls -l $DIR/$tdir > /dev/null || error "ls -l failed"
+	rpcs0=$($LCTL get_param -n mdc.*.stats |
+		awk '/^(mds_getattr|ldlm_ibits_enqueue)/ { sum += $2 }
+		     END { print sum + 0 }')
+
+	$LCTL set_param -n llite.*.readdir_plus=1
+	cancel_lru_locks mdc
+	$LCTL set_param mdc.*.stats=clear > /dev/null
+	ls -l $DIR/$tdir > /dev/null || error "ls -l with rdp failed"
+	rpcs1=$($LCTL get_param -n mdc.*.stats |
+		awk '/^(mds_getattr|ldlm_ibits_enqueue)/ { sum += $2 }
+		     END { print sum + 0 }')
+	echo "$rpcs0 RPCs without readdir-plus, $rpcs1 with"
+	[ $rpcs1 -lt $((rpcs0 / 2)) ] ||
+		error "readdir-plus did not save RPCs: $rpcs1 vs. $rpcs0"
+
+	# the entry locks granted with readdir are revoked by another client
+	chmod 0600 $MOUNT2/$tdir/$tfile-1* || error "chmod failed"
+	[ $(ls -l $DIR/$tdir | grep -c "^-rw-------") -eq 11 ] ||
+		error "mode changed on $MOUNT2 not seen"
+	chmod 0640 $MOUNT2/$tdir/$tfile-1* || error "chmod 0640 failed"
+	[ $(ls -l $DIR/$tdir | grep -c "^-rw-r-----") -eq 11 ] ||
+		error "second mode change on $MOUNT2 not seen"
+
+	$LCTL set_param -n llite.*.readdir_plus=$rdp
+	$LCTL set_param -n llite.*.statahead_max=$sa_max
+	$mounted && umount_client $MOUNT2
+	rm -rf $DIR/$tdir
+}
+run_test 427 "readdir-plus saves RPCs and sees changes of other clients"
+
+test_428() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	[[ $OSTCOUNT -lt 2 ]] && skip_env "needs >= 2 OSTs" && return
+
+	local delay=4
+	local start_ts
+	local elapsed
+	local syncs
+
+	$LFS setstripe -c $OSTCOUNT -S 1M $DIR/$tfile ||
+		error "setstripe failed"
+	# one dirty 1MiB chunk per stripe, written back by the fsync below
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=$OSTCOUNT ||
+		error "dd failed"
+	$LCTL set_param osc.*.stats=clear > /dev/null
+
+	# every OST_WRITE is held for $delay seconds on the OSS, the stripes
+	# are only written back in parallel if fsync takes that long once
+	# rather than once per stripe
+#define OBD_FAIL_OST_BRW_PAUSE_BULK	 0x214
+	do_nodes $(comma_list $(osts_nodes)) \
+		$LCTL set_param fail_val=$delay fail_loc=0x214
+	start_ts=$SECONDS
+	$MULTIOP $DIR/$tfile oO_WRONLY:yc
+	local rc=$?
+	elapsed=$((SECONDS - start_ts))
+	do_nodes $(comma_list $(osts_nodes)) \
+		$LCTL set_param fail_val=0 fail_loc=0
+	[ $rc -eq 0 ] || error "fsync failed: rc = $rc"
+
+	syncs=$($LCTL get_param -n osc.*.stats |
+		awk '/^ost_sync/ { sum += $2 } END { print sum + 0 }')
+	[ $syncs -ge $OSTCOUNT ] ||
+		error "only $syncs OST_SYNC for $OSTCOUNT stripes"
+	[ $elapsed -ge $((delay - 1)) ] ||
+		error "fsync took ${elapsed}s, writes were not delayed"
+	[ $elapsed -lt $((delay * 2)) ] ||
+		error "stripes written back one after the other: ${elapsed}s"
+
+	rm -f $DIR/$tfile
+}
+run_test 428 "fsync writes back all stripes in parallel"
+
+test_429() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	which taskset > /dev/null 2>&1 || { skip_env "no taskset" && return; }
+
+	local osc=$($LCTL list_param osc.*OST0000-osc-[^M]* | head -n 1)
+	local ncpus=$(getconf _NPROCESSORS_ONLN)
+	local ncpts
+	local pages
+	local total
+	local cpu
+
+	ncpts=$($LCTL get_param -n $osc.osc_cached_mb |
+		awk '/^lru_cpt_pages:/ { print NF - 1 }')
+	[ -n "$ncpts" ] || { skip "no per-CPT OSC LRU" && return; }
+	[ $ncpts -ge 2 ] || { skip_env "needs >= 2 CPTs" && return; }
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+	cancel_lru_locks osc
+
+	# pages go on the LRU of the CPT of the thread caching them
+	for ((cpu = 0; cpu < ncpus; cpu++)); do
+		taskset -c $cpu dd if=/dev/zero of=$DIR/$tdir/$tfile-$cpu \
+			bs=1M count=2 2> /dev/null ||
+			error "dd on cpu $cpu failed"
+	done
+	sync
+
+	pages=$($LCTL get_param -n $osc.osc_cached_mb |
+		awk '/^lru_cpt_pages:/ { $1 = ""; print }')
+	total=$(echo $pages | awk '{ for (i = 1; i <= NF; i++) sum += $i }
+				    END { print sum + 0 }')
+	echo "LRU pages per CPT: $pages"
+	[ $(echo $pages | awk '{ for (i = 1; i <= NF; i++) n += $i > 0 }
+			       END { print n + 0 }') -ge 2 ] ||
+		error "LRU pages on one CPT only: $pages"
+
+	# shrinking takes the pages from all the partitions
+	$LCTL set_param -n $osc.osc_cached_mb=0
+	pages=$($LCTL get_param -n $osc.osc_cached_mb |
+		awk '/^lru_cpt_pages:/ { $1 = ""; print }')
+	echo "LRU pages per CPT after shrink: $pages"
+	[ $(echo $pages | awk '{ for (i = 1; i <= NF; i++) sum += $i }
+			       END { print sum + 0 }') -lt $((total / 4)) ] ||
+		error "LRU not shrunk: $pages of $total pages left"
+
+	rm -rf $DIR/$tdir
+}
+run_test 429 "OSC page LRU split per CPT"
+
+test_430() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	local osc=$($LCTL list_param osc.*OST0000-osc-[^M]* | head -n 1)
+
+	$LCTL get_param -n $osc.adaptive_rpcs > /dev/null 2>&1 ||
+		{ skip "no adaptive RPC controller" && return; }
+
+	local samples=30
+	local rif=$($LCTL get_param -n $osc.max_rpcs_in_flight)
+	local ppr=$($LCTL get_param -n $osc.max_pages_per_rpc)
+	local settings
+	local changes
+	local pid
+	local i
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	$LCTL set_param $osc.adaptive_rpcs=1
+
+	# a steady stream of writes to the one OST
+	(while true; do
+		dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 conv=fsync \
+			2> /dev/null || break
+	done) &
+	pid=$!
+
+	for ((i = 0; i < samples; i++)); do
+		sleep 1
+		settings+="$($LCTL get_param -n $osc.max_rpcs_in_flight \
+			     $osc.max_pages_per_rpc | tr '\n' ' ')\n"
+	done
+	kill $pid
+	wait $pid 2> /dev/null
+	osc_rpc_adapt_check $osc $rif $ppr
+	$LCTL set_param $osc.adaptive_rpcs=0
+
+	# once it has settled, the limits stay put under the same load
+	changes=$(echo -e "$settings" | grep -v "^$" |
+		  tail -n $((samples / 2)) |
+		  awk 'prev != "" && $0 != prev { n++ } { prev = $0 }
+		       END { print n + 0 }')
+	[ $changes -le 2 ] ||
+		error "limits changed $changes times in the last $((samples / 2))s"
+
+	rm -f $DIR/$tfile
+}
+run_test 430 "adaptive RPC limits converge under a steady load"
+
+test_431() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$GSS && skip "could not run with gss" && return
+	$LCTL get_param -n crypto_mb_stats > /dev/null 2>&1 ||
+		{ skip "no multi-lane checksum engine" && return; }
+
+	local types=$($LCTL get_param -n osc.*osc-[^mM]*.checksum_type |
+		      head -n1)
+	local tested=0
+	local before
+	local after
+	local speed
+	local algo
+	local alg
+
+	[ ! -f $F77_TMP ] && setup_f77
+	set_checksums 1
+	while read alg speed before; do
+		[ "$alg" = "algorithm" ] && continue
+		[ $speed -gt 0 ] || continue
+		# the OSC name of the adler32 hash is "adler"
+		algo=${alg%32}
+		[[ "$types" == *$algo* ]] || continue
+
+		set_checksum_type $algo
+		dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ \
+			oflag=direct || error "direct write with $algo failed"
+		cancel_lru_locks osc
+		cmp $F77_TMP $DIR/$tfile || error "file compare with $algo failed"
+		after=$($LCTL get_param -n crypto_mb_stats |
+			awk '$1 == "'$alg'" { print $3 }')
+		[ $after -gt $before ] ||
+			error "$alg multi-lane engine not used ($before/$after)"
+		tested=$((tested + 1))
+	done < <($LCTL get_param -n crypto_mb_stats)
+	set_checksum_type $ORIG_CSUM_TYPE
+	set_checksums 0
+	rm -f $DIR/$tfile
+
+	[ $tested -gt 0 ] ||
+		skip "multi-lane engine slower than the crypto API here"
+}
+run_test 431 "multi-lane bulk checksums match the crypto API ones"
+
+ptlrpcd_stats_sum() {
+	$LCTL get_param -n ptlrpcd_stats |
+		awk '$1 != "thread" { sum += $'$1' } END { print sum + 0 }'
+}
+
+test_432() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$LCTL get_param -n ptlrpcd_stats > /dev/null 2>&1 ||
+		{ skip "no ptlrpcd stats" && return; }
+	[ "$(cat /sys/module/ptlrpc/parameters/ptlrpcd_check_changed)" != 0 ] ||
+		{ skip "ptlrpcd_check_changed is disabled" && return; }
+
+	local full
+	local changed
+	local i
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -c -1 $DIR/$tdir || error "setstripe failed"
+
+	full=$(ptlrpcd_stats_sum 2)
+	changed=$(ptlrpcd_stats_sum 3)
+
+	# many async RPCs in flight at once, whose replies come one by one
+	for ((i = 0; i < 16; i++)); do
+		dd if=/dev/zero of=$DIR/$tdir/$tfile.$i bs=1M count=16 \
+			2> /dev/null &
+	done
+	wait
+	sync
+
+	full=$(($(ptlrpcd_stats_sum 2) - full))
+	changed=$(($(ptlrpcd_stats_sum 3) - changed))
+
+	[ $changed -gt 0 ] ||
+		error "ptlrpcd always scanned the whole set ($full scans)"
+
+	rm -rf $DIR/$tdir
+}
+run_test 432 "ptlrpcd only checks the changed requests of its set"
+
+test_433() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	which taskset > /dev/null 2>&1 || { skip_env "no taskset" && return; }
+	$LCTL get_param -n ptlrpcd_stats 2> /dev/null | grep -q cpt_stolen ||
+		{ skip "no ptlrpcd steal stats" && return; }
+	[ "$(cat /sys/module/ptlrpc/parameters/ptlrpcd_work_stealing)" != 0 ] ||
+		{ skip "ptlrpcd_work_stealing is disabled" && return; }
+
+	local group=$(cat \
+		/sys/module/ptlrpc/parameters/ptlrpcd_partner_group_size)
+	local nthreads=$($LCTL get_param -n ptlrpcd_stats |
+		grep -c "^ptlrpcd_00_")
+	local cpt
+
+	# only the threads outside the partner group of the busy one steal
+	# through the CPT rather than from their partners
+	[ $group -gt 0 -a $nthreads -gt $group ] ||
+		{ skip "all ptlrpcd threads of a CPT are partners" && return; }
+
+	$LFS setstripe -c -1 $DIR/$tfile || error "setstripe failed"
+	cpt=$(ptlrpcd_stats_sum 6)
+
+	# one writer queues a burst of async RPCs from a single CPU, the idle
+	# ptlrpcd threads of its node take their share of them
+	taskset -c 0 dd if=/dev/zero of=$DIR/$tfile bs=1M count=256 ||
+		error "dd failed"
+	sync
+
+	[ $(ptlrpcd_stats_sum 6) -gt $cpt ] ||
+		error "no ptlrpcd thread stole a request through the CPT"
+
+	rm -f $DIR/$tfile
+}
+run_test 433 "idle ptlrpcd threads steal the requests of a busy one"
+
+test_434() {
+	$LCTL get_param -n osc.*.import | grep -q lockahead ||
+		{ skip "no lock ahead support on the OSTs" && return; }
+	[ $OSTCOUNT -lt 2 ] && skip_env "needs >= 2 OSTs" && return
+
+	local ns0=$($LCTL list_param ldlm.namespaces.*-OST0000-osc-[^M]* |
+		    head -n 1)
+	local ns1=$($LCTL list_param ldlm.namespaces.*-OST0001-osc-[^M]* |
+		    head -n 1)
+	local count0
+	local count1
+	local out
+
+	$LFS setstripe -c 2 -i 0 -S 1M $DIR/$tfile || error "setstripe failed"
+	cancel_lru_locks osc
+
+	# the first stripe only
+	$LFS ladvise -a lockahead -m WRITE -s 0 -l 1M $DIR/$tfile ||
+		error "lockahead of stripe 0 failed"
+	sleep 1
+	count0=$($LCTL get_param -n $ns0.lock_count)
+	count1=$($LCTL get_param -n $ns1.lock_count)
+	[ $count0 -eq 1 -a $count1 -eq 0 ] ||
+		error "$count0/$count1 locks on OST0000/OST0001, expect 1/0"
+
+	# the lock of stripe 0 does not stop the enqueue of stripe 1
+	out=$($LFS ladvise -a lockahead -m WRITE -s 0 -l 2M $DIR/$tfile) ||
+		error "lockahead of both stripes failed"
+	echo "$out" | grep -q "already covers" &&
+		error "extent reported as covered: $out"
+	sleep 1
+	count0=$($LCTL get_param -n $ns0.lock_count)
+	count1=$($LCTL get_param -n $ns1.lock_count)
+	[ $count0 -eq 1 -a $count1 -eq 1 ] ||
+		error "$count0/$count1 locks on OST0000/OST0001, expect 1/1"
+
+	# only now is the whole extent covered
+	$LFS ladvise -a lockahead -m WRITE -s 0 -l 2M $DIR/$tfile |
+		grep -q "already covers" || error "locks not matched"
+
+	rm -f $DIR/$tfile
+}
+run_test 434 "lock ahead enqueues the stripes not covered yet"
+
 #
 # tests that do cleanup/setup should be run at the end
 #
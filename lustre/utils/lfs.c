@@ -387,7 +387,8 @@ command_t cmdlist[] = {
 	 "usage: ladvise [--advice|-a ADVICE] [--start|-s START[kMGT]]\n"
 	 "               [--background|-b]\n"
 	 "               {[--end|-e END[kMGT]] | [--length|-l LENGTH[kMGT]]}\n"
-	 "               <file> ..."},
+	 "               [--mode|-m {READ,WRITE}] <file> ...\n"
+	 "--mode is the lock mode requested by the lockahead advice."},
 	{"help", Parser_help, 0, "help"},
 	{"exit", Parser_quit, 0, "quit"},
 	{"quit", Parser_quit, 0, "quit"},
@@ -4392,6 +4393,21 @@ static int lfs_swap_layouts(int argc, char **argv)
 }
 
 static const char *const ladvise_names[] = LU_LADVISE_NAMES;
+static const char *const lock_mode_names[] = LOCK_MODE_NAMES;
+
+static enum lock_mode_user lfs_get_lock_mode(const char *string)
+{
+	enum lock_mode_user mode;
+
+	for (mode = 0; mode < ARRAY_SIZE(lock_mode_names); mode++) {
+		if (lock_mode_names[mode] == NULL)
+			continue;
+		if (strcasecmp(string, lock_mode_names[mode]) == 0)
+			return mode;
+	}
+
+	return 0;
+}
 
 static enum lu_ladvise_type lfs_get_ladvice(const char *string)
 {
@@ -4416,9 +4432,10 @@ static int lfs_ladvise(int argc, char **argv)
 		{"end",		required_argument,	0, 'e'},
 		{"start",	required_argument,	0, 's'},
 		{"length",	required_argument,	0, 'l'},
+		{"mode",	required_argument,	0, 'm'},
 		{0, 0, 0, 0}
 	};
-	char			 short_opts[] = "a:be:l:s:";
+	char			 short_opts[] = "a:be:l:m:s:";
 	int			 c;
 	int			 rc = 0;
 	const char		*path;
@@ -4430,6 +4447,7 @@ static int lfs_ladvise(int argc, char **argv)
 	unsigned long long	 length = 0;
 	unsigned long long	 size_units;
 	unsigned long long	 flags = 0;
+	enum lock_mode_user	 mode = 0;
 
 	optind = 0;
 	while ((c = getopt_long(argc, argv, short_opts,
@@ -4488,6 +4506,15 @@ static int lfs_ladvise(int argc, char **argv)
 				return CMD_HELP;
 			}
 			break;
+		case 'm':
+			mode = lfs_get_lock_mode(optarg);
+			if (mode == 0) {
+				fprintf(stderr, "%s: bad lock mode '%s', "
+					"expect READ or WRITE\n",
+					argv[0], optarg);
+				return CMD_HELP;
+			}
+			break;
 		case '?':
 			return CMD_HELP;
 		default:
@@ -4516,6 +4543,12 @@ static int lfs_ladvise(int argc, char **argv)
 		return CMD_HELP;
 	}
 
+	if (advice_type == LU_LADVISE_LOCKAHEAD && mode == 0) {
+		fprintf(stderr, "%s: lockahead needs a lock mode (-m)\n",
+			argv[0]);
+		return CMD_HELP;
+	}
+
 	if (end != LUSTRE_EOF && length != 0 && end != start + length) {
 		fprintf(stderr, "%s: conflicting arguments of -l and -e\n",
 			argv[0]);
@@ -4549,6 +4582,8 @@ static int lfs_ladvise(int argc, char **argv)
 		advice.lla_advice = advice_type;
 		advice.lla_value1 = 0;
 		advice.lla_value2 = 0;
+		if (advice_type == LU_LADVISE_LOCKAHEAD)
+			advice.lla_lockahead_mode = mode;
 		advice.lla_value3 = 0;
 		advice.lla_value4 = 0;
 		rc2 = llapi_ladvise(fd, flags, 1, &advice);
@@ -4558,6 +4593,16 @@ static int lfs_ladvise(int argc, char **argv)
 				"'%s': %s\n", argv[0],
 				ladvise_names[advice_type],
 				path, strerror(errno));
+		} else if (advice_type == LU_LADVISE_LOCKAHEAD &&
+			   advice.lla_lockahead_result == LLA_RESULT_SAME) {
+			printf("%s: a lock already covers [%llu, %llu)\n",
+			       path, start, end);
+		} else if (advice_type == LU_LADVISE_LOCKAHEAD &&
+			   (int)advice.lla_lockahead_result < 0) {
+			rc2 = (int)advice.lla_lockahead_result;
+			fprintf(stderr, "%s: cannot lock ahead [%llu, %llu) "
+				"of file '%s': %s\n", argv[0], start, end,
+				path, strerror(-rc2));
 		}
 next:
 		if (rc == 0 && rc2 < 0)
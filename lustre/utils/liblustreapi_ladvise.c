@@ -76,9 +76,16 @@ int llapi_ladvise(int fd, unsigned long long flags, int num_advise,
 
 	rc = ioctl(fd, LL_IOC_LADVISE, ladvise_hdr);
 	if (rc < 0) {
-		llapi_error(LLAPI_MSG_ERROR, -errno, "cannot give advice");
+		rc = -errno;
+		llapi_error(LLAPI_MSG_ERROR, rc, "cannot give advice");
+		free(ladvise_hdr);
+		errno = -rc;
 		return -1;
 	}
+
+	/* lock ahead returns its results in the advices */
+	memcpy(ladvise, ladvise_hdr->lah_advise, sizeof(*ladvise) * num_advise);
+	free(ladvise_hdr);
 	return 0;
 }
 
@@ -280,6 +280,7 @@ check_lu_dirent(void)
 	CHECK_VALUE_X(LUDA_FID);
 	CHECK_VALUE_X(LUDA_TYPE);
 	CHECK_VALUE_X(LUDA_64BITHASH);
+	CHECK_VALUE_X(LUDA_ATTRS);
 }
 
 static void
@@ -290,6 +291,26 @@ check_luda_type(void)
 	CHECK_MEMBER(luda_type, lt_type);
 }
 
+static void
+check_luda_attrs(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(luda_attrs);
+	CHECK_MEMBER(luda_attrs, lda_valid);
+	CHECK_MEMBER(luda_attrs, lda_size);
+	CHECK_MEMBER(luda_attrs, lda_blocks);
+	CHECK_MEMBER(luda_attrs, lda_mtime);
+	CHECK_MEMBER(luda_attrs, lda_atime);
+	CHECK_MEMBER(luda_attrs, lda_ctime);
+	CHECK_MEMBER(luda_attrs, lda_mode);
+	CHECK_MEMBER(luda_attrs, lda_uid);
+	CHECK_MEMBER(luda_attrs, lda_gid);
+	CHECK_MEMBER(luda_attrs, lda_nlink);
+	CHECK_MEMBER(luda_attrs, lda_flags);
+	CHECK_MEMBER(luda_attrs, lda_lock_idx);
+	CHECK_MEMBER(luda_attrs, lda_lock);
+}
+
 static void
 check_lu_dirpage(void)
 {
@@ -578,10 +599,17 @@ check_obd_connect_data(void)
 	CHECK_DEFINE_64X(OBD_CONNECT_OBDOPACK);
 	CHECK_DEFINE_64X(OBD_CONNECT_FLAGS2);
 	CHECK_DEFINE_64X(OBD_CONNECT2_FILE_SECCTX);
+	CHECK_DEFINE_64X(OBD_CONNECT2_READDIR_PLUS);
+	CHECK_DEFINE_64X(OBD_CONNECT2_MULTIOBJ_BRW);
+	CHECK_DEFINE_64X(OBD_CONNECT2_LOCKAHEAD);
+	CHECK_DEFINE_64X(OBD_CONNECT2_BL_AST_BATCH);
+	CHECK_DEFINE_64X(OBD_CONNECT2_LOCK_CONVERT);
 
 	CHECK_VALUE_X(OBD_CKSUM_CRC32);
 	CHECK_VALUE_X(OBD_CKSUM_ADLER);
 	CHECK_VALUE_X(OBD_CKSUM_CRC32C);
+	CHECK_VALUE_X(OBD_CKSUM_T10IP512);
+	CHECK_VALUE_X(OBD_CKSUM_T10CRC512);
 }
 
 static void
@@ -675,6 +703,8 @@ check_obdo(void)
 	CHECK_CVALUE_X(OBD_FL_CKSUM_CRC32);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_ADLER);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_CRC32C);
+	CHECK_CVALUE_X(OBD_FL_CKSUM_T10IP512);
+	CHECK_CVALUE_X(OBD_FL_CKSUM_T10CRC512);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_RSVD2);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_RSVD3);
 	CHECK_CVALUE_X(OBD_FL_SHRINK_GRANT);
@@ -1309,6 +1339,7 @@ check_ldlm_inodebits(void)
 	BLANK_LINE();
 	CHECK_STRUCT(ldlm_inodebits);
 	CHECK_MEMBER(ldlm_inodebits, bits);
+	CHECK_MEMBER(ldlm_inodebits, cancel_bits);
 }
 
 static void
@@ -2628,6 +2659,7 @@ main(int argc, char **argv)
 	check_ost_id();
 	check_lu_dirent();
 	check_luda_type();
+	check_luda_attrs();
 	check_lu_dirpage();
 	check_lu_ladvise();
 	check_ladvise_hdr();